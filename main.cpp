@@ -1 +1,594 @@
-// main
+// fr-recorder: flight data recorder.
+//
+//   fr-recorder record  --root DIR [--config FILE.frcfg] [--source SPEC]... [--headroom-mb N]
+//                       [--vehicle-shards N] [--codec none|lz4|zstd] [--workers N]
+//                       [--raw off|also|only] [--key-file FILE] [--manifest-key FILE]
+//                       [--health-udp HOST:PORT] [--health-sysid N] [--health-ms N] [--stall-ms N]
+//                       [--thermal auto|off] [--hot-c N] [--cool-c N] [--sysfs DIR]
+//                       [--udp-rcvbuf-kb N] [--udp-batch N] [--udp-gro on|off]
+//                       [--serial-ring-kb N] [--serial-coalesce-us N] [--serial-low-latency on|off]
+//                       [--reorder-ms N] [--sessions off|arm] [--pre-roll-s N] [--post-roll-s N]
+//   fr-recorder decode  --root DIR [--flight ID] [--out DIR] [--config FILE.frcfg] [--workers N]
+//                       [--key-file FILE]
+//   fr-recorder query   --root DIR [--flight ID | --last N] --channel NAME|ID [--channel ...]
+//                       [--from S] [--to S] [--where-min V] [--where-max V] [--where-eq V]...
+//                       [--agg count,min,max,avg,p50,p99,hist] [--bins N] [--rows] [--workers N]
+//                       [--resolution auto|raw] [--max-points N] [--key-file FILE]
+//   fr-recorder replay  --root DIR [--flight ID] --to udp:HOST:PORT|pty[:LINK] [--speed X|max]
+//                       [--source NAME|INDEX] [--key-file FILE]
+//   fr-recorder verify  --root DIR [--workers N] [--key-file FILE] [--manifest-key FILE]
+//   fr-recorder catalog --root DIR [--rebuild]
+//   fr-recorder compile-config --in FILE --out FILE.frcfg
+//   fr-recorder offload --root DIR [--bind ADDR] [--port N]
+//   fr-recorder fetch   --host HOST [--port N] --dest DIR [--retries N]
+//
+// --key-file: 32-byte master key (raw or hex) for encrypted-at-rest flights.
+// --manifest-key: same format; signs (record) or checks (verify) flight manifests.
+//
+// Build: g++ -std=c++17 -O2 -pthread main.cpp src/*.cpp -o fr-recorder
+//        (add -DFR_HAVE_ZSTD ... -lzstd for the zstd codec)
+// Tests: g++ -std=c++17 -O2 -pthread tests/*.cpp src/*.cpp -o fr-tests && ./fr-tests
+
+#include <signal.h>
+
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "src/catalog.hpp"
+#include "src/codec.hpp"
+#include "src/config.hpp"
+#include "src/fs_util.hpp"
+#include "src/hash_chain.hpp"
+#include "src/lazy_decode.hpp"
+#include "src/log.hpp"
+#include "src/offload.hpp"
+#include "src/query.hpp"
+#include "src/recorder.hpp"
+#include "src/replay.hpp"
+#include "src/segment_crypto.hpp"
+#include "src/segment_reader.hpp"
+#include "src/storage_layout.hpp"
+#include "src/task_pool.hpp"
+
+namespace {
+
+// --key value pairs; a --key followed by another --key (or nothing) is "1".
+// Keys may repeat; str()/num() return the last value, all() every value.
+class Args {
+public:
+    Args(int argc, char** argv, int first) {
+        for (int i = first; i < argc; ++i) {
+            if (std::strncmp(argv[i], "--", 2) != 0) {
+                std::fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+                std::exit(2);
+            }
+            std::string key = argv[i] + 2;
+            if (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0)
+                values_[key].push_back(argv[++i]);
+            else
+                values_[key].push_back("1");
+        }
+    }
+
+    bool has(const std::string& key) const { return values_.count(key) != 0; }
+
+    std::string str(const std::string& key, const std::string& def = "") const {
+        auto it = values_.find(key);
+        return it == values_.end() ? def : it->second.back();
+    }
+
+    std::vector<std::string> all(const std::string& key) const {
+        auto it = values_.find(key);
+        return it == values_.end() ? std::vector<std::string>{} : it->second;
+    }
+
+    long num(const std::string& key, long def) const {
+        auto it = values_.find(key);
+        return it == values_.end() ? def : std::strtol(it->second.back().c_str(), nullptr, 0);
+    }
+
+    std::string required(const std::string& key) const {
+        auto it = values_.find(key);
+        if (it == values_.end()) {
+            std::fprintf(stderr, "missing required --%s\n", key.c_str());
+            std::exit(2);
+        }
+        return it->second.back();
+    }
+
+private:
+    std::map<std::string, std::vector<std::string>> values_;
+};
+
+// Blocks SIGINT/SIGTERM in every thread (call before spawning any) and
+// returns once one is delivered.
+sigset_t block_stop_signals() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    return set;
+}
+
+// Null without --<flag>; throws if the file is unusable.
+std::shared_ptr<const fr::MasterKey> key_from(const Args& args, const char* flag = "key-file") {
+    return args.has(flag) ? fr::load_master_key(args.str(flag)) : nullptr;
+}
+
+void wait_for_stop(const sigset_t& set) {
+    int sig = 0;
+    sigwait(&set, &sig);
+    FR_LOG_INFO("received signal %d, shutting down", sig);
+}
+
+int cmd_record(const Args& args) {
+    sigset_t stop = block_stop_signals();
+    fr::RecorderConfig cfg;
+    cfg.root = args.required("root");
+    if (args.has("config")) {
+        std::string err;
+        cfg.config = fr::CompiledConfig::load(args.str("config"), &err);
+        if (!cfg.config) {
+            std::fprintf(stderr, "%s\n", err.c_str());
+            return 2;
+        }
+    }
+    for (const auto& text : args.all("source")) {
+        fr::SourceSpec spec;
+        std::string err;
+        if (!fr::parse_source_spec(text, &spec, &err)) {
+            std::fprintf(stderr, "%s\n", err.c_str());
+            return 2;
+        }
+        cfg.sources.push_back(spec);
+    }
+    if (cfg.sources.empty() && (!cfg.config || cfg.config->source_count() == 0)) {
+        std::fprintf(stderr, "record: at least one --source (or a config with sources) is required\n");
+        return 2;
+    }
+    cfg.vehicle_shards = static_cast<unsigned>(args.num("vehicle-shards", 0));
+    cfg.worker_threads = static_cast<unsigned>(args.num("workers", 0));
+    const std::string raw = args.str("raw", "off");
+    if (raw == "also") {
+        cfg.raw_capture = fr::RawCapture::Also;
+    } else if (raw == "only") {
+        cfg.raw_capture = fr::RawCapture::Only;
+    } else if (raw != "off") {
+        std::fprintf(stderr, "record: --raw must be off, also or only\n");
+        return 2;
+    }
+    if (args.has("codec") && (!fr::codec::parse(args.str("codec"), &cfg.writer.codec) ||
+                              !fr::codec::available(cfg.writer.codec))) {
+        std::fprintf(stderr, "record: codec '%s' is not available\n", args.str("codec").c_str());
+        return 2;
+    }
+    if (args.has("headroom-mb")) cfg.retention.headroom_bytes = static_cast<uint64_t>(args.num("headroom-mb", 0)) << 20;
+    cfg.writer.key = key_from(args);
+    if (cfg.writer.key && !fr::AesGcm::hardware()) FR_LOG_WARN("record: no AES instructions on this CPU; encryption is slow");
+    cfg.manifest_key = key_from(args, "manifest-key");
+    if (args.has("health-udp")) {
+        const std::string target = args.str("health-udp");
+        const size_t colon = target.rfind(':');
+        if (colon == std::string::npos || colon == 0) {
+            std::fprintf(stderr, "record: --health-udp expects HOST:PORT\n");
+            return 2;
+        }
+        cfg.health.udp_host = target.substr(0, colon);
+        cfg.health.udp_port = static_cast<uint16_t>(std::strtoul(target.c_str() + colon + 1, nullptr, 10));
+    }
+    cfg.health.sysid = static_cast<uint8_t>(args.num("health-sysid", cfg.health.sysid));
+    cfg.health.interval = std::chrono::milliseconds(args.num("health-ms", cfg.health.interval.count()));
+    cfg.health.stall_after = std::chrono::milliseconds(args.num("stall-ms", cfg.health.stall_after.count()));
+    cfg.thermal_governor = args.str("thermal", "auto") != "off";
+    cfg.thermal.hot_c = static_cast<double>(args.num("hot-c", static_cast<long>(cfg.thermal.hot_c)));
+    cfg.thermal.cool_c = static_cast<double>(args.num("cool-c", static_cast<long>(cfg.thermal.cool_c)));
+    cfg.thermal.sysfs_root = args.str("sysfs", cfg.thermal.sysfs_root);
+    cfg.reorder_window = std::chrono::milliseconds(args.num("reorder-ms", cfg.reorder_window.count()));
+    fr::UdpOptions& udp = cfg.source_options.udp;
+    udp.rcvbuf_bytes = static_cast<int>(args.num("udp-rcvbuf-kb", udp.rcvbuf_bytes / 1024) * 1024);
+    udp.batch = static_cast<unsigned>(args.num("udp-batch", udp.batch));
+    udp.gro = args.str("udp-gro", "on") != "off";
+    fr::SerialOptions& serial = cfg.source_options.serial;
+    serial.ring_bytes = static_cast<size_t>(args.num("serial-ring-kb", static_cast<long>(serial.ring_bytes >> 10))) << 10;
+    serial.coalesce_us = static_cast<unsigned>(args.num("serial-coalesce-us", serial.coalesce_us));
+    serial.low_latency = args.str("serial-low-latency", "on") != "off";
+    const std::string sessions = args.str("sessions", "off");
+    if (sessions != "off" && sessions != "arm") {
+        std::fprintf(stderr, "record: --sessions must be off or arm\n");
+        return 2;
+    }
+    cfg.sessions.enabled = sessions == "arm";
+    if (cfg.sessions.enabled && cfg.raw_capture == fr::RawCapture::Only) {
+        std::fprintf(stderr, "record: --sessions arm needs framing; not with --raw only\n");
+        return 2;
+    }
+    cfg.sessions.pre_roll = std::chrono::seconds(args.num("pre-roll-s", 30));
+    cfg.sessions.post_roll = std::chrono::seconds(args.num("post-roll-s", 5));
+
+    fr::Recorder recorder(cfg);
+    recorder.start();
+    wait_for_stop(stop);
+    recorder.stop();
+    auto s = recorder.stats();
+    FR_LOG_INFO("recorded %llu records (%llu dropped, %llu lost to write errors), %llu bytes, %llu vehicles",
+                static_cast<unsigned long long>(s.records), static_cast<unsigned long long>(s.dropped),
+                static_cast<unsigned long long>(s.write_failed),
+                static_cast<unsigned long long>(s.bytes_written), static_cast<unsigned long long>(s.vehicles));
+    if (cfg.sessions.enabled)
+        FR_LOG_INFO("%llu sorties; %llu records outside them not kept", static_cast<unsigned long long>(s.sessions),
+                    static_cast<unsigned long long>(s.pre_roll_discarded));
+    if (s.late)
+        FR_LOG_INFO("%llu records arrived after the reorder window and were written out of time order",
+                    static_cast<unsigned long long>(s.late));
+    if (s.link.lost() || s.link.framing_errors)
+        FR_LOG_WARN("links: %llu kernel drops, %llu truncated, %llu UART overruns, %llu framing/parity errors, "
+                    "%llu bytes over full rings",
+                    static_cast<unsigned long long>(s.link.kernel_drops), static_cast<unsigned long long>(s.link.truncated),
+                    static_cast<unsigned long long>(s.link.overruns),
+                    static_cast<unsigned long long>(s.link.framing_errors),
+                    static_cast<unsigned long long>(s.link.ring_drops));
+    return 0;
+}
+
+int cmd_decode(const Args& args) {
+    fr::TaskPool pool(static_cast<unsigned>(args.num("workers", 0)));
+    fr::LazyDecodeConfig cfg;
+    cfg.root = args.required("root");
+    cfg.flight_id = args.str("flight");
+    cfg.out_root = args.str("out");
+    cfg.pool = &pool;
+    cfg.key = key_from(args);
+    if (args.has("config")) {
+        std::string err;
+        cfg.config = fr::CompiledConfig::load(args.str("config"), &err);
+        if (!cfg.config) {
+            std::fprintf(stderr, "%s\n", err.c_str());
+            return 2;
+        }
+    }
+    fr::LazyDecoder decoder(cfg);
+    if (!decoder.run()) {
+        FR_LOG_ERROR("decode: %s", decoder.error().c_str());
+        return 1;
+    }
+    const auto& s = decoder.stats();
+    std::printf("%s -> %s: %llu segments, %llu raw bytes, %llu frames (%llu bad checksums), %llu records\n",
+                decoder.flight_id().c_str(), decoder.out_flight_id().c_str(), static_cast<unsigned long long>(s.segments),
+                static_cast<unsigned long long>(s.raw_bytes), static_cast<unsigned long long>(s.frames),
+                static_cast<unsigned long long>(s.crc_errors), static_cast<unsigned long long>(s.records_out));
+    return 0;
+}
+
+int cmd_query(const Args& args) {
+    fr::TaskPool pool(static_cast<unsigned>(args.num("workers", 0)));
+    fr::QueryEngine engine(args.required("root"), &pool);
+    engine.set_key(key_from(args));
+    std::vector<std::string> flights =
+        args.has("flight") ? args.all("flight") : engine.recent_flights(static_cast<size_t>(args.num("last", 1)));
+    if (flights.empty()) {
+        std::fprintf(stderr, "query: no flights\n");
+        return 1;
+    }
+
+    fr::QuerySpec spec;
+    std::vector<std::string> names = args.all("channel");
+    for (const auto& name : names) {
+        uint32_t id = 0;
+        if (!engine.resolve_channel(flights.back(), name, &id)) {
+            std::fprintf(stderr, "query: unknown channel '%s'\n", name.c_str());
+            return 2;
+        }
+        spec.channels.push_back(id);
+    }
+    if (args.has("from") || args.has("to")) {
+        spec.relative_time = true;
+        if (args.has("from")) spec.t_from = static_cast<int64_t>(std::strtod(args.str("from").c_str(), nullptr) * 1e9);
+        if (args.has("to")) spec.t_to = static_cast<int64_t>(std::strtod(args.str("to").c_str(), nullptr) * 1e9);
+    }
+    if (args.has("where-min")) spec.v_lo = std::strtod(args.str("where-min").c_str(), nullptr);
+    if (args.has("where-max")) spec.v_hi = std::strtod(args.str("where-max").c_str(), nullptr);
+    for (const auto& v : args.all("where-eq")) spec.v_in.push_back(std::strtod(v.c_str(), nullptr));
+    if (args.has("agg")) {
+        spec.aggregates = 0;
+        std::stringstream list(args.str("agg"));
+        std::string a;
+        while (std::getline(list, a, ',')) {
+            if (a == "count") spec.aggregates |= fr::kAggCount;
+            else if (a == "min") spec.aggregates |= fr::kAggMin;
+            else if (a == "max") spec.aggregates |= fr::kAggMax;
+            else if (a == "avg") spec.aggregates |= fr::kAggAvg;
+            else if (a == "hist") spec.aggregates |= fr::kAggHistogram;
+            else if (a.size() > 1 && a[0] == 'p') {
+                spec.aggregates |= fr::kAggPercentiles;
+                spec.percentiles.push_back(std::strtod(a.c_str() + 1, nullptr) / 100.0);
+            } else {
+                std::fprintf(stderr, "query: unknown aggregate '%s'\n", a.c_str());
+                return 2;
+            }
+        }
+    }
+    spec.histogram_bins = static_cast<unsigned>(args.num("bins", spec.histogram_bins));
+    spec.rows = args.has("rows");
+    const std::string resolution = args.str("resolution", "auto");
+    if (resolution != "auto" && resolution != "raw") {
+        std::fprintf(stderr, "query: --resolution must be auto or raw\n");
+        return 2;
+    }
+    spec.use_rollups = resolution == "auto";
+    spec.max_points = static_cast<int64_t>(args.num("max-points", static_cast<long>(spec.max_points)));
+
+    fr::QueryResult res;
+    if (!engine.run(spec, flights, &res)) {
+        std::fprintf(stderr, "query: %s\n", engine.error().c_str());
+        return 1;
+    }
+    if (engine.read_errors())
+        std::fprintf(stderr, "query: skipped %llu unreadable segments or chunks (encrypted flights need --key-file)\n",
+                     static_cast<unsigned long long>(engine.read_errors()));
+    if (spec.rows) {
+        std::printf("t_ns,channel,value\n");
+        for (const auto& r : res.rows) std::printf("%lld,0x%08x,%.17g\n", static_cast<long long>(r.t), r.channel, r.value);
+    }
+    for (size_t i = 0; i < res.channels.size(); ++i) {
+        const auto& c = res.channels[i];
+        std::printf("%s:", names[i].c_str());
+        if (spec.aggregates & fr::kAggCount) std::printf(" count=%llu", static_cast<unsigned long long>(c.count));
+        if (!c.matched) {
+            std::printf(" no samples\n");
+            continue;
+        }
+        if (spec.aggregates & fr::kAggMin) std::printf(" min=%g", c.min);
+        if (spec.aggregates & fr::kAggMax) std::printf(" max=%g", c.max);
+        if (spec.aggregates & fr::kAggAvg) std::printf(" avg=%g", c.avg());
+        for (size_t k = 0; k < c.percentiles.size(); ++k) std::printf(" p%g=%g", spec.percentiles[k] * 100, c.percentiles[k]);
+        std::printf("\n");
+        const double width = (c.histogram_hi - c.histogram_lo) / std::max<size_t>(1, c.histogram.size());
+        for (size_t k = 0; k < c.histogram.size(); ++k)
+            std::printf("  [%g, %g) %llu\n", c.histogram_lo + k * width, c.histogram_lo + (k + 1) * width,
+                        static_cast<unsigned long long>(c.histogram[k]));
+    }
+    const auto& st = res.stats;
+    std::fprintf(stderr, "%llu flights, %llu segments, %llu chunks: %llu pruned, %llu from index, %llu decoded (%llu samples)\n",
+                 static_cast<unsigned long long>(st.flights), static_cast<unsigned long long>(st.segments),
+                 static_cast<unsigned long long>(st.chunks), static_cast<unsigned long long>(st.chunks_pruned),
+                 static_cast<unsigned long long>(st.chunks_from_index), static_cast<unsigned long long>(st.chunks_decoded),
+                 static_cast<unsigned long long>(st.samples_scanned));
+    if (st.segments_rollup)
+        std::fprintf(stderr, "%llu segments read from rollups at %g s resolution\n",
+                     static_cast<unsigned long long>(st.segments_rollup), static_cast<double>(res.resolution_ns) / 1e9);
+    if (st.segments_unavailable)
+        std::fprintf(stderr, "query: %llu segments skipped: raw data reclaimed; only count/min/max/avg reach them\n",
+                     static_cast<unsigned long long>(st.segments_unavailable));
+    return 0;
+}
+
+std::atomic<bool> g_stop{false};
+
+int cmd_replay(const Args& args) {
+    // Replay runs on this thread, so stop via a flag rather than sigwait().
+    struct sigaction sa{};
+    sa.sa_handler = [](int) { g_stop.store(true); };
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    fr::ReplayConfig cfg;
+    cfg.root = args.required("root");
+    cfg.flight_id = args.str("flight");
+    const std::string speed = args.str("speed", "1");
+    cfg.speed = speed == "max" ? 0.0 : std::strtod(speed.c_str(), nullptr);
+    cfg.source = args.str("source");
+    cfg.key = key_from(args);
+
+    fr::Replayer replayer(cfg, fr::make_replay_sink(args.required("to")));
+    bool ok = replayer.run(g_stop);
+    if (!ok) FR_LOG_ERROR("replay: %s", replayer.error().c_str());
+    const auto& s = replayer.stats();
+    std::printf("replayed %llu records, %llu bytes from %llu segments, max lateness %.3f ms\n",
+                static_cast<unsigned long long>(s.records), static_cast<unsigned long long>(s.bytes),
+                static_cast<unsigned long long>(s.segments), s.max_late_ns / 1e6);
+    if (s.unattributed)
+        std::printf("skipped %llu frames recorded without raw bytes: their source is unknown\n",
+                    static_cast<unsigned long long>(s.unattributed));
+    return ok ? 0 : 1;
+}
+
+int cmd_verify(const Args& args) {
+    const std::string root = args.required("root");
+    const std::string flights = fr::layout::flights_dir(root);
+    fr::TaskPool pool(static_cast<unsigned>(args.num("workers", 0)));
+    const auto key = key_from(args);  // without it, encrypted chunks get CRC checks only
+    const auto manifest_key = key_from(args, "manifest-key");
+    size_t files = 0, chunks = 0, bad = 0, broken = 0;
+    for (const auto& flight : fr::list_dir(flights)) {
+        for (const auto& name : fr::list_dir(flights + "/" + flight)) {
+            if (!fr::layout::is_sealed_segment(name)) continue;
+            fr::SegmentReader reader;
+            reader.set_key(key);
+            const std::string path = flights + "/" + flight + "/" + name;
+            if (!reader.open(path) || !reader.verify(&pool)) {
+                std::printf("BAD  %s\n", reader.error().c_str());
+                bad++;
+            }
+            files++;
+            chunks += reader.index().size();
+        }
+
+        const fr::ChainReport chain = fr::verify_chain(root, flight, manifest_key.get(), &pool);
+        if (!chain.manifest) {
+            std::printf("NOTE %s: no manifest\n", flight.c_str());
+            continue;
+        }
+        for (const auto& e : chain.errors) std::printf("BAD  %s/%s\n", flight.c_str(), e.c_str());
+        if (!chain.ok()) broken++;
+        static const char* const kSignature[] = {"none", "not checked (no --manifest-key)", "valid", "INVALID"};
+        std::printf("CHAIN %s: %zu of %zu segments verified, %zu missing, %zu unlisted, signature %s\n", flight.c_str(),
+                    chain.verified, chain.listed, chain.missing, chain.unlisted,
+                    kSignature[static_cast<int>(chain.signature)]);
+    }
+    std::printf("%zu segments, %zu chunks, %zu bad, %zu flights with a broken chain\n", files, chunks, bad, broken);
+    return bad || broken ? 1 : 0;
+}
+
+int cmd_catalog(const Args& args) {
+    fr::Catalog catalog(args.required("root"));
+    catalog.open();
+    if (args.has("rebuild")) catalog.rebuild();
+    for (const auto& f : catalog.flights()) {
+        size_t raw = 0, open = 0, rolled = 0;
+        uint64_t bytes = 0;
+        for (const auto& s : f.second.segments) {
+            bytes += s.second.bytes;
+            uint32_t seq = 0;
+            if (s.second.open) {
+                open++;
+            } else if (fr::layout::segment_tier(s.first) == fr::seg::Tier::Raw && fr::layout::parse_segment_seq(s.first, &seq)) {
+                raw++;
+                if (catalog.has_rollups(f.first, seq)) rolled++;
+            }
+        }
+        std::printf("%-24s %5zu sealed %3zu open %5zu with rollups %10.1f MB\n", f.first.c_str(), raw, open, rolled,
+                    bytes / 1048576.0);
+    }
+    const auto st = catalog.stats();
+    std::printf("generation %llu: %llu journal records replayed, %llu segments discovered, %llu torn bytes%s%s\n",
+                static_cast<unsigned long long>(st.generation), static_cast<unsigned long long>(st.replayed),
+                static_cast<unsigned long long>(st.discovered), static_cast<unsigned long long>(st.torn_bytes),
+                st.healed ? ", healed" : "", st.rebuilt ? ", rebuilt" : "");
+    return 0;
+}
+
+int cmd_compile_config(const Args& args) {
+    const std::string in = args.required("in");
+    const std::string out = args.required("out");
+    std::ifstream f(in);
+    if (!f) {
+        std::fprintf(stderr, "%s: %s\n", in.c_str(), std::strerror(errno));
+        return 1;
+    }
+    std::stringstream text;
+    text << f.rdbuf();
+
+    std::string blob, errors;
+    if (!fr::compile_config(text.str(), &blob, &errors)) {
+        std::fprintf(stderr, "%s", errors.c_str());
+        return 1;
+    }
+    // Round-trip through the loader so a blob we would refuse never ships.
+    std::string err;
+    auto compiled = fr::CompiledConfig::from_bytes(blob, &err);
+    if (!compiled) {
+        std::fprintf(stderr, "internal error: %s\n", err.c_str());
+        return 1;
+    }
+    if (!fr::write_file_atomic(out, blob.data(), blob.size())) {
+        std::fprintf(stderr, "%s: %s\n", out.c_str(), std::strerror(errno));
+        return 1;
+    }
+    std::printf("%s: %u sources, %u messages, %u channels, %zu bytes, crc %08x\n", out.c_str(),
+                compiled->source_count(), compiled->message_count(), compiled->channel_count(), blob.size(),
+                compiled->crc());
+    return 0;
+}
+
+int cmd_offload(const Args& args) {
+    sigset_t stop = block_stop_signals();
+    fr::OffloadServerConfig cfg;
+    cfg.root = args.required("root");
+    cfg.bind_addr = args.str("bind", cfg.bind_addr);
+    cfg.port = static_cast<uint16_t>(args.num("port", cfg.port));
+    fr::OffloadServer server(cfg);
+    server.start();
+    wait_for_stop(stop);
+    server.stop();
+    return 0;
+}
+
+int cmd_fetch(const Args& args) {
+    fr::OffloadClientConfig cfg;
+    cfg.host = args.required("host");
+    cfg.port = static_cast<uint16_t>(args.num("port", cfg.port));
+    cfg.dest = args.required("dest");
+    fr::OffloadClient client(cfg);
+    bool ok = client.sync_with_retry(static_cast<int>(args.num("retries", 20)), 1000);
+    const auto& s = client.stats();
+    std::printf("files completed %llu, already present %llu, received %llu bytes, reused %llu bytes\n",
+                static_cast<unsigned long long>(s.files_completed), static_cast<unsigned long long>(s.files_present),
+                static_cast<unsigned long long>(s.bytes_received), static_cast<unsigned long long>(s.bytes_reused));
+    return ok ? 0 : 1;
+}
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: fr-recorder <command> [--option value]...\n"
+                 "  record  --root DIR [--config FILE.frcfg] [--source SPEC]... [--headroom-mb N]\n"
+                 "          [--vehicle-shards N]   record each MAVLink system id as its own flight\n"
+                 "          SPEC: [ubx+|rtcm3+|gnss+]serial:DEV[:BAUD] | [PROTO+]udp:ADDR:PORT | [dronecan+]can:IFACE\n"
+                 "          [--codec none|lz4|zstd] [--workers N] [--key-file FILE] [--manifest-key FILE]\n"
+                 "          [--raw off|also|only]   also keep (or only keep) link bytes as read, for decode\n"
+                 "          [--health-udp HOST:PORT] [--health-sysid N] [--health-ms N] [--stall-ms N]\n"
+                 "          liveness to systemd (NOTIFY_SOCKET/WatchdogSec) and MAVLink over UDP\n"
+                 "          [--thermal auto|off] [--hot-c N] [--cool-c N] [--sysfs DIR]\n"
+                 "          hot CPU: zstd->lz4, larger chunks, low-priority channels thinned\n"
+                 "          [--udp-rcvbuf-kb N] [--udp-batch N] [--udp-gro on|off]\n"
+                 "          [--serial-ring-kb N] [--serial-coalesce-us N] [--serial-low-latency on|off]\n"
+                 "          [--reorder-ms N]   wait for a quiet source before merging past it (default 50)\n"
+                 "          [--sessions off|arm] [--pre-roll-s N] [--post-roll-s N]\n"
+                 "          arm: one flight per sortie, from N s before arming to N s after disarming\n"
+                 "  decode  --root DIR [--flight ID] [--out DIR] [--config FILE.frcfg] [--workers N]\n"
+                 "          frame (and decode) a raw capture into a new flight <ID>-decoded\n"
+                 "  query   --root DIR [--flight ID | --last N] --channel NAME|ID [--channel ...]\n"
+                 "          [--from S] [--to S] [--where-min V] [--where-max V] [--where-eq V]...\n"
+                 "          [--agg count,min,max,avg,p50,p99,hist] [--bins N] [--rows] [--workers N]\n"
+                 "          [--resolution auto|raw] [--max-points N]\n"
+                 "          auto: spans over N s answer count/min/max/avg (and rows) from rollups\n"
+                 "  replay  --root DIR [--flight ID] --to udp:HOST:PORT|pty[:LINK] [--speed X|max]\n"
+                 "          [--source NAME|INDEX]   one link only; default: all sources merged\n"
+                 "  verify  --root DIR [--workers N] [--key-file FILE] [--manifest-key FILE]\n"
+                 "          --key-file also applies to decode, query and replay (encrypted flights)\n"
+                 "          --manifest-key signs (record) and checks (verify) flight hash-chain manifests\n"
+                 "  catalog --root DIR [--rebuild]\n"
+                 "  compile-config --in FILE --out FILE.frcfg\n"
+                 "  offload --root DIR [--bind ADDR] [--port N]\n"
+                 "  fetch   --host HOST [--port N] --dest DIR [--retries N]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    const std::string cmd = argv[1];
+    const Args args(argc, argv, 2);
+    if (args.has("verbose")) fr::set_log_level(fr::LogLevel::Debug);
+
+    try {
+        if (cmd == "record") return cmd_record(args);
+        if (cmd == "decode") return cmd_decode(args);
+        if (cmd == "query") return cmd_query(args);
+        if (cmd == "replay") return cmd_replay(args);
+        if (cmd == "verify") return cmd_verify(args);
+        if (cmd == "catalog") return cmd_catalog(args);
+        if (cmd == "compile-config") return cmd_compile_config(args);
+        if (cmd == "offload") return cmd_offload(args);
+        if (cmd == "fetch") return cmd_fetch(args);
+    } catch (const std::exception& ex) {
+        FR_LOG_ERROR("%s", ex.what());
+        return 1;
+    }
+    usage();
+    return 2;
+}
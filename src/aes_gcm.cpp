@@ -0,0 +1,331 @@
+#include "aes_gcm.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FR_AES_X86 1
+#endif
+
+namespace fr {
+
+namespace {
+
+const uint8_t kSbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9,
+    0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f,
+    0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15, 0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07,
+    0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3,
+    0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58,
+    0xcf, 0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3,
+    0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec, 0x5f,
+    0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73, 0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+    0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac,
+    0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a,
+    0xae, 0x08, 0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a, 0x70,
+    0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf, 0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42,
+    0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+uint8_t xtime(uint8_t x) { return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0)); }
+
+void expand_key(const uint8_t key[32], uint8_t rk[15][16]) {
+    uint8_t* w = &rk[0][0];
+    std::memcpy(w, key, 32);
+    uint8_t rcon = 1;
+    for (int i = 8; i < 60; ++i) {
+        uint8_t t[4];
+        std::memcpy(t, w + 4 * (i - 1), 4);
+        if (i % 8 == 0) {
+            const uint8_t t0 = t[0];
+            t[0] = static_cast<uint8_t>(kSbox[t[1]] ^ rcon);
+            t[1] = kSbox[t[2]];
+            t[2] = kSbox[t[3]];
+            t[3] = kSbox[t0];
+            rcon = xtime(rcon);
+        } else if (i % 8 == 4) {
+            for (auto& b : t) b = kSbox[b];
+        }
+        for (int j = 0; j < 4; ++j) w[4 * i + j] = static_cast<uint8_t>(w[4 * (i - 8) + j] ^ t[j]);
+    }
+}
+
+void encrypt_block(const uint8_t rk[15][16], const uint8_t in[16], uint8_t out[16]) {
+    uint8_t s[16];
+    for (int i = 0; i < 16; ++i) s[i] = in[i] ^ rk[0][i];
+    for (int round = 1; round <= 14; ++round) {
+        uint8_t t[16];
+        // SubBytes + ShiftRows (state is column-major: s[4*col + row]).
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r) t[4 * c + r] = kSbox[s[4 * ((c + r) & 3) + r]];
+        if (round != 14) {
+            for (int c = 0; c < 4; ++c) {
+                uint8_t* col = t + 4 * c;
+                const uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+                const uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+                col[0] = static_cast<uint8_t>(a0 ^ all ^ xtime(a0 ^ a1));
+                col[1] = static_cast<uint8_t>(a1 ^ all ^ xtime(a1 ^ a2));
+                col[2] = static_cast<uint8_t>(a2 ^ all ^ xtime(a2 ^ a3));
+                col[3] = static_cast<uint8_t>(a3 ^ all ^ xtime(a3 ^ a0));
+            }
+        }
+        for (int i = 0; i < 16; ++i) s[i] = t[i] ^ rk[round][i];
+    }
+    std::memcpy(out, s, 16);
+}
+
+uint64_t load_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = v << 8 | p[i];
+    return v;
+}
+
+void store_be64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i, v >>= 8) p[i] = static_cast<uint8_t>(v);
+}
+
+// Portable GHASH state: Y = (Y ^ X) * H in GF(2^128), bit-reflected per SP 800-38D.
+struct Ghash {
+    uint64_t hh, hl, yh = 0, yl = 0;
+
+    explicit Ghash(const uint8_t h[16]) : hh(load_be64(h)), hl(load_be64(h + 8)) {}
+
+    void block(const uint8_t x[16]) {
+        const uint64_t xh = yh ^ load_be64(x), xl = yl ^ load_be64(x + 8);
+        uint64_t zh = 0, zl = 0, vh = hh, vl = hl;
+        for (int i = 0; i < 128; ++i) {
+            const uint64_t bit = i < 64 ? (xh >> (63 - i)) & 1 : (xl >> (127 - i)) & 1;
+            const uint64_t mask = 0 - bit;
+            zh ^= vh & mask;
+            zl ^= vl & mask;
+            const uint64_t lsb = 0 - (vl & 1);
+            vl = (vl >> 1) | (vh << 63);
+            vh = (vh >> 1) ^ (0xe100000000000000ull & lsb);
+        }
+        yh = zh;
+        yl = zl;
+    }
+
+    void bytes(const uint8_t* p, size_t n) {
+        for (; n >= 16; p += 16, n -= 16) block(p);
+        if (n) {
+            uint8_t last[16] = {};
+            std::memcpy(last, p, n);
+            block(last);
+        }
+    }
+
+    void result(uint8_t out[16]) const {
+        store_be64(out, yh);
+        store_be64(out + 8, yl);
+    }
+};
+
+void set_counter(uint8_t block[16], uint32_t c) {
+    block[12] = static_cast<uint8_t>(c >> 24);
+    block[13] = static_cast<uint8_t>(c >> 16);
+    block[14] = static_cast<uint8_t>(c >> 8);
+    block[15] = static_cast<uint8_t>(c);
+}
+
+void crypt_portable(const uint8_t rk[15][16], const uint8_t h[16], const uint8_t j0[16], const uint8_t* aad,
+                    size_t aad_len, const uint8_t* in, size_t len, uint8_t* out, bool encrypting, uint8_t s[16]) {
+    Ghash g(h);
+    g.bytes(aad, aad_len);
+    uint8_t ctr[16], ks[16];
+    std::memcpy(ctr, j0, 16);
+    uint32_t c = 2;
+    for (size_t off = 0; off < len; off += 16, ++c) {
+        const size_t n = len - off < 16 ? len - off : 16;
+        set_counter(ctr, c);
+        encrypt_block(rk, ctr, ks);
+        uint8_t block[16] = {};
+        if (!encrypting) std::memcpy(block, in + off, n);
+        for (size_t i = 0; i < n; ++i) out[off + i] = in[off + i] ^ ks[i];
+        if (encrypting) std::memcpy(block, out + off, n);
+        g.block(block);
+    }
+    uint8_t lens[16];
+    store_be64(lens, static_cast<uint64_t>(aad_len) * 8);
+    store_be64(lens + 8, static_cast<uint64_t>(len) * 8);
+    g.block(lens);
+    g.result(s);
+}
+
+#ifdef FR_AES_X86
+
+#define FR_AESNI __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+
+// GF(2^128) multiply of byte-reversed operands (Intel carry-less
+// multiplication white paper, algorithm 5).
+FR_AESNI inline __m128i gfmul(__m128i a, __m128i b) {
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    // Shift the 256-bit product left by one (the operands are reflected).
+    __m128i lo_c = _mm_srli_epi32(lo, 31), hi_c = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i carry = _mm_srli_si128(lo_c, 12);
+    hi_c = _mm_slli_si128(hi_c, 4);
+    lo_c = _mm_slli_si128(lo_c, 4);
+    lo = _mm_or_si128(lo, lo_c);
+    hi = _mm_or_si128(_mm_or_si128(hi, hi_c), carry);
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+    __m128i a1 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    __m128i a2 = _mm_srli_si128(a1, 4);
+    a1 = _mm_slli_si128(a1, 12);
+    lo = _mm_xor_si128(lo, a1);
+    __m128i b1 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    b1 = _mm_xor_si128(b1, a2);
+    lo = _mm_xor_si128(lo, b1);
+    return _mm_xor_si128(hi, lo);
+}
+
+FR_AESNI inline __m128i bswap128(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+FR_AESNI inline __m128i load_partial(const uint8_t* p, size_t n) {
+    uint8_t block[16] = {};
+    std::memcpy(block, p, n);
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+}
+
+// y = (y ^ x) * H, where y and H are kept byte-reversed.
+FR_AESNI inline __m128i absorb(__m128i y, __m128i x, __m128i hk) { return gfmul(_mm_xor_si128(y, bswap128(x)), hk); }
+
+FR_AESNI inline __m128i aes_rounds(__m128i b, const __m128i k[15]) {
+    for (int r = 1; r < 14; ++r) b = _mm_aesenc_si128(b, k[r]);
+    return _mm_aesenclast_si128(b, k[14]);
+}
+
+FR_AESNI void crypt_aesni(const uint8_t rk[15][16], const uint8_t h[16], const uint8_t j0[16], const uint8_t* aad,
+                          size_t aad_len, const uint8_t* in, size_t len, uint8_t* out, bool encrypting, uint8_t s[16]) {
+    __m128i k[15];
+    for (int i = 0; i < 15; ++i) k[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(rk[i]));
+    const __m128i hk = bswap128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h)));
+    __m128i y = _mm_setzero_si128();
+
+    size_t off = 0;
+    for (; off + 16 <= aad_len; off += 16) y = absorb(y, _mm_loadu_si128(reinterpret_cast<const __m128i*>(aad + off)), hk);
+    if (off < aad_len) y = absorb(y, load_partial(aad + off, aad_len - off), hk);
+
+    // The counter is the last four bytes, big-endian; in byte-reversed space
+    // it is the low 32-bit lane, so inc32 is a plain lane add. Data blocks
+    // start at J0 + 1.
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    __m128i ctr = bswap128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(j0)));
+
+    off = 0;
+    for (; off + 64 <= len; off += 64) {
+        __m128i b[4];
+        for (int i = 0; i < 4; ++i) {
+            ctr = _mm_add_epi32(ctr, one);
+            b[i] = _mm_xor_si128(bswap128(ctr), k[0]);
+        }
+        // Four independent blocks keep the AES unit's pipeline full.
+        for (int r = 1; r < 14; ++r)
+            for (int i = 0; i < 4; ++i) b[i] = _mm_aesenc_si128(b[i], k[r]);
+        const auto* src = reinterpret_cast<const __m128i*>(in + off);
+        auto* dst = reinterpret_cast<__m128i*>(out + off);
+        __m128i x[4], c[4];
+        for (int i = 0; i < 4; ++i) x[i] = _mm_loadu_si128(src + i);
+        for (int i = 0; i < 4; ++i) {
+            c[i] = _mm_xor_si128(x[i], _mm_aesenclast_si128(b[i], k[14]));
+            _mm_storeu_si128(dst + i, c[i]);
+        }
+        // GHASH always runs over the ciphertext.
+        for (int i = 0; i < 4; ++i) y = absorb(y, encrypting ? c[i] : x[i], hk);
+    }
+    for (; off < len; off += 16) {
+        ctr = _mm_add_epi32(ctr, one);
+        const __m128i ks = aes_rounds(_mm_xor_si128(bswap128(ctr), k[0]), k);
+        const size_t n = len - off < 16 ? len - off : 16;
+        const __m128i x = load_partial(in + off, n);
+        // Bytes past n are keystream only and are never stored or hashed.
+        const __m128i c = _mm_xor_si128(x, ks);
+        uint8_t block[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(block), c);
+        std::memcpy(out + off, block, n);
+        y = absorb(y, encrypting ? load_partial(block, n) : x, hk);
+    }
+
+    uint8_t lens[16];
+    store_be64(lens, static_cast<uint64_t>(aad_len) * 8);
+    store_be64(lens + 8, static_cast<uint64_t>(len) * 8);
+    y = absorb(y, _mm_loadu_si128(reinterpret_cast<const __m128i*>(lens)), hk);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(s), bswap128(y));
+}
+
+bool detect_hardware() { return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"); }
+
+#else
+
+bool detect_hardware() { return false; }
+
+#endif
+
+std::atomic<bool> portable_only{false};
+
+}  // namespace
+
+bool AesGcm::hardware() {
+    static const bool hw = detect_hardware();
+    return hw && !portable_only.load(std::memory_order_relaxed);
+}
+
+void AesGcm::force_portable(bool on) { portable_only.store(on, std::memory_order_relaxed); }
+
+AesGcm::AesGcm(const uint8_t key[kKeyBytes]) {
+    expand_key(key, rk_);
+    const uint8_t zero[16] = {};
+    encrypt_block(rk_, zero, h_);
+}
+
+AesGcm::~AesGcm() {
+    // Do not leave key material in freed memory.
+    volatile uint8_t* p = &rk_[0][0];
+    for (size_t i = 0; i < sizeof(rk_); ++i) p[i] = 0;
+    p = h_;
+    for (size_t i = 0; i < sizeof(h_); ++i) p[i] = 0;
+}
+
+void AesGcm::crypt(const uint8_t nonce[kNonceBytes], const uint8_t* aad, size_t aad_len, const uint8_t* in, size_t len,
+                   uint8_t* out, bool encrypting, uint8_t tag[kTagBytes]) const {
+    uint8_t j0[16];
+    std::memcpy(j0, nonce, kNonceBytes);
+    set_counter(j0, 1);
+    uint8_t s[16];
+#ifdef FR_AES_X86
+    if (hardware())
+        crypt_aesni(rk_, h_, j0, aad, aad_len, in, len, out, encrypting, s);
+    else
+#endif
+        crypt_portable(rk_, h_, j0, aad, aad_len, in, len, out, encrypting, s);
+    uint8_t ek[16];
+    encrypt_block(rk_, j0, ek);
+    for (int i = 0; i < 16; ++i) tag[i] = s[i] ^ ek[i];
+}
+
+void AesGcm::encrypt(const uint8_t nonce[kNonceBytes], const void* aad, size_t aad_len, const void* in, size_t len,
+                     void* out, uint8_t tag[kTagBytes]) const {
+    crypt(nonce, static_cast<const uint8_t*>(aad), aad_len, static_cast<const uint8_t*>(in), len,
+          static_cast<uint8_t*>(out), true, tag);
+}
+
+bool AesGcm::decrypt(const uint8_t nonce[kNonceBytes], const void* aad, size_t aad_len, const void* in, size_t len,
+                     const uint8_t tag[kTagBytes], void* out) const {
+    uint8_t expect[kTagBytes];
+    crypt(nonce, static_cast<const uint8_t*>(aad), aad_len, static_cast<const uint8_t*>(in), len,
+          static_cast<uint8_t*>(out), false, expect);
+    uint8_t diff = 0;  // constant time
+    for (size_t i = 0; i < kTagBytes; ++i) diff |= static_cast<uint8_t>(expect[i] ^ tag[i]);
+    return diff == 0;
+}
+
+}  // namespace fr
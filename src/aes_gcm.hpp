@@ -0,0 +1,47 @@
+// AES-256-GCM authenticated encryption, one-shot per buffer. Uses AES-NI and
+// PCLMULQDQ when the CPU has them (checked once at runtime), else a portable
+// table-free implementation that is correct but an order of magnitude slower.
+// Counter-mode encryption and GHASH run in the same single pass over the
+// data, four blocks at a time on the hardware path.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fr {
+
+class AesGcm {
+public:
+    static constexpr size_t kKeyBytes = 32;
+    static constexpr size_t kNonceBytes = 12;
+    static constexpr size_t kTagBytes = 16;
+
+    explicit AesGcm(const uint8_t key[kKeyBytes]);
+    ~AesGcm();
+
+    AesGcm(const AesGcm&) = delete;
+    AesGcm& operator=(const AesGcm&) = delete;
+
+    // Thread-safe: the key schedule is read-only after construction. `out`
+    // may equal `in`.
+    void encrypt(const uint8_t nonce[kNonceBytes], const void* aad, size_t aad_len, const void* in, size_t len,
+                 void* out, uint8_t tag[kTagBytes]) const;
+    // False if the tag does not match; `out` then holds unauthenticated
+    // plaintext and must be discarded.
+    bool decrypt(const uint8_t nonce[kNonceBytes], const void* aad, size_t aad_len, const void* in, size_t len,
+                 const uint8_t tag[kTagBytes], void* out) const;
+
+    // True when the AES-NI/PCLMULQDQ path is in use.
+    static bool hardware();
+    // Tests: run the portable code even where the CPU has the instructions.
+    static void force_portable(bool on);
+
+private:
+    void crypt(const uint8_t nonce[kNonceBytes], const uint8_t* aad, size_t aad_len, const uint8_t* in, size_t len,
+               uint8_t* out, bool encrypting, uint8_t tag[kTagBytes]) const;
+
+    alignas(16) uint8_t rk_[15][16];  // AES-256 round keys
+    uint8_t h_[16];                   // GHASH key, E(K, 0)
+};
+
+}  // namespace fr
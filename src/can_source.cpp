@@ -0,0 +1,84 @@
+#include "can_source.hpp"
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace fr {
+
+bool CanSource::open(std::string* err) {
+    fd_ = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (fd_ < 0) {
+        *err = std::string("socket(PF_CAN): ") + std::strerror(errno);
+        return false;
+    }
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, spec_.path.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd_, SIOCGIFINDEX, &ifr) != 0) {
+        *err = spec_.path + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+    int ifindex = ifr.ifr_ifindex;
+    if (ioctl(fd_, SIOCGIFFLAGS, &ifr) == 0 && !(ifr.ifr_flags & IFF_UP)) {
+        // Bring the link up if we are allowed to; otherwise wait for whoever
+        // owns interface configuration (systemd-networkd, a boot script).
+        ifr.ifr_flags |= IFF_UP;
+        if (ioctl(fd_, SIOCSIFFLAGS, &ifr) != 0) {
+            *err = spec_.path + ": interface down";
+            close();
+            return false;
+        }
+    }
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifindex;
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        *err = spec_.path + ": bind: " + std::strerror(errno);
+        close();
+        return false;
+    }
+    return true;
+}
+
+ssize_t CanSource::read(uint8_t* buf, size_t cap, int timeout_ms) {
+    size_t max = cap / sizeof(can_frame);
+    if (max == 0) return 0;
+    if (max > kBatch) max = kBatch;
+    int ready = wait_readable(fd_, timeout_ms);
+    if (ready <= 0) return ready;
+    // Only frames that are already queued: waiting for a full batch would
+    // delay the receive timestamp of the first one.
+    for (size_t i = 0; i < max; ++i) {
+        iov_[i] = iovec{buf + i * sizeof(can_frame), sizeof(can_frame)};
+        msgs_[i] = mmsghdr{};
+        msgs_[i].msg_hdr.msg_iov = &iov_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    int got = recvmmsg(fd_, msgs_, static_cast<unsigned>(max), MSG_DONTWAIT, nullptr);
+    if (got < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        return errno == ENETDOWN ? -1 : 0;
+    }
+    // CAN_RAW delivers whole classic frames; drop anything else in place.
+    size_t out = 0;
+    for (int i = 0; i < got; ++i) {
+        if (msgs_[i].msg_len != sizeof(can_frame)) continue;
+        if (out != static_cast<size_t>(i)) std::memmove(buf + out * sizeof(can_frame), buf + i * sizeof(can_frame), sizeof(can_frame));
+        out++;
+    }
+    return static_cast<ssize_t>(out * sizeof(can_frame));
+}
+
+void CanSource::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+}  // namespace fr
@@ -0,0 +1,521 @@
+#include "catalog.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include "clock.hpp"
+#include "crc32c.hpp"
+#include "fs_util.hpp"
+#include "log.hpp"
+#include "storage_layout.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'F', 'R', 'C', 'A', 'T', 'S', '1', '\n'};
+constexpr char kJournalMagic[8] = {'F', 'R', 'C', 'A', 'T', 'J', '1', '\n'};
+constexpr size_t kFileHeaderBytes = 16;  // magic, uint64 generation
+constexpr size_t kRecordHeaderBytes = 6;  // uint32 crc32c(len + body), uint16 len
+
+enum RecordType : uint8_t {
+    kRecSegment = 1,        // flight, name, bytes, t_first, t_last, mtime_ns, open[, hash, link]
+    kRecRemoveSegment = 2,  // flight, name
+    kRecRemoveFlight = 3,   // flight
+};
+
+using FlightMap = std::map<std::string, CatalogFlight>;
+
+template <typename T>
+void put(std::string& s, T v) {
+    s.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void put_str(std::string& s, const std::string& v) {
+    const size_t n = std::min<size_t>(v.size(), 255);
+    put<uint8_t>(s, static_cast<uint8_t>(n));
+    s.append(v, 0, n);
+}
+
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    template <typename T>
+    bool get(T* v) {
+        if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+        std::memcpy(v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+    bool get_str(std::string* v) {
+        uint8_t n = 0;
+        if (!get(&n) || end - p < n) return false;
+        v->assign(p, n);
+        p += n;
+        return true;
+    }
+};
+
+// Frames `body` as one record and appends it to `out`.
+void frame(std::string* out, const std::string& body) {
+    std::string rec;
+    put<uint16_t>(rec, static_cast<uint16_t>(body.size()));
+    rec += body;
+    put<uint32_t>(*out, crc32c(rec.data(), rec.size()));
+    *out += rec;
+}
+
+void encode_segment(std::string* out, const std::string& flight, const std::string& name, const CatalogSegment& s) {
+    std::string body;
+    put<uint8_t>(body, kRecSegment);
+    put_str(body, flight);
+    put_str(body, name);
+    put<uint64_t>(body, s.bytes);
+    put<int64_t>(body, s.t_first);
+    put<int64_t>(body, s.t_last);
+    put<int64_t>(body, s.mtime_ns);
+    put<uint8_t>(body, s.open ? 1 : 0);
+    if (s.hashed) {
+        body.append(reinterpret_cast<const char*>(s.hash.data()), s.hash.size());
+        body.append(reinterpret_cast<const char*>(s.link.data()), s.link.size());
+    }
+    frame(out, body);
+}
+
+void encode_remove(std::string* out, RecordType type, const std::string& flight, const std::string& name) {
+    std::string body;
+    put<uint8_t>(body, type);
+    put_str(body, flight);
+    if (type == kRecRemoveSegment) put_str(body, name);
+    frame(out, body);
+}
+
+bool apply_record(FlightMap* m, const char* body, size_t len) {
+    Cursor c{body, body + len};
+    uint8_t type = 0;
+    std::string flight, name;
+    if (!c.get(&type) || !c.get_str(&flight)) return false;
+    switch (type) {
+        case kRecSegment: {
+            CatalogSegment s;
+            uint8_t open = 0;
+            if (!c.get_str(&name) || !c.get(&s.bytes) || !c.get(&s.t_first) || !c.get(&s.t_last) || !c.get(&s.mtime_ns) ||
+                !c.get(&open))
+                return false;
+            s.open = open != 0;
+            // Records written before segments were hashed end here.
+            s.hashed = c.get(&s.hash) && c.get(&s.link);
+            auto& segs = (*m)[flight].segments;
+            // Sealing renames x.frs.open to x.frs.
+            if (!s.open) segs.erase(name + layout::kOpenSuffix);
+            segs[name] = s;
+            return true;
+        }
+        case kRecRemoveSegment: {
+            if (!c.get_str(&name)) return false;
+            auto it = m->find(flight);
+            if (it != m->end()) it->second.segments.erase(name);
+            return true;
+        }
+        case kRecRemoveFlight:
+            m->erase(flight);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Applies framed records from data[off, end); returns the end of the last
+// record that was intact.
+size_t replay_records(FlightMap* m, const std::string& data, size_t off, size_t end, uint64_t* applied) {
+    while (end - off >= kRecordHeaderBytes) {
+        uint32_t crc;
+        uint16_t len;
+        std::memcpy(&crc, data.data() + off, sizeof(crc));
+        std::memcpy(&len, data.data() + off + sizeof(crc), sizeof(len));
+        if (end - off - kRecordHeaderBytes < len) break;
+        const char* rec = data.data() + off + sizeof(crc);
+        if (crc32c(rec, sizeof(len) + len) != crc) break;
+        if (!apply_record(m, rec + sizeof(len), len)) break;
+        off += kRecordHeaderBytes + len;
+        if (applied) (*applied)++;
+    }
+    return off;
+}
+
+bool read_header(const std::string& data, const char* magic, uint64_t* gen) {
+    if (data.size() < kFileHeaderBytes || std::memcmp(data.data(), magic, 8) != 0) return false;
+    std::memcpy(gen, data.data() + 8, sizeof(*gen));
+    return true;
+}
+
+std::string file_header(const char* magic, uint64_t gen) {
+    std::string h(magic, 8);
+    put<uint64_t>(h, gen);
+    return h;
+}
+
+int64_t mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+}  // namespace
+
+Catalog::Catalog(std::string root, bool read_only) : root_(std::move(root)), read_only_(read_only) {}
+
+Catalog::~Catalog() {
+    if (journal_fd_ >= 0) ::close(journal_fd_);
+}
+
+bool Catalog::load_snapshot(int slot, uint64_t* gen, FlightMap* out) const {
+    std::string data;
+    if (!read_file(layout::catalog_snapshot_path(root_, slot), &data)) return false;
+    if (data.size() < kFileHeaderBytes + sizeof(uint32_t) || !read_header(data, kSnapshotMagic, gen)) return false;
+    const size_t body_end = data.size() - sizeof(uint32_t);
+    uint32_t crc;
+    std::memcpy(&crc, data.data() + body_end, sizeof(crc));
+    if (crc32c(data.data(), body_end) != crc) return false;
+    out->clear();
+    return replay_records(out, data, kFileHeaderBytes, body_end, nullptr) == body_end;
+}
+
+bool Catalog::replay_journal(int slot, uint64_t gen, uint64_t* good, uint64_t* file_size) {
+    std::string data;
+    uint64_t found = 0;
+    if (!read_file(layout::catalog_journal_path(root_, slot), &data) || !read_header(data, kJournalMagic, &found) ||
+        found != gen)
+        return false;
+    *good = replay_records(&flights_, data, kFileHeaderBytes, data.size(), &stats_.replayed);
+    *file_size = data.size();
+    return true;
+}
+
+void Catalog::open() {
+    std::lock_guard<std::mutex> lk(mu_);
+    flights_.clear();
+    stats_ = Stats();
+    if (journal_fd_ >= 0) ::close(journal_fd_);
+    journal_fd_ = -1;
+    if (!read_only_) make_dirs(root_);
+
+    uint64_t gen[2] = {0, 0};
+    FlightMap snap[2];
+    bool ok[2];
+    for (int s = 0; s < 2; ++s) ok[s] = load_snapshot(s, &gen[s], &snap[s]);
+    int best = -1;
+    for (int s = 0; s < 2; ++s)
+        if (ok[s] && (best < 0 || gen[s] > gen[best])) best = s;
+    for (int s = 0; s < 2; ++s) {
+        // A snapshot file that exists but does not load is damage, not absence.
+        if (!ok[s] && access(layout::catalog_snapshot_path(root_, s).c_str(), F_OK) == 0) stats_.healed = true;
+    }
+
+    if (best < 0) {
+        // No usable snapshot: first run on this store, or both damaged. Number
+        // the rebuilt generation past any journal still lying around.
+        for (int s = 0; s < 2; ++s) {
+            std::string data;
+            uint64_t g = 0;
+            if (read_file(layout::catalog_journal_path(root_, s), &data) && read_header(data, kJournalMagic, &g))
+                stats_.generation = std::max(stats_.generation, g);
+        }
+        stats_.healed = false;
+        rebuild_locked();
+        return;
+    }
+
+    flights_ = std::move(snap[best]);
+    stats_.generation = gen[best];
+    int slot = best;
+    uint64_t good = 0, size = 0;
+    bool have_journal = replay_journal(slot, gen[best], &good, &size);
+    // Crashed between a compaction's snapshot and its journal: records
+    // appended meanwhile are only in the previous generation's journal.
+    // Replaying all of it is harmless, since records overwrite or erase
+    // and the snapshot already holds their effect up to some prefix.
+    uint64_t unused = 0;
+    const bool carried =
+        !have_journal && gen[best] > 0 && replay_journal(1 - best, gen[best] - 1, &unused, &unused);
+    // The next generation's journal without its snapshot: that snapshot was
+    // damaged. Its records continue from where this generation's journal ended.
+    uint64_t good2 = 0, size2 = 0;
+    if (replay_journal(1 - best, gen[best] + 1, &good2, &size2)) {
+        slot = 1 - best;
+        stats_.generation = gen[best] + 1;
+        stats_.healed = true;
+        have_journal = true;
+        good = good2;
+        size = size2;
+    }
+    stats_.torn_bytes = size - good;
+    stats_.journal_records = stats_.replayed;
+
+    std::string records;
+    size_t count = 0;
+    discover(&records, &count);
+    if (read_only_) return;
+
+    const std::string path = layout::catalog_journal_path(root_, slot);
+    // Replayed state that is in neither a sound snapshot nor the journal we
+    // keep appending to must be written out again.
+    bool resnapshot = stats_.healed || carried;
+    if (have_journal && stats_.torn_bytes) {
+        FR_LOG_WARN("catalog: dropping %llu torn journal bytes", static_cast<unsigned long long>(stats_.torn_bytes));
+        if (truncate(path.c_str(), static_cast<off_t>(good)) != 0) {
+            have_journal = false;
+            resnapshot = true;
+        }
+    }
+    if (have_journal) {
+        journal_fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (journal_fd_ < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+    } else if (!start_journal(slot, stats_.generation)) {
+        throw std::system_error(errno, std::generic_category(), "create " + path);
+    }
+    append(records, count);
+    if (resnapshot) compact_locked();
+    // Twice after damage, so that neither slot keeps the bad snapshot.
+    if (stats_.healed) compact_locked();
+    FR_LOG_INFO("catalog: generation %llu, %zu flights, %llu journal records, %llu discovered%s",
+                static_cast<unsigned long long>(stats_.generation), flights_.size(),
+                static_cast<unsigned long long>(stats_.replayed), static_cast<unsigned long long>(stats_.discovered),
+                stats_.healed ? " (healed)" : "");
+}
+
+void Catalog::rebuild() {
+    std::lock_guard<std::mutex> lk(mu_);
+    rebuild_locked();
+}
+
+void Catalog::rebuild_locked() {
+    flights_.clear();
+    stats_.rebuilt = true;
+    stats_.discovered = 0;
+    std::string unused;
+    size_t n = 0;
+    for (const auto& flight : list_dir(layout::flights_dir(root_))) scan_flight(flight, &unused, &n);
+    if (read_only_) return;
+    FR_LOG_INFO("catalog: rebuilt from %zu flight directories (%llu segments)", flights_.size(),
+                static_cast<unsigned long long>(stats_.discovered));
+    compact_locked();
+}
+
+void Catalog::scan_flight(const std::string& flight, std::string* records, size_t* count) {
+    const std::string dir = layout::flight_dir(root_, flight);
+    for (const auto& name : list_dir(dir)) {
+        const bool open = layout::is_open_segment(name);
+        if (!open && !layout::is_sealed_segment(name)) continue;
+        struct stat st{};
+        if (stat((dir + "/" + name).c_str(), &st) != 0) continue;
+        CatalogSegment s;
+        s.bytes = static_cast<uint64_t>(st.st_size);
+        s.mtime_ns = mtime_ns(st);
+        s.open = open;
+        flights_[flight].segments[name] = s;
+        encode_segment(records, flight, name, s);
+        (*count)++;
+        stats_.discovered++;
+    }
+}
+
+void Catalog::discover(std::string* records, size_t* count) {
+    // Whole flights the journal never heard of (their first segment was still
+    // open at the crash, or the store predates the catalogue)...
+    for (const auto& flight : list_dir(layout::flights_dir(root_)))
+        if (!flights_.count(flight)) scan_flight(flight, records, count);
+
+    // ...and raw segments past the last catalogued one of each known flight.
+    for (auto& kv : flights_) {
+        uint32_t last = 0;
+        for (const auto& seg : kv.second.segments) {
+            uint32_t seq = 0;
+            if (layout::segment_tier(seg.first) == seg::Tier::Raw && layout::parse_segment_seq(seg.first, &seq))
+                last = std::max(last, seq);
+        }
+        const std::string dir = layout::flight_dir(root_, kv.first);
+        for (uint32_t seq = last + 1;; ++seq) {
+            std::string name = layout::segment_name(seq);
+            struct stat st{};
+            bool open = false;
+            if (stat((dir + "/" + name).c_str(), &st) != 0) {
+                name = layout::open_segment_name(seq);
+                open = true;
+                if (stat((dir + "/" + name).c_str(), &st) != 0) break;
+            }
+            CatalogSegment s;
+            s.bytes = static_cast<uint64_t>(st.st_size);
+            s.mtime_ns = mtime_ns(st);
+            s.open = open;
+            kv.second.segments[name] = s;
+            encode_segment(records, kv.first, name, s);
+            (*count)++;
+            stats_.discovered++;
+        }
+    }
+}
+
+void Catalog::append(const std::string& records, size_t count) {
+    if (read_only_ || journal_fd_ < 0 || records.empty()) return;
+    if (compacting_) {
+        // Goes into the next journal too; the snapshot being written
+        // predates it.
+        carry_ += records;
+        carry_count_ += count;
+    }
+    if (!write_all(journal_fd_, records.data(), records.size()) || fdatasync(journal_fd_) != 0)
+        FR_LOG_WARN("catalog: journal append failed: %s", std::strerror(errno));
+    stats_.journal_records += count;
+}
+
+bool Catalog::start_journal(int slot, uint64_t gen) {
+    const std::string path = layout::catalog_journal_path(root_, slot);
+    const std::string header = file_header(kJournalMagic, gen);
+    if (!write_file_atomic(path, header.data(), header.size())) return false;
+    int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0) return false;
+    if (journal_fd_ >= 0) ::close(journal_fd_);
+    journal_fd_ = fd;
+    return true;
+}
+
+std::string Catalog::snapshot_locked(uint64_t gen) const {
+    std::string data = file_header(kSnapshotMagic, gen);
+    for (const auto& f : flights_)
+        for (const auto& s : f.second.segments) encode_segment(&data, f.first, s.first, s.second);
+    put<uint32_t>(data, crc32c(data.data(), data.size()));
+    return data;
+}
+
+void Catalog::compact_locked() {
+    const uint64_t gen = stats_.generation + 1;
+    const int slot = static_cast<int>(gen % 2);
+    const std::string data = snapshot_locked(gen);
+
+    // Snapshot first: until the new journal exists, a crash leaves this
+    // snapshot with a stale journal in its slot, which open() ignores.
+    if (!write_file_atomic(layout::catalog_snapshot_path(root_, slot), data.data(), data.size()) ||
+        !start_journal(slot, gen)) {
+        FR_LOG_WARN("catalog: snapshot failed: %s", std::strerror(errno));
+        return;
+    }
+    stats_.generation = gen;
+    stats_.journal_records = 0;
+    stats_.snapshots++;
+}
+
+void Catalog::compact() { compact_unlocked(0); }
+
+void Catalog::compact_if_needed(uint64_t max_records) { compact_unlocked(max_records); }
+
+void Catalog::compact_unlocked(uint64_t min_records) {
+    // Seal callbacks and manifest rewrites take mu_ on the recording path, so
+    // it is held only to copy the state and, at the end, to switch journals:
+    // the snapshot, O(catalogue) bytes and an fsync, is written without it.
+    uint64_t gen = 0;
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (read_only_ || compacting_ || stats_.journal_records < min_records) return;
+        compacting_ = true;
+        carry_.clear();
+        carry_count_ = 0;
+        gen = stats_.generation + 1;
+        data = snapshot_locked(gen);
+    }
+    const int slot = static_cast<int>(gen % 2);
+    // Snapshot first: until the new journal exists, appends still go to the
+    // current one, which open() replays should we crash before the switch.
+    const bool written = write_file_atomic(layout::catalog_snapshot_path(root_, slot), data.data(), data.size());
+    const int err = errno;
+
+    std::lock_guard<std::mutex> lk(mu_);
+    compacting_ = false;
+    // The new journal starts with what was appended during the snapshot;
+    // as small as an ordinary append.
+    std::string journal = file_header(kJournalMagic, gen) + carry_;
+    const size_t carried = carry_count_;
+    carry_.clear();
+    carry_count_ = 0;
+    if (!written || !write_file_atomic(layout::catalog_journal_path(root_, slot), journal.data(), journal.size())) {
+        FR_LOG_WARN("catalog: snapshot failed: %s", std::strerror(written ? errno : err));
+        return;
+    }
+    const int fd = ::open(layout::catalog_journal_path(root_, slot).c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0) {
+        FR_LOG_WARN("catalog: open new journal: %s", std::strerror(errno));
+        return;
+    }
+    if (journal_fd_ >= 0) ::close(journal_fd_);
+    journal_fd_ = fd;
+    stats_.generation = gen;
+    stats_.journal_records = carried;
+    stats_.snapshots++;
+}
+
+void Catalog::add_sealed(const SealedSegment& s) {
+    CatalogSegment seg;
+    seg.bytes = s.bytes;
+    seg.t_first = s.t_first;
+    seg.t_last = s.t_last;
+    seg.mtime_ns = realtime_ns();
+    seg.hashed = true;
+    seg.hash = s.hash;
+    seg.link = s.link;
+    std::string rec;
+    encode_segment(&rec, s.flight_id, s.name, seg);
+    std::lock_guard<std::mutex> lk(mu_);
+    apply_record(&flights_, rec.data() + kRecordHeaderBytes, rec.size() - kRecordHeaderBytes);
+    append(rec, 1);
+}
+
+void Catalog::remove_segments(const std::string& flight, const std::vector<std::string>& names) {
+    if (names.empty()) return;
+    std::string recs;
+    for (const auto& n : names) encode_remove(&recs, kRecRemoveSegment, flight, n);
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = flights_.find(flight);
+    if (it != flights_.end())
+        for (const auto& n : names) it->second.segments.erase(n);
+    append(recs, names.size());
+}
+
+void Catalog::remove_flight(const std::string& flight) {
+    std::string rec;
+    encode_remove(&rec, kRecRemoveFlight, flight, {});
+    std::lock_guard<std::mutex> lk(mu_);
+    flights_.erase(flight);
+    append(rec, 1);
+}
+
+std::map<std::string, CatalogFlight> Catalog::flights() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return flights_;
+}
+
+bool Catalog::flight(const std::string& flight_id, CatalogFlight* out) const {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = flights_.find(flight_id);
+    if (it == flights_.end()) return false;
+    *out = it->second;
+    return true;
+}
+
+bool Catalog::has_rollups(const std::string& flight, uint32_t seq) const {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = flights_.find(flight);
+    return it != flights_.end() && it->second.segments.count(layout::segment_name(seq, seg::Tier::Rollup1m));
+}
+
+Catalog::Stats Catalog::stats() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return stats_;
+}
+
+}  // namespace fr
@@ -0,0 +1,125 @@
+// Crash-safe catalogue of the store: every flight and segment, its size, time
+// range and sealed state, so startup does not have to readdir and stat
+// thousands of files on a slow card.
+//
+// State lives in a snapshot plus an append-only journal of changes since it.
+// Every journal record carries a CRC-32C; a torn tail after power loss is cut
+// off at the last good record. Compaction writes a new snapshot (tmp + fsync +
+// rename) into the other of two slots and starts a fresh journal there, so the
+// previous generation survives untouched: if the newest snapshot is damaged,
+// the older one plus both journals reproduce the same state. Only when no
+// snapshot is readable does open() fall back to scanning the directory tree.
+//
+// Segments written after the last journal record (sealed right before a
+// crash, or still .open) are picked up by probing the next sequence number of
+// each known flight, plus one readdir of flights/ for unknown flight dirs.
+//
+// Sealed segments carry their SHA-256 and hash chain link (hash_chain.hpp), so
+// a flight's manifest can be rebuilt from the catalogue alone.
+//
+// Thread-safe. Appends come from writer seal callbacks (one write + fdatasync,
+// next to the segment's own) and the retention thread.
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "segment_writer.hpp"
+
+namespace fr {
+
+struct CatalogSegment {
+    uint64_t bytes = 0;
+    int64_t t_first = 0;  // 0 when discovered by a scan rather than journaled
+    int64_t t_last = 0;
+    int64_t mtime_ns = 0;  // CLOCK_REALTIME of the seal (file mtime when scanned)
+    bool open = false;     // .open file left by a crash or still being written
+    bool hashed = false;   // hash/link known (journaled at seal, not discovered by a scan)
+    Sha256Digest hash{};
+    Sha256Digest link{};   // hash chain link; zero for rollup tiers
+};
+
+struct CatalogFlight {
+    std::map<std::string, CatalogSegment> segments;  // by file name == by sequence
+};
+
+class Catalog {
+public:
+    struct Stats {
+        uint64_t generation = 0;
+        uint64_t journal_records = 0;  // since the current snapshot
+        uint64_t replayed = 0;         // records applied by open()
+        uint64_t torn_bytes = 0;       // discarded journal tail
+        uint64_t discovered = 0;       // segments found on disk but not journaled
+        uint64_t snapshots = 0;
+        bool healed = false;   // newest snapshot was bad; recovered via the older one
+        bool rebuilt = false;  // no usable snapshot; scanned the tree
+    };
+
+    // Read-only catalogues never write, truncate or compact (e.g. the offload
+    // server looking at a store that a running recorder owns).
+    explicit Catalog(std::string root, bool read_only = false);
+    ~Catalog();
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    // Loads snapshot and journal, repairing them if needed. Throws
+    // std::system_error if a writable catalogue cannot create its journal.
+    void open();
+
+    // Discards the catalogue and rebuilds it from a directory scan.
+    void rebuild();
+
+    void add_sealed(const SealedSegment& s);
+    void remove_segments(const std::string& flight, const std::vector<std::string>& names);
+    void remove_flight(const std::string& flight);
+
+    std::map<std::string, CatalogFlight> flights() const;
+    // One flight; false if it is not catalogued.
+    bool flight(const std::string& flight_id, CatalogFlight* out) const;
+    // True once the coarsest rollup tier for raw segment `seq` is catalogued.
+    bool has_rollups(const std::string& flight, uint32_t seq) const;
+
+    // Folds the journal into a new snapshot once it holds `max_records`
+    // records. Meant for a background thread; the snapshot is O(catalogue)
+    // and is written without holding the lock that appends take.
+    void compact_if_needed(uint64_t max_records = 4096);
+    void compact();
+
+    Stats stats() const;
+
+private:
+    using FlightMap = std::map<std::string, CatalogFlight>;
+
+    bool load_snapshot(int slot, uint64_t* gen, FlightMap* out) const;
+    // Applies the journal of `slot` if it belongs to `gen`; returns false if it
+    // does not. `*good` receives the length of the valid prefix.
+    bool replay_journal(int slot, uint64_t gen, uint64_t* good, uint64_t* file_size);
+    void rebuild_locked();
+    void scan_flight(const std::string& flight, std::string* records, size_t* count);
+    void discover(std::string* records, size_t* count);
+    void append(const std::string& records, size_t count);
+    bool start_journal(int slot, uint64_t gen);
+    void compact_locked();  // open() and rebuild() only
+    void compact_unlocked(uint64_t min_records);
+    std::string snapshot_locked(uint64_t gen) const;
+
+    const std::string root_;
+    const bool read_only_;
+
+    mutable std::mutex mu_;
+    FlightMap flights_;
+    Stats stats_;
+    int journal_fd_ = -1;
+    // While compact_unlocked() writes a snapshot, appends are copied here
+    // for the journal that will follow it.
+    bool compacting_ = false;
+    std::string carry_;
+    size_t carry_count_ = 0;
+};
+
+}  // namespace fr
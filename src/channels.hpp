@@ -0,0 +1,34 @@
+// Channel id space. The top byte selects a family; the low 24 bits identify the
+// channel within it.
+#pragma once
+
+#include <cstdint>
+
+namespace fr {
+namespace channel {
+
+constexpr uint32_t kFamilyShift = 24;
+constexpr uint32_t kLocalMask = 0x00ffffff;
+
+enum Family : uint32_t {
+    kDecoded = 0x00,      // numeric channels defined by configuration
+    kMavlink = 0x01,      // whole MAVLink frames, local id = msgid
+    kRawStream = 0x02,    // raw link bytes, local id = source index
+    kCanFrame = 0x03,     // raw CAN frames, local id = source index
+    kUbx = 0x04,          // whole UBX frames, local id = class << 8 | id
+    kRtcm3 = 0x05,        // whole RTCM3 frames, local id = message number
+    kDroneCan = 0x06,     // reassembled DroneCAN transfers, see dronecan.hpp
+    kMeta = 0x0f,         // recorder metadata
+};
+
+constexpr uint32_t make(Family f, uint32_t local) { return (static_cast<uint32_t>(f) << kFamilyShift) | (local & kLocalMask); }
+// Well-known kMeta channels.
+constexpr uint32_t kMetaConfig = 1;   // compiled config blob, once per segment
+constexpr uint32_t kMetaSources = 2;  // source table, once per segment (see source.hpp)
+constexpr uint32_t kMetaSession = 3;  // arm/disarm and takeoff/landing events (see session.hpp)
+
+constexpr Family family(uint32_t ch) { return static_cast<Family>(ch >> kFamilyShift); }
+constexpr uint32_t local(uint32_t ch) { return ch & kLocalMask; }
+
+}  // namespace channel
+}  // namespace fr
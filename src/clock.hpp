@@ -0,0 +1,22 @@
+// Timestamp sources. Records are stamped with CLOCK_MONOTONIC nanoseconds;
+// CLOCK_REALTIME is only used to name flights and for wall-clock metadata.
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+namespace fr {
+
+inline int64_t monotonic_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline int64_t realtime_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+}  // namespace fr
@@ -0,0 +1,202 @@
+#include "codec.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef FR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace fr {
+namespace codec {
+
+namespace {
+
+// LZ4 block format: sequences of [token][literal len ext][literals]
+// [offset:le16][match len ext]; the last sequence carries literals only.
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5;   // the block always ends in >= 5 literals
+constexpr size_t kMatchFindLimit = 12;  // no match may start in the last 12 bytes
+constexpr unsigned kHashLog = 12;
+constexpr size_t kMaxOffset = 65535;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash4(uint32_t v) { return (v * 2654435761u) >> (32 - kHashLog); }
+
+void put_length(std::string* out, size_t len) {
+    for (; len >= 255; len -= 255) out->push_back(static_cast<char>(255));
+    out->push_back(static_cast<char>(len));
+}
+
+void put_sequence(std::string* out, const uint8_t* lit, size_t lit_len, size_t offset, size_t match_len) {
+    const size_t ml = match_len ? match_len - kMinMatch : 0;
+    uint8_t token = static_cast<uint8_t>((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (match_len) token |= static_cast<uint8_t>(ml >= 15 ? 15 : ml);
+    out->push_back(static_cast<char>(token));
+    if (lit_len >= 15) put_length(out, lit_len - 15);
+    out->append(reinterpret_cast<const char*>(lit), lit_len);
+    if (!match_len) return;
+    out->push_back(static_cast<char>(offset & 0xff));
+    out->push_back(static_cast<char>(offset >> 8));
+    if (ml >= 15) put_length(out, ml - 15);
+}
+
+void lz4_compress(const uint8_t* src, size_t len, std::string* out) {
+    out->clear();
+    out->reserve(len + len / 255 + 16);
+    const uint8_t* const end = src + len;
+    const uint8_t* anchor = src;
+    if (len > kMatchFindLimit) {
+        uint32_t table[1u << kHashLog] = {};
+        const uint8_t* const match_start_limit = end - kMatchFindLimit;
+        const uint8_t* const match_end_limit = end - kLastLiterals;
+        const uint8_t* ip = src + 1;
+        while (ip < match_start_limit) {
+            const uint32_t seq = read32(ip);
+            const uint32_t h = hash4(seq);
+            const uint8_t* ref = src + table[h];
+            table[h] = static_cast<uint32_t>(ip - src);
+            if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset || read32(ref) != seq) {
+                // Skip faster through incompressible stretches.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            const uint8_t* m = ip + kMinMatch;
+            const uint8_t* r = ref + kMinMatch;
+            while (m < match_end_limit && *m == *r) ++m, ++r;
+            put_sequence(out, anchor, static_cast<size_t>(ip - anchor), static_cast<size_t>(ip - ref),
+                         static_cast<size_t>(m - ip));
+            ip = anchor = m;
+        }
+    }
+    put_sequence(out, anchor, static_cast<size_t>(end - anchor), 0, 0);
+}
+
+bool lz4_decompress(const uint8_t* src, size_t len, size_t raw_len, std::string* out) {
+    out->resize(raw_len);
+    uint8_t* const dst = reinterpret_cast<uint8_t*>(&(*out)[0]);
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + raw_len;
+    const uint8_t* ip = src;
+    const uint8_t* const iend = src + len;
+
+    auto get_length = [&](size_t* n) {
+        for (;;) {
+            if (ip >= iend) return false;
+            uint8_t b = *ip++;
+            *n += b;
+            if (b != 255) return true;
+        }
+    };
+
+    while (ip < iend) {
+        const uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length(&lit)) return false;
+        if (lit > static_cast<size_t>(iend - ip) || lit > static_cast<size_t>(oend - op)) return false;
+        std::memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break;  // last sequence: literals only
+
+        if (iend - ip < 2) return false;
+        const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+        size_t ml = token & 15;
+        if (ml == 15 && !get_length(&ml)) return false;
+        ml += kMinMatch;
+        if (ml > static_cast<size_t>(oend - op)) return false;
+        const uint8_t* ref = op - offset;
+        if (offset >= ml) {
+            std::memcpy(op, ref, ml);
+            op += ml;
+        } else {
+            while (ml--) *op++ = *ref++;  // overlapping copy repeats the pattern
+        }
+    }
+    return op == oend;
+}
+
+}  // namespace
+
+bool available(seg::Codec c) {
+    switch (c) {
+        case seg::Codec::None:
+        case seg::Codec::Lz4: return true;
+        case seg::Codec::Zstd:
+#ifdef FR_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool parse(const std::string& s, seg::Codec* out) {
+    for (seg::Codec c : {seg::Codec::None, seg::Codec::Lz4, seg::Codec::Zstd})
+        if (s == name(c)) {
+            *out = c;
+            return true;
+        }
+    return false;
+}
+
+const char* name(seg::Codec c) {
+    switch (c) {
+        case seg::Codec::None: return "none";
+        case seg::Codec::Lz4: return "lz4";
+        case seg::Codec::Zstd: return "zstd";
+    }
+    return "?";
+}
+
+bool compress(seg::Codec c, const void* src, size_t len, std::string* out) {
+    const auto* p = static_cast<const uint8_t*>(src);
+    switch (c) {
+        case seg::Codec::None: return false;
+        case seg::Codec::Lz4: lz4_compress(p, len, out); break;
+        case seg::Codec::Zstd: {
+#ifdef FR_HAVE_ZSTD
+            out->resize(ZSTD_compressBound(len));
+            size_t n = ZSTD_compress(&(*out)[0], out->size(), p, len, 3);
+            if (ZSTD_isError(n)) return false;
+            out->resize(n);
+            break;
+#else
+            return false;
+#endif
+        }
+    }
+    return out->size() < len;
+}
+
+bool decompress(seg::Codec c, const void* src, size_t len, size_t raw_len, std::string* out) {
+    const auto* p = static_cast<const uint8_t*>(src);
+    switch (c) {
+        case seg::Codec::None:
+            if (len != raw_len) return false;
+            out->assign(reinterpret_cast<const char*>(p), len);
+            return true;
+        case seg::Codec::Lz4: return lz4_decompress(p, len, raw_len, out);
+        case seg::Codec::Zstd: {
+#ifdef FR_HAVE_ZSTD
+            out->resize(raw_len);
+            size_t n = ZSTD_decompress(&(*out)[0], raw_len, p, len);
+            return !ZSTD_isError(n) && n == raw_len;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+}  // namespace codec
+}  // namespace fr
@@ -0,0 +1,26 @@
+// Chunk payload compression. Lz4 is a self-contained implementation of the LZ4
+// block format (fast enough to run on every chunk); Zstd is available when
+// built with -DFR_HAVE_ZSTD and linked with -lzstd.
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "segment_format.hpp"
+
+namespace fr {
+namespace codec {
+
+bool available(seg::Codec c);
+// "none", "lz4", "zstd".
+bool parse(const std::string& name, seg::Codec* out);
+const char* name(seg::Codec c);
+
+// Compresses into *out. False if the codec is unavailable or the result would
+// not be smaller than the input; the caller then stores the chunk raw.
+bool compress(seg::Codec c, const void* src, size_t len, std::string* out);
+// Decompresses exactly raw_len bytes into *out. False on malformed input.
+bool decompress(seg::Codec c, const void* src, size_t len, size_t raw_len, std::string* out);
+
+}  // namespace codec
+}  // namespace fr
@@ -0,0 +1,256 @@
+#include "compactor.hpp"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "catalog.hpp"
+#include "log.hpp"
+#include "segment_reader.hpp"
+#include "storage_layout.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+
+// Finite samples only: NaN is how MAVLink says "no value", and one would
+// turn the bucket's sum (and, first in the bucket, its min and max) into NaN.
+struct Acc {
+    double min = 0, max = 0, sum = 0, last = 0;
+    int64_t last_t = INT64_MIN;
+    uint64_t count = 0;
+    uint64_t nulls = 0;  // non-finite samples left out
+
+    void add(int64_t t, double v) {
+        if (!std::isfinite(v)) {
+            nulls++;
+            return;
+        }
+        if (count == 0 || v < min) min = v;
+        if (count == 0 || v > max) max = v;
+        sum += v;
+        if (t >= last_t) {
+            last_t = t;
+            last = v;
+        }
+        count++;
+    }
+    void merge(const RollupPoint& p, int64_t p_last_t) {
+        if (p.count == 0) return;
+        if (count == 0 || p.min < min) min = p.min;
+        if (count == 0 || p.max > max) max = p.max;
+        sum += p.mean * p.count;
+        if (p_last_t >= last_t) {
+            last_t = p_last_t;
+            last = p.last;
+        }
+        count += p.count;
+    }
+    RollupPoint point(int64_t bucket) const {
+        return RollupPoint{bucket, min, max, sum / static_cast<double>(count), last, static_cast<uint32_t>(count)};
+    }
+};
+
+int64_t bucket_of(int64_t t, int64_t period) {
+    int64_t q = t / period;
+    if (t % period < 0) q--;
+    return q * period;
+}
+
+// channel -> bucket start -> points, in time order.
+using TierPoints = std::map<uint32_t, std::vector<RollupPoint>>;
+
+TierPoints coarsen(const TierPoints& finer, int64_t period) {
+    TierPoints out;
+    for (const auto& ch : finer) {
+        std::map<int64_t, Acc> buckets;
+        // Finer points are in time order, so the bucket start orders "last".
+        for (const auto& p : ch.second) buckets[bucket_of(p.t, period)].merge(p, p.t);
+        auto& dst = out[ch.first];
+        dst.reserve(buckets.size());
+        for (const auto& b : buckets) dst.push_back(b.second.point(b.first));
+    }
+    return out;
+}
+
+}  // namespace
+
+Compactor::Compactor(CompactorConfig cfg) : cfg_(std::move(cfg)) {}
+
+Compactor::~Compactor() { stop(false); }
+
+void Compactor::start() {
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread([this] { run(); });
+}
+
+void Compactor::stop(bool drain) {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stopping_ = true;
+        drain_ = drain;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void Compactor::enqueue(const SealedSegment& s) {
+    if (s.tier != seg::Tier::Raw) return;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        queue_.push_back(Job{s.flight_id, s.path, s.seq});
+    }
+    cv_.notify_one();
+}
+
+Compactor::Stats Compactor::stats() const {
+    Stats s;
+    s.segments_compacted = compacted_.load();
+    s.errors = errors_.load();
+    s.null_samples = nulls_.load();
+    std::lock_guard<std::mutex> lk(mu_);
+    s.queued = queue_.size();
+    return s;
+}
+
+bool Compactor::has_rollups(const std::string& flight_dir, uint32_t seq) {
+    std::string p = flight_dir + "/" + layout::segment_name(seq, seg::Tier::Rollup1m);
+    return access(p.c_str(), F_OK) == 0;
+}
+
+void Compactor::run() {
+    set_thread_name("fr-compactor");
+    set_background_priority();
+    if (cfg_.backfill) backfill();
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty() || (stopping_ && !drain_)) return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        compact(job.flight_id, job.path, job.seq);
+    }
+}
+
+void Compactor::backfill() {
+    std::string flights = layout::flights_dir(cfg_.root);
+    std::vector<Job> jobs;
+    if (cfg_.catalog) {
+        for (const auto& f : cfg_.catalog->flights()) {
+            for (const auto& s : f.second.segments) {
+                uint32_t seq = 0;
+                if (!layout::is_sealed_segment(s.first) || layout::segment_tier(s.first) != seg::Tier::Raw) continue;
+                if (!layout::parse_segment_seq(s.first, &seq) ||
+                    f.second.segments.count(layout::segment_name(seq, seg::Tier::Rollup1m)))
+                    continue;
+                jobs.push_back(Job{f.first, flights + "/" + f.first + "/" + s.first, seq});
+            }
+        }
+    } else if (DIR* top = opendir(flights.c_str())) {
+        while (dirent* fe = readdir(top)) {
+            if (fe->d_name[0] == '.') continue;
+            std::string dir = flights + "/" + fe->d_name;
+            DIR* d = opendir(dir.c_str());
+            if (!d) continue;
+            while (dirent* se = readdir(d)) {
+                std::string name = se->d_name;
+                uint32_t seq = 0;
+                if (!layout::is_sealed_segment(name) || layout::segment_tier(name) != seg::Tier::Raw) continue;
+                if (!layout::parse_segment_seq(name, &seq) || has_rollups(dir, seq)) continue;
+                jobs.push_back(Job{fe->d_name, dir + "/" + name, seq});
+            }
+            closedir(d);
+        }
+        closedir(top);
+    }
+    if (jobs.empty()) return;
+    FR_LOG_INFO("compactor: backfilling %zu segments", jobs.size());
+    std::lock_guard<std::mutex> lk(mu_);
+    for (auto& j : jobs) queue_.push_back(std::move(j));
+}
+
+bool Compactor::compact(const std::string& flight_id, const std::string& raw_path, uint32_t seq) {
+    SegmentReader reader;
+    reader.set_key(cfg_.key);
+    if (!reader.open(raw_path)) {
+        FR_LOG_WARN("compactor: %s", reader.error().c_str());
+        errors_++;
+        return false;
+    }
+
+    // 1 s tier straight from raw samples.
+    const int64_t p1 = seg::tier_period_ns(seg::Tier::Rollup1s);
+    std::map<uint32_t, std::map<int64_t, Acc>> acc;
+    ChunkData chunk;
+    bool complete = true;
+    for (const auto& e : reader.index()) {
+        if (e.kind != static_cast<uint8_t>(seg::ChunkKind::Samples)) continue;
+        if (!reader.read_chunk(e, &chunk)) {
+            FR_LOG_WARN("compactor: %s", reader.error().c_str());
+            errors_++;
+            complete = false;
+            continue;
+        }
+        auto& buckets = acc[e.channel];
+        for (size_t i = 0; i < chunk.t.size(); ++i) buckets[bucket_of(chunk.t[i], p1)].add(chunk.t[i], chunk.v[i]);
+    }
+
+    const int64_t t0 = reader.index().empty() ? 0 : reader.index().front().t_first;
+    TierPoints tiers[seg::kTierCount];
+    uint64_t nulls = 0;
+    for (const auto& ch : acc) {
+        auto& dst = tiers[1][ch.first];
+        dst.reserve(ch.second.size());
+        for (const auto& b : ch.second) {
+            nulls += b.second.nulls;
+            if (b.second.count) dst.push_back(b.second.point(b.first));
+        }
+    }
+    nulls_ += nulls;
+    tiers[2] = coarsen(tiers[1], seg::tier_period_ns(seg::Tier::Rollup10s));
+    tiers[3] = coarsen(tiers[2], seg::tier_period_ns(seg::Tier::Rollup1m));
+
+    // Finest first: the coarsest file's existence marks the segment as done.
+    // With a chunk unreadable the finer tiers are still worth having, but the
+    // marker is withheld: retention only drops raw segments that have it,
+    // and backfill retries the segment on the next start.
+    const int tiers_to_write = complete ? seg::kTierCount : seg::kTierCount - 1;
+    try {
+        for (int t = 1; t < tiers_to_write; ++t) {
+            SegmentWriterConfig wc;
+            wc.root = cfg_.root;
+            wc.flight_id = flight_id;
+            wc.tier = static_cast<seg::Tier>(t);
+            wc.first_seq = seq;
+            wc.max_segment_bytes = 0;
+            wc.max_segment_ns = 0;
+            wc.key = cfg_.key;
+            SegmentWriter w(wc);
+            w.set_seal_callback(on_sealed_);
+            w.begin(t0);
+            for (const auto& ch : tiers[t])
+                for (const auto& p : ch.second) w.append_rollup(ch.first, p);
+            w.close();
+        }
+    } catch (const std::exception& ex) {
+        FR_LOG_WARN("compactor: %s: %s", raw_path.c_str(), ex.what());
+        errors_++;
+        return false;
+    }
+    if (!complete) return false;
+    compacted_++;
+    return true;
+}
+
+}  // namespace fr
@@ -0,0 +1,98 @@
+// Background compactor: turns each sealed raw segment into 1 s, 10 s and 1 min
+// rollup segments holding min/max/mean/last/count per numeric channel, over
+// finite samples only (NaN is MAVLink's "no value"). Rollups use the regular
+// segment format, so readers need nothing special, and long-range queries
+// (query.hpp) read a few KB of rollups instead of GB of raw samples.
+//
+// Buckets are aligned to absolute multiples of the tier period. A bucket that
+// straddles two raw segments appears (partially) in both segments' rollups;
+// readers merging adjacent segments combine them by count.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "segment_writer.hpp"
+
+namespace fr {
+
+class Catalog;
+
+struct CompactorConfig {
+    std::string root;
+    // On start, look for sealed raw segments whose rollups are missing (e.g.
+    // after a crash) and queue them.
+    bool backfill = true;
+    // Optional; backfill consults it instead of walking every flight directory.
+    Catalog* catalog = nullptr;
+    // Reads encrypted raw segments and encrypts the rollups written from them.
+    std::shared_ptr<const MasterKey> key;
+};
+
+class Compactor {
+public:
+    struct Stats {
+        uint64_t segments_compacted = 0;
+        uint64_t errors = 0;
+        uint64_t queued = 0;
+        uint64_t null_samples = 0;  // non-finite, counted here instead of in any bucket
+    };
+
+    explicit Compactor(CompactorConfig cfg);
+    ~Compactor();
+
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+
+    // Receives every rollup segment this compactor seals (e.g. to feed retention).
+    void set_seal_callback(SegmentWriter::SealCallback cb) { on_sealed_ = std::move(cb); }
+
+    void start();
+    // Finishes the queue before returning unless `drain` is false.
+    void stop(bool drain = true);
+
+    // Queues a sealed raw segment. Cheap; safe to call from a writer's seal callback.
+    void enqueue(const SealedSegment& s);
+
+    // Builds all rollup tiers for one raw segment on the calling thread. If a
+    // chunk cannot be read, writes all but the coarsest (completion marker)
+    // tier and returns false.
+    bool compact(const std::string& flight_id, const std::string& raw_path, uint32_t seq);
+
+    Stats stats() const;
+
+    // True once the coarsest tier for `seq` exists, i.e. compaction completed.
+    static bool has_rollups(const std::string& flight_dir, uint32_t seq);
+
+private:
+    struct Job {
+        std::string flight_id;
+        std::string path;
+        uint32_t seq;
+    };
+
+    void run();
+    void backfill();
+
+    const CompactorConfig cfg_;
+    SegmentWriter::SealCallback on_sealed_;
+
+    std::thread thread_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    bool stopping_ = false;
+    bool drain_ = true;
+
+    std::atomic<uint64_t> compacted_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> nulls_{0};
+};
+
+}  // namespace fr
@@ -0,0 +1,404 @@
+#include "config.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "channels.hpp"
+#include "crc32c.hpp"
+#include "source.hpp"
+#include "value_storage.hpp"
+
+namespace fr {
+
+namespace cfg {
+
+size_t field_size(FieldType t) {
+    switch (t) {
+        case FieldType::U8:
+        case FieldType::I8: return 1;
+        case FieldType::U16:
+        case FieldType::I16: return 2;
+        case FieldType::U32:
+        case FieldType::I32:
+        case FieldType::F32: return 4;
+        case FieldType::U64:
+        case FieldType::I64:
+        case FieldType::F64: return 8;
+    }
+    return 0;
+}
+
+bool parse_field_type(const std::string& s, FieldType* out) {
+    static const std::pair<const char*, FieldType> kNames[] = {
+        {"u8", FieldType::U8},   {"i8", FieldType::I8},   {"u16", FieldType::U16}, {"i16", FieldType::I16},
+        {"u32", FieldType::U32}, {"i32", FieldType::I32}, {"u64", FieldType::U64}, {"i64", FieldType::I64},
+        {"f32", FieldType::F32}, {"f64", FieldType::F64},
+    };
+    for (const auto& n : kNames)
+        if (s == n.first) {
+            *out = n.second;
+            return true;
+        }
+    return false;
+}
+
+}  // namespace cfg
+
+// ---------------------------------------------------------------------------
+// Loading
+
+CompiledConfig::~CompiledConfig() {
+    if (map_) munmap(map_, size_);
+}
+
+std::shared_ptr<const CompiledConfig> CompiledConfig::load(const std::string& path, std::string* err) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *err = path + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    struct stat st{};
+    fstat(fd, &st);
+    if (st.st_size < static_cast<off_t>(sizeof(cfg::ConfigHeader))) {
+        close(fd);
+        *err = path + ": too small to be a compiled config";
+        return nullptr;
+    }
+    void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        *err = path + ": mmap: " + std::strerror(errno);
+        return nullptr;
+    }
+    std::shared_ptr<CompiledConfig> c(new CompiledConfig());
+    c->map_ = map;
+    c->data_ = static_cast<const uint8_t*>(map);
+    c->size_ = static_cast<size_t>(st.st_size);
+    if (!c->validate(err)) {
+        *err = path + ": " + *err;
+        return nullptr;
+    }
+    return c;
+}
+
+std::shared_ptr<const CompiledConfig> CompiledConfig::from_bytes(std::string bytes, std::string* err) {
+    std::shared_ptr<CompiledConfig> c(new CompiledConfig());
+    c->owned_ = std::move(bytes);
+    c->data_ = reinterpret_cast<const uint8_t*>(c->owned_.data());
+    c->size_ = c->owned_.size();
+    if (!c->validate(err)) return nullptr;
+    return c;
+}
+
+bool CompiledConfig::validate(std::string* err) const {
+    if (size_ < sizeof(cfg::ConfigHeader)) {
+        *err = "truncated header";
+        return false;
+    }
+    const cfg::ConfigHeader& h = header();
+    if (std::memcmp(h.magic, cfg::kMagic, sizeof(h.magic)) != 0) {
+        *err = "not a compiled config";
+        return false;
+    }
+    if (h.version != cfg::kVersion) {
+        *err = "config version " + std::to_string(h.version) + " not supported";
+        return false;
+    }
+    if (h.total_size != size_ ||
+        crc32c(data_ + sizeof(h), size_ - sizeof(h)) != h.crc) {
+        *err = "checksum mismatch";
+        return false;
+    }
+    auto in_bounds = [&](uint64_t off, uint64_t n, uint64_t elem) { return off + n * elem <= size_; };
+    if (!in_bounds(h.sources_off, h.n_sources, sizeof(cfg::SourceRec)) ||
+        !in_bounds(h.messages_off, h.n_messages, sizeof(cfg::MessageRec)) ||
+        !in_bounds(h.channels_off, h.n_channels, sizeof(cfg::ChannelRec)) || !in_bounds(h.strings_off, h.strings_size, 1) ||
+        (h.strings_size > 0 && data_[h.strings_off + h.strings_size - 1] != '\0')) {
+        *err = "table out of bounds";
+        return false;
+    }
+    for (uint32_t i = 0; i < h.n_messages; ++i) {
+        const auto& m = message(i);
+        if ((i > 0 && message(i - 1).msgid >= m.msgid) || uint64_t{m.first_channel} + m.n_channels > h.n_channels) {
+            *err = "message table corrupt";
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.n_channels; ++i) {
+        const auto& c = channel(i);
+        const auto s = static_cast<seg::ValueStorage>(c.storage);
+        if (c.name_off >= h.strings_size || c.type > static_cast<uint8_t>(cfg::FieldType::F64) ||
+            storage::packed_size(s, 0) == SIZE_MAX || (storage::fixed_point(s) && !(c.precision > 0))) {
+            *err = "channel table corrupt";
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.n_sources; ++i)
+        if (source(i).name_off >= h.strings_size || source(i).spec_off >= h.strings_size) {
+            *err = "source table corrupt";
+            return false;
+        }
+    return true;
+}
+
+int CompiledConfig::find_message(uint32_t msgid) const {
+    const cfg::MessageRec* m = messages();
+    uint32_t lo = 0, hi = header().n_messages;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (m[mid].msgid < msgid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < header().n_messages && m[lo].msgid == msgid ? static_cast<int>(lo) : -1;
+}
+
+const cfg::ChannelRec* CompiledConfig::find_channel(uint32_t id) const {
+    for (uint32_t i = 0; i < header().n_channels; ++i)
+        if (channels()[i].id == id) return &channels()[i];
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Compiling
+
+namespace {
+
+// A decimated channel still stores a sample this often, so a flat signal
+// shows up in every segment.
+constexpr double kDefaultMaxGapS = 10.0;
+
+struct KeyValues {
+    std::map<std::string, std::string> kv;
+    std::vector<std::string> positional;
+};
+
+KeyValues split_args(std::istringstream& in) {
+    KeyValues out;
+    std::string tok;
+    while (in >> tok) {
+        size_t eq = tok.find('=');
+        if (eq == std::string::npos)
+            out.positional.push_back(tok);
+        else
+            out.kv[tok.substr(0, eq)] = tok.substr(eq + 1);
+    }
+    return out;
+}
+
+bool to_number(const std::string& s, double* out) {
+    char* end = nullptr;
+    *out = std::strtod(s.c_str(), &end);
+    return !s.empty() && *end == '\0' && std::isfinite(*out);
+}
+
+class StringTable {
+public:
+    uint32_t add(const std::string& s) {
+        auto it = offsets_.find(s);
+        if (it != offsets_.end()) return it->second;
+        uint32_t off = static_cast<uint32_t>(bytes_.size());
+        bytes_.append(s);
+        bytes_.push_back('\0');
+        offsets_[s] = off;
+        return off;
+    }
+    const std::string& bytes() const { return bytes_; }
+
+private:
+    std::string bytes_;
+    std::map<std::string, uint32_t> offsets_;
+};
+
+template <typename T>
+void append_table(std::string* out, const std::vector<T>& v) {
+    out->append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+}  // namespace
+
+bool compile_config(const std::string& text, std::string* blob, std::string* errors) {
+    std::ostringstream errs;
+    auto error = [&](int line, const std::string& msg) { errs << "line " << line << ": " << msg << "\n"; };
+
+    StringTable strings;
+    std::vector<cfg::SourceRec> sources;
+    std::map<uint32_t, cfg::MessageRec> messages;
+    std::vector<cfg::ChannelRec> channels;
+    std::set<std::string> names;
+    std::set<uint32_t> channel_ids;
+
+    auto priority_of = [&](const KeyValues& a, int line, uint8_t* out) {
+        auto it = a.kv.find("priority");
+        if (it == a.kv.end()) return;
+        double p = 0;
+        if (!to_number(it->second, &p) || p < 0 || p > cfg::kLowestPriority || p != std::floor(p))
+            error(line, "priority must be 0.." + std::to_string(cfg::kLowestPriority));
+        else
+            *out = static_cast<uint8_t>(p);
+    };
+
+    std::istringstream lines(text);
+    std::string raw;
+    int lineno = 0;
+    while (std::getline(lines, raw)) {
+        lineno++;
+        size_t hash = raw.find('#');
+        if (hash != std::string::npos) raw.resize(hash);
+        std::istringstream in(raw);
+        std::string kind;
+        if (!(in >> kind)) continue;
+        KeyValues a = split_args(in);
+
+        if (kind == "source") {
+            // source <name> <spec> [priority=N]
+            if (a.positional.size() != 2) {
+                error(lineno, "expected: source <name> <spec> [priority=N]");
+                continue;
+            }
+            SourceSpec spec;
+            std::string err;
+            if (!parse_source_spec(a.positional[1], &spec, &err)) error(lineno, err);
+            if (!names.insert("source:" + a.positional[0]).second) error(lineno, "duplicate source " + a.positional[0]);
+            cfg::SourceRec s{};
+            s.name_off = strings.add(a.positional[0]);
+            s.spec_off = strings.add(a.positional[1]);
+            s.priority = 0;
+            priority_of(a, lineno, &s.priority);
+            sources.push_back(s);
+        } else if (kind == "message") {
+            // message <msgid> [priority=N] [max_rate_hz=R] [store=0|1]
+            double id = 0;
+            if (a.positional.size() != 1 || !to_number(a.positional[0], &id) || id < 0 || id > 0xffffff) {
+                error(lineno, "expected: message <msgid> [priority=N] [max_rate_hz=R] [store=0|1]");
+                continue;
+            }
+            auto msgid = static_cast<uint32_t>(id);
+            if (messages.count(msgid)) error(lineno, "duplicate message " + a.positional[0]);
+            cfg::MessageRec& m = messages[msgid];
+            m.msgid = msgid;
+            m.flags = cfg::kStoreFrame;
+            priority_of(a, lineno, &m.priority);
+            if (a.kv.count("max_rate_hz")) {
+                double hz = 0;
+                if (!to_number(a.kv["max_rate_hz"], &hz) || hz <= 0)
+                    error(lineno, "max_rate_hz must be > 0");
+                else
+                    m.min_interval_us = static_cast<uint32_t>(1e6 / hz);
+            }
+            if (a.kv.count("store") && a.kv["store"] == "0") m.flags &= static_cast<uint8_t>(~cfg::kStoreFrame);
+        } else if (kind == "channel") {
+            // channel <id> <name> msg=<msgid> offset=<n> type=<t> [scale=S] [bias=B] [priority=N]
+            //         [max_error=E] [max_gap_s=G] [storage=f64|f32|f16|bf16|i16|i32] [precision=P]
+            double id = 0, msg = 0, off = 0, scale = 1, bias = 0, max_error = 0, max_gap = kDefaultMaxGapS;
+            double precision = 0;
+            cfg::FieldType type{};
+            seg::ValueStorage stored = seg::ValueStorage::F64;
+            if (a.positional.size() != 2 || !to_number(a.positional[0], &id) || !a.kv.count("msg") ||
+                !a.kv.count("offset") || !a.kv.count("type")) {
+                error(lineno,
+                      "expected: channel <id> <name> msg=<msgid> offset=<n> type=<t> [scale=S] [bias=B] [priority=N] "
+                      "[max_error=E] [max_gap_s=G] [storage=T] [precision=P]");
+                continue;
+            }
+            if (id < 0 || id > channel::kLocalMask || id != std::floor(id)) error(lineno, "channel id out of range");
+            if (!to_number(a.kv["msg"], &msg) || msg < 0 || msg > 0xffffff) error(lineno, "bad msg id");
+            if (!cfg::parse_field_type(a.kv["type"], &type)) error(lineno, "unknown type " + a.kv["type"]);
+            if (!to_number(a.kv["offset"], &off) || off < 0 || off + cfg::field_size(type) > 255)
+                error(lineno, "field does not fit in a MAVLink payload");
+            if (a.kv.count("scale") && !to_number(a.kv["scale"], &scale)) error(lineno, "bad scale");
+            if (a.kv.count("bias") && !to_number(a.kv["bias"], &bias)) error(lineno, "bad bias");
+            if (a.kv.count("max_error") && (!to_number(a.kv["max_error"], &max_error) || max_error < 0))
+                error(lineno, "max_error must be >= 0");
+            if (a.kv.count("max_gap_s") && (!to_number(a.kv["max_gap_s"], &max_gap) || max_gap < 0))
+                error(lineno, "max_gap_s must be >= 0");
+            if (a.kv.count("storage") && !storage::parse(a.kv["storage"], &stored))
+                error(lineno, "unknown storage " + a.kv["storage"]);
+            if (a.kv.count("precision") && (!to_number(a.kv["precision"], &precision) || precision <= 0))
+                error(lineno, "precision must be > 0");
+            if (storage::fixed_point(stored) && !a.kv.count("precision"))
+                error(lineno, std::string("storage=") + storage::name(stored) + " needs precision=");
+            if (!storage::fixed_point(stored) && a.kv.count("precision"))
+                error(lineno, "precision applies to i16/i32 storage only");
+            if (!channel_ids.insert(static_cast<uint32_t>(id)).second) error(lineno, "duplicate channel id");
+            if (!names.insert("channel:" + a.positional[1]).second) error(lineno, "duplicate channel " + a.positional[1]);
+
+            cfg::ChannelRec c{};
+            c.id = static_cast<uint32_t>(id);
+            c.name_off = strings.add(a.positional[1]);
+            c.msgid = static_cast<uint32_t>(msg);
+            c.offset = static_cast<uint16_t>(off);
+            c.type = static_cast<uint8_t>(type);
+            c.scale = static_cast<float>(scale);
+            c.bias = static_cast<float>(bias);
+            c.max_error = static_cast<float>(max_error);
+            c.max_gap_s = static_cast<float>(max_gap);
+            c.storage = static_cast<uint8_t>(stored);
+            c.precision = static_cast<float>(precision);
+            priority_of(a, lineno, &c.priority);
+            channels.push_back(c);
+        } else {
+            error(lineno, "unknown directive '" + kind + "'");
+        }
+    }
+
+    // Group extractors by message so each rule owns one contiguous run.
+    std::stable_sort(channels.begin(), channels.end(),
+                     [](const cfg::ChannelRec& a, const cfg::ChannelRec& b) { return a.msgid < b.msgid; });
+    for (size_t i = 0; i < channels.size(); ++i) {
+        auto it = messages.find(channels[i].msgid);
+        if (it == messages.end()) {
+            cfg::MessageRec m{};
+            m.msgid = channels[i].msgid;
+            m.flags = cfg::kStoreFrame;
+            it = messages.emplace(m.msgid, m).first;
+        }
+        if (it->second.n_channels == 0) it->second.first_channel = static_cast<uint32_t>(i);
+        it->second.n_channels++;
+    }
+
+    *errors = errs.str();
+    if (!errors->empty()) return false;
+
+    std::vector<cfg::MessageRec> msg_table;
+    for (const auto& kv : messages) msg_table.push_back(kv.second);
+
+    cfg::ConfigHeader h{};
+    std::memcpy(h.magic, cfg::kMagic, sizeof(h.magic));
+    h.version = cfg::kVersion;
+    h.n_sources = static_cast<uint32_t>(sources.size());
+    h.n_messages = static_cast<uint32_t>(msg_table.size());
+    h.n_channels = static_cast<uint32_t>(channels.size());
+    h.sources_off = sizeof(h);
+    h.messages_off = h.sources_off + h.n_sources * static_cast<uint32_t>(sizeof(cfg::SourceRec));
+    h.channels_off = h.messages_off + h.n_messages * static_cast<uint32_t>(sizeof(cfg::MessageRec));
+    h.strings_off = h.channels_off + h.n_channels * static_cast<uint32_t>(sizeof(cfg::ChannelRec));
+    h.strings_size = static_cast<uint32_t>(strings.bytes().size());
+    h.total_size = h.strings_off + h.strings_size;
+
+    std::string body;
+    append_table(&body, sources);
+    append_table(&body, msg_table);
+    append_table(&body, channels);
+    body += strings.bytes();
+    h.crc = crc32c(body.data(), body.size());
+
+    blob->assign(reinterpret_cast<const char*>(&h), sizeof(h));
+    *blob += body;
+    return true;
+}
+
+}  // namespace fr
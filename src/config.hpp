@@ -0,0 +1,150 @@
+// Compiled recorder configuration.
+//
+// The human-edited text config is compiled offline (fr-recorder
+// compile-config) into a versioned, checksummed blob. At boot the recorder
+// mmaps the blob and uses its tables in place: message rules are sorted by
+// msgid for binary search, and each rule points at a contiguous run of field
+// extractors. Nothing is parsed on the vehicle.
+//
+//   ConfigHeader | SourceRec[] | MessageRec[] | ChannelRec[] | strings
+//
+// The same bytes are embedded in every segment (channel::kMeta) so a flight
+// log always carries the exact configuration that produced it.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace fr {
+namespace cfg {
+
+constexpr char kMagic[8] = {'F', 'R', 'C', 'F', 'G', '0', '1', '\n'};
+constexpr uint16_t kVersion = 1;  // anything else is rejected
+constexpr uint8_t kLowestPriority = 3;
+
+enum class FieldType : uint8_t { U8, I8, U16, I16, U32, I32, U64, I64, F32, F64 };
+
+size_t field_size(FieldType t);
+bool parse_field_type(const std::string& s, FieldType* out);
+
+enum MessageFlags : uint8_t {
+    kStoreFrame = 1 << 0,  // keep the whole frame as a blob as well as decoded fields
+};
+
+#pragma pack(push, 1)
+
+struct ConfigHeader {
+    char magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t total_size;
+    uint32_t crc;  // CRC-32C of everything after the header
+    uint32_t n_sources;
+    uint32_t n_messages;
+    uint32_t n_channels;
+    uint32_t sources_off;
+    uint32_t messages_off;
+    uint32_t channels_off;
+    uint32_t strings_off;
+    uint32_t strings_size;
+};
+
+struct SourceRec {
+    uint32_t name_off;  // into the string table
+    uint32_t spec_off;
+    uint8_t priority;
+    uint8_t reserved[3];
+};
+
+struct MessageRec {
+    uint32_t msgid;
+    uint32_t min_interval_us;  // 0: store every frame
+    uint32_t first_channel;    // index into ChannelRec[]
+    uint32_t n_channels;
+    uint8_t priority;
+    uint8_t flags;
+    uint8_t reserved[2];
+};
+
+struct ChannelRec {
+    uint32_t id;
+    uint32_t name_off;
+    uint32_t msgid;
+    uint16_t offset;  // byte offset of the field in the message payload
+    uint8_t type;     // FieldType
+    uint8_t priority;
+    float scale;
+    float bias;
+    // Swinging-door decimation (see swinging_door.hpp): 0 stores every
+    // sample, else the reconstruction error bound in output units.
+    float max_error;
+    float max_gap_s;  // longest time without a stored sample; 0: unbounded
+    // Stored value type (seg::ValueStorage, see value_storage.hpp) and, for
+    // fixed point, its resolution in output units.
+    uint8_t storage;
+    uint8_t reserved[3];
+    float precision;
+};
+
+#pragma pack(pop)
+
+}  // namespace cfg
+
+// Read-only view over a compiled config, either mmapped from a file or held in
+// memory. Accessors never allocate.
+class CompiledConfig {
+public:
+    ~CompiledConfig();
+
+    CompiledConfig(const CompiledConfig&) = delete;
+    CompiledConfig& operator=(const CompiledConfig&) = delete;
+
+    // mmaps and validates a compiled config file. nullptr (with *err) on failure.
+    static std::shared_ptr<const CompiledConfig> load(const std::string& path, std::string* err);
+    // Validates and takes ownership of an in-memory blob.
+    static std::shared_ptr<const CompiledConfig> from_bytes(std::string bytes, std::string* err);
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    uint32_t crc() const { return header().crc; }
+
+    const cfg::ConfigHeader& header() const { return *reinterpret_cast<const cfg::ConfigHeader*>(data_); }
+    uint32_t source_count() const { return header().n_sources; }
+    uint32_t message_count() const { return header().n_messages; }
+    uint32_t channel_count() const { return header().n_channels; }
+
+    const cfg::SourceRec& source(uint32_t i) const { return sources()[i]; }
+    const cfg::MessageRec& message(uint32_t i) const { return messages()[i]; }
+    const cfg::ChannelRec& channel(uint32_t i) const { return channels()[i]; }
+    const char* str(uint32_t off) const { return reinterpret_cast<const char*>(data_ + header().strings_off + off); }
+
+    // Rule index for msgid, or -1. Binary search over the sorted table.
+    int find_message(uint32_t msgid) const;
+    // Channel record by channel id, or nullptr.
+    const cfg::ChannelRec* find_channel(uint32_t id) const;
+
+private:
+    CompiledConfig() = default;
+    bool validate(std::string* err) const;
+
+    const cfg::SourceRec* sources() const { return reinterpret_cast<const cfg::SourceRec*>(data_ + header().sources_off); }
+    const cfg::MessageRec* messages() const {
+        return reinterpret_cast<const cfg::MessageRec*>(data_ + header().messages_off);
+    }
+    const cfg::ChannelRec* channels() const {
+        return reinterpret_cast<const cfg::ChannelRec*>(data_ + header().channels_off);
+    }
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    void* map_ = nullptr;  // non-null when mmapped
+    std::string owned_;
+};
+
+// Compiles text config into a blob. On failure returns false and fills *errors
+// with one "line N: ..." message per problem found.
+bool compile_config(const std::string& text, std::string* blob, std::string* errors);
+
+}  // namespace fr
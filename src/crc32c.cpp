@@ -0,0 +1,44 @@
+#include "crc32c.hpp"
+
+namespace fr {
+
+namespace {
+
+struct Table {
+    uint32_t t[8][256];
+    Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i)
+            for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+    }
+};
+
+const Table& table() {
+    static const Table tab;
+    return tab;
+}
+
+}  // namespace
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+    const auto& t = table().t;
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    // Slicing-by-8: one table lookup per byte but eight independent loads per step.
+    while (len >= 8) {
+        uint32_t lo = crc ^ (static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+                             static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    return ~crc;
+}
+
+}  // namespace fr
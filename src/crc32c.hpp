@@ -0,0 +1,12 @@
+// CRC-32C (Castagnoli), used for chunk, index and journal checksums.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fr {
+
+// Pass the previous result as `crc` to checksum data in pieces.
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+}  // namespace fr
@@ -0,0 +1,83 @@
+#include "decoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace fr {
+
+Decoder::Decoder(std::shared_ptr<const CompiledConfig> cfg)
+    : cfg_(std::move(cfg)), last_stored_ns_(256), doors_(256), last_thinned_ns_(256) {}
+
+SwingingDoor& Decoder::door(uint8_t sysid, uint32_t channel_index) {
+    std::vector<SwingingDoor>& per_channel = doors_[sysid];
+    if (per_channel.empty()) {
+        per_channel.reserve(cfg_->channel_count());
+        for (uint32_t i = 0; i < cfg_->channel_count(); ++i) {
+            const cfg::ChannelRec& c = cfg_->channel(i);
+            per_channel.emplace_back(c.max_error, static_cast<int64_t>(static_cast<double>(c.max_gap_s) * 1e9));
+        }
+    }
+    return per_channel[channel_index];
+}
+
+uint64_t Decoder::samples_decimated() const {
+    uint64_t n = 0;
+    for (const auto& per_channel : doors_)
+        for (const auto& d : per_channel) n += d.samples_in() - d.samples_out();
+    return n;
+}
+
+double Decoder::read_field(const MavFrame& f, const cfg::ChannelRec& c) {
+    const auto type = static_cast<cfg::FieldType>(c.type);
+    uint8_t raw[8] = {};
+    const size_t n = cfg::field_size(type);
+    if (c.offset < f.payload_len) std::memcpy(raw, f.payload + c.offset, std::min<size_t>(n, f.payload_len - c.offset));
+
+    switch (type) {
+        case cfg::FieldType::U8: return raw[0];
+        case cfg::FieldType::I8: return static_cast<int8_t>(raw[0]);
+        case cfg::FieldType::U16: {
+            uint16_t v;
+            std::memcpy(&v, raw, sizeof(v));
+            return v;
+        }
+        case cfg::FieldType::I16: {
+            int16_t v;
+            std::memcpy(&v, raw, sizeof(v));
+            return v;
+        }
+        case cfg::FieldType::U32: {
+            uint32_t v;
+            std::memcpy(&v, raw, sizeof(v));
+            return v;
+        }
+        case cfg::FieldType::I32: {
+            int32_t v;
+            std::memcpy(&v, raw, sizeof(v));
+            return v;
+        }
+        case cfg::FieldType::U64: {
+            uint64_t v;
+            std::memcpy(&v, raw, sizeof(v));
+            return static_cast<double>(v);
+        }
+        case cfg::FieldType::I64: {
+            int64_t v;
+            std::memcpy(&v, raw, sizeof(v));
+            return static_cast<double>(v);
+        }
+        case cfg::FieldType::F32: {
+            float v;
+            std::memcpy(&v, raw, sizeof(v));
+            return v;
+        }
+        case cfg::FieldType::F64: {
+            double v;
+            std::memcpy(&v, raw, sizeof(v));
+            return v;
+        }
+    }
+    return 0.0;
+}
+
+}  // namespace fr
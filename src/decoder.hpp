@@ -0,0 +1,200 @@
+// Applies a compiled config to MAVLink frames: per-message storage rules
+// (rate limit, keep the raw frame or not) and numeric field extraction onto
+// channel::kDecoded channels.
+//
+// Channels with a max_error are decimated per vehicle by a SwingingDoor, so
+// the last sample of such a channel may be held back. It is released by the
+// channel's next sample, by flush() or flush_vehicle(), or once it is older
+// than the channel's max_gap (checked as the source's frames come in).
+//
+// While thermal thinning is on (set_thinning), messages and channels whose
+// config priority is at or below a threshold are stored at most once per
+// thinning interval per vehicle; higher-priority data is untouched.
+//
+// Messages without a rule are stored as whole frames, as without a config.
+// One Decoder per source thread; not thread-safe.
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "channels.hpp"
+#include "config.hpp"
+#include "mavlink.hpp"
+#include "record.hpp"
+#include "swinging_door.hpp"
+
+namespace fr {
+
+class Decoder {
+public:
+    explicit Decoder(std::shared_ptr<const CompiledConfig> cfg);
+
+    // Calls emit(Record&&) for the frame blob (unless rate-limited or not
+    // stored) and for every configured field of the message.
+    template <typename Emit>
+    void decode(const MavFrame& f, int64_t t_ns, uint16_t source, Emit&& emit);
+
+    // Emits every sample still held back by decimation (end of recording,
+    // source lost or reopened).
+    template <typename Emit>
+    void flush(uint16_t source, Emit&& emit);
+    // The same for one vehicle (it disarmed: its sortie is about to close).
+    template <typename Emit>
+    void flush_vehicle(uint8_t sysid, uint16_t source, Emit&& emit);
+
+    // `interval_ns` (0: off) is read on every frame and may be changed from
+    // another thread; it must outlive the decoder. Priorities are 0 (highest)
+    // to cfg::kLowestPriority; `min_priority` and above get thinned.
+    void set_thinning(const std::atomic<int64_t>* interval_ns, uint8_t min_priority) {
+        thin_ns_ = interval_ns;
+        thin_priority_ = min_priority;
+    }
+
+    uint64_t frames_skipped() const { return frames_skipped_; }
+    // Messages and samples dropped by thermal thinning so far.
+    uint64_t thinned() const { return thinned_; }
+    // Decoded samples dropped by decimation so far.
+    uint64_t samples_decimated() const;
+
+private:
+    SwingingDoor& door(uint8_t sysid, uint32_t channel_index);
+    // Releases held samples older than their channel's max_gap.
+    template <typename Emit>
+    void expire(int64_t now, uint16_t source, Emit&& emit);
+
+    static constexpr int64_t kExpireCheckNs = 100000000;
+
+    static Record sample(uint32_t id, int64_t t_ns, double v, uint16_t source, uint8_t vehicle) {
+        Record r;
+        r.t_ns = t_ns;
+        r.channel = channel::make(channel::kDecoded, id);
+        r.source = source;
+        r.vehicle = vehicle;
+        r.value = v;
+        return r;
+    }
+
+    // Little-endian field at c.offset; bytes past payload_len read as zero
+    // because MAVLink v2 truncates trailing zero bytes.
+    static double read_field(const MavFrame& f, const cfg::ChannelRec& c);
+
+    std::shared_ptr<const CompiledConfig> cfg_;
+    // [sysid][rule], allocated on first frame from that vehicle so a link
+    // carrying a swarm rate-limits every vehicle independently.
+    std::vector<std::vector<int64_t>> last_stored_ns_;
+    // [sysid][channel index], allocated the same way; only decimated channels use theirs.
+    std::vector<std::vector<SwingingDoor>> doors_;
+    // [sysid][rule] like last_stored_ns_, for thinning.
+    std::vector<std::vector<int64_t>> last_thinned_ns_;
+    const std::atomic<int64_t>* thin_ns_ = nullptr;
+    uint8_t thin_priority_ = cfg::kLowestPriority;
+    uint64_t frames_skipped_ = 0;
+    uint64_t thinned_ = 0;
+    int64_t next_expire_ns_ = 0;
+};
+
+template <typename Emit>
+void Decoder::decode(const MavFrame& f, int64_t t_ns, uint16_t source, Emit&& emit) {
+    auto store_frame = [&] {
+        Record r;
+        r.t_ns = t_ns;
+        r.channel = channel::make(channel::kMavlink, f.msgid);
+        r.source = source;
+        r.vehicle = f.sysid;
+        r.blob = true;
+        r.bytes.assign(reinterpret_cast<const char*>(f.data), f.len);
+        emit(std::move(r));
+    };
+
+    if (t_ns >= next_expire_ns_) {
+        next_expire_ns_ = t_ns + kExpireCheckNs;
+        expire(t_ns, source, emit);
+    }
+
+    const int rule = cfg_->find_message(f.msgid);
+    if (rule < 0) {
+        store_frame();
+        return;
+    }
+    const cfg::MessageRec& m = cfg_->message(static_cast<uint32_t>(rule));
+    bool thin = false;
+    if (const int64_t thin_ns = thin_ns_ ? thin_ns_->load(std::memory_order_relaxed) : 0) {
+        std::vector<int64_t>& per_rule = last_thinned_ns_[f.sysid];
+        if (per_rule.empty()) per_rule.resize(cfg_->message_count(), 0);
+        int64_t& last = per_rule[static_cast<size_t>(rule)];
+        if (last == 0 || t_ns - last >= thin_ns)
+            last = t_ns;
+        else
+            thin = true;
+    }
+    if (thin && m.priority >= thin_priority_) {
+        thinned_++;
+        return;
+    }
+    if (m.flags & cfg::kStoreFrame) {
+        std::vector<int64_t>& per_rule = last_stored_ns_[f.sysid];
+        if (per_rule.empty()) per_rule.resize(cfg_->message_count(), 0);
+        int64_t& last = per_rule[static_cast<size_t>(rule)];
+        if (m.min_interval_us == 0 || last == 0 || t_ns - last >= int64_t{m.min_interval_us} * 1000) {
+            last = t_ns;
+            store_frame();
+        } else {
+            frames_skipped_++;
+        }
+    }
+    for (uint32_t i = 0; i < m.n_channels; ++i) {
+        const cfg::ChannelRec& c = cfg_->channel(m.first_channel + i);
+        if (thin && c.priority >= thin_priority_) {
+            thinned_++;
+            continue;
+        }
+        const double v = read_field(f, c) * c.scale + c.bias;
+        if (c.max_error <= 0) {
+            emit(sample(c.id, t_ns, v, source, f.sysid));
+            continue;
+        }
+        SwingingDoor& d = door(f.sysid, m.first_channel + i);
+        SwingingDoor::Point out[2];
+        if (!std::isfinite(v)) {
+            // Not something a line can approximate: store it as-is.
+            if (d.flush(out)) emit(sample(c.id, out[0].t, out[0].v, source, f.sysid));
+            d.reset();
+            emit(sample(c.id, t_ns, v, source, f.sysid));
+            continue;
+        }
+        const int n = d.push(t_ns, v, out);
+        for (int k = 0; k < n; ++k) emit(sample(c.id, out[k].t, out[k].v, source, f.sysid));
+    }
+}
+
+template <typename Emit>
+void Decoder::flush(uint16_t source, Emit&& emit) {
+    for (size_t sysid = 0; sysid < doors_.size(); ++sysid) flush_vehicle(static_cast<uint8_t>(sysid), source, emit);
+}
+
+template <typename Emit>
+void Decoder::flush_vehicle(uint8_t sysid, uint16_t source, Emit&& emit) {
+    std::vector<SwingingDoor>& per_channel = doors_[sysid];
+    for (size_t i = 0; i < per_channel.size(); ++i) {
+        SwingingDoor::Point p;
+        if (per_channel[i].flush(&p)) emit(sample(cfg_->channel(static_cast<uint32_t>(i)).id, p.t, p.v, source, sysid));
+    }
+}
+
+template <typename Emit>
+void Decoder::expire(int64_t now, uint16_t source, Emit&& emit) {
+    for (size_t sysid = 0; sysid < doors_.size(); ++sysid) {
+        std::vector<SwingingDoor>& per_channel = doors_[sysid];
+        for (size_t i = 0; i < per_channel.size(); ++i) {
+            SwingingDoor::Point p;
+            if (per_channel[i].expire(now, &p))
+                emit(sample(cfg_->channel(static_cast<uint32_t>(i)).id, p.t, p.v, source, static_cast<uint8_t>(sysid)));
+        }
+    }
+}
+
+}  // namespace fr
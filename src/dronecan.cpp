@@ -0,0 +1,126 @@
+#include "dronecan.hpp"
+
+#include <linux/can.h>
+
+#include <cstring>
+
+namespace fr {
+
+namespace {
+
+constexpr uint8_t kStartOfTransfer = 0x80;
+constexpr uint8_t kEndOfTransfer = 0x40;
+constexpr uint8_t kToggle = 0x20;
+constexpr uint8_t kTransferIdMask = 0x1f;
+
+uint32_t local_id(uint32_t id) {
+    if (id & 0x80) return dronecan::kService | ((id >> 16) & 0xff);
+    // Anonymous messages (source node 0) reuse the upper bits as a discriminator.
+    return (id & 0x7f) == 0 ? (id >> 8) & 0x3 : (id >> 8) & 0xffff;
+}
+
+}  // namespace
+
+DroneCanReassembler::DroneCanReassembler() : storage_(dronecan::kSlots * dronecan::kMaxPayload) {
+    for (size_t i = 0; i < dronecan::kSlots; ++i) slots_[i].buf = storage_.data() + i * dronecan::kMaxPayload;
+}
+
+DroneCanReassembler::Slot* DroneCanReassembler::find(uint32_t key) {
+    for (Slot& s : slots_)
+        if (s.used && s.key == key) return &s;
+    return nullptr;
+}
+
+DroneCanReassembler::Slot* DroneCanReassembler::allocate(uint32_t key, int64_t t_ns) {
+    Slot* oldest = nullptr;
+    for (Slot& s : slots_) {
+        if (!s.used) {
+            oldest = &s;
+            break;
+        }
+        if (!oldest || s.t_start < oldest->t_start) oldest = &s;
+    }
+    if (oldest->used) {
+        if (t_ns - oldest->t_start > dronecan::kTimeoutNs)
+            stats_.timeouts++;
+        else
+            stats_.evictions++;
+    }
+    oldest->used = true;
+    oldest->key = key;
+    return oldest;
+}
+
+const DroneCanTransfer* DroneCanReassembler::push(const can_frame& f, int64_t t_ns) {
+    if (!(f.can_id & CAN_EFF_FLAG) || (f.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) || f.can_dlc < 1 || f.can_dlc > 8)
+        return nullptr;
+    stats_.frames++;
+    const uint32_t id = f.can_id & CAN_EFF_MASK;
+    const uint32_t key = id & 0x00ffffff;
+    const uint8_t tail = f.data[f.can_dlc - 1];
+    const uint8_t tid = tail & kTransferIdMask;
+    const uint8_t toggle = (tail & kToggle) ? 1 : 0;
+    const size_t n = f.can_dlc - 1u;
+
+    if ((tail & kStartOfTransfer) && (tail & kEndOfTransfer)) {
+        stats_.transfers++;
+        done_ = DroneCanTransfer{id, local_id(id), 0, false, f.data, n};
+        return &done_;
+    }
+    if (tail & kStartOfTransfer) {
+        if (toggle != 0 || n < 2) {
+            stats_.errors++;
+            return nullptr;
+        }
+        Slot* s = find(key);
+        if (s) {
+            stats_.errors++;  // the previous transfer never finished
+        } else {
+            s = allocate(key, t_ns);
+        }
+        s->can_id = id;
+        s->transfer_id = tid;
+        s->toggle = 1;
+        s->crc = static_cast<uint16_t>(f.data[0] | f.data[1] << 8);
+        s->t_start = t_ns;
+        s->len = n - 2;
+        std::memcpy(s->buf, f.data + 2, s->len);
+        return nullptr;
+    }
+
+    Slot* s = find(key);
+    if (!s) {
+        stats_.orphans++;
+        return nullptr;
+    }
+    if (t_ns - s->t_start > dronecan::kTimeoutNs) {
+        stats_.timeouts++;
+        s->used = false;
+        return nullptr;
+    }
+    if (tid != s->transfer_id || toggle != s->toggle || s->len + n > dronecan::kMaxPayload) {
+        stats_.errors++;
+        s->used = false;
+        return nullptr;
+    }
+    std::memcpy(s->buf + s->len, f.data, n);
+    s->len += n;
+    s->toggle ^= 1;
+    if (!(tail & kEndOfTransfer)) return nullptr;
+    s->used = false;  // the buffer stays intact until the next push()
+    stats_.transfers++;
+    stats_.multi_frame++;
+    done_ = DroneCanTransfer{s->can_id, local_id(s->can_id), s->crc, true, s->buf, s->len};
+    return &done_;
+}
+
+void DroneCanReassembler::encode(const DroneCanTransfer& t, std::string* out) {
+    char hdr[dronecan::kRecordHeader];
+    for (int i = 0; i < 4; ++i) hdr[i] = static_cast<char>(t.can_id >> (8 * i));
+    hdr[4] = static_cast<char>(t.transfer_crc);
+    hdr[5] = static_cast<char>(t.transfer_crc >> 8);
+    out->assign(hdr, sizeof(hdr));
+    out->append(reinterpret_cast<const char*>(t.payload), t.len);
+}
+
+}  // namespace fr
@@ -0,0 +1,92 @@
+// DroneCAN (UAVCAN v0) transfer reassembly over raw SocketCAN frames.
+//
+// Every frame carries a tail byte (start/end of transfer, toggle, transfer
+// id). Multi-frame transfers open with a 2-byte transfer CRC that is seeded
+// with the data type signature, which only the DSDL knows; it is kept with
+// the payload so offline tools can check it. Partial transfers are collected
+// in a fixed table of preallocated session slots, so the CAN thread never
+// allocates no matter how many ESCs and batteries are talking.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct can_frame;
+
+namespace fr {
+
+namespace dronecan {
+
+constexpr size_t kSlots = 32;            // concurrent multi-frame sessions
+constexpr size_t kMaxPayload = 1024;     // larger transfers are dropped
+constexpr int64_t kTimeoutNs = 2000000000;  // transfer timeout from the spec
+
+// Local id within channel::kDroneCan: message data type id, or kService |
+// service type id. Anonymous messages keep only their 2-bit type id.
+constexpr uint32_t kService = 1u << 16;
+
+// Stored record layout: [u32 can_id LE][u16 transfer_crc LE][payload]. The
+// CAN id of the first frame carries priority, source and (for services)
+// destination node; transfer_crc is 0 for single-frame transfers.
+constexpr size_t kRecordHeader = 6;
+
+}  // namespace dronecan
+
+struct DroneCanTransfer {
+    uint32_t can_id;  // 29-bit id of the first frame
+    uint32_t local;   // channel local id, see dronecan::kService
+    uint16_t transfer_crc;
+    bool multi_frame;
+    const uint8_t* payload;  // tail bytes and transfer CRC removed
+    size_t len;
+};
+
+class DroneCanReassembler {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t transfers = 0;
+        uint64_t multi_frame = 0;
+        uint64_t errors = 0;     // toggle or transfer id mismatch, oversize
+        uint64_t orphans = 0;    // continuation without a start
+        uint64_t timeouts = 0;   // sessions abandoned mid-transfer
+        uint64_t evictions = 0;  // slot table full
+    };
+
+    DroneCanReassembler();
+
+    // Feeds one frame received at t_ns. Returns the transfer it completes,
+    // valid until the next call (and while `f` lives), or nullptr.
+    // Standard-id, RTR and error frames are ignored.
+    const DroneCanTransfer* push(const can_frame& f, int64_t t_ns);
+
+    // Serializes `t` in the stored record layout.
+    static void encode(const DroneCanTransfer& t, std::string* out);
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Slot {
+        uint32_t key = 0;  // can id without priority
+        uint32_t can_id = 0;
+        bool used = false;
+        uint8_t transfer_id = 0;
+        uint8_t toggle = 0;  // expected on the next frame
+        uint16_t crc = 0;
+        int64_t t_start = 0;
+        size_t len = 0;
+        uint8_t* buf = nullptr;  // kMaxPayload bytes in storage_
+    };
+
+    Slot* find(uint32_t key);
+    Slot* allocate(uint32_t key, int64_t t_ns);
+
+    std::vector<uint8_t> storage_;
+    Slot slots_[dronecan::kSlots];
+    DroneCanTransfer done_{};
+    Stats stats_;
+};
+
+}  // namespace fr
@@ -0,0 +1,34 @@
+// Small POSIX file helpers shared by the writers and readers. Functions that
+// return bool leave errno set on failure.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fr {
+
+// mkdir -p. Throws std::system_error on failure.
+void make_dirs(const std::string& path);
+
+// Sorted entry names of a directory, without "." and "..". Empty if it
+// cannot be opened.
+std::vector<std::string> list_dir(const std::string& path);
+
+// fsync()s a directory so renames/unlinks inside it are durable.
+bool fsync_dir(const std::string& path);
+
+// Writes `path.tmp`, fsyncs it, renames it over `path` and fsyncs the
+// directory, so readers see either the old file or the complete new one.
+bool write_file_atomic(const std::string& path, const void* data, size_t len);
+
+// Whole file into `out`; false (errno set) if it cannot be read.
+bool read_file(const std::string& path, std::string* out);
+
+// Loops over short writes / EINTR.
+bool write_all(int fd, const void* data, size_t len);
+// Loops over short reads / EINTR; false on EOF before `len` bytes.
+bool pread_all(int fd, void* data, size_t len, uint64_t offset);
+
+}  // namespace fr
@@ -0,0 +1,105 @@
+#include "gnss.hpp"
+
+namespace fr {
+
+namespace gnss {
+
+namespace {
+
+struct Crc24Table {
+    uint32_t t[256];
+    Crc24Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i << 16;
+            for (int k = 0; k < 8; ++k) c = (c & 0x800000) ? (c << 1) ^ 0x1864cfbu : c << 1;
+            t[i] = c & 0xffffff;
+        }
+    }
+};
+
+const Crc24Table& crc24_table() {
+    static const Crc24Table tab;
+    return tab;
+}
+
+}  // namespace
+
+uint32_t crc24q(const uint8_t* p, size_t n, uint32_t crc) {
+    const uint32_t* t = crc24_table().t;
+    while (n--) crc = ((crc << 8) ^ t[((crc >> 16) ^ *p++) & 0xff]) & 0xffffff;
+    return crc;
+}
+
+}  // namespace gnss
+
+size_t GnssFramer::wanted(const uint8_t* p, size_t n) {
+    if (p[0] == gnss::kUbxSync1) {
+        if (n < 2) return 2;
+        if (p[1] != gnss::kUbxSync2 || n < 6) return 6;
+        size_t len = static_cast<size_t>(p[4]) | static_cast<size_t>(p[5]) << 8;
+        return len > gnss::kUbxMaxPayload ? 6 : len + 8;
+    }
+    if (p[0] == gnss::kRtcmPreamble) {
+        if (n < 3 || (p[1] & 0xfc)) return 3;
+        return ((static_cast<size_t>(p[1] & 0x03) << 8) | p[2]) + 6;
+    }
+    return 1;
+}
+
+size_t GnssFramer::parse_one(const uint8_t* p, size_t n, GnssFrame* frame, bool* ok) {
+    *ok = false;
+    if (!is_start(p[0])) {
+        size_t skip = 1;
+        while (skip < n && !is_start(p[skip])) skip++;
+        stats_.skipped_bytes += skip;
+        return skip;
+    }
+    size_t need = wanted(p, n);
+    if (n < need) return 0;
+
+    GnssFrame f{};
+    f.data = p;
+    f.len = need;
+    if (p[0] == gnss::kUbxSync1) {
+        if (p[1] != gnss::kUbxSync2 || need == 6) {  // false sync or implausible length
+            stats_.skipped_bytes++;
+            return 1;
+        }
+        uint8_t a = 0, b = 0;
+        for (size_t i = 2; i < need - 2; ++i) {
+            a = static_cast<uint8_t>(a + p[i]);
+            b = static_cast<uint8_t>(b + a);
+        }
+        if (a != p[need - 2] || b != p[need - 1]) {
+            stats_.crc_errors++;
+            return 1;
+        }
+        f.rtcm = false;
+        f.msg_id = static_cast<uint16_t>(p[2] << 8 | p[3]);
+        f.payload = p + 6;
+        f.payload_len = static_cast<uint16_t>(need - 8);
+        stats_.ubx_frames++;
+    } else {
+        if (p[1] & 0xfc) {  // reserved bits must be zero
+            stats_.skipped_bytes++;
+            return 1;
+        }
+        uint32_t crc = gnss::crc24q(p, need - 3);
+        uint32_t got = static_cast<uint32_t>(p[need - 3]) << 16 | static_cast<uint32_t>(p[need - 2]) << 8 | p[need - 1];
+        if (crc != got) {
+            stats_.crc_errors++;
+            return 1;
+        }
+        f.rtcm = true;
+        f.payload = p + 3;
+        f.payload_len = static_cast<uint16_t>(need - 6);
+        f.msg_id = f.payload_len >= 2 ? static_cast<uint16_t>(f.payload[0] << 4 | f.payload[1] >> 4) : 0;
+        stats_.rtcm_frames++;
+    }
+    stats_.frames++;
+    *frame = f;
+    *ok = true;
+    return need;
+}
+
+}  // namespace fr
@@ -0,0 +1,111 @@
+// Streaming u-blox UBX and RTCM3 frame extraction for GNSS receivers. Like
+// MavlinkFramer, the framer only finds frame boundaries and validates
+// checksums (Fletcher-8 for UBX, CRC-24Q for RTCM3); raw observations are
+// stored whole for post-processed kinematics. Receivers usually interleave
+// both with NMEA sentences on one port, so the framer accepts either
+// protocol and skips everything else.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "source.hpp"
+
+namespace fr {
+
+struct GnssFrame {
+    const uint8_t* data;  // whole frame, sync through checksum
+    size_t len;
+    const uint8_t* payload;
+    uint16_t payload_len;
+    bool rtcm;        // RTCM3 rather than UBX
+    uint16_t msg_id;  // UBX: class << 8 | id; RTCM3: 12-bit message number (0 if the payload is too short)
+};
+
+namespace gnss {
+
+constexpr uint8_t kUbxSync1 = 0xb5;
+constexpr uint8_t kUbxSync2 = 0x62;
+constexpr uint8_t kRtcmPreamble = 0xd3;
+// UBX allows 64 KiB payloads, but nothing a receiver streams comes close
+// (RXM-RAWX with 64 signals is ~2 KiB); a larger length is a false sync.
+constexpr size_t kUbxMaxPayload = 8192;
+
+enum Accept : uint8_t { kUbx = 1, kRtcm3 = 2, kBoth = 3 };
+
+// Frames accepted on a source speaking `p` (0 for MAVLink).
+constexpr uint8_t accept_for(LinkProtocol p) {
+    return p == LinkProtocol::Ubx ? kUbx : p == LinkProtocol::Rtcm3 ? kRtcm3 : p == LinkProtocol::Gnss ? kBoth : 0;
+}
+
+// CRC-24Q as used by RTCM3 (and SBAS): polynomial 0x1864CFB, zero seed.
+uint32_t crc24q(const uint8_t* p, size_t n, uint32_t crc = 0);
+
+}  // namespace gnss
+
+class GnssFramer {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t ubx_frames = 0;
+        uint64_t rtcm_frames = 0;
+        uint64_t crc_errors = 0;
+        uint64_t skipped_bytes = 0;
+    };
+
+    explicit GnssFramer(uint8_t accept = gnss::kBoth) : accept_(accept) {}
+
+    // Feeds bytes and invokes on_frame(const GnssFrame&) for every complete
+    // frame. Frames that lie entirely inside `data` are handed out in place;
+    // only a frame split across calls is copied.
+    template <typename F>
+    void feed(const uint8_t* data, size_t len, F&& on_frame);
+
+    void reset() { pending_.clear(); }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    bool is_start(uint8_t b) const {
+        return ((accept_ & gnss::kUbx) && b == gnss::kUbxSync1) || ((accept_ & gnss::kRtcm3) && b == gnss::kRtcmPreamble);
+    }
+    // Same contract as MavlinkFramer::wanted() and parse_one().
+    static size_t wanted(const uint8_t* p, size_t n);
+    size_t parse_one(const uint8_t* p, size_t n, GnssFrame* frame, bool* ok);
+
+    uint8_t accept_;
+    std::vector<uint8_t> pending_;
+    Stats stats_;
+};
+
+template <typename F>
+void GnssFramer::feed(const uint8_t* data, size_t len, F&& on_frame) {
+    GnssFrame frame{};
+    bool ok = false;
+    // Finish a frame split across calls, copying only the bytes it needs.
+    while (!pending_.empty()) {
+        size_t want = wanted(pending_.data(), pending_.size());
+        if (pending_.size() < want) {
+            if (len == 0) return;
+            size_t take = want - pending_.size() < len ? want - pending_.size() : len;
+            pending_.insert(pending_.end(), data, data + take);
+            data += take;
+            len -= take;
+            continue;
+        }
+        size_t consumed = parse_one(pending_.data(), pending_.size(), &frame, &ok);
+        if (ok) on_frame(frame);
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(consumed));
+    }
+    size_t off = 0;
+    while (off < len) {
+        size_t consumed = parse_one(data + off, len - off, &frame, &ok);
+        if (consumed == 0) break;
+        if (ok) on_frame(frame);
+        off += consumed;
+    }
+    if (off < len) pending_.assign(data + off, data + len);
+}
+
+}  // namespace fr
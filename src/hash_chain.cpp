@@ -0,0 +1,229 @@
+#include "hash_chain.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <sstream>
+
+#include "fs_util.hpp"
+#include "storage_layout.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr const char* kManifestHeader = "fr-manifest 1";
+constexpr const char* kSignatureTag = "signature ";
+constexpr size_t kHashReadBytes = 1u << 20;
+
+bool from_hex(const std::string& s, uint8_t* out, size_t n) {
+    if (s.size() != 2 * n) return false;
+    for (size_t i = 0; i < 2 * n; ++i) {
+        const char c = s[i];
+        int d;
+        if (c >= '0' && c <= '9')
+            d = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            d = c - 'a' + 10;
+        else
+            return false;
+        if (i % 2 == 0)
+            out[i / 2] = static_cast<uint8_t>(d << 4);
+        else
+            out[i / 2] |= static_cast<uint8_t>(d);
+    }
+    return true;
+}
+
+std::string key_id_hex(const MasterKey& key) {
+    Sha256Digest d{};
+    std::memcpy(d.data(), key.id.data(), key.id.size());
+    return to_hex(d).substr(0, 2 * key.id.size());
+}
+
+// The manifest is signed under its own key so that an encryption key and a
+// signing key can be the same file without one use weakening the other.
+Sha256Digest sign(const MasterKey& key, const std::string& body) {
+    static const char kLabel[] = "FRMANIFEST1";
+    const Sha256Digest k = hmac_sha256(key.bytes.data(), key.bytes.size(), kLabel, sizeof(kLabel) - 1);
+    return hmac_sha256(k.data(), k.size(), body.data(), body.size());
+}
+
+bool equal_ct(const Sha256Digest& a, const Sha256Digest& b) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+}  // namespace
+
+Sha256Digest chain_genesis(const std::string& flight_id) {
+    Sha256 h;
+    h.update("FRCHAIN1", 8);
+    h.update(flight_id.data(), flight_id.size());
+    return h.finish();
+}
+
+Sha256Digest chain_link(const Sha256Digest& prev, const Sha256Digest& segment_hash) {
+    uint8_t buf[64];
+    std::memcpy(buf, prev.data(), 32);
+    std::memcpy(buf + 32, segment_hash.data(), 32);
+    return Sha256::hash(buf, sizeof(buf));
+}
+
+bool hash_file(const std::string& path, Sha256Digest* out) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    std::string buf(kHashReadBytes, '\0');
+    Sha256 h;
+    for (;;) {
+        ssize_t n = ::read(fd, &buf[0], buf.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            const int e = errno;
+            ::close(fd);
+            errno = e;
+            return false;
+        }
+        if (n == 0) break;
+        h.update(buf.data(), static_cast<size_t>(n));
+    }
+    ::close(fd);
+    *out = h.finish();
+    return true;
+}
+
+bool write_manifest(const std::string& root, const std::string& flight_id,
+                    const std::vector<ManifestSegment>& segments, const MasterKey* key, const std::string& summary) {
+    std::string text = std::string(kManifestHeader) + "\nflight " + flight_id + "\n";
+    Sha256Digest head = chain_genesis(flight_id);
+    for (const auto& s : segments) {
+        text += "segment " + s.name + " " + std::to_string(s.bytes) + " " + std::to_string(s.t_first) + " " +
+                std::to_string(s.t_last) + " " + to_hex(s.hash) + " " + to_hex(s.link) + "\n";
+        head = s.link;
+    }
+    text += "head " + to_hex(head) + "\n";
+    text += summary;
+    if (key)
+        text += std::string(kSignatureTag) + "hmac-sha256 " + key_id_hex(*key) + " " + to_hex(sign(*key, text)) + "\n";
+    else
+        text += std::string(kSignatureTag) + "none\n";
+    return write_file_atomic(layout::manifest_path(root, flight_id), text.data(), text.size());
+}
+
+ChainReport verify_chain(const std::string& root, const std::string& flight_id, const MasterKey* key,
+                         TaskPool* pool) {
+    ChainReport r;
+    std::string text;
+    if (!read_file(layout::manifest_path(root, flight_id), &text)) return r;
+    r.manifest = true;
+
+    const size_t sig_at = text.rfind(std::string("\n") + kSignatureTag);
+    const std::string body = sig_at == std::string::npos ? text : text.substr(0, sig_at + 1);
+    std::istringstream lines(body);
+    std::string line;
+    if (!std::getline(lines, line) || line != kManifestHeader) {
+        r.errors.push_back("MANIFEST: unknown format");
+        return r;
+    }
+
+    std::vector<ManifestSegment> segs;
+    Sha256Digest head{};
+    bool have_head = false;
+    while (std::getline(lines, line)) {
+        std::istringstream in(line);
+        std::string tag, a, b;
+        in >> tag;
+        if (tag == "flight") {
+            in >> a;
+            if (a != flight_id) r.errors.push_back("MANIFEST: belongs to flight " + a);
+        } else if (tag == "segment") {
+            ManifestSegment s;
+            if (!(in >> s.name >> s.bytes >> s.t_first >> s.t_last >> a >> b) || !from_hex(a, s.hash.data(), 32) ||
+                !from_hex(b, s.link.data(), 32)) {
+                r.errors.push_back("MANIFEST: malformed line: " + line);
+                return r;
+            }
+            segs.push_back(std::move(s));
+        } else if (tag == "head") {
+            have_head = (in >> a) && from_hex(a, head.data(), 32);
+        } else if (tag == "quantiles" || tag == "stats" || tag == "session") {
+            // Summary statistics and sortie times: covered by the signature,
+            // not by the chain.
+        } else {
+            r.errors.push_back("MANIFEST: unexpected line: " + line);
+            return r;
+        }
+    }
+    r.listed = segs.size();
+
+    // Signature first: everything below only means something if the manifest
+    // itself is authentic.
+    std::string sig_line = sig_at == std::string::npos ? "" : text.substr(sig_at + 1);
+    while (!sig_line.empty() && sig_line.back() == '\n') sig_line.pop_back();
+    std::istringstream sig_in(sig_line);
+    std::string tag, scheme, id, mac;
+    sig_in >> tag >> scheme >> id >> mac;
+    if (scheme == "hmac-sha256") {
+        Sha256Digest want{};
+        if (!key) {
+            r.signature = ChainReport::Signature::Unchecked;
+        } else if (id != key_id_hex(*key)) {
+            r.signature = ChainReport::Signature::Invalid;
+            r.errors.push_back("MANIFEST: signed with a different key");
+        } else if (!from_hex(mac, want.data(), 32) || !equal_ct(want, sign(*key, body))) {
+            r.signature = ChainReport::Signature::Invalid;
+            r.errors.push_back("MANIFEST: bad signature");
+        } else {
+            r.signature = ChainReport::Signature::Valid;
+        }
+    } else if (scheme != "none") {
+        r.signature = ChainReport::Signature::Invalid;
+        r.errors.push_back("MANIFEST: missing or unknown signature");
+    } else if (key) {
+        // Stripping the signature must not be a way around it.
+        r.signature = ChainReport::Signature::Invalid;
+        r.errors.push_back("MANIFEST: not signed");
+    }
+
+    Sha256Digest prev = chain_genesis(flight_id);
+    for (const auto& s : segs) {
+        if (s.link != chain_link(prev, s.hash)) r.errors.push_back(s.name + ": chain link does not match");
+        prev = s.link;
+    }
+    if (!have_head || head != prev) r.errors.push_back("MANIFEST: head does not match the chain");
+
+    const std::string dir = layout::flight_dir(root, flight_id);
+    std::vector<Sha256Digest> got(segs.size());
+    std::vector<int> err(segs.size(), 0);
+    {
+        TaskGroup g(pool);
+        for (size_t i = 0; i < segs.size(); ++i)
+            g.run([&, i] {
+                if (!hash_file(dir + "/" + segs[i].name, &got[i])) err[i] = errno ? errno : EIO;
+            });
+    }
+    std::set<std::string> listed;
+    for (size_t i = 0; i < segs.size(); ++i) {
+        listed.insert(segs[i].name);
+        if (err[i] == ENOENT) {
+            r.missing++;
+        } else if (err[i]) {
+            r.errors.push_back(segs[i].name + ": " + std::strerror(err[i]));
+        } else if (got[i] != segs[i].hash) {
+            r.errors.push_back(segs[i].name + ": contents do not match the manifest");
+        } else {
+            r.verified++;
+        }
+    }
+    for (const auto& name : list_dir(dir))
+        if (layout::is_sealed_segment(name) && layout::segment_tier(name) == seg::Tier::Raw && !listed.count(name))
+            r.unlisted++;
+    return r;
+}
+
+}  // namespace fr
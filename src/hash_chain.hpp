@@ -0,0 +1,81 @@
+// Tamper-evident hash chain over a flight's raw segments.
+//
+// Each sealed segment's SHA-256 covers the whole file. The writer feeds its
+// output buffer to the hash as it goes to disk, so sealing only finishes the
+// last partial block. Segment hashes are chained per flight:
+//
+//   link_0 = SHA-256("FRCHAIN1" | flight id)
+//   link_n = SHA-256(link_n-1 | hash_n)
+//
+// so removing, reordering or editing any segment breaks every later link.
+// SealedSegment carries hash and link, the catalogue journals them, and after
+// every raw seal the recorder rewrites the flight's MANIFEST: one line per
+// segment plus the head link, signed with HMAC-SHA-256 under a key derived
+// from the --manifest-key master key. HMAC is symmetric, so whoever can check
+// a signature can also forge one: keep the verifying copy of the key with the
+// investigators, not on a ground station.
+//
+// Verification re-hashes segments in parallel on a TaskPool; the chain itself
+// is then checked in order, which costs one 64-byte hash per segment.
+// Segments reclaimed by retention show up as missing, not as a broken chain,
+// because the manifest still records their hashes.
+//
+// The final rewrite at the end of a recording also carries the flight's
+// per-channel summary statistics (summary_stats.hpp) and, for a sortie, its
+// arm/takeoff/landing/disarm times (session.hpp), under the same signature.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "segment_crypto.hpp"
+#include "sha256.hpp"
+#include "task_pool.hpp"
+
+namespace fr {
+
+Sha256Digest chain_genesis(const std::string& flight_id);
+Sha256Digest chain_link(const Sha256Digest& prev, const Sha256Digest& segment_hash);
+
+// SHA-256 of a whole file; false (errno set) if it cannot be read.
+bool hash_file(const std::string& path, Sha256Digest* out);
+
+struct ManifestSegment {
+    std::string name;
+    uint64_t bytes = 0;
+    int64_t t_first = 0;
+    int64_t t_last = 0;
+    Sha256Digest hash{};
+    Sha256Digest link{};
+};
+
+// Atomically replaces the flight's MANIFEST. `segments` must be the raw
+// segments in sequence order, starting at the first. `summary` is zero or
+// more complete "quantiles"/"stats" lines (FlightSummary::format) and at
+// most one "session" line (SessionTimes::format). Signs when `key` is set.
+bool write_manifest(const std::string& root, const std::string& flight_id,
+                    const std::vector<ManifestSegment>& segments, const MasterKey* key,
+                    const std::string& summary = {});
+
+struct ChainReport {
+    enum class Signature { None, Unchecked, Valid, Invalid };
+
+    bool manifest = false;  // false: no MANIFEST (flight predates it, or crashed before the first seal)
+    Signature signature = Signature::None;
+    size_t listed = 0;
+    size_t verified = 0;  // present and matching
+    size_t missing = 0;   // listed but gone (reclaimed)
+    size_t unlisted = 0;  // sealed after the last manifest write (crash)
+    std::vector<std::string> errors;
+
+    bool ok() const { return errors.empty() && signature != Signature::Invalid; }
+};
+
+// Checks a flight's MANIFEST: signature (when `key` is set), the chain of
+// links, and every listed segment still on disk against its hash.
+ChainReport verify_chain(const std::string& root, const std::string& flight_id, const MasterKey* key,
+                         TaskPool* pool);
+
+}  // namespace fr
@@ -0,0 +1,229 @@
+#include "health.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "clock.hpp"
+#include "log.hpp"
+#include "mavlink.hpp"
+#include "net_util.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+
+// MAVLink enum values used in HEARTBEAT and STATUSTEXT.
+constexpr uint8_t kMavTypeOnboardController = 18;
+constexpr uint8_t kMavAutopilotInvalid = 8;
+constexpr uint8_t kMavStateActive = 4;
+constexpr uint8_t kMavStateCritical = 5;
+constexpr uint8_t kSeverityCritical = 2;
+constexpr uint8_t kSeverityWarning = 4;
+constexpr uint8_t kSeverityInfo = 6;
+
+constexpr int64_t kDropHoldNs = 2000000000;
+
+void put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+// Connected datagram socket for $NOTIFY_SOCKET ("/path" or "@abstract").
+int open_notify_socket(const char* path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const size_t n = std::strlen(path);
+    if ((path[0] != '/' && path[0] != '@') || n >= sizeof(addr.sun_path)) return -1;
+    std::memcpy(addr.sun_path, path, n);
+    if (path[0] == '@') addr.sun_path[0] = '\0';
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + n)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}  // namespace
+
+HealthMonitor::HealthMonitor(HealthConfig cfg, Sampler sample) : cfg_(std::move(cfg)), sample_(std::move(sample)) {
+    if (cfg_.systemd) {
+        if (const char* path = std::getenv("NOTIFY_SOCKET")) {
+            notify_fd_ = open_notify_socket(path);
+            if (notify_fd_ < 0) FR_LOG_WARN("health: cannot use NOTIFY_SOCKET %s: %s", path, std::strerror(errno));
+        }
+        const char* usec = std::getenv("WATCHDOG_USEC");
+        const char* pid = std::getenv("WATCHDOG_PID");
+        if (notify_fd_ >= 0 && usec && (!pid || std::strtol(pid, nullptr, 10) == getpid())) {
+            const auto half = std::chrono::milliseconds(std::strtoull(usec, nullptr, 10) / 2000);
+            watchdog_ = half.count() > 0;
+            if (watchdog_ && cfg_.interval > half) {
+                FR_LOG_INFO("health: interval %lld ms -> %lld ms for WatchdogSec",
+                            static_cast<long long>(cfg_.interval.count()), static_cast<long long>(half.count()));
+                cfg_.interval = half;
+            }
+        }
+    }
+    if (!cfg_.udp_host.empty()) udp_fd_ = udp_connect(cfg_.udp_host, cfg_.udp_port);
+}
+
+HealthMonitor::~HealthMonitor() {
+    stop();
+    if (notify_fd_ >= 0) close(notify_fd_);
+    if (udp_fd_ >= 0) close(udp_fd_);
+}
+
+void HealthMonitor::start() {
+    if (thread_.joinable()) return;
+    stop_ = false;
+    t0_ns_ = monotonic_ns();
+    thread_ = std::thread([this] { run(); });
+    notify("READY=1");
+}
+
+void HealthMonitor::stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    notify("STOPPING=1\nSTATUS=stopping: closing segments");
+}
+
+void HealthMonitor::run() {
+    set_thread_name("fr-health");
+    set_high_priority();
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!stop_) {
+        lk.unlock();
+        tick(monotonic_ns());
+        lk.lock();
+        // Fixed cadence; after an overrun (suspend, debugger) restart from now
+        // rather than firing a burst of catch-up ticks.
+        next += cfg_.interval;
+        const auto now = std::chrono::steady_clock::now();
+        if (next < now) next = now;
+        cv_.wait_until(lk, next, [this] { return stop_; });
+    }
+}
+
+void HealthMonitor::tick(int64_t now_ns) {
+    const HealthSample s = sample_();
+    const int64_t idle_ns = s.oldest_tick_ns ? now_ns - s.oldest_tick_ns : 0;
+    uint32_t problems = 0;
+    if (idle_ns > std::chrono::duration_cast<std::chrono::nanoseconds>(cfg_.stall_after).count())
+        problems |= kHealthStalled;
+    // Drops come in bursts; hold the flag so the state does not flap per tick.
+    if (s.dropped + s.link_lost > last_dropped_) last_drop_ns_ = now_ns;
+    if (last_drop_ns_ && now_ns - last_drop_ns_ < kDropHoldNs) problems |= kHealthDropping;
+    if (!s.headroom_ok) problems |= kHealthLowDisk;
+    if (s.sources && !s.sources_open) problems |= kHealthNoSource;
+    last_dropped_ = s.dropped + s.link_lost;
+    const HealthState state = (problems & kHealthStalled) ? HealthState::Stalled
+                              : problems                 ? HealthState::Degraded
+                                                         : HealthState::Ok;
+    state_.store(state, std::memory_order_relaxed);
+
+    static const char* const kStateName[] = {"ok", "degraded", "STALLED"};
+    char write_age[32];
+    if (s.last_write_ns)
+        std::snprintf(write_age, sizeof(write_age), "%.1f s ago", (now_ns - s.last_write_ns) / 1e9);
+    else
+        std::snprintf(write_age, sizeof(write_age), "none yet");
+    char summary[192];
+    std::snprintf(summary, sizeof(summary),
+                  "%s: queue %llu/%llu, %llu+%llu dropped, last write %s, %llu MB free, %u/%u sources open%s",
+                  kStateName[static_cast<int>(state)], static_cast<unsigned long long>(s.queue_depth),
+                  static_cast<unsigned long long>(s.queue_capacity), static_cast<unsigned long long>(s.dropped),
+                  static_cast<unsigned long long>(s.link_lost), write_age,
+                  static_cast<unsigned long long>(s.free_bytes >> 20), s.sources_open, s.sources,
+                  s.hot ? ", thermal hot mode" : "");
+
+    // Not feeding the watchdog is the point: systemd restarts a stalled recorder.
+    notify(std::string(watchdog_ && state != HealthState::Stalled ? "WATCHDOG=1\n" : "") + "STATUS=" + summary);
+
+    if (udp_fd_ >= 0) {
+        uint8_t hb[9];
+        put_u32(hb, problems | (s.hot ? uint32_t{kHealthHotMode} : 0u));
+        hb[4] = kMavTypeOnboardController;
+        hb[5] = kMavAutopilotInvalid;
+        hb[6] = 0;
+        hb[7] = state == HealthState::Stalled ? kMavStateCritical : kMavStateActive;
+        hb[8] = 3;
+        send_mavlink(mavlink::kMsgHeartbeat, hb, sizeof(hb));
+
+        const uint32_t boot_ms = static_cast<uint32_t>((now_ns - t0_ns_) / 1000000);
+        auto named = [&](const char* name, float value) {
+            uint8_t p[18] = {};
+            put_u32(p, boot_ms);
+            std::memcpy(p + 4, &value, sizeof(value));
+            std::memcpy(p + 8, name, std::min<size_t>(std::strlen(name), 10));  // not NUL-terminated at 10
+            send_mavlink(mavlink::kMsgNamedValueFloat, p, sizeof(p));
+        };
+        named("fr_queue", static_cast<float>(s.queue_depth));
+        named("fr_drops", static_cast<float>(s.dropped));
+        named("fr_lnklost", static_cast<float>(s.link_lost));
+        named("fr_wr_age", s.last_write_ns ? static_cast<float>((now_ns - s.last_write_ns) / 1e9) : -1.0f);
+        named("fr_idle", static_cast<float>(idle_ns / 1e9));
+        named("fr_free_mb", static_cast<float>(s.free_bytes >> 20));
+    }
+
+    if (problems != last_problems_) {
+        std::string text = "fr: ";
+        uint8_t severity = kSeverityInfo;
+        if (problems & kHealthStalled) {
+            char buf[48];
+            std::snprintf(buf, sizeof(buf), "writer stalled %.1f s", idle_ns / 1e9);
+            text += buf;
+            severity = kSeverityCritical;
+        } else if (problems) {
+            text += "degraded:";
+            if (problems & kHealthDropping) text += " dropping";
+            if (problems & kHealthLowDisk) text += " low-disk";
+            if (problems & kHealthNoSource) text += " no-source";
+            severity = kSeverityWarning;
+        } else {
+            text += "recording ok";
+        }
+        if (severity == kSeverityInfo)
+            FR_LOG_INFO("health: %s", text.c_str() + 4);
+        else
+            FR_LOG_WARN("health: %s", text.c_str() + 4);
+        send_statustext(severity, text);
+        last_problems_ = problems;
+    }
+}
+
+void HealthMonitor::notify(const std::string& msg) {
+    if (notify_fd_ >= 0) send(notify_fd_, msg.data(), msg.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+void HealthMonitor::send_mavlink(uint32_t msgid, const void* payload, size_t len) {
+    uint8_t frame[mavlink::kMaxFrameV2];
+    const size_t n = mavlink::encode_v2(frame, mav_seq_++, cfg_.sysid, cfg_.compid, msgid, payload, len);
+    // A full or refused link must not slow the next tick; the data is periodic.
+    if (n) send(udp_fd_, frame, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+void HealthMonitor::send_statustext(uint8_t severity, const std::string& text) {
+    if (udp_fd_ < 0) return;
+    uint8_t p[54] = {};  // severity, text[50], id, chunk_seq
+    p[0] = severity;
+    std::memcpy(p + 1, text.data(), std::min<size_t>(text.size(), 50));
+    send_mavlink(mavlink::kMsgStatustext, p, sizeof(p));
+}
+
+}  // namespace fr
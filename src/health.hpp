@@ -0,0 +1,116 @@
+// Recorder health reporting, on its own thread and independent of bulk I/O.
+//
+// At a fixed cadence the monitor samples pipeline counters and reports them:
+//
+//   systemd   sd_notify datagrams on $NOTIFY_SOCKET: READY=1 at start,
+//             WATCHDOG=1 every tick while healthy, STATUS=<summary>, and
+//             STOPPING=1 at stop. The cadence is clamped to half of
+//             $WATCHDOG_USEC so WatchdogSec= can never expire on a live one.
+//   MAVLink   optional UDP link to the flight controller or GCS: HEARTBEAT
+//             (onboard controller, system_status CRITICAL while stalled,
+//             problem flags in custom_mode), NAMED_VALUE_FLOAT counters, and a
+//             STATUSTEXT whenever the state changes.
+//
+// The sampler must only read atomics or locks that are never held across
+// I/O; the monitor itself never touches the filesystem and sends with
+// MSG_DONTWAIT. A writer stuck in write() or fsync() stops publishing
+// progress, so after `stall_after` the state turns Stalled and the watchdog
+// is no longer fed: systemd restarts the recorder, and the flight controller
+// sees the stall within about a second.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fr {
+
+struct HealthConfig {
+    std::chrono::milliseconds interval{200};
+    // A writer that has not looped for this long is stalled. Writers loop at
+    // least every 100 ms while idle.
+    std::chrono::milliseconds stall_after{800};
+    std::string udp_host;  // MAVLink status target; empty: off
+    uint16_t udp_port = 14550;
+    uint8_t sysid = 1;
+    uint8_t compid = 191;  // MAV_COMP_ID_ONBOARD_COMPUTER
+    bool systemd = true;   // when $NOTIFY_SOCKET is set
+};
+
+struct HealthSample {
+    uint64_t queue_depth = 0;  // records waiting, all shards
+    uint64_t queue_capacity = 0;
+    uint64_t records = 0;
+    uint64_t dropped = 0;
+    uint64_t link_lost = 0;  // before ingest: kernel buffers, UART overruns (SourceCounters::lost)
+    int64_t last_write_ns = 0;  // CLOCK_MONOTONIC of the last batch written; 0: none yet
+    int64_t oldest_tick_ns = 0;  // least recent writer loop iteration over all shards
+    uint64_t free_bytes = 0;     // as last measured by retention
+    bool headroom_ok = true;
+    uint32_t sources = 0;
+    uint32_t sources_open = 0;
+    bool hot = false;  // thermal hot mode (thermal.hpp); not a fault
+};
+
+enum class HealthState : uint8_t { Ok, Degraded, Stalled };
+
+// Bits of the HEARTBEAT custom_mode.
+enum HealthProblem : uint32_t {
+    kHealthStalled = 1u << 0,
+    kHealthDropping = 1u << 1,  // queue or link losses within the last two seconds
+    kHealthLowDisk = 1u << 2,
+    kHealthNoSource = 1u << 3,
+    kHealthHotMode = 1u << 4,  // informational: does not change the state
+};
+
+class HealthMonitor {
+public:
+    using Sampler = std::function<HealthSample()>;
+
+    // Opens the UDP link if configured. Throws std::system_error.
+    HealthMonitor(HealthConfig cfg, Sampler sample);
+    ~HealthMonitor();
+
+    HealthMonitor(const HealthMonitor&) = delete;
+    HealthMonitor& operator=(const HealthMonitor&) = delete;
+
+    void start();
+    void stop();
+
+    HealthState state() const { return state_.load(std::memory_order_relaxed); }
+
+    // One round at `now_ns` (CLOCK_MONOTONIC): sample, update the state,
+    // report. The thread calls it every interval; not to be called while
+    // the thread runs.
+    void tick(int64_t now_ns);
+
+private:
+    void run();
+    void notify(const std::string& msg);
+    void send_mavlink(uint32_t msgid, const void* payload, size_t len);
+    void send_statustext(uint8_t severity, const std::string& text);
+
+    HealthConfig cfg_;
+    Sampler sample_;
+    int notify_fd_ = -1;
+    bool watchdog_ = false;  // $WATCHDOG_USEC applies to this process
+    int udp_fd_ = -1;
+    uint8_t mav_seq_ = 0;
+    int64_t t0_ns_ = 0;
+    uint64_t last_dropped_ = 0;
+    int64_t last_drop_ns_ = 0;
+    uint32_t last_problems_ = 0;
+    std::atomic<HealthState> state_{HealthState::Ok};
+
+    std::thread thread_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+}  // namespace fr
@@ -0,0 +1,249 @@
+#include "lazy_decode.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "channels.hpp"
+#include "decoder.hpp"
+#include "gnss.hpp"
+#include "log.hpp"
+#include "mavlink.hpp"
+#include "raw_coverage.hpp"
+#include "record.hpp"
+#include "segment_reader.hpp"
+#include "segment_writer.hpp"
+#include "source.hpp"
+#include "storage_layout.hpp"
+
+namespace fr {
+
+namespace {
+
+// Decoding state of one source index, carried from segment to segment.
+struct Stream {
+    MavlinkFramer framer;
+    std::unique_ptr<GnssFramer> gnss;  // instead of framer on GNSS sources
+    std::unique_ptr<Decoder> decoder;
+    bool datagram = false;  // each raw record is a whole datagram
+    std::vector<const ChunkData*> chunks;  // this segment's raw chunks, in order
+    std::vector<Record> out;
+    uint64_t raw_bytes = 0;
+};
+
+void decode_stream(Stream& s, uint16_t source, bool last) {
+    for (const ChunkData* c : s.chunks) {
+        size_t off = 0;
+        for (size_t i = 0; i < c->t.size(); ++i) {
+            const int64_t t = c->t[i];
+            const auto* data = reinterpret_cast<const uint8_t*>(c->blob_bytes.data() + off);
+            off += c->blob_len[i];
+            s.raw_bytes += c->blob_len[i];
+            if (s.gnss) {
+                s.gnss->feed(data, c->blob_len[i], [&](const GnssFrame& f) {
+                    Record r;
+                    r.t_ns = t;
+                    r.channel = channel::make(f.rtcm ? channel::kRtcm3 : channel::kUbx, f.msg_id);
+                    r.source = source;
+                    r.blob = true;
+                    r.bytes.assign(reinterpret_cast<const char*>(f.data), f.len);
+                    s.out.push_back(std::move(r));
+                });
+                if (s.datagram) s.gnss->reset();
+                continue;
+            }
+            s.framer.feed(data, c->blob_len[i], [&](const MavFrame& f) {
+                if (s.decoder) {
+                    s.decoder->decode(f, t, source, [&s](Record&& r) { s.out.push_back(std::move(r)); });
+                    return;
+                }
+                Record r;
+                r.t_ns = t;
+                r.channel = channel::make(channel::kMavlink, f.msgid);
+                r.source = source;
+                r.vehicle = f.sysid;
+                r.blob = true;
+                r.bytes.assign(reinterpret_cast<const char*>(f.data), f.len);
+                s.out.push_back(std::move(r));
+            });
+            if (s.datagram) s.framer.reset();
+        }
+    }
+    // Decimated samples still held back go into the final segment.
+    if (last && s.decoder) s.decoder->flush(source, [&s](Record&& r) { s.out.push_back(std::move(r)); });
+}
+
+// Channels never copied: the raw bytes themselves, and what the output
+// writer re-creates as preamble.
+bool consumed(uint32_t ch) {
+    switch (channel::family(ch)) {
+        case channel::kRawStream: return true;
+        // Session events come from the live recorder; carry them over.
+        case channel::kMeta: return channel::local(ch) != channel::kMetaSession;
+        default: return false;
+    }
+}
+
+// True if the decode produces this record again from raw bytes: frames when
+// it runs without a config, decoded fields when it runs with one.
+bool regenerated(const RawCoverage& raw, bool decoding, uint32_t ch, int64_t t) {
+    switch (channel::family(ch)) {
+        case channel::kMavlink: return !decoding && raw.covers(ch, t);
+        case channel::kDecoded: return decoding && raw.covers(ch, t);
+        default: return raw.covers(ch, t);
+    }
+}
+
+void append_chunk(const ChunkData& c, const RawCoverage& raw, bool decoding, std::vector<Record>* out) {
+    size_t off = 0;
+    for (size_t i = 0; i < c.t.size(); ++i) {
+        const size_t at = off;
+        if (c.v.empty()) off += c.blob_len[i];
+        if (regenerated(raw, decoding, c.hdr.channel, c.t[i])) continue;
+        Record r;
+        r.t_ns = c.t[i];
+        r.channel = c.hdr.channel;
+        if (!c.v.empty()) {
+            r.value = c.v[i];
+        } else {
+            r.blob = true;
+            r.bytes.assign(c.blob_bytes, at, c.blob_len[i]);
+        }
+        out->push_back(std::move(r));
+    }
+}
+
+}  // namespace
+
+bool LazyDecoder::run() {
+    if (cfg_.flight_id.empty()) cfg_.flight_id = layout::latest_flight(cfg_.root);
+    if (cfg_.out_root.empty()) cfg_.out_root = cfg_.root;
+    if (cfg_.out_flight_id.empty()) cfg_.out_flight_id = cfg_.flight_id + "-decoded";
+    const std::vector<std::string> segments = layout::raw_segment_paths(cfg_.root, cfg_.flight_id);
+    if (cfg_.flight_id.empty() || segments.empty()) {
+        error_ = "no raw segments for flight '" + cfg_.flight_id + "'";
+        return false;
+    }
+    // Indexes only: cheap, and an output flight of copies would look like a
+    // successful decode.
+    bool have_raw = false;
+    for (size_t i = 0; i < segments.size() && !have_raw; ++i) {
+        SegmentReader reader;
+        reader.set_key(cfg_.key);
+        if (!reader.open(segments[i])) {
+            error_ = reader.error();
+            return false;
+        }
+        for (const seg::IndexEntry& e : reader.index())
+            if (channel::family(e.channel) == channel::kRawStream) have_raw = true;
+    }
+    if (!have_raw) {
+        error_ = "flight '" + cfg_.flight_id + "' has no raw stream to decode (recorded with --raw off)";
+        return false;
+    }
+
+    SegmentWriterConfig wc;
+    wc.root = cfg_.out_root;
+    wc.flight_id = cfg_.out_flight_id;
+    wc.pool = cfg_.pool;
+    wc.key = cfg_.key;
+    std::unique_ptr<SegmentWriter> writer;
+    std::map<uint32_t, Stream> streams;  // by source index
+    std::vector<SourceSpec> sources;
+    RawCoverage coverage(&sources);
+
+    for (size_t seg_index = 0; seg_index < segments.size(); ++seg_index) {
+        const std::string& path = segments[seg_index];
+        const bool last = seg_index + 1 == segments.size();
+        SegmentReader reader;
+        reader.set_key(cfg_.key);
+        if (!reader.open(path)) {
+            error_ = reader.error();
+            return false;
+        }
+        // Decoded column data for the whole segment; streams point into it.
+        std::vector<ChunkData> chunks(reader.index().size());
+        std::vector<const ChunkData*> recorded;
+        std::vector<Record> merged;
+        std::string config_blob;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const seg::IndexEntry& e = reader.index()[i];
+            if (e.kind == static_cast<uint8_t>(seg::ChunkKind::Rollup)) continue;
+            if (!reader.read_chunk(e, &chunks[i])) {
+                FR_LOG_WARN("decode: %s", reader.error().c_str());
+                continue;
+            }
+            const ChunkData& c = chunks[i];
+            if (e.channel == channel::make(channel::kMeta, channel::kMetaSources) && !c.blob_len.empty()) {
+                sources = parse_source_table(c.blob_bytes.substr(0, c.blob_len[0]));
+            } else if (e.channel == channel::make(channel::kMeta, channel::kMetaConfig) && !c.blob_len.empty()) {
+                config_blob = c.blob_bytes.substr(0, c.blob_len[0]);
+            } else if (channel::family(e.channel) == channel::kRawStream) {
+                streams[channel::local(e.channel)].chunks.push_back(&c);
+            } else if (!consumed(e.channel)) {
+                recorded.push_back(&c);
+            }
+        }
+        // After the whole index: the source table may come late.
+        coverage.clear();
+        for (const auto& kv : streams)
+            for (const ChunkData* c : kv.second.chunks) coverage.add(*c);
+        for (const ChunkData* c : recorded) append_chunk(*c, coverage, cfg_.config != nullptr, &merged);
+
+        if (!writer) {
+            writer = std::make_unique<SegmentWriter>(wc);
+            if (cfg_.config)
+                config_blob.assign(reinterpret_cast<const char*>(cfg_.config->data()), cfg_.config->size());
+            if (!config_blob.empty())
+                writer->add_segment_preamble(channel::make(channel::kMeta, channel::kMetaConfig), config_blob);
+            if (!sources.empty())
+                writer->add_segment_preamble(channel::make(channel::kMeta, channel::kMetaSources), format_source_table(sources));
+        }
+
+        {
+            TaskGroup group(cfg_.pool);
+            for (auto& kv : streams) {
+                Stream& s = kv.second;
+                if (s.chunks.empty() && !(last && s.decoder)) continue;
+                const uint32_t index = kv.first;
+                if (index < sources.size()) {
+                    s.datagram = sources[index].kind == SourceKind::Udp;
+                    if (!s.gnss && gnss::accept_for(sources[index].protocol))
+                        s.gnss = std::make_unique<GnssFramer>(gnss::accept_for(sources[index].protocol));
+                }
+                if (cfg_.config && !s.decoder) s.decoder = std::make_unique<Decoder>(cfg_.config);
+                group.run([&s, index, last] { decode_stream(s, static_cast<uint16_t>(index), last); });
+            }
+        }
+
+        for (auto& kv : streams) {
+            Stream& s = kv.second;
+            merged.insert(merged.end(), std::make_move_iterator(s.out.begin()), std::make_move_iterator(s.out.end()));
+            s.out.clear();
+            s.chunks.clear();
+        }
+        std::stable_sort(merged.begin(), merged.end(), [](const Record& a, const Record& b) { return a.t_ns < b.t_ns; });
+        for (const Record& r : merged) {
+            if (r.blob)
+                writer->append_blob(r.channel, r.t_ns, r.bytes.data(), static_cast<uint32_t>(r.bytes.size()));
+            else
+                writer->append(r.channel, r.t_ns, r.value);
+        }
+        stats_.records_out += merged.size();
+        stats_.segments++;
+    }
+    writer->close();
+
+    for (const auto& kv : streams) {
+        stats_.raw_bytes += kv.second.raw_bytes;
+        stats_.frames += kv.second.framer.stats().frames;
+        stats_.crc_errors += kv.second.framer.stats().crc_errors;
+        if (kv.second.gnss) {
+            stats_.frames += kv.second.gnss->stats().frames;
+            stats_.crc_errors += kv.second.gnss->stats().crc_errors;
+        }
+    }
+    return true;
+}
+
+}  // namespace fr
@@ -0,0 +1,64 @@
+// Offline decoding of raw-stream captures (RawCapture::Also/Only).
+//
+// Reads a flight segment by segment, reassembles each source's byte stream
+// (channel::kRawStream), frames MAVLink (or UBX/RTCM3 on GNSS sources) and
+// optionally applies a compiled config, and writes the result as a new flight
+// next to the original. Every source is an independent task on the pool, so
+// a ground workstation decodes many links at once; framer state carries
+// across segments, so frames split by a rotation are not lost.
+//
+// Recorded frames and decoded fields are dropped only where the decode
+// regenerates them from raw bytes (see raw_coverage.hpp); those of sources or
+// spans without raw capture, and all other channels, are copied through.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "config.hpp"
+#include "segment_crypto.hpp"
+#include "task_pool.hpp"
+
+namespace fr {
+
+struct LazyDecodeConfig {
+    std::string root;
+    std::string flight_id;      // empty: the most recent flight
+    std::string out_root;       // empty: same as root
+    std::string out_flight_id;  // empty: <flight_id>-decoded
+    std::shared_ptr<const CompiledConfig> config;  // optional field extraction
+    std::shared_ptr<const MasterKey> key;          // reads and writes encrypted flights
+    TaskPool* pool = nullptr;
+};
+
+class LazyDecoder {
+public:
+    struct Stats {
+        uint64_t segments = 0;
+        uint64_t raw_bytes = 0;
+        uint64_t frames = 0;
+        uint64_t crc_errors = 0;
+        uint64_t records_out = 0;
+    };
+
+    explicit LazyDecoder(LazyDecodeConfig cfg) : cfg_(std::move(cfg)) {}
+
+    // False with error() if the flight cannot be read or holds no raw stream
+    // (recorded with --raw off: there is nothing to decode). Throws
+    // std::system_error if the output flight directory cannot be created.
+    bool run();
+
+    const std::string& flight_id() const { return cfg_.flight_id; }
+    const std::string& out_flight_id() const { return cfg_.out_flight_id; }
+    const std::string& error() const { return error_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    LazyDecodeConfig cfg_;
+    std::string error_;
+    Stats stats_;
+};
+
+}  // namespace fr
@@ -0,0 +1,33 @@
+#include "log.hpp"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+
+namespace fr {
+
+namespace {
+std::atomic<int> g_level{static_cast<int>(LogLevel::Info)};
+const char* const kTags[] = {"D", "I", "W", "E"};
+}  // namespace
+
+void set_log_level(LogLevel level) { g_level.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+void logf(LogLevel level, const char* fmt, ...) {
+    if (static_cast<int>(level) < g_level.load(std::memory_order_relaxed)) return;
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    char line[1024];
+    int n = std::snprintf(line, sizeof(line), "[%5ld.%03ld %s] ", static_cast<long>(ts.tv_sec),
+                          ts.tv_nsec / 1000000, kTags[static_cast<int>(level)]);
+    va_list ap;
+    va_start(ap, fmt);
+    std::vsnprintf(line + n, sizeof(line) - static_cast<size_t>(n), fmt, ap);
+    va_end(ap);
+    // One fputs per line keeps concurrent threads from interleaving mid-line.
+    std::fputs(line, stderr);
+    std::fputc('\n', stderr);
+}
+
+}  // namespace fr
@@ -0,0 +1,17 @@
+// Minimal leveled logging to stderr. Cheap enough for control paths; never
+// call from per-record code.
+#pragma once
+
+namespace fr {
+
+enum class LogLevel { Debug = 0, Info = 1, Warn = 2, Error = 3 };
+
+void set_log_level(LogLevel level);
+void logf(LogLevel level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+}  // namespace fr
+
+#define FR_LOG_DEBUG(...) ::fr::logf(::fr::LogLevel::Debug, __VA_ARGS__)
+#define FR_LOG_INFO(...) ::fr::logf(::fr::LogLevel::Info, __VA_ARGS__)
+#define FR_LOG_WARN(...) ::fr::logf(::fr::LogLevel::Warn, __VA_ARGS__)
+#define FR_LOG_ERROR(...) ::fr::logf(::fr::LogLevel::Error, __VA_ARGS__)
@@ -0,0 +1,142 @@
+#include "mavlink.hpp"
+
+#include <cstring>
+
+namespace fr {
+namespace mavlink {
+
+namespace {
+
+struct Extra {
+    uint32_t msgid;
+    uint8_t crc_extra;
+};
+
+// Messages we rely on for session logic and the bulk of autopilot traffic.
+constexpr Extra kExtras[] = {
+    {0, 50},     // HEARTBEAT
+    {1, 124},    // SYS_STATUS
+    {2, 137},    // SYSTEM_TIME
+    {22, 220},   // PARAM_VALUE
+    {24, 24},    // GPS_RAW_INT
+    {27, 144},   // RAW_IMU
+    {30, 39},    // ATTITUDE
+    {33, 104},   // GLOBAL_POSITION_INT
+    {36, 222},   // SERVO_OUTPUT_RAW
+    {65, 118},   // RC_CHANNELS
+    {74, 20},    // VFR_HUD
+    {76, 152},   // COMMAND_LONG
+    {105, 93},   // HIGHRES_IMU
+    {111, 34},   // TIMESYNC
+    {147, 154},  // BATTERY_STATUS
+    {245, 130},  // EXTENDED_SYS_STATE
+    {251, 170},  // NAMED_VALUE_FLOAT
+    {253, 83},   // STATUSTEXT
+};
+
+}  // namespace
+
+int crc_extra(uint32_t msgid) {
+    for (const auto& e : kExtras)
+        if (e.msgid == msgid) return e.crc_extra;
+    return -1;
+}
+
+uint16_t crc_x25(const uint8_t* p, size_t n, uint16_t crc) {
+    while (n--) {
+        uint8_t tmp = static_cast<uint8_t>(*p++ ^ (crc & 0xff));
+        tmp ^= static_cast<uint8_t>(tmp << 4);
+        crc = static_cast<uint16_t>((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4));
+    }
+    return crc;
+}
+
+size_t encode_v2(uint8_t* out, uint8_t seq, uint8_t sysid, uint8_t compid, uint32_t msgid, const void* payload,
+                 size_t len) {
+    const int extra = crc_extra(msgid);
+    if (extra < 0 || len > 255) return 0;
+    const auto* p = static_cast<const uint8_t*>(payload);
+    while (len > 1 && p[len - 1] == 0) --len;
+    out[0] = kStxV2;
+    out[1] = static_cast<uint8_t>(len);
+    out[2] = 0;  // incompat flags: unsigned
+    out[3] = 0;
+    out[4] = seq;
+    out[5] = sysid;
+    out[6] = compid;
+    out[7] = static_cast<uint8_t>(msgid);
+    out[8] = static_cast<uint8_t>(msgid >> 8);
+    out[9] = static_cast<uint8_t>(msgid >> 16);
+    std::memcpy(out + 10, p, len);
+    uint16_t crc = crc_x25(out + 1, 9 + len);
+    const uint8_t e = static_cast<uint8_t>(extra);
+    crc = crc_x25(&e, 1, crc);
+    out[10 + len] = static_cast<uint8_t>(crc);
+    out[11 + len] = static_cast<uint8_t>(crc >> 8);
+    return 12 + len;
+}
+
+}  // namespace mavlink
+
+size_t MavlinkFramer::wanted(const uint8_t* p, size_t n) {
+    if (p[0] == mavlink::kStxV1) return n < 2 ? 2 : static_cast<size_t>(p[1]) + 8;
+    if (p[0] == mavlink::kStxV2) return n < 3 ? 3 : static_cast<size_t>(p[1]) + 12 + ((p[2] & 0x01) ? 13 : 0);
+    return 1;
+}
+
+size_t MavlinkFramer::parse_one(const uint8_t* p, size_t n, MavFrame* frame, bool* ok) {
+    *ok = false;
+    if (p[0] != mavlink::kStxV1 && p[0] != mavlink::kStxV2) {
+        size_t skip = 1;
+        while (skip < n && p[skip] != mavlink::kStxV1 && p[skip] != mavlink::kStxV2) skip++;
+        stats_.skipped_bytes += skip;
+        return skip;
+    }
+    size_t need = wanted(p, n);
+    if (n < need) return 0;
+
+    MavFrame f{};
+    f.data = p;
+    f.len = need;
+    f.payload_len = p[1];
+    size_t crc_at;
+    if (p[0] == mavlink::kStxV1) {
+        f.version = 1;
+        f.seq = p[2];
+        f.sysid = p[3];
+        f.compid = p[4];
+        f.msgid = p[5];
+        f.payload = p + 6;
+        crc_at = 6 + f.payload_len;
+    } else {
+        if (p[2] & ~0x01) {  // unknown incompat flags: cannot be parsed safely
+            stats_.crc_errors++;
+            return 1;
+        }
+        f.version = 2;
+        f.seq = p[4];
+        f.sysid = p[5];
+        f.compid = p[6];
+        f.msgid = static_cast<uint32_t>(p[7]) | static_cast<uint32_t>(p[8]) << 8 | static_cast<uint32_t>(p[9]) << 16;
+        f.payload = p + 10;
+        crc_at = 10 + f.payload_len;
+    }
+
+    int extra = mavlink::crc_extra(f.msgid);
+    if (extra >= 0) {
+        uint16_t crc = mavlink::crc_x25(p + 1, crc_at - 1);
+        uint8_t e = static_cast<uint8_t>(extra);
+        crc = mavlink::crc_x25(&e, 1, crc);
+        uint16_t got = static_cast<uint16_t>(p[crc_at] | p[crc_at + 1] << 8);
+        if (crc != got) {
+            stats_.crc_errors++;
+            return 1;
+        }
+    }
+    stats_.frames++;
+    *frame = f;
+    *ok = true;
+    return need;
+}
+
+}  // namespace fr
@@ -0,0 +1,110 @@
+// Streaming MAVLink v1/v2 frame extraction. The framer only finds frame
+// boundaries and validates checksums; field decoding happens downstream. A
+// minimal v2 encoder serves the recorder's own status messages.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fr {
+
+struct MavFrame {
+    const uint8_t* data;  // whole frame, STX through checksum/signature
+    size_t len;
+    const uint8_t* payload;
+    uint8_t payload_len;
+    uint8_t version;  // 1 or 2
+    uint8_t seq;
+    uint8_t sysid;
+    uint8_t compid;
+    uint32_t msgid;
+};
+
+namespace mavlink {
+
+constexpr uint8_t kStxV1 = 0xfe;
+constexpr uint8_t kStxV2 = 0xfd;
+constexpr uint32_t kMsgHeartbeat = 0;
+constexpr uint32_t kMsgExtendedSysState = 245;
+constexpr uint32_t kMsgNamedValueFloat = 251;
+constexpr uint32_t kMsgStatustext = 253;
+constexpr size_t kMaxFrameV2 = 280;  // unsigned
+
+// CRC_EXTRA seed for `msgid`, or -1 when the message is not in the built-in
+// table (its checksum then cannot be verified and the frame is accepted on
+// structure alone).
+int crc_extra(uint32_t msgid);
+
+uint16_t crc_x25(const uint8_t* p, size_t n, uint16_t crc = 0xffff);
+
+// Writes an unsigned v2 frame into `out` (kMaxFrameV2 bytes) and returns its
+// length, or 0 if `msgid` has no CRC_EXTRA in the table or `len` > 255.
+// Trailing zero bytes of the payload are truncated as v2 requires.
+size_t encode_v2(uint8_t* out, uint8_t seq, uint8_t sysid, uint8_t compid, uint32_t msgid, const void* payload,
+                 size_t len);
+
+}  // namespace mavlink
+
+class MavlinkFramer {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t crc_errors = 0;
+        uint64_t skipped_bytes = 0;
+    };
+
+    // Feeds bytes and invokes on_frame(const MavFrame&) for every complete
+    // frame. Frames that lie entirely inside `data` are handed out in place;
+    // only a frame split across calls is copied.
+    template <typename F>
+    void feed(const uint8_t* data, size_t len, F&& on_frame);
+
+    // Drops any partial frame (e.g. at a datagram boundary or after reopen).
+    void reset() { pending_.clear(); }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // Bytes needed before parse_one() can decide on the frame starting at p:
+    // the full frame length once the header is visible, else the header size.
+    static size_t wanted(const uint8_t* p, size_t n);
+    // Returns bytes consumed from p (a whole frame, or junk up to the next
+    // start marker, or 1 after a bad checksum); 0 when more data is needed.
+    // *ok is set when a valid frame was consumed into *frame.
+    size_t parse_one(const uint8_t* p, size_t n, MavFrame* frame, bool* ok);
+
+    std::vector<uint8_t> pending_;
+    Stats stats_;
+};
+
+template <typename F>
+void MavlinkFramer::feed(const uint8_t* data, size_t len, F&& on_frame) {
+    MavFrame frame{};
+    bool ok = false;
+    // Finish a frame split across calls, copying only the bytes it needs.
+    while (!pending_.empty()) {
+        size_t want = wanted(pending_.data(), pending_.size());
+        if (pending_.size() < want) {
+            if (len == 0) return;
+            size_t take = want - pending_.size() < len ? want - pending_.size() : len;
+            pending_.insert(pending_.end(), data, data + take);
+            data += take;
+            len -= take;
+            continue;
+        }
+        size_t consumed = parse_one(pending_.data(), pending_.size(), &frame, &ok);
+        if (ok) on_frame(frame);
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(consumed));
+    }
+    size_t off = 0;
+    while (off < len) {
+        size_t consumed = parse_one(data + off, len - off, &frame, &ok);
+        if (consumed == 0) break;
+        if (ok) on_frame(frame);
+        off += consumed;
+    }
+    if (off < len) pending_.assign(data + off, data + len);
+}
+
+}  // namespace fr
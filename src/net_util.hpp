@@ -0,0 +1,24 @@
+// Socket setup helpers. Setup failures throw std::system_error; the send/recv
+// loops return false with errno set so callers can treat a dropped link as a
+// normal, retryable event.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace fr {
+
+// Listening TCP socket on addr:port ("0.0.0.0" for any).
+int tcp_listen(const std::string& addr, uint16_t port, int backlog = 8);
+// Connected TCP socket; `timeout_ms` bounds connect and every later recv/send.
+int tcp_connect(const std::string& host, uint16_t port, int timeout_ms);
+// UDP socket connect()ed to host:port, so send() needs no address.
+int udp_connect(const std::string& host, uint16_t port);
+// Applies SO_RCVTIMEO/SO_SNDTIMEO and TCP keepalive so dead peers are noticed.
+void set_socket_timeouts(int fd, int timeout_ms);
+
+bool send_all(int fd, const void* data, size_t len, int flags = 0);
+bool recv_all(int fd, void* data, size_t len);
+
+}  // namespace fr
@@ -0,0 +1,617 @@
+#include "offload.hpp"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+
+#include "catalog.hpp"
+#include "fs_util.hpp"
+#include "log.hpp"
+#include "net_util.hpp"
+#include "storage_layout.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x464f5246;  // "FROF"
+constexpr uint32_t kMaxRequestPayload = 64u << 10;
+// Receiver-side sidecar holding a completed file's manifest payload.
+constexpr const char* kChunksSuffix = ".chunks";
+
+enum MsgType : uint16_t {
+    kListReq = 1,      // (empty)
+    kListResp = 2,     // u32 n, n * {u64 size, u16 name_len, name}
+    kManifestReq = 3,  // name
+    kManifestResp = 4, // u32 chunk_bytes, u64 size, u32 n, n * digest
+    kGetReq = 5,       // u64 offset, u64 length, name
+    kGetResp = 6,      // raw file bytes, len == requested length
+};
+
+enum Status : uint16_t {
+    kOk = 0,
+    kNotFound = 1,
+    kBadRequest = 2,
+};
+
+#pragma pack(push, 1)
+struct MsgHeader {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t status;
+    uint32_t len;
+};
+#pragma pack(pop)
+
+class Buf {
+public:
+    template <typename T>
+    void put(T v) {
+        bytes.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    void put_bytes(const void* p, size_t n) { bytes.append(static_cast<const char*>(p), n); }
+    std::string bytes;
+};
+
+class Cursor {
+public:
+    explicit Cursor(const std::string& s) : p_(s.data()), end_(s.data() + s.size()) {}
+    template <typename T>
+    bool get(T* v) {
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) return false;
+        std::memcpy(v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+    bool get_bytes(void* out, size_t n) {
+        if (static_cast<size_t>(end_ - p_) < n) return false;
+        std::memcpy(out, p_, n);
+        p_ += n;
+        return true;
+    }
+    std::string rest() { return std::string(p_, end_); }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+bool send_msg(int fd, uint16_t type, uint16_t status, const std::string& payload) {
+    MsgHeader h{kMagic, type, status, static_cast<uint32_t>(payload.size())};
+    return send_all(fd, &h, sizeof(h), payload.empty() ? 0 : MSG_MORE) &&
+           (payload.empty() || send_all(fd, payload.data(), payload.size()));
+}
+
+bool recv_msg(int fd, MsgHeader* h, std::string* payload, uint32_t max_len) {
+    if (!recv_all(fd, h, sizeof(*h))) return false;
+    if (h->magic != kMagic || h->len > max_len) {
+        errno = EPROTO;
+        return false;
+    }
+    payload->resize(h->len);
+    return h->len == 0 || recv_all(fd, &(*payload)[0], h->len);
+}
+
+int64_t mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool hash_range(int fd, uint64_t offset, uint64_t len, std::vector<uint8_t>* buf, Sha256Digest* out) {
+    buf->resize(static_cast<size_t>(len));
+    if (!pread_all(fd, buf->data(), buf->size(), offset)) return false;
+    *out = Sha256::hash(buf->data(), buf->size());
+    return true;
+}
+
+// Copies a chunk the receiver already holds in another file, re-verifying it
+// against the expected digest (`buf` is sized to the chunk length).
+bool copy_local_chunk(const std::string& src_path, uint64_t src_off, int dst, uint64_t dst_off,
+                      const Sha256Digest& want, std::vector<uint8_t>* buf) {
+    int src = open(src_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0) return false;
+    bool ok = pread_all(src, buf->data(), buf->size(), src_off) && Sha256::hash(buf->data(), buf->size()) == want &&
+              pwrite(dst, buf->data(), buf->size(), static_cast<off_t>(dst_off)) == static_cast<ssize_t>(buf->size());
+    close(src);
+    return ok;
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Server
+
+OffloadServer::OffloadServer(OffloadServerConfig cfg) : cfg_(std::move(cfg)) {}
+
+OffloadServer::~OffloadServer() { stop(); }
+
+void OffloadServer::start() {
+    listen_fd_ = tcp_listen(cfg_.bind_addr, cfg_.port);
+    sockaddr_in sa{};
+    socklen_t len = sizeof(sa);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&sa), &len);
+    port_ = ntohs(sa.sin_port);
+    stop_.store(false);
+    accept_thread_ = std::thread([this] { accept_loop(); });
+    FR_LOG_INFO("offload: serving %s on port %u", cfg_.root.c_str(), port_);
+}
+
+void OffloadServer::stop() {
+    if (!accept_thread_.joinable()) return;
+    stop_.store(true);
+    shutdown(listen_fd_, SHUT_RDWR);
+    accept_thread_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+
+    std::list<Client> clients;
+    {
+        std::lock_guard<std::mutex> lk(clients_mu_);
+        for (const Client& c : clients_)
+            if (c.fd >= 0) shutdown(c.fd, SHUT_RDWR);
+        clients.swap(clients_);
+    }
+    for (auto& c : clients) c.thread.join();
+}
+
+void OffloadServer::reap_clients() {
+    std::list<Client> finished;
+    {
+        std::lock_guard<std::mutex> lk(clients_mu_);
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            auto next = std::next(it);
+            if (it->done) finished.splice(finished.end(), clients_, it);
+            it = next;
+        }
+    }
+    // Each has already left serve(); the joins return at once.
+    for (auto& c : finished) c.thread.join();
+}
+
+void OffloadServer::accept_loop() {
+    set_thread_name("fr-offload");
+    while (!stop_.load()) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        set_socket_timeouts(fd, cfg_.io_timeout_ms);
+        // A flaky link reconnects again and again; do not keep a thread
+        // object per connection until stop().
+        reap_clients();
+        std::lock_guard<std::mutex> lk(clients_mu_);
+        Client& c = clients_.emplace_back();
+        c.fd = fd;
+        // Started under the lock, so it cannot mark itself done before
+        // `thread` is assigned.
+        c.thread = std::thread([this, &c, fd] {
+            set_thread_name("fr-offload-cl");
+            serve(fd);
+            std::lock_guard<std::mutex> lk2(clients_mu_);
+            close(fd);
+            c.fd = -1;
+            c.done = true;
+        });
+    }
+}
+
+void OffloadServer::serve(int fd) {
+    MsgHeader h{};
+    std::string payload;
+    while (!stop_.load() && recv_msg(fd, &h, &payload, kMaxRequestPayload)) {
+        bool ok = false;
+        Cursor c(payload);
+        switch (h.type) {
+            case kListReq:
+                ok = handle_list(fd);
+                break;
+            case kManifestReq:
+                ok = handle_manifest(fd, payload);
+                break;
+            case kGetReq: {
+                uint64_t off = 0, len = 0;
+                ok = c.get(&off) && c.get(&len) && handle_get(fd, c.rest(), off, len);
+                break;
+            }
+            default:
+                ok = false;
+        }
+        if (!ok) break;
+    }
+}
+
+bool OffloadServer::resolve(const std::string& name, std::string* path) const {
+    size_t slash = name.find('/');
+    if (slash == std::string::npos || slash == 0 || name.find('/', slash + 1) != std::string::npos) return false;
+    if (name.find("..") != std::string::npos) return false;
+    if (!layout::is_sealed_segment(name.substr(slash + 1))) return false;
+    *path = layout::flights_dir(cfg_.root) + "/" + name;
+    return true;
+}
+
+bool OffloadServer::handle_list(int fd) {
+    Buf out;
+    uint32_t n = 0;
+    Buf entries;
+    // The recorder may own the store; read its catalogue without touching it.
+    Catalog catalog(cfg_.root, true);
+    catalog.open();
+    for (const auto& f : catalog.flights()) {
+        for (const auto& s : f.second.segments) {
+            if (s.second.open) continue;
+            std::string name = f.first + "/" + s.first;
+            entries.put<uint64_t>(s.second.bytes);
+            entries.put<uint16_t>(static_cast<uint16_t>(name.size()));
+            entries.put_bytes(name.data(), name.size());
+            n++;
+        }
+    }
+    out.put<uint32_t>(n);
+    out.bytes += entries.bytes;
+    return send_msg(fd, kListResp, kOk, out.bytes);
+}
+
+bool OffloadServer::manifest_for(const std::string& path, Manifest* out) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st{};
+    fstat(fd, &st);
+    {
+        std::lock_guard<std::mutex> lk(cache_mu_);
+        auto it = cache_.find(path);
+        if (it != cache_.end() && it->second.size == static_cast<uint64_t>(st.st_size) &&
+            it->second.mtime_ns == mtime_ns(st)) {
+            *out = it->second;
+            close(fd);
+            return true;
+        }
+    }
+    Manifest m;
+    m.size = static_cast<uint64_t>(st.st_size);
+    m.mtime_ns = mtime_ns(st);
+    std::vector<uint8_t> buf;
+    for (uint64_t off = 0; off < m.size; off += cfg_.chunk_bytes) {
+        Sha256Digest d;
+        if (!hash_range(fd, off, std::min<uint64_t>(cfg_.chunk_bytes, m.size - off), &buf, &d)) {
+            close(fd);
+            return false;
+        }
+        m.chunks.push_back(d);
+    }
+    close(fd);
+    std::lock_guard<std::mutex> lk(cache_mu_);
+    cache_[path] = m;
+    *out = std::move(m);
+    return true;
+}
+
+bool OffloadServer::handle_manifest(int fd, const std::string& name) {
+    std::string path;
+    Manifest m;
+    if (!resolve(name, &path)) return send_msg(fd, kManifestResp, kBadRequest, {});
+    if (!manifest_for(path, &m)) return send_msg(fd, kManifestResp, kNotFound, {});
+    Buf out;
+    out.put<uint32_t>(cfg_.chunk_bytes);
+    out.put<uint64_t>(m.size);
+    out.put<uint32_t>(static_cast<uint32_t>(m.chunks.size()));
+    for (const auto& d : m.chunks) out.put_bytes(d.data(), d.size());
+    return send_msg(fd, kManifestResp, kOk, out.bytes);
+}
+
+bool OffloadServer::handle_get(int fd, const std::string& name, uint64_t offset, uint64_t length) {
+    std::string path;
+    if (!resolve(name, &path)) return send_msg(fd, kGetResp, kBadRequest, {});
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) return send_msg(fd, kGetResp, kNotFound, {});
+    struct stat st{};
+    fstat(file, &st);
+    if (offset > static_cast<uint64_t>(st.st_size) || length > static_cast<uint64_t>(st.st_size) - offset ||
+        length > UINT32_MAX) {
+        close(file);
+        return send_msg(fd, kGetResp, kBadRequest, {});
+    }
+
+    MsgHeader h{kMagic, kGetResp, kOk, static_cast<uint32_t>(length)};
+    bool ok = send_all(fd, &h, sizeof(h), MSG_MORE);
+    off_t pos = static_cast<off_t>(offset);
+    uint64_t left = length;
+    while (ok && left > 0) {
+        ssize_t n = sendfile(fd, file, &pos, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = false;
+        else left -= static_cast<uint64_t>(n);
+    }
+    close(file);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Client
+
+OffloadClient::OffloadClient(OffloadClientConfig cfg) : cfg_(std::move(cfg)) {}
+
+bool OffloadClient::sync_with_retry(int attempts, int backoff_ms) {
+    for (int i = 1; i <= attempts; ++i) {
+        if (sync()) return true;
+        if (i < attempts) {
+            FR_LOG_WARN("offload: attempt %d/%d failed, retrying", i, attempts);
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms * i));
+        }
+    }
+    return false;
+}
+
+bool OffloadClient::sync() {
+    int sock = -1;
+    try {
+        sock = tcp_connect(cfg_.host, cfg_.port, cfg_.io_timeout_ms);
+    } catch (const std::system_error& ex) {
+        FR_LOG_WARN("offload: %s", ex.what());
+        return false;
+    }
+
+    MsgHeader h{};
+    std::string payload;
+    if (!send_msg(sock, kListReq, kOk, {}) || !recv_msg(sock, &h, &payload, 64u << 20) || h.type != kListResp) {
+        close(sock);
+        return false;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> files;
+    Cursor c(payload);
+    uint32_t n = 0;
+    c.get(&n);
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t size = 0;
+        uint16_t len = 0;
+        if (!c.get(&size) || !c.get(&len)) break;
+        std::string name(len, '\0');
+        if (!c.get_bytes(&name[0], len)) break;
+        files.emplace_back(std::move(name), size);
+    }
+    std::sort(files.begin(), files.end());
+
+    const uint64_t local_errors = stats_.local_errors;
+    bool all_ok = true;
+    for (const auto& f : files) {
+        bool ok = false;
+        try {
+            ok = fetch_file(sock, f.first, f.second);
+        } catch (const std::exception& ex) {
+            // Local I/O (dest unwritable, disk full) fails this pass, not
+            // the whole retry loop.
+            FR_LOG_WARN("offload: %s", ex.what());
+        }
+        if (!ok) {
+            all_ok = false;
+            // Stream state is unknown after a failed transfer; reconnect next pass.
+            break;
+        }
+    }
+    close(sock);
+    return all_ok && stats_.local_errors == local_errors;
+}
+
+bool OffloadClient::fetch_file(int sock, const std::string& name, uint64_t size) {
+    if (name.find("..") != std::string::npos || name.empty() || name[0] == '/') return true;
+    const std::string final_path = layout::flights_dir(cfg_.dest) + "/" + name;
+    const std::string part_path = final_path + ".part";
+
+    struct stat st{};
+    if (stat(final_path.c_str(), &st) == 0 && static_cast<uint64_t>(st.st_size) == size) {
+        stats_.files_present++;
+        return true;
+    }
+
+    MsgHeader h{};
+    std::string payload;
+    if (!send_msg(sock, kManifestReq, kOk, name) || !recv_msg(sock, &h, &payload, 64u << 20)) return false;
+    if (h.type != kManifestResp || h.status != kOk) {
+        FR_LOG_WARN("offload: no manifest for %s", name.c_str());
+        return h.type == kManifestResp;  // vanished on the server: skip, not fatal
+    }
+    Cursor c(payload);
+    uint32_t chunk_bytes = 0, nchunks = 0;
+    uint64_t file_size = 0;
+    if (!c.get(&chunk_bytes) || !c.get(&file_size) || !c.get(&nchunks) || chunk_bytes == 0) return false;
+    std::vector<Sha256Digest> chunks(nchunks);
+    for (auto& d : chunks)
+        if (!c.get_bytes(d.data(), d.size())) return false;
+
+    index_local(chunk_bytes);
+    // Nothing has been requested yet, so the stream is still in step: a file
+    // that cannot be written here is skipped and the rest still come over.
+    try {
+        make_dirs(final_path.substr(0, final_path.rfind('/')));
+    } catch (const std::system_error& ex) {
+        FR_LOG_WARN("offload: %s", ex.what());
+        stats_.local_errors++;
+        return true;
+    }
+    int fd = open(part_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        FR_LOG_WARN("offload: open %s: %s", part_path.c_str(), std::strerror(errno));
+        stats_.local_errors++;
+        return true;
+    }
+    fstat(fd, &st);
+    uint64_t have = static_cast<uint64_t>(st.st_size);
+    if (have > file_size) {
+        ftruncate(fd, 0);
+        have = 0;
+    }
+
+    // Work out which byte ranges still have to cross the link.
+    std::vector<uint8_t> buf;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;  // [begin, end)
+    std::vector<uint32_t> to_verify;
+    auto need = [&](uint64_t b, uint64_t e) {
+        if (!ranges.empty() && ranges.back().second == b && e - ranges.back().first <= cfg_.max_request_bytes)
+            ranges.back().second = e;
+        else
+            ranges.emplace_back(b, e);
+    };
+    for (uint32_t i = 0; i < nchunks; ++i) {
+        uint64_t b = static_cast<uint64_t>(i) * chunk_bytes;
+        uint64_t e = std::min<uint64_t>(b + chunk_bytes, file_size);
+        Sha256Digest d;
+        buf.resize(static_cast<size_t>(e - b));
+        if (e <= have && hash_range(fd, b, e - b, &buf, &d) && d == chunks[i]) {
+            stats_.bytes_reused += e - b;
+            continue;
+        }
+        auto known = known_chunks_.find(chunks[i]);
+        if (known != known_chunks_.end() && known->second.length == e - b &&
+            copy_local_chunk(known->second.path, known->second.offset, fd, b, chunks[i], &buf)) {
+            stats_.bytes_reused += e - b;
+            continue;
+        }
+        // Resume inside a partially received chunk instead of refetching it.
+        uint64_t from = (b < have && have < e) ? have : b;
+        if (from != b) stats_.bytes_reused += from - b;
+        need(from, e);
+        to_verify.push_back(i);
+    }
+
+    bool ok = true;
+    std::vector<uint8_t> rx(256u << 10);
+    for (const auto& r : ranges) {
+        Buf req;
+        req.put<uint64_t>(r.first);
+        req.put<uint64_t>(r.second - r.first);
+        req.put_bytes(name.data(), name.size());
+        if (!send_msg(sock, kGetReq, kOk, req.bytes) || !recv_all(sock, &h, sizeof(h)) || h.magic != kMagic ||
+            h.type != kGetResp || h.status != kOk || h.len != r.second - r.first) {
+            ok = false;
+            break;
+        }
+        uint64_t pos = r.first;
+        while (ok && pos < r.second) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(rx.size(), r.second - pos));
+            ssize_t got = recv(sock, rx.data(), want, 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0 || pwrite(fd, rx.data(), static_cast<size_t>(got), static_cast<off_t>(pos)) != got) {
+                ok = false;
+                break;
+            }
+            pos += static_cast<uint64_t>(got);
+            stats_.bytes_received += static_cast<uint64_t>(got);
+        }
+        if (!ok) {
+            // Keep the contiguous prefix; the next pass resumes from there.
+            fdatasync(fd);
+            break;
+        }
+    }
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+
+    for (uint32_t i : to_verify) {
+        uint64_t b = static_cast<uint64_t>(i) * chunk_bytes;
+        uint64_t e = std::min<uint64_t>(b + chunk_bytes, file_size);
+        Sha256Digest d;
+        if (!hash_range(fd, b, e - b, &buf, &d) || d != chunks[i]) {
+            FR_LOG_WARN("offload: %s chunk %u failed verification", name.c_str(), i);
+            stats_.chunk_mismatches++;
+            ftruncate(fd, static_cast<off_t>(b));
+            ok = false;
+            break;
+        }
+    }
+    if (ok && ftruncate(fd, static_cast<off_t>(file_size)) != 0) ok = false;
+    if (ok) ok = fdatasync(fd) == 0;
+    close(fd);
+    if (!ok) return false;
+
+    if (rename(part_path.c_str(), final_path.c_str()) != 0) return false;
+    fsync_dir(final_path.substr(0, final_path.rfind('/')));
+    remember(final_path, chunk_bytes, file_size, chunks);
+    write_sidecar(final_path, chunk_bytes, file_size, chunks);
+    stats_.files_completed++;
+    FR_LOG_INFO("offload: %s complete", name.c_str());
+    return true;
+}
+
+void OffloadClient::remember(const std::string& path, uint32_t chunk_bytes, uint64_t size,
+                             const std::vector<Sha256Digest>& chunks) {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const uint64_t b = static_cast<uint64_t>(i) * chunk_bytes;
+        known_chunks_.emplace(chunks[i], ChunkRef{path, b, static_cast<uint32_t>(std::min<uint64_t>(chunk_bytes, size - b))});
+    }
+}
+
+void OffloadClient::write_sidecar(const std::string& path, uint32_t chunk_bytes, uint64_t size,
+                                  const std::vector<Sha256Digest>& chunks) {
+    // Same payload as a manifest response. Losing it only costs a rehash.
+    Buf out;
+    out.put<uint32_t>(chunk_bytes);
+    out.put<uint64_t>(size);
+    out.put<uint32_t>(static_cast<uint32_t>(chunks.size()));
+    for (const auto& d : chunks) out.put_bytes(d.data(), d.size());
+    write_file_atomic(path + kChunksSuffix, out.bytes.data(), out.bytes.size());
+}
+
+void OffloadClient::index_local(uint32_t chunk_bytes) {
+    if (!indexed_.insert(chunk_bytes).second) return;
+    const std::string flights = layout::flights_dir(cfg_.dest);
+    size_t files = 0, hashed = 0;
+    for (const auto& flight : list_dir(flights)) {
+        const std::string dir = flights + "/" + flight;
+        for (const auto& name : list_dir(dir)) {
+            if (!layout::is_sealed_segment(name)) continue;  // not .part, .chunks or metadata
+            const std::string path = dir + "/" + name;
+            struct stat st{};
+            if (stat(path.c_str(), &st) != 0) continue;
+            const auto size = static_cast<uint64_t>(st.st_size);
+            std::string sidecar;
+            if (read_file(path + kChunksSuffix, &sidecar)) {
+                Cursor c(sidecar);
+                uint32_t cb = 0, n = 0;
+                uint64_t sz = 0;
+                if (c.get(&cb) && c.get(&sz) && c.get(&n) && cb == chunk_bytes && sz == size) {
+                    std::vector<Sha256Digest> chunks(n);
+                    bool ok = true;
+                    for (auto& d : chunks) ok = ok && c.get_bytes(d.data(), d.size());
+                    if (ok) {
+                        remember(path, chunk_bytes, size, chunks);
+                        files++;
+                        continue;
+                    }
+                }
+            }
+            // Completed before sidecars existed, or at another chunk size.
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            std::vector<Sha256Digest> chunks;
+            std::vector<uint8_t> buf;
+            bool ok = true;
+            for (uint64_t off = 0; ok && off < size; off += chunk_bytes) {
+                Sha256Digest d;
+                ok = hash_range(fd, off, std::min<uint64_t>(chunk_bytes, size - off), &buf, &d);
+                chunks.push_back(d);
+            }
+            close(fd);
+            if (!ok) continue;
+            remember(path, chunk_bytes, size, chunks);
+            write_sidecar(path, chunk_bytes, size, chunks);
+            files++;
+            hashed++;
+        }
+    }
+    if (files)
+        FR_LOG_INFO("offload: indexed %zu local files (%zu hashed) for chunk reuse", files, hashed);
+}
+
+}  // namespace fr
@@ -0,0 +1,143 @@
+// Post-flight offload of sealed segments over TCP.
+//
+// The server lists sealed segments and, per segment, a manifest of SHA-256
+// hashes over fixed-size chunks. The client compares the manifest against
+// whatever it already holds (a .part file left by an earlier dropout, or an
+// identical chunk in a file it has already completed) and requests only the
+// missing byte ranges. Completed files keep their manifest in a .chunks
+// sidecar, so that index of local chunks survives across runs; files without
+// one are hashed once, the first time a manifest asks for their chunk size.
+// The server answers range requests with sendfile(), so segment data never
+// passes through user space on the vehicle.
+//
+// Wire format: every message is an OffloadMsgHeader followed by `len` payload
+// bytes; see offload.cpp for the per-type payloads.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sha256.hpp"
+
+namespace fr {
+
+struct OffloadServerConfig {
+    std::string root;
+    std::string bind_addr = "0.0.0.0";
+    uint16_t port = 7461;  // 0 picks an ephemeral port; see OffloadServer::port()
+    uint32_t chunk_bytes = 1u << 20;
+    int io_timeout_ms = 15000;
+};
+
+class OffloadServer {
+public:
+    explicit OffloadServer(OffloadServerConfig cfg);
+    ~OffloadServer();
+
+    OffloadServer(const OffloadServer&) = delete;
+    OffloadServer& operator=(const OffloadServer&) = delete;
+
+    // Binds and starts accepting. Throws std::system_error if the bind fails.
+    void start();
+    void stop();
+
+    uint16_t port() const { return port_; }
+
+private:
+    struct Manifest {
+        uint64_t size = 0;
+        int64_t mtime_ns = 0;
+        std::vector<Sha256Digest> chunks;
+    };
+
+    struct Client {
+        int fd = -1;  // -1 once the connection is closed
+        std::thread thread;
+        bool done = false;
+    };
+
+    void accept_loop();
+    // Joins client threads that have finished; called on every accept.
+    void reap_clients();
+    void serve(int fd);
+    bool handle_list(int fd);
+    bool handle_manifest(int fd, const std::string& name);
+    bool handle_get(int fd, const std::string& name, uint64_t offset, uint64_t length);
+    bool resolve(const std::string& name, std::string* path) const;
+    bool manifest_for(const std::string& path, Manifest* out);
+
+    const OffloadServerConfig cfg_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::thread accept_thread_;
+
+    std::mutex clients_mu_;
+    std::list<Client> clients_;  // stable addresses: each thread marks its own entry done
+
+    // Hashing a segment is the expensive part of a manifest; cache by path
+    // and invalidate on size/mtime change.
+    std::mutex cache_mu_;
+    std::map<std::string, Manifest> cache_;
+};
+
+struct OffloadClientConfig {
+    std::string host;
+    uint16_t port = 7461;
+    std::string dest;
+    int io_timeout_ms = 15000;
+    // Contiguous missing chunks are merged into range requests up to this size.
+    uint64_t max_request_bytes = 64ull << 20;
+};
+
+class OffloadClient {
+public:
+    struct Stats {
+        uint64_t files_completed = 0;
+        uint64_t files_present = 0;
+        uint64_t bytes_received = 0;
+        uint64_t bytes_reused = 0;  // chunks satisfied from local data
+        uint64_t chunk_mismatches = 0;
+        uint64_t local_errors = 0;  // files skipped: they could not be written under dest
+    };
+
+    explicit OffloadClient(OffloadClientConfig cfg);
+
+    // One pass: connect, list, fetch everything missing. False on any dropout,
+    // verification failure or file that could not be written locally;
+    // partial progress is kept for the next pass.
+    bool sync();
+    // Repeats sync() with linear backoff until it succeeds or attempts run out.
+    bool sync_with_retry(int attempts, int backoff_ms);
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct ChunkRef {
+        std::string path;
+        uint64_t offset;
+        uint32_t length;
+    };
+
+    bool fetch_file(int sock, const std::string& name, uint64_t size);
+    // Adds every completed file under dest to known_chunks_, at `chunk_bytes`.
+    void index_local(uint32_t chunk_bytes);
+    void remember(const std::string& path, uint32_t chunk_bytes, uint64_t size, const std::vector<Sha256Digest>& chunks);
+    static void write_sidecar(const std::string& path, uint32_t chunk_bytes, uint64_t size,
+                              const std::vector<Sha256Digest>& chunks);
+
+    const OffloadClientConfig cfg_;
+    Stats stats_;
+    // Content-addressed view of chunks already on disk at the receiver.
+    std::map<Sha256Digest, ChunkRef> known_chunks_;
+    std::set<uint32_t> indexed_;  // chunk sizes index_local() has covered
+};
+
+}  // namespace fr
@@ -0,0 +1,467 @@
+#include "query.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "channels.hpp"
+#include "config.hpp"
+#include "fs_util.hpp"
+#include "segment_reader.hpp"
+#include "storage_layout.hpp"
+
+namespace fr {
+
+namespace {
+
+struct SegmentPlan {
+    std::string path;
+    int64_t t_lo = 0;  // absolute time range for this segment's flight
+    int64_t t_hi = 0;
+    seg::Tier tier = seg::Tier::Raw;
+    std::vector<seg::IndexEntry> decode;
+};
+
+// A rollup bucket as a row, before merging its parts from adjacent segments.
+struct BucketRow {
+    int64_t t;
+    uint32_t channel;
+    double sum;
+    uint64_t count;
+};
+
+// Per-channel accumulator; one per task, merged at the end.
+struct Acc {
+    uint64_t count = 0;
+    bool matched = false;  // from index entries that cannot count (no null count)
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+    std::vector<double> values;
+    std::vector<uint64_t> histogram;
+    // Union of surviving chunks' [v_min, v_max], for an automatic histogram range.
+    double stats_lo = std::numeric_limits<double>::infinity();
+    double stats_hi = -std::numeric_limits<double>::infinity();
+
+    void merge(Acc& o) {
+        count += o.count;
+        matched = matched || o.matched;
+        min = std::min(min, o.min);
+        max = std::max(max, o.max);
+        sum += o.sum;
+        values.insert(values.end(), o.values.begin(), o.values.end());
+        if (histogram.size() < o.histogram.size()) histogram.resize(o.histogram.size());
+        for (size_t i = 0; i < o.histogram.size(); ++i) histogram[i] += o.histogram[i];
+        stats_lo = std::min(stats_lo, o.stats_lo);
+        stats_hi = std::max(stats_hi, o.stats_hi);
+    }
+};
+
+int64_t add_sat(int64_t a, int64_t b) {
+    int64_t r;
+    if (__builtin_add_overflow(a, b, &r)) return b > 0 ? std::numeric_limits<int64_t>::max() : std::numeric_limits<int64_t>::min();
+    return r;
+}
+
+// Finite samples with v in [lo, hi]: branch-free so the loop vectorises.
+void scan_minmax_sum(const double* v, size_t n, double lo, double hi, Acc* a) {
+    double mn = a->min, mx = a->max, sum = 0;
+    uint64_t cnt = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const double x = v[i];
+        const bool keep = x >= lo && x <= hi && std::isfinite(x);
+        mn = keep && x < mn ? x : mn;
+        mx = keep && x > mx ? x : mx;
+        sum += keep ? x : 0.0;
+        cnt += keep;
+    }
+    a->min = mn;
+    a->max = mx;
+    a->sum += sum;
+    a->count += cnt;
+}
+
+// Equality-predicate variant; the set is small, so a linear probe is fine.
+void scan_in_set(const double* v, size_t n, const std::vector<double>& set, double lo, double hi, Acc* a) {
+    for (size_t i = 0; i < n; ++i) {
+        const double x = v[i];
+        if (!(x >= lo && x <= hi) || std::find(set.begin(), set.end(), x) == set.end()) continue;
+        a->min = std::min(a->min, x);
+        a->max = std::max(a->max, x);
+        a->sum += x;
+        a->count++;
+    }
+}
+
+// Time covered by a segment's index.
+bool segment_extent(const std::string& path, const std::shared_ptr<const MasterKey>& key, int64_t* first,
+                    int64_t* last) {
+    SegmentReader reader;
+    reader.set_key(key);
+    if (!reader.open(path) || reader.index().empty()) return false;
+    *first = std::numeric_limits<int64_t>::max();
+    *last = std::numeric_limits<int64_t>::min();
+    for (const auto& e : reader.index()) {
+        *first = std::min(*first, e.t_first);
+        *last = std::max(*last, e.t_last);
+    }
+    return true;
+}
+
+}  // namespace
+
+std::vector<std::string> QueryEngine::recent_flights(size_t last_n) const {
+    std::vector<std::string> flights;
+    for (const auto& f : list_dir(layout::flights_dir(root_))) {
+        // Rollups alone still answer aggregates.
+        for (int t = 0; t < seg::kTierCount; ++t) {
+            if (layout::segment_paths(root_, f, static_cast<seg::Tier>(t)).empty()) continue;
+            flights.push_back(f);
+            break;
+        }
+    }
+    if (last_n && flights.size() > last_n) flights.erase(flights.begin(), flights.end() - static_cast<std::ptrdiff_t>(last_n));
+    return flights;
+}
+
+bool QueryEngine::resolve_channel(const std::string& flight, const std::string& text, uint32_t* id) const {
+    char* end = nullptr;
+    const unsigned long n = std::strtoul(text.c_str(), &end, 0);
+    if (!text.empty() && *end == '\0') {
+        *id = n <= channel::kLocalMask ? channel::make(channel::kDecoded, static_cast<uint32_t>(n)) : static_cast<uint32_t>(n);
+        return true;
+    }
+    // By name, through the config embedded in the flight's first segment.
+    std::vector<std::string> paths = layout::raw_segment_paths(root_, flight);
+    SegmentReader reader;
+    reader.set_key(key_);
+    if (paths.empty() || !reader.open(paths.front())) return false;
+    for (const auto& e : reader.index()) {
+        if (e.channel != channel::make(channel::kMeta, channel::kMetaConfig)) continue;
+        ChunkData c;
+        std::string err;
+        if (!reader.read_chunk(e, &c) || c.blob_len.empty()) return false;
+        auto cfg = CompiledConfig::from_bytes(c.blob_bytes.substr(0, c.blob_len[0]), &err);
+        if (!cfg) return false;
+        for (uint32_t i = 0; i < cfg->channel_count(); ++i) {
+            if (text == cfg->str(cfg->channel(i).name_off)) {
+                *id = channel::make(channel::kDecoded, cfg->channel(i).id);
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+bool QueryEngine::run(const QuerySpec& spec, const std::vector<std::string>& flights, QueryResult* out) {
+    *out = QueryResult();
+    read_errors_ = 0;
+    if (spec.channels.empty()) {
+        error_ = "no channels selected";
+        return false;
+    }
+    std::unordered_map<uint32_t, size_t> slot_of;
+    for (size_t i = 0; i < spec.channels.size(); ++i) slot_of.emplace(spec.channels[i], i);
+
+    // Index stats answer min/max, and count where the entry records its null
+    // count; sums and anything per-sample need the data.
+    const bool index_only_ok =
+        (spec.aggregates & ~static_cast<uint32_t>(kAggCount | kAggMin | kAggMax)) == 0 && !spec.rows && spec.v_in.empty();
+    const bool want_count = spec.aggregates & kAggCount;
+    const bool want_hist = spec.aggregates & kAggHistogram;
+    const bool want_values = spec.aggregates & kAggPercentiles;
+
+    const bool rollup_ok = spec.use_rollups &&
+                           (spec.aggregates & ~static_cast<uint32_t>(kAggCount | kAggMin | kAggMax | kAggAvg)) == 0 &&
+                           spec.v_in.empty() && spec.v_lo == -std::numeric_limits<double>::infinity() &&
+                           spec.v_hi == std::numeric_limits<double>::infinity();
+
+    // Per flight: absolute time range (relative ranges start at the flight's
+    // first timestamp), the tier to read, and its segments.
+    std::vector<SegmentPlan> plans;
+    for (const auto& flight : flights) {
+        // seq -> path per tier; "" where that tier has no file.
+        std::map<uint32_t, std::array<std::string, seg::kTierCount>> files;
+        for (int t = 0; t < seg::kTierCount; ++t)
+            for (auto& f : layout::segment_paths(root_, flight, static_cast<seg::Tier>(t)))
+                files[f.first][static_cast<size_t>(t)] = std::move(f.second);
+        if (files.empty()) continue;
+        auto finest = [](const std::array<std::string, seg::kTierCount>& a) -> const std::string& {
+            for (const auto& path : a)
+                if (!path.empty()) return path;
+            return a[0];
+        };
+
+        int64_t lo = spec.t_from, hi = spec.t_to;
+        int64_t first = 0, last = 0, unused = 0;
+        const bool open_ended = lo == std::numeric_limits<int64_t>::min() || hi == std::numeric_limits<int64_t>::max();
+        if (spec.relative_time || (rollup_ok && open_ended)) {
+            if (!segment_extent(finest(files.begin()->second), key_, &first, &unused) ||
+                !segment_extent(finest(files.rbegin()->second), key_, &unused, &last)) {
+                read_errors_++;
+                continue;
+            }
+            if (spec.relative_time) {
+                lo = add_sat(first, spec.t_from);
+                hi = add_sat(first, spec.t_to);
+            }
+        }
+        seg::Tier tier = seg::Tier::Raw;
+        if (rollup_ok) {
+            const int64_t span_lo = open_ended ? std::max(lo, first) : lo;
+            const int64_t span_hi = open_ended ? std::min(hi, last) : hi;
+            tier = seg::tier_for_span(span_hi > span_lo ? span_hi - span_lo : 0, spec.max_points);
+        }
+        for (auto& kv : files) {
+            auto& a = kv.second;
+            // The chosen tier where compaction has produced it, else raw, else
+            // (raw reclaimed) whichever rollup is left.
+            int use = -1;
+            if (tier != seg::Tier::Raw && !a[static_cast<size_t>(tier)].empty())
+                use = static_cast<int>(tier);
+            else if (!a[0].empty())
+                use = 0;
+            else if (rollup_ok)
+                for (int t = 1; t < seg::kTierCount && use < 0; ++t)
+                    if (!a[static_cast<size_t>(t)].empty()) use = t;
+            if (use < 0) {
+                out->stats.segments_unavailable++;
+                continue;
+            }
+            const auto used = static_cast<seg::Tier>(use);
+            if (used != seg::Tier::Raw) {
+                out->stats.segments_rollup++;
+                out->resolution_ns = std::max(out->resolution_ns, seg::tier_period_ns(used));
+            }
+            plans.push_back(SegmentPlan{std::move(a[static_cast<size_t>(use)]), lo, hi, used, {}});
+        }
+        out->stats.flights++;
+    }
+    out->stats.segments = plans.size();
+
+    std::mutex mu;
+    std::vector<Acc> total(spec.channels.size());
+    std::vector<BucketRow> buckets;
+    std::atomic<uint64_t> errors{0};
+
+    // Phase 1: prune chunks via index statistics.
+    {
+        TaskGroup group(pool_);
+        for (SegmentPlan& plan : plans) {
+            group.run([&, p = &plan] {
+                SegmentReader reader;
+                reader.set_key(key_);
+                if (!reader.open(p->path)) {
+                    errors++;
+                    return;
+                }
+                std::vector<Acc> local(spec.channels.size());
+                QueryStats st;
+                const auto kind = static_cast<uint8_t>(p->tier == seg::Tier::Raw ? seg::ChunkKind::Samples
+                                                                                  : seg::ChunkKind::Rollup);
+                for (const auto& e : reader.index()) {
+                    auto it = slot_of.find(e.channel);
+                    if (it == slot_of.end() || e.kind != kind) continue;
+                    st.chunks++;
+                    if (kind == static_cast<uint8_t>(seg::ChunkKind::Rollup)) {
+                        // Counts and sums are per bucket: always decoded.
+                        const int64_t period = seg::tier_period_ns(p->tier);
+                        if (add_sat(e.t_last, period) <= p->t_lo || e.t_first > p->t_hi || std::isnan(e.v_min))
+                            st.chunks_pruned++;
+                        else
+                            p->decode.push_back(e);
+                        continue;
+                    }
+                    const bool no_finite = std::isnan(e.v_min);
+                    const bool any_in = spec.v_in.empty() ||
+                                        std::any_of(spec.v_in.begin(), spec.v_in.end(),
+                                                    [&e](double v) { return seg::may_contain(e, v); });
+                    if (e.t_last < p->t_lo || e.t_first > p->t_hi || no_finite || e.v_max < spec.v_lo ||
+                        e.v_min > spec.v_hi || !any_in) {
+                        st.chunks_pruned++;
+                        continue;
+                    }
+                    Acc& a = local[it->second];
+                    const bool opaque = e.flags & seg::kIndexOpaque;
+                    if (!opaque) {
+                        a.stats_lo = std::min(a.stats_lo, e.v_min);
+                        a.stats_hi = std::max(a.stats_hi, e.v_max);
+                    }
+                    const bool inside = !opaque && e.t_first >= p->t_lo && e.t_last <= p->t_hi &&
+                                        e.v_min >= spec.v_lo && e.v_max <= spec.v_hi;
+                    uint64_t finite = 0;
+                    const bool counted = seg::finite_count(e, &finite);
+                    if (inside && index_only_ok && (counted || !want_count)) {
+                        // Unpruned, so it holds at least one finite sample,
+                        // whether or not the entry can say how many.
+                        a.count += finite;
+                        a.matched = true;
+                        a.min = std::min(a.min, e.v_min);
+                        a.max = std::max(a.max, e.v_max);
+                        st.chunks_from_index++;
+                        continue;
+                    }
+                    p->decode.push_back(e);
+                }
+                std::lock_guard<std::mutex> lk(mu);
+                for (size_t i = 0; i < local.size(); ++i) total[i].merge(local[i]);
+                out->stats.chunks += st.chunks;
+                out->stats.chunks_pruned += st.chunks_pruned;
+                out->stats.chunks_from_index += st.chunks_from_index;
+            });
+        }
+    }
+
+    // Histogram ranges are fixed before any sample is binned.
+    std::vector<std::pair<double, double>> hist_range(spec.channels.size());
+    const unsigned bins = std::max(1u, spec.histogram_bins);
+    for (size_t i = 0; i < total.size(); ++i) {
+        if (spec.histogram_lo < spec.histogram_hi) {
+            hist_range[i] = {spec.histogram_lo, spec.histogram_hi};
+        } else {
+            double lo = std::max(total[i].stats_lo, spec.v_lo), hi = std::min(total[i].stats_hi, spec.v_hi);
+            if (!(lo <= hi)) lo = hi = 0;
+            hist_range[i] = {lo, hi > lo ? hi : lo + 1};
+        }
+    }
+
+    // Phase 2: decode and scan what pruning could not settle.
+    {
+        TaskGroup group(pool_);
+        for (SegmentPlan& plan : plans) {
+            if (plan.decode.empty()) continue;
+            group.run([&, p = &plan] {
+                SegmentReader reader;
+                reader.set_key(key_);
+                if (!reader.open(p->path)) {
+                    errors++;
+                    return;
+                }
+                std::vector<Acc> local(spec.channels.size());
+                std::vector<QueryRow> rows;
+                std::vector<BucketRow> bucket_rows;
+                uint64_t decoded = 0, scanned = 0;
+                ChunkData c;
+                for (const auto& e : p->decode) {
+                    if (!reader.read_chunk(e, &c)) {
+                        errors++;
+                        continue;
+                    }
+                    decoded++;
+                    const size_t slot = slot_of.at(e.channel);
+                    Acc& a = local[slot];
+                    if (p->tier != seg::Tier::Raw) {
+                        const int64_t period = seg::tier_period_ns(p->tier);
+                        for (const RollupPoint& r : c.rollup) {
+                            // Buckets without finite samples (or from a
+                            // compactor that let NaN in) hold nothing to add.
+                            if (add_sat(r.t, period) <= p->t_lo || r.t > p->t_hi || r.count == 0 || !std::isfinite(r.mean))
+                                continue;
+                            a.count += r.count;
+                            a.min = std::min(a.min, r.min);
+                            a.max = std::max(a.max, r.max);
+                            a.sum += r.mean * r.count;
+                            if (spec.rows) bucket_rows.push_back(BucketRow{r.t, e.channel, r.mean * r.count, r.count});
+                        }
+                        scanned += c.rollup.size();
+                        continue;
+                    }
+                    // Trim to the time range; timestamps within a chunk are ordered.
+                    size_t b = 0, n = c.t.size();
+                    if (e.t_first < p->t_lo) b = std::lower_bound(c.t.begin(), c.t.end(), p->t_lo) - c.t.begin();
+                    if (e.t_last > p->t_hi) n = std::upper_bound(c.t.begin(), c.t.end(), p->t_hi) - c.t.begin();
+                    if (b >= n) continue;
+                    scanned += n - b;
+                    if (spec.v_in.empty())
+                        scan_minmax_sum(c.v.data() + b, n - b, spec.v_lo, spec.v_hi, &a);
+                    else
+                        scan_in_set(c.v.data() + b, n - b, spec.v_in, spec.v_lo, spec.v_hi, &a);
+
+                    if (!want_values && !want_hist && !spec.rows) continue;
+                    const auto range = hist_range[slot];
+                    const double scale = bins / (range.second - range.first);
+                    if (want_hist && a.histogram.empty()) a.histogram.assign(bins, 0);
+                    for (size_t i = b; i < n; ++i) {
+                        const double x = c.v[i];
+                        if (!(x >= spec.v_lo && x <= spec.v_hi && std::isfinite(x))) continue;
+                        if (!spec.v_in.empty() && std::find(spec.v_in.begin(), spec.v_in.end(), x) == spec.v_in.end())
+                            continue;
+                        if (want_values) a.values.push_back(x);
+                        if (want_hist) {
+                            double k = std::floor((x - range.first) * scale);
+                            a.histogram[static_cast<size_t>(std::min<double>(std::max(k, 0.0), bins - 1))]++;
+                        }
+                        if (spec.rows) rows.push_back(QueryRow{c.t[i], e.channel, x});
+                    }
+                }
+                std::lock_guard<std::mutex> lk(mu);
+                for (size_t i = 0; i < local.size(); ++i) total[i].merge(local[i]);
+                out->rows.insert(out->rows.end(), rows.begin(), rows.end());
+                buckets.insert(buckets.end(), bucket_rows.begin(), bucket_rows.end());
+                out->stats.chunks_decoded += decoded;
+                out->stats.samples_scanned += scanned;
+            });
+        }
+    }
+    read_errors_ += errors.load();
+    if (out->stats.segments > 0 && out->stats.chunks == 0 && read_errors_ >= out->stats.segments) {
+        error_ = "no segment could be read";
+        return false;
+    }
+
+    for (size_t i = 0; i < total.size(); ++i) {
+        Acc& a = total[i];
+        ChannelSummary s;
+        s.channel = spec.channels[i];
+        s.count = a.count;
+        s.matched = a.matched || a.count > 0;
+        s.min = a.min;
+        s.max = a.max;
+        s.sum = a.sum;
+        if (want_values && !a.values.empty()) {
+            std::sort(a.values.begin(), a.values.end());
+            for (double q : spec.percentiles) {
+                const double rank = std::min(std::max(q, 0.0), 1.0) * static_cast<double>(a.values.size() - 1);
+                const size_t k = static_cast<size_t>(rank);
+                const double frac = rank - static_cast<double>(k);
+                const double next = k + 1 < a.values.size() ? a.values[k + 1] : a.values[k];
+                s.percentiles.push_back(a.values[k] + (next - a.values[k]) * frac);
+            }
+        }
+        if (want_hist) {
+            s.histogram_lo = hist_range[i].first;
+            s.histogram_hi = hist_range[i].second;
+            s.histogram = a.histogram.empty() ? std::vector<uint64_t>(bins, 0) : a.histogram;
+        }
+        out->channels.push_back(std::move(s));
+    }
+    if (!buckets.empty()) {
+        // A bucket straddling two segments has a part in each one's rollup.
+        std::sort(buckets.begin(), buckets.end(), [](const BucketRow& a, const BucketRow& b) {
+            return a.t != b.t ? a.t < b.t : a.channel < b.channel;
+        });
+        for (size_t i = 0; i < buckets.size();) {
+            BucketRow m = buckets[i];
+            for (++i; i < buckets.size() && buckets[i].t == m.t && buckets[i].channel == m.channel; ++i) {
+                m.sum += buckets[i].sum;
+                m.count += buckets[i].count;
+            }
+            out->rows.push_back(QueryRow{m.t, m.channel, m.sum / static_cast<double>(m.count)});
+        }
+    }
+    if (spec.rows) {
+        std::sort(out->rows.begin(), out->rows.end(), [](const QueryRow& a, const QueryRow& b) {
+            return a.t != b.t ? a.t < b.t : a.channel < b.channel;
+        });
+    }
+    return true;
+}
+
+}  // namespace fr
@@ -0,0 +1,144 @@
+// Columnar queries over recorded flights.
+//
+// A query projects a set of numeric channels, filters by time and value, and
+// aggregates (count/min/max/avg, percentiles, histograms) across any number of
+// flights. Predicates are pushed down to the per-chunk statistics in each
+// segment's index: chunks outside the time range or whose [v_min, v_max]
+// cannot satisfy the value predicate are never read (for equality predicates
+// the entry's bloom filter rules out most of the rest), and when a chunk lies
+// wholly inside both and only count/min/max are wanted it is answered from
+// the index alone. Remaining chunks are decoded and scanned in tight loops,
+// one pool task per segment. Encrypted chunks carry no value statistics, so
+// they are pruned by time only and always decoded.
+//
+// Long spans read rollup tiers (compactor.hpp) instead of raw samples when the
+// rollups can answer: count/min/max/avg, and rows as bucket means, without a
+// value predicate. seg::tier_for_span picks the finest tier covering the span
+// in at most max_points buckets per channel; a bucket counts whole when it
+// overlaps the time range. Buckets split across two segments are merged by count.
+// Segments whose raw data retention has reclaimed are read from the finest
+// rollup left, or counted as unavailable when the query needs raw samples.
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "segment_crypto.hpp"
+#include "task_pool.hpp"
+
+namespace fr {
+
+enum QueryAgg : uint32_t {
+    kAggCount = 1 << 0,
+    kAggMin = 1 << 1,
+    kAggMax = 1 << 2,
+    kAggAvg = 1 << 3,
+    kAggPercentiles = 1 << 4,
+    kAggHistogram = 1 << 5,
+};
+
+struct QuerySpec {
+    std::vector<uint32_t> channels;  // projection (full channel ids); required
+    // Time range, inclusive. With relative_time, nanoseconds since the start
+    // of each flight (so one range applies to every flight), else absolute.
+    int64_t t_from = std::numeric_limits<int64_t>::min();
+    int64_t t_to = std::numeric_limits<int64_t>::max();
+    bool relative_time = false;
+    // Value predicate, inclusive. NaN samples never match a bounded predicate.
+    double v_lo = -std::numeric_limits<double>::infinity();
+    double v_hi = std::numeric_limits<double>::infinity();
+    // Optional equality predicate (value is one of these), ANDed with the
+    // range; meant for discrete channels such as modes and error codes.
+    std::vector<double> v_in;
+
+    uint32_t aggregates = kAggCount | kAggMin | kAggMax | kAggAvg;
+    std::vector<double> percentiles;  // in [0, 1]
+    unsigned histogram_bins = 20;
+    // Histogram range; when unset (lo >= hi) it is taken from the statistics
+    // of the chunks that survive pruning (encrypted chunks have none).
+    double histogram_lo = 0;
+    double histogram_hi = 0;
+    bool rows = false;  // also return every matching (t, channel, value)
+    // Rollups for spans wider than max_points seconds; false: raw samples only.
+    bool use_rollups = true;
+    int64_t max_points = 2000;
+};
+
+struct ChannelSummary {
+    uint32_t channel = 0;
+    // Exact when kAggCount was asked for. Otherwise chunks answered from
+    // an index entry without a null count add nothing (the entry does not
+    // know how many samples are finite); test `matched`, not count > 0.
+    uint64_t count = 0;
+    bool matched = false;  // some sample passed the filters
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+    std::vector<double> percentiles;  // parallel to QuerySpec::percentiles
+    double histogram_lo = 0;
+    double histogram_hi = 0;
+    std::vector<uint64_t> histogram;  // values outside the range are clamped to the end bins
+
+    double avg() const { return count ? sum / static_cast<double>(count) : 0.0; }
+};
+
+struct QueryRow {
+    int64_t t;
+    uint32_t channel;
+    double value;
+};
+
+struct QueryStats {
+    uint64_t flights = 0;
+    uint64_t segments = 0;
+    uint64_t chunks = 0;          // candidate chunks of projected channels
+    uint64_t chunks_pruned = 0;   // skipped via time/value statistics
+    uint64_t chunks_from_index = 0;  // answered from index statistics alone
+    uint64_t chunks_decoded = 0;
+    uint64_t samples_scanned = 0;  // raw samples and rollup buckets
+    uint64_t segments_rollup = 0;  // read at rollup resolution
+    uint64_t segments_unavailable = 0;  // raw data reclaimed, and the query needs it
+};
+
+struct QueryResult {
+    std::vector<ChannelSummary> channels;  // in QuerySpec::channels order
+    std::vector<QueryRow> rows;            // by time, when requested
+    QueryStats stats;
+    int64_t resolution_ns = 0;  // widest rollup bucket read; 0: raw samples throughout
+};
+
+class QueryEngine {
+public:
+    // `pool` may be null (single-threaded).
+    QueryEngine(std::string root, TaskPool* pool) : root_(std::move(root)), pool_(pool) {}
+
+    // Needed to read encrypted flights.
+    void set_key(std::shared_ptr<const MasterKey> key) { key_ = std::move(key); }
+
+    // The `last_n` most recent flights (all when 0), oldest first.
+    std::vector<std::string> recent_flights(size_t last_n) const;
+
+    // Channel id for "NAME" (looked up in the config embedded in `flight`),
+    // a decoded channel number ("12"), or a full channel id ("0x01000000").
+    bool resolve_channel(const std::string& flight, const std::string& text, uint32_t* id) const;
+
+    // False with error() if the spec is invalid or nothing could be read;
+    // damaged segments and chunks are skipped and counted as read errors.
+    bool run(const QuerySpec& spec, const std::vector<std::string>& flights, QueryResult* out);
+
+    const std::string& error() const { return error_; }
+    uint64_t read_errors() const { return read_errors_; }
+
+private:
+    std::string root_;
+    TaskPool* pool_;
+    std::shared_ptr<const MasterKey> key_;
+    std::string error_;
+    uint64_t read_errors_ = 0;
+};
+
+}  // namespace fr
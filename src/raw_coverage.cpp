@@ -0,0 +1,30 @@
+#include "raw_coverage.hpp"
+
+#include "channels.hpp"
+#include "gnss.hpp"
+
+namespace fr {
+
+void RawCoverage::add(const ChunkData& raw) {
+    const uint32_t index = channel::local(raw.hdr.channel);
+    const bool gnss = index < sources_->size() && gnss::accept_for((*sources_)[index].protocol);
+    auto& times = gnss ? gnss_ : mavlink_;
+    times.insert(raw.t.begin(), raw.t.end());
+}
+
+void RawCoverage::clear() {
+    mavlink_.clear();
+    gnss_.clear();
+}
+
+bool RawCoverage::covers(uint32_t ch, int64_t t) const {
+    switch (channel::family(ch)) {
+        case channel::kMavlink:
+        case channel::kDecoded: return mavlink_.count(t) != 0;
+        case channel::kUbx:
+        case channel::kRtcm3: return gnss_.count(t) != 0;
+        default: return false;
+    }
+}
+
+}  // namespace fr
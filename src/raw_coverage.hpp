@@ -0,0 +1,41 @@
+// Which recorded frames merely duplicate raw link bytes (RawCapture::Also).
+//
+// A frame is stamped with the receive time of the read that completed it,
+// and that read is stored on channel::kRawStream with the same timestamp, so
+// a recorded frame is a duplicate exactly when a raw record of a source with
+// the same framing carries its timestamp. Frames without one (--raw off, a
+// source or span that raw capture did not cover) are the only copy and must
+// be kept. Decode and replay use this to prefer raw bytes without losing
+// anything recorded only as frames.
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "segment_reader.hpp"
+#include "source.hpp"
+
+namespace fr {
+
+class RawCoverage {
+public:
+    // `sources` is the flight's source table (may be empty: all MAVLink).
+    explicit RawCoverage(const std::vector<SourceSpec>* sources) : sources_(sources) {}
+
+    // A kRawStream chunk of the segment being read.
+    void add(const ChunkData& raw);
+    void clear();
+
+    // True if the record on `channel` at `t` could be reframed from raw bytes:
+    // kMavlink and kDecoded from a MAVLink source, kUbx and kRtcm3 from a GNSS
+    // source. Always false for other families.
+    bool covers(uint32_t channel, int64_t t) const;
+
+private:
+    const std::vector<SourceSpec>* sources_;
+    std::unordered_set<int64_t> mavlink_;
+    std::unordered_set<int64_t> gnss_;
+};
+
+}  // namespace fr
@@ -0,0 +1,19 @@
+// Unit of data flowing from ingest threads to the writer.
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace fr {
+
+struct Record {
+    int64_t t_ns = 0;
+    uint32_t channel = 0;
+    uint16_t source = 0;  // index into the configured sources
+    uint8_t vehicle = 0;  // MAVLink system id; routes the record to a shard
+    bool blob = false;
+    double value = 0.0;   // numeric records
+    std::string bytes;    // blob records
+};
+
+}  // namespace fr
@@ -0,0 +1,141 @@
+#include "record_queue.hpp"
+
+#include <algorithm>
+
+#include "clock.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr size_t kMinLaneCapacity = 1024;
+
+}  // namespace
+
+RecordQueue::RecordQueue(size_t producers, size_t capacity, std::chrono::nanoseconds window)
+    : window_ns_(window.count()) {
+    if (producers == 0) producers = 1;
+    const size_t per_lane = std::max(capacity / producers, kMinLaneCapacity);
+    for (size_t i = 0; i < producers; ++i) lanes_.push_back(std::make_unique<Lane>(per_lane));
+    heap_.reserve(producers);
+}
+
+bool RecordQueue::push(size_t producer, Record&& r) {
+    Lane& lane = *lanes_[producer < lanes_.size() ? producer : 0];
+    if (!lane.ring.try_push(std::move(r))) {
+        lane.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // Pairs with the fence in pop_batch(): either the consumer sees this
+    // record before it sleeps, or this sees it sleeping and wakes it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        { std::lock_guard<std::mutex> lk(mu_); }
+        cv_.notify_one();
+    }
+    return true;
+}
+
+void RecordQueue::drain() {
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+        Lane& lane = *lanes_[i];
+        // Bounded so a writer that is behind holds at most a ring's worth
+        // per producer here; the rest waits, or drops, in the ring.
+        const size_t limit = lane.ring.capacity();
+        const bool was_empty = lane.run.empty();
+        Record r;
+        while (lane.run.size() < limit && lane.ring.try_pop(&r)) {
+            if (r.t_ns > lane.seen_ns) lane.seen_ns = r.t_ns;
+            lane.run.push_back(std::move(r));
+            held_count_++;
+        }
+        if (was_empty && !lane.run.empty()) {
+            heap_.push_back(Head{lane.run.front().t_ns, i});
+            std::push_heap(heap_.begin(), heap_.end());
+        }
+    }
+}
+
+bool RecordQueue::rings_empty() const {
+    for (const auto& lane : lanes_)
+        if (lane->ring.size()) return false;
+    return true;
+}
+
+int64_t RecordQueue::watermark(int64_t now_ns) const {
+    // Producers with a run pending are bounded by their own heap entry.
+    const int64_t floor = now_ns - window_ns_;
+    int64_t mark = INT64_MAX;
+    for (const auto& lane : lanes_)
+        if (lane->run.empty()) mark = std::min(mark, std::max(lane->seen_ns, floor));
+    return mark;
+}
+
+size_t RecordQueue::pop_batch(std::vector<Record>* out, size_t max, std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        // Closed first: a record pushed before close() is then always drained.
+        const bool closed = closed_.load(std::memory_order_acquire);
+        drain();
+        const int64_t now = monotonic_ns();
+        const int64_t mark = closed ? INT64_MAX : watermark(now);
+        size_t n = 0;
+        while (!heap_.empty() && n < max && heap_.front().t_ns <= mark) {
+            std::pop_heap(heap_.begin(), heap_.end());
+            const size_t i = heap_.back().lane;
+            heap_.pop_back();
+            Lane& lane = *lanes_[i];
+            Record& r = lane.run.front();
+            if (r.t_ns < released_ns_)
+                late_.fetch_add(1, std::memory_order_relaxed);
+            else
+                released_ns_ = r.t_ns;
+            out->push_back(std::move(r));
+            lane.run.pop_front();
+            n++;
+            if (!lane.run.empty()) {
+                heap_.push_back(Head{lane.run.front().t_ns, i});
+                std::push_heap(heap_.begin(), heap_.end());
+            }
+        }
+        held_count_ -= n;
+        held_.store(held_count_, std::memory_order_relaxed);
+        if (n) return n;
+        if (closed && rings_empty()) return 0;
+
+        // Sleep until the oldest held record leaves the window, a producer
+        // pushes, or the timeout.
+        auto wake = deadline;
+        const auto steady = std::chrono::steady_clock::now();
+        if (steady >= deadline) return 0;
+        if (!heap_.empty())
+            wake = std::min(wake, steady + std::chrono::nanoseconds(heap_.front().t_ns + window_ns_ - now));
+        std::unique_lock<std::mutex> lk(mu_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (rings_empty() && !closed_.load(std::memory_order_relaxed)) cv_.wait_until(lk, wake);
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void RecordQueue::close() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        closed_.store(true, std::memory_order_release);
+    }
+    cv_.notify_all();
+}
+
+size_t RecordQueue::size() const {
+    size_t n = held_.load(std::memory_order_relaxed);
+    for (const auto& lane : lanes_) n += lane->ring.size();
+    return n;
+}
+
+uint64_t RecordQueue::dropped() const {
+    uint64_t n = 0;
+    for (const auto& lane : lanes_) n += lane->dropped.load(std::memory_order_relaxed);
+    return n;
+}
+
+}  // namespace fr
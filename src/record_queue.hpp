@@ -0,0 +1,96 @@
+// Bounded queue from ingest threads to a writer, merging all producers into
+// one stream in timestamp order.
+//
+// Each producer (source thread) owns a lock-free SPSC ring, so producers
+// never contend with each other or with the writer. Producers never block:
+// when the writer falls behind, a full ring drops and counts.
+//
+// The consumer drains the rings into per-producer runs and merges those
+// with a k-way heap. The oldest record is released once no producer can
+// still deliver anything older: each producer has either a run pending,
+// already delivered a later timestamp, or been quiet for the whole reorder
+// window. Record timestamps are CLOCK_MONOTONIC receive times, so a quiet
+// producer's next record is never older than now - window, and ordering adds
+// at most `window` of latency. A record older than one already released (a
+// producer stalled past the window, a sample held back by decimation) is
+// released at once and counted as late.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "record.hpp"
+#include "spsc_queue.hpp"
+
+namespace fr {
+
+class RecordQueue {
+public:
+    // `capacity` is shared out evenly between the producers' rings.
+    RecordQueue(size_t producers, size_t capacity, std::chrono::nanoseconds window);
+
+    RecordQueue(const RecordQueue&) = delete;
+    RecordQueue& operator=(const RecordQueue&) = delete;
+
+    // From one thread at a time per producer. False (and counted) if that
+    // producer's ring is full.
+    bool push(size_t producer, Record&& r);
+
+    // Consumer only. Moves up to `max` records into *out, in timestamp order;
+    // waits up to `timeout` for the first. After close() everything held is
+    // released without waiting out the window.
+    size_t pop_batch(std::vector<Record>* out, size_t max, std::chrono::milliseconds timeout);
+
+    // After the last push.
+    void close();
+
+    // Records in the rings and held for ordering; approximate.
+    size_t size() const;
+    uint64_t dropped() const;
+    uint64_t late() const { return late_.load(std::memory_order_relaxed); }
+
+private:
+    struct Lane {
+        explicit Lane(size_t capacity) : ring(capacity) {}
+        SpscQueue<Record> ring;
+        std::atomic<uint64_t> dropped{0};
+        // Consumer only.
+        std::deque<Record> run;
+        int64_t seen_ns = INT64_MIN;  // newest timestamp drained so far
+    };
+    struct Head {
+        int64_t t_ns;
+        size_t lane;
+        // Min-heap on time; ties go to the lower producer index.
+        bool operator<(const Head& o) const { return t_ns != o.t_ns ? t_ns > o.t_ns : lane > o.lane; }
+    };
+
+    void drain();
+    bool rings_empty() const;
+    int64_t watermark(int64_t now_ns) const;
+
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    const int64_t window_ns_;
+
+    // Consumer only.
+    std::vector<Head> heap_;  // one entry per non-empty run
+    size_t held_count_ = 0;
+    int64_t released_ns_ = INT64_MIN;
+
+    std::atomic<size_t> held_{0};  // held_count_, for size()
+    std::atomic<uint64_t> late_{0};
+
+    // Producers only take the mutex to wake a consumer that is asleep.
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> closed_{false};
+};
+
+}  // namespace fr
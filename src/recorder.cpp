@@ -0,0 +1,567 @@
+#include "recorder.hpp"
+
+#include <linux/can.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "channels.hpp"
+#include "clock.hpp"
+#include "fs_util.hpp"
+#include "log.hpp"
+#include "storage_layout.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+Recorder::Recorder(RecorderConfig cfg) : cfg_(std::move(cfg)), flight_id_(layout::make_flight_id(realtime_ns())) {
+    pool_ = std::make_unique<TaskPool>(cfg_.worker_threads);
+    // Two: a sortie can seal while another's manifest is rewritten.
+    io_pool_ = std::make_unique<TaskPool>(2);
+    manifests_ = std::make_unique<TaskGroup>(io_pool_.get());
+    sealing_ = std::make_unique<TaskGroup>(io_pool_.get());
+    if (cfg_.sessions.enabled && cfg_.raw_capture == RawCapture::Only)
+        throw std::runtime_error("sessions need MAVLink framing, which raw-only capture skips");
+    cfg_.writer.root = cfg_.root;
+    cfg_.writer.pool = pool_.get();
+    cfg_.retention.root = cfg_.root;
+    catalog_ = std::make_unique<Catalog>(cfg_.root);
+    catalog_->open();
+    cfg_.retention.catalog = catalog_.get();
+    if (cfg_.config) {
+        const CompiledConfig& c = *cfg_.config;
+        for (uint32_t i = 0; i < c.source_count(); ++i) {
+            SourceSpec spec;
+            std::string err;
+            // Validated by the compiler; a failure here means a corrupt blob.
+            if (!parse_source_spec(c.str(c.source(i).spec_off), &spec, &err)) throw std::runtime_error("config: " + err);
+            spec.name = c.str(c.source(i).name_off);
+            cfg_.sources.push_back(spec);
+        }
+        for (uint32_t i = 0; i < c.channel_count(); ++i)
+            channel_names_[channel::make(channel::kDecoded, c.channel(i).id)] = c.str(c.channel(i).name_off);
+    }
+
+    retention_ = std::make_unique<RetentionManager>(cfg_.retention);
+    if (cfg_.compact) {
+        compactor_ = std::make_unique<Compactor>(CompactorConfig{cfg_.root, true, catalog_.get(), cfg_.writer.key});
+        compactor_->set_seal_callback([this](const SealedSegment& s) {
+            catalog_->add_sealed(s);
+            retention_->notify_sealed(s.flight_id, s.name, s.bytes);
+        });
+    }
+
+    const unsigned n_shards = cfg_.vehicle_shards ? cfg_.vehicle_shards : 1;
+    for (unsigned i = 0; i < n_shards; ++i)
+        shards_.push_back(std::make_unique<Shard>(cfg_.sources.size(), cfg_.queue_capacity, cfg_.reorder_window));
+    // Single-flight mode creates its writer up front so an unusable root
+    // fails at startup; per-vehicle writers appear with their first record,
+    // and sortie writers on arming.
+    if (!cfg_.vehicle_shards && !sessioned(0))
+        writer_for(*shards_[0], 0);
+    else
+        make_dirs(layout::flights_dir(cfg_.root));
+
+    std::vector<std::unique_ptr<Source>> sources;
+    for (const auto& spec : cfg_.sources) sources.push_back(make_source(spec, cfg_.source_options));
+    framers_.resize(sources.size());
+    if (cfg_.sessions.enabled) detectors_.resize(sources.size());
+    for (const auto& spec : cfg_.sources) {
+        gnss_framers_.emplace_back(gnss::accept_for(spec.protocol));
+        dronecan_.push_back(spec.protocol == LinkProtocol::DroneCan ? std::make_unique<DroneCanReassembler>() : nullptr);
+    }
+    if (cfg_.config)
+        for (size_t i = 0; i < sources.size(); ++i) {
+            decoders_.emplace_back(cfg_.config);
+            decoders_.back().set_thinning(&thin_ns_, cfg_.hot_thin_priority);
+        }
+    SourceCallbacks cb;
+    cb.on_data = [this](size_t i, const uint8_t* d, size_t n, int64_t t) { on_data(i, d, n, t); };
+    cb.on_state = [this](size_t i, bool) {
+        framers_[i].reset();
+        gnss_framers_[i].reset();
+        // Whatever comes next may be far later; store held samples now.
+        if (!decoders_.empty())
+            decoders_[i].flush(static_cast<uint16_t>(i), [this, i](Record&& r) { push(i, std::move(r)); });
+    };
+    sources_ = std::make_unique<SourceManager>(std::move(sources), std::move(cb), cfg_.source_policy);
+    health_ = std::make_unique<HealthMonitor>(cfg_.health, [this] { return health_sample(); });
+    if (cfg_.thermal_governor)
+        thermal_ = std::make_unique<ThermalGovernor>(cfg_.thermal,
+                                                     [this](PowerMode m, const ThermalReading&) { on_power_mode(m); });
+}
+
+Recorder::~Recorder() { stop(); }
+
+void Recorder::start() {
+    stop_.store(false);
+    for (auto& shard : shards_)
+        for (auto& kv : shard->writers) retention_->pin_flight(kv.second->flight_id());
+    running_.store(true);
+    retention_->start();
+    if (compactor_) compactor_->start();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard* shard = shards_[i].get();
+        shard->last_tick_ns.store(monotonic_ns());
+        shard->thread = std::thread([this, shard, i] { writer_loop(*shard, i); });
+    }
+    // Last, so that the very first record already has somewhere to go.
+    sources_->start();
+    health_->start();
+    if (thermal_) thermal_->start();
+    FR_LOG_INFO("recorder: flight %s, %zu sources, %zu writer shards, %u pool workers",
+                cfg_.sessions.enabled ? "per sortie" : flight_id_.c_str(), sources_->size(), shards_.size(),
+                pool_->size());
+}
+
+void Recorder::stop() {
+    if (!running_.exchange(false)) return;
+    health_->stop();  // tells systemd we are stopping; sealing may take a while
+    if (thermal_) thermal_->stop();
+    sources_->stop();
+    // Samples held back by decimation belong in the final segments.
+    for (size_t i = 0; i < decoders_.size(); ++i)
+        decoders_[i].flush(static_cast<uint16_t>(i), [this, i](Record&& r) { push(i, std::move(r)); });
+    stop_.store(true);
+    for (auto& shard : shards_) shard->queue.close();
+    for (auto& shard : shards_) {
+        shard->thread.join();
+        uint64_t bytes = 0;
+        for (auto& kv : shard->writers) {
+            close_writer(*shard, *kv.second);
+            bytes += kv.second->bytes_written();
+        }
+        shard->bytes_written.store(bytes);
+        // Pre-roll that no arming claimed.
+        for (auto& kv : shard->sessions)
+            if (!kv.second.open) shard->pre_roll_discarded.fetch_add(kv.second.pre_roll.size());
+    }
+    sealing_->wait();
+    manifests_->wait();
+    // Last rewrite, now with the statistics; the writers are closed and the
+    // shard threads gone, so nothing else touches the summaries.
+    for (auto& shard : shards_)
+        for (auto& kv : shard->writers) finish_manifest(kv.second->flight_id(), manifest_extras(*shard, kv.first));
+    // Only now may retention reclaim them: the manifest lists every segment.
+    for (auto& shard : shards_)
+        for (auto& kv : shard->writers) retention_->unpin_flight(kv.second->flight_id());
+    if (compactor_) compactor_->stop();
+    retention_->stop();
+}
+
+void Recorder::on_power_mode(PowerMode mode) {
+    power_mode_.store(mode, std::memory_order_relaxed);
+    refresh_thinning();
+}
+
+void Recorder::on_headroom(bool ok) {
+    if (low_disk_.exchange(!ok) == !ok) return;  // another shard got there first
+    if (ok) {
+        FR_LOG_INFO("recorder: disk headroom restored, storing everything again");
+    } else {
+        FR_LOG_WARN("recorder: free space below headroom, thinning low-priority data until reclaim catches up");
+        retention_->kick();
+    }
+    refresh_thinning();
+}
+
+void Recorder::refresh_thinning() {
+    // Two threads may flip their inputs at once; recompute under a lock so
+    // the last store always reflects both.
+    std::lock_guard<std::mutex> lk(thin_mu_);
+    const bool thin = power_mode_.load(std::memory_order_relaxed) == PowerMode::Hot ||
+                      low_disk_.load(std::memory_order_relaxed);
+    thin_ns_.store(thin ? std::chrono::duration_cast<std::chrono::nanoseconds>(cfg_.hot_thin_interval).count() : 0,
+                   std::memory_order_relaxed);
+}
+
+void Recorder::apply_power_mode(SegmentWriter& w, PowerMode mode) const {
+    const bool hot = mode == PowerMode::Hot;
+    w.set_codec(hot && cfg_.writer.codec == seg::Codec::Zstd ? seg::Codec::Lz4 : cfg_.writer.codec);
+    w.set_flush_scale(hot ? cfg_.hot_flush_scale : 1);
+}
+
+HealthSample Recorder::health_sample() const {
+    HealthSample h;
+    for (const auto& shard : shards_) {
+        h.queue_depth += shard->queue.size();
+        h.queue_capacity += cfg_.queue_capacity;
+        h.records += shard->records.load(std::memory_order_relaxed);
+        h.dropped += shard->queue.dropped() + shard->write_failed.load(std::memory_order_relaxed);
+        const int64_t tick = shard->last_tick_ns.load(std::memory_order_relaxed);
+        if (!h.oldest_tick_ns || tick < h.oldest_tick_ns) h.oldest_tick_ns = tick;
+        h.last_write_ns = std::max(h.last_write_ns, shard->last_write_ns.load(std::memory_order_relaxed));
+    }
+    h.hot = power_mode_.load(std::memory_order_relaxed) == PowerMode::Hot;
+    // Retention publishes free space after each statvfs; never blocks on it.
+    h.free_bytes = retention_->stats().free_bytes;
+    h.headroom_ok = retention_->headroom_ok();
+    for (const auto& st : sources_->status()) {
+        h.sources++;
+        if (st.state == SourceManager::State::Open) h.sources_open++;
+        h.link_lost += st.counters.lost();
+    }
+    return h;
+}
+
+Recorder::Stats Recorder::stats() const {
+    Stats s;
+    for (const auto& shard : shards_) {
+        s.records += shard->records.load();
+        s.dropped += shard->queue.dropped();
+        s.write_failed += shard->write_failed.load();
+        s.late += shard->queue.late();
+        s.bytes_written += shard->bytes_written.load();
+        s.vehicles += shard->vehicles.load();
+        s.sessions += shard->sessions_opened.load();
+        s.pre_roll_discarded += shard->pre_roll_discarded.load();
+    }
+    s.bytes_written += sealed_bytes_.load();
+    for (const auto& st : sources_->status()) s.link += st.counters;
+    s.first_data_ns = sources_->first_data_ns();
+    return s;
+}
+
+void Recorder::push(size_t source, Record&& r) {
+    Shard& shard = cfg_.vehicle_shards ? *shards_[r.vehicle % shards_.size()] : *shards_[0];
+    shard.queue.push(source, std::move(r));
+}
+
+void Recorder::on_data(size_t index, const uint8_t* data, size_t len, int64_t t_ns) {
+    const auto source = static_cast<uint16_t>(index);
+    // Low on disk with raw capture on, whole frames are the copy to shed:
+    // decode and replay rebuild them from the raw bytes, which they prefer
+    // anyway (raw_coverage.hpp). Shedding raw instead would leave a window
+    // that both treat as covered by nothing but the frames. Decoded fields
+    // stay, thinned like everything else.
+    const bool shed_frames = cfg_.raw_capture == RawCapture::Also && low_disk_.load(std::memory_order_relaxed);
+    auto emit_frame = [&](const MavFrame& f) {
+        // Ahead of the frame's own records, so an arming heartbeat lands in
+        // the sortie it opens.
+        SessionEvent ev;
+        if (!detectors_.empty() && detectors_[index].observe(f, &ev)) {
+            // Samples held back by decimation belong in the sortie that the
+            // post-roll is about to close.
+            if (ev == SessionEvent::Disarm && !decoders_.empty())
+                decoders_[index].flush_vehicle(f.sysid, source, [this, index](Record&& r) { push(index, std::move(r)); });
+            push(index, session_record(ev, f.sysid, t_ns, source));
+        }
+        if (!decoders_.empty()) {
+            decoders_[index].decode(f, t_ns, source, [this, index](Record&& r) { push(index, std::move(r)); });
+            return;
+        }
+        if (shed_frames) return;
+        Record r;
+        r.t_ns = t_ns;
+        r.channel = channel::make(channel::kMavlink, f.msgid);
+        r.source = source;
+        r.vehicle = f.sysid;
+        r.blob = true;
+        r.bytes.assign(reinterpret_cast<const char*>(f.data), f.len);
+        push(index, std::move(r));
+    };
+    // Raw observations are stored whole; decoding is left to PPK tools.
+    auto emit_gnss = [&](const GnssFrame& f) {
+        if (shed_frames) return;
+        Record r;
+        r.t_ns = t_ns;
+        r.channel = channel::make(f.rtcm ? channel::kRtcm3 : channel::kUbx, f.msg_id);
+        r.source = source;
+        r.blob = true;
+        r.bytes.assign(reinterpret_cast<const char*>(f.data), f.len);
+        push(index, std::move(r));
+    };
+
+    const SourceKind kind = cfg_.sources[index].kind;
+    if (cfg_.raw_capture != RawCapture::Off && kind != SourceKind::Can) {
+        // One copy, no parsing: the cheapest possible capture path.
+        Record r;
+        r.t_ns = t_ns;
+        r.channel = channel::make(channel::kRawStream, source);
+        r.source = source;
+        r.blob = true;
+        r.bytes.assign(reinterpret_cast<const char*>(data), len);
+        push(index, std::move(r));
+        if (cfg_.raw_capture == RawCapture::Only) return;
+    }
+
+    const bool gnss = gnss::accept_for(cfg_.sources[index].protocol) != 0;
+    switch (kind) {
+        case SourceKind::Serial:
+            if (gnss)
+                gnss_framers_[index].feed(data, len, emit_gnss);
+            else
+                framers_[index].feed(data, len, emit_frame);
+            break;
+        case SourceKind::Udp:
+            // A datagram never continues in the next one.
+            if (gnss) {
+                gnss_framers_[index].feed(data, len, emit_gnss);
+                gnss_framers_[index].reset();
+            } else {
+                framers_[index].feed(data, len, emit_frame);
+                framers_[index].reset();
+            }
+            break;
+        case SourceKind::Can:
+            for (size_t off = 0; off + sizeof(can_frame) <= len; off += sizeof(can_frame)) {
+                Record r;
+                r.t_ns = t_ns;
+                r.channel = channel::make(channel::kCanFrame, source);
+                r.source = source;
+                r.blob = true;
+                r.bytes.assign(reinterpret_cast<const char*>(data + off), sizeof(can_frame));
+                push(index, std::move(r));
+                if (!dronecan_[index]) continue;
+                can_frame frame;
+                std::memcpy(&frame, data + off, sizeof(frame));
+                if (const DroneCanTransfer* t = dronecan_[index]->push(frame, t_ns)) {
+                    Record m;
+                    m.t_ns = t_ns;
+                    m.channel = channel::make(channel::kDroneCan, t->local);
+                    m.source = source;
+                    m.blob = true;
+                    DroneCanReassembler::encode(*t, &m.bytes);
+                    push(index, std::move(m));
+                }
+            }
+            break;
+    }
+}
+
+SegmentWriter& Recorder::writer_for(Shard& shard, uint8_t vehicle) {
+    auto it = shard.writers.find(vehicle);
+    if (it != shard.writers.end()) return *it->second;
+
+    SegmentWriterConfig wc = cfg_.writer;
+    if (sessioned(vehicle))
+        wc.flight_id = shard.sessions.at(vehicle).flight_id;
+    else
+        wc.flight_id = cfg_.vehicle_shards ? layout::vehicle_flight_id(flight_id_, vehicle) : flight_id_;
+    auto writer = std::make_unique<SegmentWriter>(wc);  // throws if the directory cannot be made
+    if (cfg_.config) {
+        const CompiledConfig& c = *cfg_.config;
+        writer->add_segment_preamble(channel::make(channel::kMeta, channel::kMetaConfig),
+                                     std::string(reinterpret_cast<const char*>(c.data()), c.size()));
+        for (uint32_t i = 0; i < c.channel_count(); ++i) {
+            const cfg::ChannelRec& ch = c.channel(i);
+            if (ch.storage != static_cast<uint8_t>(seg::ValueStorage::F64))
+                writer->set_storage(channel::make(channel::kDecoded, ch.id), static_cast<seg::ValueStorage>(ch.storage),
+                                    ch.precision);
+        }
+    }
+    writer->add_segment_preamble(channel::make(channel::kMeta, channel::kMetaSources), format_source_table(cfg_.sources));
+    writer->set_seal_callback([this](const SealedSegment& s) {
+        catalog_->add_sealed(s);
+        retention_->notify_sealed(s.flight_id, s.name, s.bytes);
+        if (!retention_->headroom_ok()) retention_->kick();
+        if (compactor_) compactor_->enqueue(s);
+        manifests_->run([this, flight = s.flight_id] { update_manifest(flight); });
+    });
+    if (running_.load()) {
+        retention_->pin_flight(wc.flight_id);
+        FR_LOG_INFO("recorder: vehicle %u -> flight %s", vehicle, wc.flight_id.c_str());
+    }
+    apply_power_mode(*writer, shard.applied_mode);
+    if (!shard.seen.test(vehicle)) {
+        shard.seen.set(vehicle);
+        shard.vehicles.fetch_add(1, std::memory_order_relaxed);
+    }
+    return *shard.writers.emplace(vehicle, std::move(writer)).first->second;
+}
+
+void Recorder::update_manifest(const std::string& flight_id) {
+    // Read the catalogue under the lock too: a later rewrite then always
+    // lists at least as many segments as an earlier one.
+    std::lock_guard<std::mutex> lk(manifest_mu_);
+    CatalogFlight f;
+    if (!catalog_->flight(flight_id, &f)) return;
+    auto& listed = manifest_segments_[flight_id];
+    for (const auto& kv : f.segments) {
+        const CatalogSegment& c = kv.second;
+        if (c.open || !c.hashed || layout::segment_tier(kv.first) != seg::Tier::Raw) continue;
+        listed[kv.first] = ManifestSegment{kv.first, c.bytes, c.t_first, c.t_last, c.hash, c.link};
+    }
+    std::vector<ManifestSegment> segs;
+    segs.reserve(listed.size());
+    for (const auto& kv : listed) segs.push_back(kv.second);
+    auto extras = manifest_extras_.find(flight_id);
+    if (!write_manifest(cfg_.root, flight_id, segs, cfg_.manifest_key.get(),
+                        extras != manifest_extras_.end() ? extras->second : std::string()))
+        FR_LOG_WARN("recorder: manifest for %s: %s", flight_id.c_str(), std::strerror(errno));
+}
+
+void Recorder::finish_manifest(const std::string& flight_id, std::string extras) {
+    {
+        std::lock_guard<std::mutex> lk(manifest_mu_);
+        manifest_extras_[flight_id] = std::move(extras);
+    }
+    update_manifest(flight_id);
+}
+
+std::string Recorder::manifest_extras(Shard& shard, uint8_t vehicle) {
+    std::string extras;
+    auto it = shard.summaries.find(vehicle);
+    if (it != shard.summaries.end()) {
+        if (!it->second.empty()) extras = it->second.format(channel_names_);
+        shard.summaries.erase(it);
+    }
+    auto s = shard.sessions.find(vehicle);
+    if (s != shard.sessions.end() && s->second.open) extras += s->second.times.format();
+    return extras;
+}
+
+void Recorder::write(Shard& shard, uint8_t vehicle, const Record& r) {
+    try {
+        SegmentWriter& w = writer_for(shard, vehicle);
+        if (r.blob)
+            w.append_blob(r.channel, r.t_ns, r.bytes.data(), static_cast<uint32_t>(r.bytes.size()));
+        else
+            w.append(r.channel, r.t_ns, r.value);
+    } catch (const std::exception& ex) {
+        // Segment could not be opened or written (disk gone, read-only
+        // remount). The record is lost, and counted, along with whatever
+        // an abandoned segment held; the next one tries again, so the queue
+        // keeps draining and ingest never backs up.
+        // Records appended earlier were counted as written; move them over.
+        const auto* failed = dynamic_cast<const SegmentWriteError*>(&ex);
+        const uint64_t lost = failed ? std::max<uint64_t>(failed->records_lost(), 1) : 1;
+        shard.records.fetch_sub(lost - 1, std::memory_order_relaxed);
+        shard.write_failed.fetch_add(lost, std::memory_order_relaxed);
+        if (!shard.failing) FR_LOG_ERROR("writer: %s; records are being lost", ex.what());
+        shard.failing = true;
+        return;
+    }
+    if (shard.failing) {
+        shard.failing = false;
+        FR_LOG_INFO("writer: writing again, %llu records lost so far",
+                    static_cast<unsigned long long>(shard.write_failed.load(std::memory_order_relaxed)));
+    }
+    if (!r.blob) shard.summaries[vehicle].add(r.channel, r.value);
+    shard.records.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Recorder::close_writer(Shard& shard, SegmentWriter& w) {
+    try {
+        w.close();
+    } catch (const SegmentWriteError& ex) {
+        shard.records.fetch_sub(ex.records_lost(), std::memory_order_relaxed);
+        shard.write_failed.fetch_add(ex.records_lost(), std::memory_order_relaxed);
+        FR_LOG_ERROR("writer: %s; %llu records lost", ex.what(), static_cast<unsigned long long>(ex.records_lost()));
+    }
+}
+
+void Recorder::route(Shard& shard, uint8_t vehicle, Record&& r) {
+    Session& s = shard.sessions.try_emplace(vehicle, cfg_.sessions).first->second;
+    if (s.open && s.close_at_ns && r.t_ns >= s.close_at_ns) close_session(shard, vehicle, s);
+
+    SessionEvent ev;
+    uint8_t sysid = 0;
+    if (parse_session_record(r, &ev, &sysid)) {
+        switch (ev) {
+            case SessionEvent::Arm:
+                s.armed.set(sysid);
+                s.close_at_ns = 0;  // re-armed within the post-roll: same sortie
+                if (!s.open) open_session(shard, vehicle, s);
+                if (!s.times.arm_ns) s.times.arm_ns = r.t_ns;
+                break;
+            case SessionEvent::Disarm:
+                s.armed.reset(sysid);
+                if (!s.open) break;
+                s.times.disarm_ns = r.t_ns;
+                if (s.armed.none())
+                    s.close_at_ns =
+                        r.t_ns + std::chrono::duration_cast<std::chrono::nanoseconds>(cfg_.sessions.post_roll).count();
+                break;
+            case SessionEvent::Takeoff:
+                if (s.open && !s.times.takeoff_ns) s.times.takeoff_ns = r.t_ns;
+                break;
+            case SessionEvent::Landing:
+                if (s.open) s.times.landing_ns = r.t_ns;
+                break;
+        }
+    }
+    if (s.open)
+        write(shard, vehicle, r);
+    else
+        shard.pre_roll_discarded.fetch_add(s.pre_roll.push(std::move(r)), std::memory_order_relaxed);
+}
+
+void Recorder::open_session(Shard& shard, uint8_t vehicle, Session& s) {
+    // Flight ids have one-second resolution and a fixed width (they live in
+    // every segment header); a re-arm within the same second takes the next.
+    s.id_s = std::max(realtime_ns() / 1000000000, s.id_s + 1);
+    const std::string id = layout::make_flight_id(s.id_s * 1000000000);
+    s.flight_id = cfg_.vehicle_shards ? layout::vehicle_flight_id(id, vehicle) : id;
+    s.open = true;
+    s.times = SessionTimes{};
+    s.times.pre_roll = s.pre_roll.size();
+    shard.sessions_opened.fetch_add(1, std::memory_order_relaxed);
+    FR_LOG_INFO("recorder: armed, sortie %s (%zu records of pre-roll)", s.flight_id.c_str(), s.pre_roll.size());
+    s.pre_roll.drain([&](Record&& p) { write(shard, vehicle, p); });
+}
+
+void Recorder::close_session(Shard& shard, uint8_t vehicle, Session& s) {
+    s.close_at_ns = 0;
+    std::string extras = manifest_extras(shard, vehicle);
+    s.open = false;
+    auto it = shard.writers.find(vehicle);
+    if (it == shard.writers.end()) return;  // never managed to open a segment
+    std::shared_ptr<SegmentWriter> w(std::move(it->second));
+    shard.writers.erase(it);
+    FR_LOG_INFO("recorder: disarmed, sealing sortie %s", s.flight_id.c_str());
+    // Sealing syncs and renames the last segment and rewrites the manifest;
+    // none of that should hold up the next sortie's records.
+    sealing_->run([this, &shard, w, extras = std::move(extras)]() mutable {
+        close_writer(shard, *w);
+        sealed_bytes_.fetch_add(w->bytes_written(), std::memory_order_relaxed);
+        // Pinned until the final manifest lists every segment.
+        finish_manifest(w->flight_id(), std::move(extras));
+        retention_->unpin_flight(w->flight_id());
+    });
+}
+
+void Recorder::writer_loop(Shard& shard, size_t index) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "fr-writer-%zu", index);
+    set_thread_name(name);
+    std::vector<Record> batch;
+    batch.reserve(1024);
+    for (;;) {
+        shard.last_tick_ns.store(monotonic_ns(), std::memory_order_relaxed);
+        const PowerMode mode = power_mode_.load(std::memory_order_relaxed);
+        if (mode != shard.applied_mode) {
+            shard.applied_mode = mode;
+            for (auto& kv : shard.writers) apply_power_mode(*kv.second, mode);
+        }
+        const bool headroom = retention_->headroom_ok();
+        if (headroom == low_disk_.load(std::memory_order_relaxed)) on_headroom(headroom);
+        batch.clear();
+        size_t n = shard.queue.pop_batch(&batch, 1024, std::chrono::milliseconds(100));
+        if (n == 0 && stop_.load()) break;
+        // write() counts each record as written or lost.
+        for (Record& r : batch) {
+            const uint8_t vehicle = cfg_.vehicle_shards ? r.vehicle : 0;
+            if (sessioned(vehicle))
+                route(shard, vehicle, std::move(r));
+            else
+                write(shard, vehicle, r);
+        }
+        // A post-roll also ends when the link goes quiet after disarming.
+        // Anything older than the reorder window has been delivered by now.
+        const int64_t settled =
+            monotonic_ns() - std::chrono::duration_cast<std::chrono::nanoseconds>(cfg_.reorder_window).count();
+        for (auto& kv : shard.sessions)
+            if (kv.second.open && kv.second.close_at_ns && kv.second.close_at_ns <= settled)
+                close_session(shard, kv.first, kv.second);
+        if (n) shard.last_write_ns.store(monotonic_ns(), std::memory_order_relaxed);
+        uint64_t bytes = 0;
+        for (const auto& kv : shard.writers) bytes += kv.second->bytes_written();
+        shard.bytes_written.store(bytes, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace fr
@@ -0,0 +1,264 @@
+// Top-level recording pipeline:
+//
+//   source threads --(frame extraction)--> SPSC rings --(time merge)--> writer thread
+//                                                                        |  seal
+//                                                          retention <---+---> compactor
+//                                                                  \      |      /
+//                                                                   +-- catalog --+
+//
+// Chunk encoding and compression for all writers run on one shared
+// work-stealing TaskPool. A separate health thread (health.hpp) watches the
+// writers' progress and queues and reports liveness to systemd and the
+// flight controller. A thermal governor (thermal.hpp) switches the pipeline
+// into a cheaper hot mode while the CPU is hot or clocked down.
+//
+// When free space falls below the retention headroom faster than reclaim can
+// restore it, the writers stop storing what can be spared: low-priority data
+// is thinned as in hot mode and, with raw capture on, whole frames are
+// skipped (the raw bytes hold them) until the headroom is back. Every seal
+// in the meantime triggers a reclaim pass instead of waiting for the next
+// poll.
+//
+// With vehicle_shards > 0 the queue/writer pair is replicated: records are
+// routed by MAVLink system id to one of N shards, and each shard thread owns
+// the SegmentWriters of its vehicles outright, so vehicles never contend on
+// a common queue or writer.
+//
+// With sessions enabled (session.hpp) a flight is a sortie rather than a
+// power cycle: arming opens a flight, pre-roll included, and the writer hands
+// it to the I/O pool for sealing once disarmed and the post-roll is over.
+//
+// start() returns as soon as the threads exist; nothing on the startup path
+// waits for a device, so recording begins with whichever source is first to
+// produce data.
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "catalog.hpp"
+#include "compactor.hpp"
+#include "config.hpp"
+#include "decoder.hpp"
+#include "dronecan.hpp"
+#include "gnss.hpp"
+#include "hash_chain.hpp"
+#include "health.hpp"
+#include "mavlink.hpp"
+#include "record_queue.hpp"
+#include "retention.hpp"
+#include "segment_writer.hpp"
+#include "session.hpp"
+#include "source.hpp"
+#include "source_manager.hpp"
+#include "summary_stats.hpp"
+#include "task_pool.hpp"
+#include "thermal.hpp"
+
+namespace fr {
+
+// Raw link capture: every read from a byte-oriented source (serial, UDP) is
+// stored as-is on channel::kRawStream, so framing and decoding can be deferred
+// to `fr-recorder decode` on a ground workstation. CAN is always stored raw.
+enum class RawCapture {
+    Off,   // frames and decoded fields only
+    Also,  // raw bytes in addition to frames
+    Only,  // raw bytes only: no framing or decoding on the vehicle
+};
+
+struct RecorderConfig {
+    std::string root;
+    // Optional compiled config. Its sources are appended to `sources`, its
+    // rules drive decoding, and its bytes are embedded in every segment.
+    std::shared_ptr<const CompiledConfig> config;
+    std::vector<SourceSpec> sources;
+    SourceRetryPolicy source_policy;
+    SourceOptions source_options;
+    SegmentWriterConfig writer;   // root and flight_id are filled in by the recorder
+    RetentionConfig retention;    // root is filled in by the recorder
+    HealthConfig health;
+    // Thermal/power governor; off: the settings above apply throughout.
+    bool thermal_governor = true;
+    ThermalConfig thermal;
+    // Hot mode: zstd chunks fall back to LZ4, chunk and write-back sizes grow
+    // by hot_flush_scale, and config messages/channels with priority >=
+    // hot_thin_priority are stored at most once per hot_thin_interval. The
+    // thinning also applies while disk headroom is low.
+    unsigned hot_flush_scale = 4;
+    std::chrono::milliseconds hot_thin_interval{200};
+    uint8_t hot_thin_priority = 2;
+    // Signs each flight's MANIFEST (hash_chain.hpp); null: unsigned manifest.
+    std::shared_ptr<const MasterKey> manifest_key;
+    bool compact = true;
+    RawCapture raw_capture = RawCapture::Off;
+    // 0: a single writer and flight directory for everything. N > 0: shard by
+    // MAVLink system id over N writer threads; every vehicle is recorded as
+    // its own flight (<flight-id>-sysNNN). Non-MAVLink data goes to sys000.
+    unsigned vehicle_shards = 0;
+    unsigned worker_threads = 0;       // encode/compress pool; 0: one per CPU
+    size_t queue_capacity = 1u << 16;  // per shard, split between the sources
+    // How long the merge waits for a quiet source before releasing newer
+    // records from the others (record_queue.hpp).
+    std::chrono::milliseconds reorder_window{50};
+    // One flight per sortie. Needs MAVLink framing, so not with RawCapture::
+    // Only. With vehicle_shards, sys000 (non-MAVLink data) belongs to no
+    // vehicle and stays one flight per power cycle.
+    SessionConfig sessions;
+};
+
+class Recorder {
+public:
+    struct Stats {
+        uint64_t records = 0;  // written to a segment
+        uint64_t dropped = 0;  // ingest queue full
+        uint64_t write_failed = 0;  // lost to a segment that could not be opened or written
+        uint64_t late = 0;  // released out of time order by the merge
+        SourceCounters link;  // summed over sources
+        uint64_t bytes_written = 0;
+        uint64_t vehicles = 0;
+        uint64_t sessions = 0;
+        uint64_t pre_roll_discarded = 0;  // records outside any sortie, not kept
+        int64_t first_data_ns = 0;
+    };
+
+    explicit Recorder(RecorderConfig cfg);
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    void start();
+    void stop();
+
+    // Per power cycle; with sessions, each sortie gets its own id on arming.
+    const std::string& flight_id() const { return flight_id_; }
+    Stats stats() const;
+    std::vector<SourceManager::Status> source_status() const { return sources_->status(); }
+    // Lock-light snapshot for the health thread; safe while writers are blocked.
+    HealthSample health_sample() const;
+    HealthState health_state() const { return health_->state(); }
+    PowerMode power_mode() const { return power_mode_.load(std::memory_order_relaxed); }
+
+private:
+    struct Session {
+        explicit Session(const SessionConfig& c) : pre_roll(c.pre_roll, c.pre_roll_bytes) {}
+        std::bitset<256> armed;  // system ids currently armed
+        bool open = false;
+        std::string flight_id;
+        int64_t id_s = 0;         // realtime second in flight_id; kept increasing
+        int64_t close_at_ns = 0;  // end of the post-roll; 0: none pending
+        SessionTimes times;
+        PreRoll pre_roll;         // while not open
+    };
+
+    struct Shard {
+        Shard(size_t producers, size_t capacity, std::chrono::nanoseconds window)
+            : queue(producers, capacity, window) {}
+        RecordQueue queue;
+        std::thread thread;
+        // Writers keyed by vehicle; touched only by this shard's thread
+        // (and by the constructor/stop() while that thread is not running).
+        std::unordered_map<uint8_t, std::unique_ptr<SegmentWriter>> writers;
+        std::atomic<uint64_t> records{0};
+        std::atomic<uint64_t> write_failed{0};
+        bool failing = false;  // the last write failed; shard thread only
+        std::atomic<uint64_t> bytes_written{0};
+        std::atomic<uint64_t> vehicles{0};
+        // CLOCK_MONOTONIC of the writer loop's last iteration and last
+        // non-empty batch, for stall detection.
+        std::atomic<int64_t> last_tick_ns{0};
+        std::atomic<int64_t> last_write_ns{0};
+        PowerMode applied_mode = PowerMode::Normal;  // as last pushed to `writers`
+        // Per-vehicle streaming statistics, same keys and ownership as `writers`.
+        std::unordered_map<uint8_t, FlightSummary> summaries;
+        // Same again, for vehicles whose flights follow sessions.
+        std::unordered_map<uint8_t, Session> sessions;
+        std::bitset<256> seen;  // vehicles counted in `vehicles`
+        std::atomic<uint64_t> sessions_opened{0};
+        std::atomic<uint64_t> pre_roll_discarded{0};
+    };
+
+    void on_data(size_t index, const uint8_t* data, size_t len, int64_t t_ns);
+    // `source` is the producing thread's source index.
+    void push(size_t source, Record&& r);
+    SegmentWriter& writer_for(Shard& shard, uint8_t vehicle);
+    void writer_loop(Shard& shard, size_t index);
+    // Counts the record in Shard::records, or in write_failed if its segment
+    // cannot be opened or written; never throws.
+    void write(Shard& shard, uint8_t vehicle, const Record& r);
+    // Seals the writer's last segment, counting what a failed seal loses.
+    void close_writer(Shard& shard, SegmentWriter& w);
+    bool sessioned(uint8_t vehicle) const { return cfg_.sessions.enabled && !(cfg_.vehicle_shards && vehicle == 0); }
+    // Writes `r`, buffers it as pre-roll, or acts on it as a session event.
+    void route(Shard& shard, uint8_t vehicle, Record&& r);
+    void open_session(Shard& shard, uint8_t vehicle, Session& s);
+    // Detaches the flight's writer and seals it on io_pool_.
+    void close_session(Shard& shard, uint8_t vehicle, Session& s);
+    void update_manifest(const std::string& flight_id);
+    // Final rewrite; `extras` (summary and session lines) sticks to the flight
+    // so that a late rewrite from a seal callback keeps it.
+    void finish_manifest(const std::string& flight_id, std::string extras);
+    // Takes the vehicle's summary (and session) lines for its final manifest.
+    std::string manifest_extras(Shard& shard, uint8_t vehicle);
+    void on_power_mode(PowerMode mode);
+    // Called by a writer thread whenever it sees the retention headroom state
+    // differ from low_disk_.
+    void on_headroom(bool ok);
+    void refresh_thinning();
+    void apply_power_mode(SegmentWriter& w, PowerMode mode) const;
+
+    RecorderConfig cfg_;
+    std::string flight_id_;
+    std::unordered_map<uint32_t, std::string> channel_names_;  // decoded channels, for summaries
+
+    std::unique_ptr<Catalog> catalog_;  // outlives everything that journals to it
+    std::unique_ptr<TaskPool> pool_;  // outlives the writers that use it
+    // Sealing and manifest rewrites block on fsync and on the catalogue lock.
+    // They get their own small pool: a back-pressured writer helps pool_
+    // with encode tasks and must not pick one of these up instead.
+    std::unique_ptr<TaskPool> io_pool_;
+    // Manifest rewrites run on io_pool_, off the writer threads; serialised
+    // by manifest_mu_ so a stale rewrite never lands after a newer one.
+    std::unique_ptr<TaskGroup> manifests_;
+    std::mutex manifest_mu_;
+    std::unordered_map<std::string, std::string> manifest_extras_;  // by flight, under manifest_mu_
+    // Every raw segment a flight's manifest has listed, by flight then name,
+    // under manifest_mu_. Retention drops reclaimed segments from the
+    // catalogue; the manifest keeps them so the chain still verifies.
+    std::unordered_map<std::string, std::map<std::string, ManifestSegment>> manifest_segments_;
+    // Sorties being sealed after disarm.
+    std::unique_ptr<TaskGroup> sealing_;
+    std::atomic<uint64_t> sealed_bytes_{0};
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::unique_ptr<RetentionManager> retention_;
+    std::unique_ptr<Compactor> compactor_;
+    std::unique_ptr<SourceManager> sources_;
+    std::unique_ptr<HealthMonitor> health_;
+    std::unique_ptr<ThermalGovernor> thermal_;
+    // Published by the governor thread; writers and decoders pick it up on
+    // their next batch or frame.
+    std::atomic<PowerMode> power_mode_{PowerMode::Normal};
+    std::atomic<bool> low_disk_{false};
+    std::atomic<int64_t> thin_ns_{0};  // from both of the above, under thin_mu_
+    std::mutex thin_mu_;
+    // One framer per source, touched only by that source's thread; GNSS
+    // sources (SourceSpec::protocol) use gnss_framers_ instead.
+    std::vector<MavlinkFramer> framers_;
+    std::vector<GnssFramer> gnss_framers_;
+    std::vector<std::unique_ptr<DroneCanReassembler>> dronecan_;  // null unless DroneCAN
+    std::vector<Decoder> decoders_;  // same, empty without a config
+    std::vector<SessionDetector> detectors_;  // same, empty without sessions
+
+    std::atomic<bool> running_{false};  // read by the writer threads
+    std::atomic<bool> stop_{false};
+};
+
+}  // namespace fr
@@ -0,0 +1,297 @@
+#include "replay.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "channels.hpp"
+#include "clock.hpp"
+#include "fs_util.hpp"
+#include "gnss.hpp"
+#include "log.hpp"
+#include "net_util.hpp"
+#include "raw_coverage.hpp"
+#include "segment_reader.hpp"
+#include "storage_layout.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr int64_t kMaxSleepNs = 100 * 1000000LL;  // bounds stop latency
+constexpr int kPollMs = 100;                       // same, while the pty consumer lags
+
+class UdpSink : public ReplaySink {
+public:
+    UdpSink(const std::string& host, uint16_t port)
+        : fd_(udp_connect(host, port)), name_("udp:" + host + ":" + std::to_string(port)) {}
+    ~UdpSink() override { ::close(fd_); }
+
+    bool write(const uint8_t* data, size_t len, const std::atomic<bool>&) override {
+        // ECONNREFUSED just means nobody is listening yet; keep going.
+        return send(fd_, data, len, MSG_NOSIGNAL) >= 0 || errno == ECONNREFUSED;
+    }
+    std::string describe() const override { return name_; }
+
+private:
+    int fd_;
+    std::string name_;
+};
+
+class PtySink : public ReplaySink {
+public:
+    explicit PtySink(const std::string& link) : link_(link) {
+        fd_ = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC | O_NONBLOCK);
+        if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "posix_openpt");
+        char name[128];
+        if (grantpt(fd_) != 0 || unlockpt(fd_) != 0 || ptsname_r(fd_, name, sizeof(name)) != 0) {
+            int err = errno;
+            ::close(fd_);
+            throw std::system_error(err, std::generic_category(), "pty setup");
+        }
+        slave_ = name;
+        // Raw line discipline so the consumer sees exactly the recorded bytes.
+        termios tio{};
+        if (tcgetattr(fd_, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fd_, TCSANOW, &tio);
+        }
+        if (!link_.empty()) {
+            ::unlink(link_.c_str());
+            if (symlink(slave_.c_str(), link_.c_str()) != 0) {
+                int err = errno;
+                ::close(fd_);
+                throw std::system_error(err, std::generic_category(), "symlink " + link_);
+            }
+        }
+    }
+    ~PtySink() override {
+        if (!link_.empty()) ::unlink(link_.c_str());
+        ::close(fd_);
+    }
+
+    bool write(const uint8_t* data, size_t len, const std::atomic<bool>& stop) override {
+        // Non-blocking: with nobody reading the slave the pty buffer fills
+        // and a blocking write would never see the stop request.
+        while (len) {
+            const ssize_t n = ::write(fd_, data, len);
+            if (n > 0) {
+                data += n;
+                len -= static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno != EAGAIN && errno != EIO) return false;
+            // EIO: no slave open yet. Either way, wait for a consumer.
+            if (stop.load()) return true;
+            pollfd p{fd_, POLLOUT, 0};
+            if (::poll(&p, 1, kPollMs) > 0 && !(p.revents & POLLOUT))
+                std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));
+        }
+        return true;
+    }
+    std::string describe() const override { return link_.empty() ? slave_ : link_ + " -> " + slave_; }
+
+private:
+    int fd_ = -1;
+    std::string slave_;
+    std::string link_;
+};
+
+bool replayable(uint32_t ch) {
+    switch (channel::family(ch)) {
+        case channel::kRawStream:
+        case channel::kMavlink:
+        case channel::kUbx:
+        case channel::kRtcm3: return true;
+        default: return false;
+    }
+}
+
+// One unit in replay order; points into the segment's decoded chunks.
+struct Unit {
+    int64_t t;
+    uint32_t channel;
+    uint32_t seq;  // position within its channel, keeps equal timestamps stable
+    const char* data;
+    uint32_t len;
+};
+
+}  // namespace
+
+std::unique_ptr<ReplaySink> make_replay_sink(const std::string& target) {
+    if (target == "pty" || target.rfind("pty:", 0) == 0)
+        return std::make_unique<PtySink>(target.size() > 4 ? target.substr(4) : "");
+    if (target.rfind("udp:", 0) == 0) {
+        size_t colon = target.rfind(':');
+        if (colon > 4)
+            return std::make_unique<UdpSink>(target.substr(4, colon - 4),
+                                             static_cast<uint16_t>(std::strtoul(target.c_str() + colon + 1, nullptr, 10)));
+    }
+    throw std::system_error(EINVAL, std::generic_category(), "replay target '" + target + "': expected udp:HOST:PORT or pty[:LINK]");
+}
+
+Replayer::Replayer(ReplayConfig cfg, std::unique_ptr<ReplaySink> sink) : cfg_(std::move(cfg)), sink_(std::move(sink)) {}
+
+bool Replayer::run(const std::atomic<bool>& stop) {
+    if (cfg_.flight_id.empty()) cfg_.flight_id = layout::latest_flight(cfg_.root);
+    if (cfg_.flight_id.empty()) {
+        error_ = "no flights under " + layout::flights_dir(cfg_.root);
+        return false;
+    }
+    const std::vector<std::string> segments = layout::raw_segment_paths(cfg_.root, cfg_.flight_id);
+    if (segments.empty()) {
+        error_ = "no raw segments in flight " + cfg_.flight_id;
+        return false;
+    }
+
+    FR_LOG_INFO("replay: flight %s, %zu segments -> %s", cfg_.flight_id.c_str(), segments.size(),
+                sink_->describe().c_str());
+    for (const auto& path : segments) {
+        if (stop.load()) break;
+        if (!replay_segment(path, stop)) return false;
+        stats_.segments++;
+    }
+    return true;
+}
+
+bool Replayer::select_source() {
+    if (cfg_.source.empty() || selected_ >= 0) return true;
+    for (size_t i = 0; i < sources_.size(); ++i)
+        if (sources_[i].name == cfg_.source || std::to_string(i) == cfg_.source) selected_ = static_cast<int>(i);
+    if (selected_ < 0) {
+        std::string names;
+        for (size_t i = 0; i < sources_.size(); ++i)
+            names += (i ? ", " : "") + std::to_string(i) + "=" + sources_[i].name;
+        error_ = "no source '" + cfg_.source + "' in flight " + cfg_.flight_id +
+                 (names.empty() ? " (no source table)" : " (has " + names + ")");
+        return false;
+    }
+    return true;
+}
+
+bool Replayer::replay_segment(const std::string& path, const std::atomic<bool>& stop) {
+    SegmentReader reader;
+    reader.set_key(cfg_.key);
+    if (!reader.open(path)) {
+        error_ = reader.error();
+        return false;
+    }
+    // A segment is at most a few tens of MB: decode its replayable chunks,
+    // then order all units across channels.
+    std::vector<ChunkData> chunks;
+    chunks.reserve(reader.index().size());
+    for (const auto& e : reader.index()) {
+        const bool table = e.channel == channel::make(channel::kMeta, channel::kMetaSources);
+        if (!table && (!replayable(e.channel) || e.kind != static_cast<uint8_t>(seg::ChunkKind::Blobs))) continue;
+        chunks.emplace_back();
+        if (!reader.read_chunk(e, &chunks.back())) {
+            // Skip damage rather than abort: the rest of the flight is still useful.
+            FR_LOG_WARN("replay: %s", reader.error().c_str());
+            chunks.pop_back();
+        } else if (table) {
+            const ChunkData& c = chunks.back();
+            if (!c.blob_len.empty()) sources_ = parse_source_table(c.blob_bytes.substr(0, c.blob_len[0]));
+            chunks.pop_back();
+        }
+    }
+    if (!select_source()) return false;
+    if (selected_ < 0 && !warned_merge_ && sources_.size() > 1) {
+        warned_merge_ = true;
+        FR_LOG_WARN("replay: %zu sources merged into one stream; pick one with --source", sources_.size());
+    }
+
+    RawCoverage coverage(&sources_);
+    for (const ChunkData& c : chunks)
+        if (channel::family(c.hdr.channel) == channel::kRawStream) coverage.add(c);
+    // Frames without raw bytes belong to the selected source only if no other
+    // source frames the same way.
+    bool frames_attributed[2] = {true, true};  // [gnss]
+    if (selected_ >= 0) {
+        const SourceSpec& sel = sources_[selected_];
+        const bool selected_gnss = gnss::accept_for(sel.protocol) != 0;
+        for (int gnss = 0; gnss < 2; ++gnss) {
+            size_t same = 0;
+            for (const SourceSpec& s : sources_)
+                same += s.kind != SourceKind::Can && (gnss::accept_for(s.protocol) != 0) == (gnss != 0);
+            frames_attributed[gnss] = sel.kind != SourceKind::Can && selected_gnss == (gnss != 0) && same == 1;
+        }
+    }
+
+    std::vector<Unit> units;
+    std::vector<std::pair<uint32_t, uint32_t>> channel_seq;  // channel -> units emitted so far
+    for (const ChunkData& c : chunks) {
+        const bool raw = channel::family(c.hdr.channel) == channel::kRawStream;
+        if (raw && selected_ >= 0 && channel::local(c.hdr.channel) != static_cast<uint32_t>(selected_)) continue;
+        const bool gnss_frame = !raw && channel::family(c.hdr.channel) != channel::kMavlink;
+        auto it = std::find_if(channel_seq.begin(), channel_seq.end(),
+                               [&](const std::pair<uint32_t, uint32_t>& p) { return p.first == c.hdr.channel; });
+        if (it == channel_seq.end()) it = channel_seq.insert(channel_seq.end(), {c.hdr.channel, 0});
+        size_t off = 0;
+        for (size_t i = 0; i < c.t.size(); ++i) {
+            const size_t at = off;
+            off += c.blob_len[i];
+            if (!raw) {
+                if (coverage.covers(c.hdr.channel, c.t[i])) continue;  // the raw bytes hold it
+                if (!frames_attributed[gnss_frame]) {
+                    stats_.unattributed++;
+                    continue;
+                }
+            }
+            units.push_back(Unit{c.t[i], c.hdr.channel, it->second++, c.blob_bytes.data() + at, c.blob_len[i]});
+        }
+    }
+    std::sort(units.begin(), units.end(), [](const Unit& a, const Unit& b) {
+        if (a.t != b.t) return a.t < b.t;
+        if (a.channel != b.channel) return a.channel < b.channel;
+        return a.seq < b.seq;
+    });
+
+    for (const Unit& u : units) {
+        if (!wait_until(u.t, stop)) return true;
+        if (!sink_->write(reinterpret_cast<const uint8_t*>(u.data), u.len, stop)) {
+            error_ = sink_->describe() + ": " + std::strerror(errno);
+            return false;
+        }
+        if (stop.load()) return true;
+        stats_.records++;
+        stats_.bytes += u.len;
+    }
+    return true;
+}
+
+bool Replayer::wait_until(int64_t t_ns, const std::atomic<bool>& stop) {
+    if (stop.load()) return false;
+    if (!started_) {
+        started_ = true;
+        t0_rec_ = t_ns;
+        t0_wall_ = monotonic_ns();
+    }
+    if (cfg_.speed <= 0) return true;
+    const int64_t due = t0_wall_ + static_cast<int64_t>(static_cast<double>(t_ns - t0_rec_) / cfg_.speed);
+    for (;;) {
+        const int64_t now = monotonic_ns();
+        if (now >= due) {
+            stats_.max_late_ns = std::max(stats_.max_late_ns, now - due);
+            return true;
+        }
+        if (stop.load()) return false;
+        const int64_t wake = std::min(due, now + kMaxSleepNs);
+        timespec ts{static_cast<time_t>(wake / 1000000000), static_cast<long>(wake % 1000000000)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+}
+
+}  // namespace fr
@@ -0,0 +1,91 @@
+// Re-emits a recorded flight's link traffic (raw stream bytes, and MAVLink,
+// UBX and RTCM3 frames) to a UDP peer or a pseudo-terminal, with the
+// original inter-arrival timing, N times faster, or as fast as possible.
+//
+// Raw bytes are the exact link traffic and win wherever they exist; a frame
+// is replayed only if no raw record holds it (raw_coverage.hpp), so sources
+// and spans captured without raw bytes still come through. One sink carries
+// one link: pick the source with `source`, or every source is merged. Frames
+// recorded without raw bytes do not say which source they came from; with a
+// source selected they are replayed only when it is the flight's one source
+// of that framing, and counted as unattributed otherwise.
+//
+// Records are ordered by (timestamp, channel, position in chunk), so a replay
+// of the same flight always produces the same byte sequence. Used to drive the
+// recorder and downstream consumers with real traffic shapes.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "segment_crypto.hpp"
+#include "source.hpp"
+
+namespace fr {
+
+// Destination for replayed bytes.
+class ReplaySink {
+public:
+    virtual ~ReplaySink() = default;
+    // One recorded unit (a frame, or one raw-stream read). False on failure.
+    // May wait for the consumer, but returns (true) soon after *stop is set.
+    virtual bool write(const uint8_t* data, size_t len, const std::atomic<bool>& stop) = 0;
+    // Where a consumer should connect, e.g. the pty slave path.
+    virtual std::string describe() const = 0;
+};
+
+// "udp:HOST:PORT" (one datagram per unit) or "pty[:LINK]" (a new pseudo-tty;
+// LINK, if given, becomes a symlink to its slave). Throws std::system_error.
+std::unique_ptr<ReplaySink> make_replay_sink(const std::string& target);
+
+struct ReplayConfig {
+    std::string root;
+    std::string flight_id;  // empty: the most recent flight
+    double speed = 1.0;     // 1: original timing, N: N times faster, 0: as fast as possible
+    std::string source;     // name or index in the flight's source table; empty: all sources
+    std::shared_ptr<const MasterKey> key;  // for encrypted flights
+};
+
+class Replayer {
+public:
+    struct Stats {
+        uint64_t segments = 0;
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        int64_t max_late_ns = 0;  // worst lateness against the schedule
+        uint64_t unattributed = 0;  // frames without raw bytes skipped: source unknown
+    };
+
+    Replayer(ReplayConfig cfg, std::unique_ptr<ReplaySink> sink);
+
+    // Replays the whole flight; returns early (true) once *stop is set.
+    // False with error() if the flight cannot be read or the sink fails.
+    bool run(const std::atomic<bool>& stop);
+
+    const std::string& flight_id() const { return cfg_.flight_id; }
+    const std::string& error() const { return error_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    bool replay_segment(const std::string& path, const std::atomic<bool>& stop);
+    // Resolves cfg_.source against the table; false with error_ if absent.
+    bool select_source();
+    bool wait_until(int64_t t_ns, const std::atomic<bool>& stop);
+
+    ReplayConfig cfg_;
+    std::unique_ptr<ReplaySink> sink_;
+    std::string error_;
+    Stats stats_;
+    std::vector<SourceSpec> sources_;  // the flight's source table
+    int selected_ = -1;                // index of cfg_.source, once resolved
+    bool warned_merge_ = false;
+    bool started_ = false;
+    int64_t t0_rec_ = 0;
+    int64_t t0_wall_ = 0;
+};
+
+}  // namespace fr
@@ -0,0 +1,376 @@
+#include "retention.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "catalog.hpp"
+#include "clock.hpp"
+#include "log.hpp"
+#include "storage_layout.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+
+int64_t stat_mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+}  // namespace
+
+RetentionManager::RetentionManager(RetentionConfig cfg) : cfg_(std::move(cfg)) {}
+
+RetentionManager::~RetentionManager() { stop(); }
+
+void RetentionManager::start() {
+    if (thread_.joinable()) return;
+    stop_.store(false);
+    thread_ = std::thread([this] { run(); });
+}
+
+void RetentionManager::stop() {
+    if (!thread_.joinable()) return;
+    stop_.store(true);
+    kick();
+    thread_.join();
+}
+
+void RetentionManager::notify_sealed(const std::string& flight_id, const std::string& segment, uint64_t bytes) {
+    std::lock_guard<std::mutex> lk(inbox_mu_);
+    inbox_.push_back(Event{Event::Kind::Sealed, flight_id, segment, bytes});
+}
+
+void RetentionManager::pin_flight(const std::string& flight_id) {
+    std::lock_guard<std::mutex> lk(inbox_mu_);
+    inbox_.push_back(Event{Event::Kind::Pin, flight_id, {}, 0});
+}
+
+void RetentionManager::unpin_flight(const std::string& flight_id) {
+    std::lock_guard<std::mutex> lk(inbox_mu_);
+    inbox_.push_back(Event{Event::Kind::Unpin, flight_id, {}, 0});
+}
+
+void RetentionManager::kick() {
+    {
+        std::lock_guard<std::mutex> lk(inbox_mu_);
+        kicked_ = true;
+    }
+    inbox_cv_.notify_one();
+}
+
+RetentionManager::Stats RetentionManager::stats() const {
+    std::lock_guard<std::mutex> lk(stats_mu_);
+    return stats_;
+}
+
+void RetentionManager::run() {
+    set_thread_name("fr-retention");
+    // Not idle priority: under the full CPU load that comes with a busy
+    // flight, an idle-class thread may never run, and the disk fills anyway.
+    set_maintenance_priority();
+    scan();
+
+    int64_t last_ns = monotonic_ns();
+    std::vector<Event> events;
+    while (!stop_.load()) {
+        {
+            std::unique_lock<std::mutex> lk(inbox_mu_);
+            inbox_cv_.wait_for(lk, cfg_.poll_interval, [this] { return kicked_ || stop_.load(); });
+            kicked_ = false;
+            events.swap(inbox_);
+        }
+        if (stop_.load()) break;
+
+        uint64_t sealed = 0;
+        for (const Event& ev : events) {
+            apply(ev);
+            if (ev.kind == Event::Kind::Sealed) sealed += ev.bytes;
+        }
+        events.clear();
+
+        int64_t now_ns = monotonic_ns();
+        double dt = static_cast<double>(now_ns - last_ns) / 1e9;
+        last_ns = now_ns;
+        if (dt > 0) sealed_rate_bps_ = 0.8 * sealed_rate_bps_ + 0.2 * (static_cast<double>(sealed) / dt);
+
+        // Look two poll intervals ahead so reclaim finishes before the writer
+        // actually reaches the headroom line, not after.
+        uint64_t free = query_free_bytes();
+        double horizon_s = 2.0 * std::chrono::duration<double>(cfg_.poll_interval).count();
+        uint64_t projected_use = static_cast<uint64_t>(sealed_rate_bps_ * horizon_s);
+        uint64_t projected_free = free > projected_use ? free - projected_use : 0;
+
+        if (projected_free < cfg_.headroom_bytes) {
+            reclaim(cfg_.headroom_bytes + cfg_.hysteresis_bytes - projected_free);
+            free = query_free_bytes();
+        }
+        headroom_ok_.store(free >= cfg_.headroom_bytes, std::memory_order_relaxed);
+
+        if (cfg_.catalog) cfg_.catalog->compact_if_needed();
+
+        std::lock_guard<std::mutex> lk(stats_mu_);
+        stats_.free_bytes = free;
+        stats_.passes++;
+        uint64_t total = 0;
+        for (const auto& kv : flights_) total += kv.second.bytes;
+        stats_.catalogued_bytes = total;
+    }
+}
+
+void RetentionManager::scan() {
+    if (cfg_.catalog) {
+        for (const auto& f : cfg_.catalog->flights())
+            for (const auto& s : f.second.segments) add_segment(f.first, s.first, s.second.bytes, s.second.mtime_ns);
+        FR_LOG_INFO("retention: %zu flights from catalog", flights_.size());
+        return;
+    }
+    std::string flights = layout::flights_dir(cfg_.root);
+    DIR* top = opendir(flights.c_str());
+    if (!top) {
+        if (errno != ENOENT) FR_LOG_WARN("retention: cannot open %s: %s", flights.c_str(), std::strerror(errno));
+        return;
+    }
+    while (dirent* fe = readdir(top)) {
+        if (fe->d_name[0] == '.') continue;
+        std::string flight = fe->d_name;
+        int dfd = openat(dirfd(top), fe->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd < 0) continue;
+        DIR* d = fdopendir(dfd);
+        if (!d) {
+            close(dfd);
+            continue;
+        }
+        while (dirent* se = readdir(d)) {
+            std::string name = se->d_name;
+            if (!layout::is_sealed_segment(name) && !layout::is_open_segment(name)) continue;
+            struct stat st{};
+            if (fstatat(dfd, se->d_name, &st, 0) != 0) continue;
+            add_segment(flight, name, static_cast<uint64_t>(st.st_blocks) * 512, stat_mtime_ns(st));
+        }
+        closedir(d);
+    }
+    closedir(top);
+    FR_LOG_INFO("retention: catalogued %zu flights under %s", flights_.size(), flights.c_str());
+}
+
+void RetentionManager::apply(const Event& ev) {
+    switch (ev.kind) {
+        case Event::Kind::Sealed: {
+            // The writer renames x.frs.open -> x.frs; forget the open entry.
+            auto it = flights_.find(ev.flight);
+            if (it != flights_.end()) {
+                auto open = it->second.segments.find(ev.segment + layout::kOpenSuffix);
+                if (open != it->second.segments.end()) {
+                    it->second.bytes -= open->second.bytes;
+                    it->second.segments.erase(open);
+                }
+            }
+            add_segment(ev.flight, ev.segment, ev.bytes, realtime_ns());
+            break;
+        }
+        case Event::Kind::Pin:
+            pinned_.insert(ev.flight);
+            break;
+        case Event::Kind::Unpin:
+            pinned_.erase(ev.flight);
+            break;
+    }
+}
+
+void RetentionManager::add_segment(const std::string& flight, const std::string& name, uint64_t bytes,
+                                   int64_t mtime_ns) {
+    FlightInfo& fi = flights_[flight];
+    SegmentInfo& si = fi.segments[name];
+    fi.bytes -= si.bytes;
+    si.bytes = bytes;
+    si.mtime_ns = mtime_ns;
+    fi.bytes += bytes;
+    if (fi.oldest_ns == 0 || mtime_ns < fi.oldest_ns) fi.oldest_ns = mtime_ns;
+}
+
+uint64_t RetentionManager::query_free_bytes() const {
+    struct statvfs vfs{};
+    if (statvfs(cfg_.root.c_str(), &vfs) != 0) return UINT64_MAX;
+    return static_cast<uint64_t>(vfs.f_bavail) * vfs.f_frsize;
+}
+
+bool RetentionManager::is_flagged(const std::string& flight) const {
+    std::string marker = layout::flight_dir(cfg_.root, flight) + "/" + layout::kKeepMarker;
+    return access(marker.c_str(), F_OK) == 0;
+}
+
+void RetentionManager::reclaim(uint64_t want_bytes) {
+    std::vector<std::pair<int64_t, std::string>> order;
+    for (const auto& kv : flights_) {
+        if (pinned_.count(kv.first) || is_flagged(kv.first)) continue;
+        order.emplace_back(kv.second.oldest_ns, kv.first);
+    }
+    std::sort(order.begin(), order.end());
+
+    uint64_t freed = 0;
+    auto remove_all = [&](const std::string& flight, const std::vector<std::string>& names) {
+        for (size_t i = 0; i < names.size(); i += cfg_.unlink_batch) {
+            size_t end = std::min(names.size(), i + cfg_.unlink_batch);
+            remove_batch(flight, std::vector<std::string>(names.begin() + i, names.begin() + end));
+        }
+    };
+
+    // Pass 1: compact. Raw segments whose rollups are complete can go first;
+    // queries then answer aggregates for them from the rollups (query.hpp).
+    for (const auto& victim : order) {
+        if (freed >= want_bytes || stop_.load()) break;
+        const std::string& flight = victim.second;
+        FlightInfo& fi = flights_[flight];
+        std::vector<std::string> names;
+        for (const auto& seg : fi.segments) {
+            if (freed >= want_bytes) break;
+            uint32_t seq = 0;
+            if (!layout::is_sealed_segment(seg.first) || layout::segment_tier(seg.first) != seg::Tier::Raw) continue;
+            if (!layout::parse_segment_seq(seg.first, &seq)) continue;
+            if (!fi.segments.count(layout::segment_name(seq, seg::Tier::Rollup1m))) continue;
+            names.push_back(seg.first);
+            freed += seg.second.bytes;
+        }
+        remove_all(flight, names);
+    }
+
+    // Pass 2: delete raw data. Oldest segments first, so a long flight gives
+    // up only as much of its head as needed. A segment still being written
+    // (or left open by a crash, holding its last seconds) is never a victim.
+    auto delete_pass = [&](bool rollups) {
+        for (const auto& victim : order) {
+            if (freed >= want_bytes || stop_.load()) break;
+            const std::string& flight = victim.second;
+            FlightInfo& fi = flights_[flight];
+            std::vector<std::string> names;
+            for (const auto& seg : fi.segments) {
+                if (freed >= want_bytes) break;
+                if (!layout::is_sealed_segment(seg.first)) continue;
+                if ((layout::segment_tier(seg.first) != seg::Tier::Raw) != rollups) continue;
+                names.push_back(seg.first);
+                freed += seg.second.bytes;
+            }
+            remove_all(flight, names);
+            if (fi.segments.empty()) {
+                remove_flight_dir(flight);
+                flights_.erase(flight);
+            }
+        }
+    };
+    delete_pass(false);
+    // Pass 3: rollups, the last record of the flights whose raw data is gone.
+    delete_pass(true);
+    if (freed == 0) {
+        FR_LOG_DEBUG("retention: below headroom but nothing reclaimable");
+        return;
+    }
+    FR_LOG_INFO("retention: reclaimed %llu bytes (wanted %llu)", static_cast<unsigned long long>(freed),
+                static_cast<unsigned long long>(want_bytes));
+}
+
+uint64_t RetentionManager::remove_batch(const std::string& flight, const std::vector<std::string>& names) {
+    FlightInfo& fi = flights_[flight];
+    std::string dir = layout::flight_dir(cfg_.root, flight);
+    int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) {
+        // Directory vanished under us (manual cleanup); just drop the entries.
+        for (const auto& n : names) {
+            auto it = fi.segments.find(n);
+            if (it == fi.segments.end()) continue;
+            fi.bytes -= it->second.bytes;
+            fi.segments.erase(it);
+        }
+        if (cfg_.catalog) cfg_.catalog->remove_segments(flight, names);
+        return 0;
+    }
+
+    uint64_t removed_bytes = 0;
+    uint64_t removed = 0;
+    std::vector<std::string> gone;
+    for (const auto& n : names) {
+        auto it = fi.segments.find(n);
+        if (it == fi.segments.end()) continue;
+        uint64_t bytes = it->second.bytes;
+        if (bytes > cfg_.punch_slice_bytes) release_blocks(dfd, n, bytes);
+        if (unlinkat(dfd, n.c_str(), 0) == 0 || errno == ENOENT) {
+            removed_bytes += bytes;
+            removed++;
+            fi.bytes -= bytes;
+            fi.segments.erase(it);
+            gone.push_back(n);
+        } else {
+            FR_LOG_WARN("retention: unlink %s/%s: %s", dir.c_str(), n.c_str(), std::strerror(errno));
+        }
+    }
+    // One directory sync per batch instead of one per file.
+    fsync(dfd);
+    close(dfd);
+    if (cfg_.catalog) cfg_.catalog->remove_segments(flight, gone);
+
+    fi.oldest_ns = 0;
+    for (const auto& seg : fi.segments)
+        if (fi.oldest_ns == 0 || seg.second.mtime_ns < fi.oldest_ns) fi.oldest_ns = seg.second.mtime_ns;
+
+    std::lock_guard<std::mutex> lk(stats_mu_);
+    stats_.reclaimed_bytes += removed_bytes;
+    stats_.segments_removed += removed;
+    return removed_bytes;
+}
+
+void RetentionManager::release_blocks(int dirfd, const std::string& name, uint64_t bytes) {
+    int fd = openat(dirfd, name.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    // Free extents from the tail in bounded slices. A single unlink of a
+    // multi-GB file can hold the journal long enough to stall the writer's
+    // next fsync; slicing spreads that cost across many short operations.
+    off_t end = static_cast<off_t>(bytes);
+    const off_t slice = static_cast<off_t>(cfg_.punch_slice_bytes);
+    while (end > 0 && !stop_.load()) {
+        off_t start = end > slice ? end - slice : 0;
+        int rc = -1;
+        if (punch_supported_) {
+            rc = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, end - start);
+            if (rc != 0 && (errno == EOPNOTSUPP || errno == ENOSYS)) punch_supported_ = false;
+        }
+        if (!punch_supported_) rc = ftruncate(fd, start);
+        if (rc != 0) break;
+        end = start;
+    }
+    close(fd);
+}
+
+void RetentionManager::remove_flight_dir(const std::string& flight) {
+    std::string dir = layout::flight_dir(cfg_.root, flight);
+    int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        if (DIR* d = fdopendir(dfd)) {
+            // Remaining entries are per-flight metadata sidecars.
+            while (dirent* e = readdir(d)) {
+                if (e->d_name[0] == '.' && (e->d_name[1] == '\0' || (e->d_name[1] == '.' && e->d_name[2] == '\0')))
+                    continue;
+                unlinkat(dfd, e->d_name, 0);
+            }
+            closedir(d);
+        } else {
+            close(dfd);
+        }
+    }
+    if (rmdir(dir.c_str()) != 0 && errno != ENOENT) {
+        FR_LOG_WARN("retention: rmdir %s: %s", dir.c_str(), std::strerror(errno));
+        return;
+    }
+    if (cfg_.catalog) cfg_.catalog->remove_flight(flight);
+    FR_LOG_INFO("retention: removed flight %s", flight.c_str());
+    std::lock_guard<std::mutex> lk(stats_mu_);
+    stats_.flights_removed++;
+}
+
+}  // namespace fr
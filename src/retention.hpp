@@ -0,0 +1,129 @@
+// Storage quota manager. Keeps a catalogue of sealed segments per flight and,
+// when free space falls below the configured headroom, reclaims the oldest
+// unflagged flights from a background thread: first by dropping raw segments
+// that already have rollups (compaction), then raw segments outright, and
+// rollups last. Segments still open are never reclaimed.
+//
+// The writer only ever calls the notify_* hooks, which append to an inbox under
+// a short lock and never touch the filesystem. All stat/unlink/punch work runs
+// on the retention thread at normal CPU and lowest best-effort I/O priority,
+// so reclaim keeps pace even when the CPU is saturated. With a Catalog the
+// startup inventory comes from it instead of a directory walk, removals are
+// journaled, and the catalogue is compacted from this thread.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fr {
+
+class Catalog;
+
+struct RetentionConfig {
+    std::string root;
+    // Reclaim whenever (projected) free space drops below this.
+    uint64_t headroom_bytes = 1ull << 30;
+    // Once reclaiming, continue until free space is this far above headroom so
+    // we do not oscillate around the threshold one segment at a time.
+    uint64_t hysteresis_bytes = 256ull << 20;
+    std::chrono::milliseconds poll_interval{500};
+    // Unlinks are grouped per flight directory and followed by one dir fsync.
+    size_t unlink_batch = 32;
+    // Files larger than this are hole-punched in slices of this size before
+    // being unlinked, bounding the time any single fs operation holds the journal.
+    uint64_t punch_slice_bytes = 32ull << 20;
+    Catalog* catalog = nullptr;  // optional; must outlive the manager
+};
+
+class RetentionManager {
+public:
+    struct Stats {
+        uint64_t free_bytes = 0;
+        uint64_t catalogued_bytes = 0;
+        uint64_t reclaimed_bytes = 0;
+        uint64_t segments_removed = 0;
+        uint64_t flights_removed = 0;
+        uint64_t passes = 0;
+    };
+
+    explicit RetentionManager(RetentionConfig cfg);
+    ~RetentionManager();
+
+    RetentionManager(const RetentionManager&) = delete;
+    RetentionManager& operator=(const RetentionManager&) = delete;
+
+    void start();
+    void stop();
+
+    // Writer-side hooks. Constant time, no syscalls.
+    void notify_sealed(const std::string& flight_id, const std::string& segment, uint64_t bytes);
+    void pin_flight(const std::string& flight_id);
+    void unpin_flight(const std::string& flight_id);
+
+    // False while free space is below headroom and reclaim has not caught up.
+    // A single relaxed load, safe to poll per segment from the writer.
+    bool headroom_ok() const { return headroom_ok_.load(std::memory_order_relaxed); }
+
+    // Wakes the retention thread for an immediate pass.
+    void kick();
+
+    Stats stats() const;
+
+private:
+    struct SegmentInfo {
+        uint64_t bytes = 0;
+        int64_t mtime_ns = 0;
+    };
+    struct FlightInfo {
+        std::map<std::string, SegmentInfo> segments;  // ordered by name == by sequence
+        uint64_t bytes = 0;
+        int64_t oldest_ns = 0;
+    };
+    struct Event {
+        enum class Kind { Sealed, Pin, Unpin } kind;
+        std::string flight;
+        std::string segment;
+        uint64_t bytes;
+    };
+
+    void run();
+    void scan();
+    void apply(const Event& ev);
+    void add_segment(const std::string& flight, const std::string& name, uint64_t bytes, int64_t mtime_ns);
+    uint64_t query_free_bytes() const;
+    void reclaim(uint64_t want_bytes);
+    uint64_t remove_batch(const std::string& flight, const std::vector<std::string>& names);
+    void release_blocks(int dirfd, const std::string& name, uint64_t bytes);
+    void remove_flight_dir(const std::string& flight);
+    bool is_flagged(const std::string& flight) const;
+
+    const RetentionConfig cfg_;
+
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> headroom_ok_{true};
+
+    mutable std::mutex inbox_mu_;
+    std::condition_variable inbox_cv_;
+    std::vector<Event> inbox_;
+    bool kicked_ = false;
+
+    // Owned by the retention thread.
+    std::map<std::string, FlightInfo> flights_;
+    std::set<std::string> pinned_;
+    double sealed_rate_bps_ = 0.0;  // EWMA of sealed bytes per second
+    bool punch_supported_ = true;
+
+    mutable std::mutex stats_mu_;
+    Stats stats_;
+};
+
+}  // namespace fr
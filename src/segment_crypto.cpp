@@ -0,0 +1,102 @@
+#include "segment_crypto.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+
+#include "fs_util.hpp"
+#include "sha256.hpp"
+
+namespace fr {
+
+namespace {
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+Sha256Digest segment_key(const MasterKey& key, const seg::FileHeader& hdr) {
+    uint8_t info[6 + sizeof(hdr.flight_id) + sizeof(hdr.seq) + 1];
+    std::memcpy(info, "FRSEG1", 6);
+    std::memcpy(info + 6, hdr.flight_id, sizeof(hdr.flight_id));
+    std::memcpy(info + 6 + sizeof(hdr.flight_id), &hdr.seq, sizeof(hdr.seq));
+    info[sizeof(info) - 1] = hdr.tier;
+    return hmac_sha256(key.bytes.data(), key.bytes.size(), info, sizeof(info));
+}
+
+void make_nonce(uint32_t salt, uint64_t counter, uint8_t nonce[AesGcm::kNonceBytes]) {
+    std::memcpy(nonce, &salt, sizeof(salt));
+    std::memcpy(nonce + sizeof(salt), &counter, sizeof(counter));
+}
+
+}  // namespace
+
+MasterKey::~MasterKey() {
+    volatile uint8_t* p = bytes.data();
+    for (size_t i = 0; i < bytes.size(); ++i) p[i] = 0;
+}
+
+std::shared_ptr<const MasterKey> load_master_key(const std::string& path) {
+    std::string text;
+    if (!read_file(path, &text)) throw std::system_error(errno, std::generic_category(), "key file " + path);
+    auto key = std::make_shared<MasterKey>();
+    if (text.size() == key->bytes.size()) {
+        std::memcpy(key->bytes.data(), text.data(), text.size());
+    } else {
+        size_t n = 0;
+        int hi = -1;
+        for (char c : text) {
+            if (std::isspace(static_cast<unsigned char>(c))) continue;
+            const int d = hex_digit(c);
+            if (d < 0 || n == key->bytes.size()) {
+                n = key->bytes.size() + 1;
+                break;
+            }
+            if (hi < 0) {
+                hi = d;
+            } else {
+                key->bytes[n++] = static_cast<uint8_t>(hi << 4 | d);
+                hi = -1;
+            }
+        }
+        if (n != key->bytes.size() || hi >= 0)
+            throw std::system_error(EINVAL, std::generic_category(), "key file " + path + ": expected 32 bytes or 64 hex digits");
+    }
+    volatile char* t = &text[0];
+    for (size_t i = 0; i < text.size(); ++i) t[i] = 0;
+    const Sha256Digest d = Sha256::hash(key->bytes.data(), key->bytes.size());
+    std::memcpy(key->id.data(), d.data(), key->id.size());
+    return key;
+}
+
+ChunkCipher::ChunkCipher(const MasterKey& key, const seg::FileHeader& hdr)
+    : gcm_(segment_key(key, hdr).data()), salt_(hdr.nonce_salt) {}
+
+void ChunkCipher::seal(const seg::ChunkHeader& hdr, uint64_t counter, std::string* payload) const {
+    const size_t n = payload->size();
+    std::string out(AesGcm::kNonceBytes + n + AesGcm::kTagBytes, '\0');
+    auto* p = reinterpret_cast<uint8_t*>(&out[0]);
+    make_nonce(salt_, counter, p);
+    gcm_.encrypt(p, &hdr, offsetof(seg::ChunkHeader, stored_len), payload->data(), n, p + AesGcm::kNonceBytes,
+                 p + AesGcm::kNonceBytes + n);
+    payload->swap(out);
+}
+
+bool ChunkCipher::open(const seg::ChunkHeader& hdr, const char* stored, size_t len, std::string* out) const {
+    if (len < kOverhead) return false;
+    const auto* p = reinterpret_cast<const uint8_t*>(stored);
+    const size_t n = len - kOverhead;
+    out->resize(n);
+    if (gcm_.decrypt(p, &hdr, offsetof(seg::ChunkHeader, stored_len), p + AesGcm::kNonceBytes, n,
+                     p + AesGcm::kNonceBytes + n, reinterpret_cast<uint8_t*>(&(*out)[0])))
+        return true;
+    out->clear();
+    return false;
+}
+
+}  // namespace fr
@@ -0,0 +1,55 @@
+// Encryption at rest for segments.
+//
+// One 256-bit master key per installation. Every segment gets its own AES-256
+// key, HMAC-SHA-256(master, flight id | seq | tier), so a nonce can only
+// repeat if the same flight, sequence and tier were written twice; the random
+// per-segment nonce salt covers that case too. Whole chunks are sealed after
+// compression, on the pool alongside encoding, so the ingest path never sees
+// the cipher. The chunk header (minus lengths and checksums) is authenticated
+// data, so chunks cannot be moved between channels or time ranges unnoticed.
+// payload_crc still covers the stored bytes, so `verify` and recovery scans
+// work without the key.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "aes_gcm.hpp"
+#include "segment_format.hpp"
+
+namespace fr {
+
+struct MasterKey {
+    std::array<uint8_t, AesGcm::kKeyBytes> bytes{};
+    std::array<uint8_t, 8> id{};  // first bytes of SHA-256(key); stored in every file header
+
+    ~MasterKey();
+};
+
+// Reads a key file holding 32 raw bytes or 64 hex digits (whitespace
+// ignored). Throws std::system_error if it is unreadable or malformed.
+std::shared_ptr<const MasterKey> load_master_key(const std::string& path);
+
+// Cipher for the chunks of one segment.
+class ChunkCipher {
+public:
+    static constexpr size_t kOverhead = AesGcm::kNonceBytes + AesGcm::kTagBytes;
+
+    // `hdr` must carry flight id, seq, tier and nonce salt.
+    ChunkCipher(const MasterKey& key, const seg::FileHeader& hdr);
+
+    // Replaces *payload with nonce | ciphertext | tag. `hdr` must be complete
+    // up to t_last (flags included); `counter` is unique within the segment.
+    void seal(const seg::ChunkHeader& hdr, uint64_t counter, std::string* payload) const;
+    // Inverse of seal(); false if the chunk fails authentication.
+    bool open(const seg::ChunkHeader& hdr, const char* stored, size_t len, std::string* out) const;
+
+private:
+    AesGcm gcm_;
+    uint32_t salt_;
+};
+
+}  // namespace fr
@@ -0,0 +1,130 @@
+#include "segment_format.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace fr {
+namespace seg {
+
+namespace {
+
+constexpr int kBloomHashes = 3;
+
+bool integral(double x, int64_t* k) {
+    // Exactly representable range, so the cast cannot overflow.
+    if (!(x >= -9.0e18 && x <= 9.0e18) || x != std::floor(x)) return false;
+    *k = static_cast<int64_t>(x);
+    return true;
+}
+
+// splitmix64 finaliser; each byte of the result picks one of the 256 bits.
+uint64_t mix(int64_t k) {
+    uint64_t z = static_cast<uint64_t>(k) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void bloom_set(uint64_t* bloom, int64_t k) {
+    const uint64_t h = mix(k);
+    for (int i = 0; i < kBloomHashes; ++i) {
+        const unsigned bit = (h >> (8 * i)) & 0xff;
+        bloom[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+bool bloom_test(const uint64_t* bloom, int64_t k) {
+    const uint64_t h = mix(k);
+    for (int i = 0; i < kBloomHashes; ++i) {
+        const unsigned bit = (h >> (8 * i)) & 0xff;
+        if (!(bloom[bit >> 6] & (1ULL << (bit & 63)))) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int64_t tier_period_ns(Tier tier) {
+    switch (tier) {
+        case Tier::Raw: return 0;
+        case Tier::Rollup1s: return 1000000000LL;
+        case Tier::Rollup10s: return 10000000000LL;
+        case Tier::Rollup1m: return 60000000000LL;
+    }
+    return 0;
+}
+
+Tier tier_for_span(int64_t span_ns, int64_t max_points) {
+    constexpr int64_t kRawSpanNs = 60LL * 1000000000;
+    if (span_ns <= kRawSpanNs) return Tier::Raw;
+    for (int t = 1; t < kTierCount; ++t) {
+        auto tier = static_cast<Tier>(t);
+        if (span_ns / tier_period_ns(tier) <= max_points) return tier;
+    }
+    return Tier::Rollup1m;
+}
+
+const char* tier_suffix(Tier tier) {
+    switch (tier) {
+        case Tier::Raw: return "";
+        case Tier::Rollup1s: return "r1s";
+        case Tier::Rollup10s: return "r10s";
+        case Tier::Rollup1m: return "r1m";
+    }
+    return "";
+}
+
+void fill_sample_stats(const double* v, size_t n, IndexEntry* e) {
+    double lo = std::numeric_limits<double>::quiet_NaN(), hi = lo;
+    uint32_t nulls = 0;
+    bool discrete = true;
+    uint64_t bloom[kBloomWords] = {};
+    for (size_t i = 0; i < n; ++i) {
+        const double x = v[i];
+        if (!std::isfinite(x)) {
+            nulls++;
+            continue;
+        }
+        if (std::isnan(lo) || x < lo) lo = x;
+        if (std::isnan(hi) || x > hi) hi = x;
+        int64_t k;
+        if (discrete && integral(x, &k))
+            bloom_set(bloom, k);
+        else
+            discrete = false;
+    }
+    e->v_min = lo;
+    e->v_max = hi;
+    e->null_count = nulls;
+    e->flags = kIndexNullCount;
+    // Past half full the false-positive rate climbs quickly (continuous
+    // signals that happen to be integers); such a filter is not worth storing.
+    int bits = 0;
+    for (uint64_t w : bloom) bits += __builtin_popcountll(w);
+    if (discrete && bits <= kBloomWords * 32) {
+        std::copy(bloom, bloom + kBloomWords, e->bloom);
+        e->flags |= kIndexBloom;
+    } else {
+        std::fill(e->bloom, e->bloom + kBloomWords, 0);
+    }
+}
+
+void make_opaque(IndexEntry* e) {
+    e->flags = kIndexOpaque;
+    e->v_min = -std::numeric_limits<double>::infinity();
+    e->v_max = std::numeric_limits<double>::infinity();
+    e->null_count = 0;
+    for (auto& w : e->bloom) w = 0;
+}
+
+bool may_contain(const IndexEntry& e, double v) {
+    if (!(v >= e.v_min && v <= e.v_max)) return false;  // also: no finite values
+    if (!(e.flags & kIndexBloom)) return true;
+    int64_t k;
+    // The filter exists only if every finite value is an integer.
+    return integral(v, &k) && bloom_test(e.bloom, k);
+}
+
+}  // namespace seg
+}  // namespace fr
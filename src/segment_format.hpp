@@ -0,0 +1,195 @@
+// On-disk segment format. A segment is a self-describing file:
+//
+//   FileHeader | Chunk* | IndexEntry[n] | Trailer
+//
+// Each chunk holds a batch of records for one channel, stored column-wise
+// (all timestamps, then all values). The index at the end lets readers jump
+// straight to the chunks they need; if the trailer is missing (power loss
+// before seal) the chunks can still be recovered by a forward scan because
+// every chunk header carries a magic and a payload checksum.
+//
+// Besides time range and value bounds, every index entry carries the chunk's
+// null (non-finite) count and, for chunks of discrete values such as flight
+// modes or error codes, a small bloom filter, so a reader can rule a chunk
+// out for "value == X" without touching it.
+//
+// Samples chunks store their values as double unless the channel declares a
+// narrower storage type (float, half, bfloat16 or fixed point, see
+// value_storage.hpp); readers widen them back, and index statistics describe
+// the widened values, so nothing downstream sees the difference.
+//
+// Rollup tiers use exactly the same layout with ChunkKind::Rollup chunks, so
+// one reader serves raw and downsampled data alike.
+//
+// Encrypted segments (kFileEncrypted, see segment_crypto.hpp) keep this
+// layout; only chunk payloads are sealed, and index entries withhold value
+// statistics. Channel ids, counts and time ranges stay readable.
+//
+// All integers are little-endian; the structs are written as-is.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fr {
+namespace seg {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "segment format assumes a little-endian host");
+
+constexpr char kFileMagic[8] = {'F', 'R', 'S', 'E', 'G', '0', '1', '\n'};
+constexpr char kTrailerMagic[8] = {'F', 'R', 'S', 'E', 'G', 'E', 'N', 'D'};
+constexpr uint32_t kChunkMagic = 0x4b435246;  // "FRCK"
+constexpr uint16_t kVersion = 1;  // anything else is rejected
+
+enum class Tier : uint8_t {
+    Raw = 0,
+    Rollup1s = 1,
+    Rollup10s = 2,
+    Rollup1m = 3,
+};
+constexpr int kTierCount = 4;
+
+// Bucket width of a rollup tier; 0 for raw.
+int64_t tier_period_ns(Tier tier);
+// Tier a reader should use to cover `span_ns` with at most `max_points`
+// values per channel. Spans under a minute always read raw data.
+Tier tier_for_span(int64_t span_ns, int64_t max_points);
+// File-name infix for a tier: "" for raw, "r1s", "r10s", "r1m".
+const char* tier_suffix(Tier tier);
+
+enum class ChunkKind : uint8_t {
+    Samples = 0,  // int64 t[n], values in the chunk's ValueStorage
+    Blobs = 1,    // int64 t[n], uint32 len[n], bytes
+    Rollup = 2,   // int64 t[n], double min[n], max[n], mean[n], last[n], uint32 count[n]
+};
+
+// Applies to the whole chunk payload; payload_crc covers the stored bytes.
+enum class Codec : uint8_t {
+    None = 0,
+    Lz4 = 1,   // LZ4 block format
+    Zstd = 2,  // only when built with FR_HAVE_ZSTD
+};
+
+// How a Samples chunk stores its values. Fixed point is relative to the
+// chunk: v = base + q * step, with the most negative q meaning non-finite.
+enum class ValueStorage : uint8_t {
+    F64 = 0,      // double v[n]
+    F32 = 1,      // float v[n]
+    F16 = 2,      // IEEE binary16 v[n]
+    BF16 = 3,     // bfloat16 v[n]
+    Fixed16 = 4,  // double step, double base, int16 q[n]
+    Fixed32 = 5,  // double step, double base, int32 q[n]
+};
+
+#pragma pack(push, 1)
+
+enum FileFlags : uint8_t {
+    kFileEncrypted = 1 << 0,  // chunk payloads are AES-256-GCM sealed
+};
+
+struct FileHeader {
+    char magic[8];
+    uint16_t version;
+    uint8_t tier;
+    uint8_t flags;  // FileFlags
+    uint32_t seq;
+    int64_t created_realtime_ns;
+    char flight_id[24];
+    uint8_t key_id[8];    // encrypted only: identifies the master key
+    uint32_t nonce_salt;  // encrypted only: random, mixed into every chunk nonce
+    uint8_t reserved[4];
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t channel;
+    uint8_t kind;
+    uint8_t codec;
+    uint8_t flags;    // ChunkFlags
+    uint8_t storage;  // ValueStorage; Samples only
+    uint32_t count;
+    int64_t t_first;
+    int64_t t_last;
+    uint32_t stored_len;  // payload bytes following this header
+    uint32_t raw_len;     // payload bytes after decoding
+    uint32_t payload_crc;  // CRC-32C of the stored payload
+    uint32_t header_crc;   // CRC-32C of the preceding header fields
+};
+static_assert(sizeof(ChunkHeader) == 48, "ChunkHeader layout");
+
+enum ChunkFlags : uint8_t {
+    // Stored payload is nonce | ciphertext | tag over the (compressed) payload.
+    kChunkEncrypted = 1 << 0,
+};
+
+constexpr int kBloomWords = 4;  // 256 bits: a few percent false positives at ~20 distinct values
+
+enum IndexFlags : uint8_t {
+    kIndexNullCount = 1 << 0,  // null_count is valid
+    kIndexBloom = 1 << 1,      // bloom is valid
+    // Value statistics withheld (encrypted chunk): v_min/v_max are -inf/+inf
+    // so nothing is pruned by value, and the entry never answers a query.
+    kIndexOpaque = 1 << 2,
+};
+
+struct IndexEntry {
+    uint64_t offset;  // of the ChunkHeader
+    uint32_t length;  // header + stored payload
+    uint32_t channel;
+    uint8_t kind;
+    uint8_t flags;  // IndexFlags
+    uint8_t reserved[2];
+    uint32_t count;
+    int64_t t_first;
+    int64_t t_last;
+    double v_min;  // Samples/Rollup only; NaN when the chunk has no finite values
+    double v_max;
+    uint32_t null_count;  // Samples only: non-finite values, excluded from v_min/v_max
+    uint32_t reserved2;
+    // Samples only: set when every finite value is an integer and the filter
+    // stayed sparse; see bloom_may_contain().
+    uint64_t bloom[kBloomWords];
+};
+static_assert(sizeof(IndexEntry) == 96, "IndexEntry layout");
+
+struct Trailer {
+    uint64_t index_offset;
+    uint32_t index_count;
+    uint32_t index_crc;
+    char magic[8];
+};
+static_assert(sizeof(Trailer) == 24, "Trailer layout");
+
+#pragma pack(pop)
+
+// Fills v_min, v_max, null_count, bloom and flags of a Samples chunk.
+void fill_sample_stats(const double* v, size_t n, IndexEntry* e);
+
+// False only if the chunk certainly holds no sample equal to `v` (by value
+// bounds, or by bloom filter when `v` is an integer and the entry has one).
+bool may_contain(const IndexEntry& e, double v);
+
+// Clears value statistics that would leak plaintext from an encrypted chunk.
+void make_opaque(IndexEntry* e);
+
+// Finite samples in the chunk, when the entry knows its null count.
+inline bool finite_count(const IndexEntry& e, uint64_t* n) {
+    if (!(e.flags & kIndexNullCount)) return false;
+    *n = e.count - e.null_count;
+    return true;
+}
+
+}  // namespace seg
+
+// One rollup bucket for one channel.
+struct RollupPoint {
+    int64_t t;  // bucket start
+    double min;
+    double max;
+    double mean;
+    double last;
+    uint32_t count;
+};
+
+}  // namespace fr
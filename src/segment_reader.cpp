@@ -0,0 +1,260 @@
+#include "segment_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+#include "codec.hpp"
+#include "crc32c.hpp"
+#include "fs_util.hpp"
+#include "value_storage.hpp"
+
+namespace fr {
+
+namespace {
+
+template <typename T>
+const char* take(const char* p, uint32_t n, std::vector<T>* out) {
+    out->resize(n);
+    std::memcpy(out->data(), p, n * sizeof(T));
+    return p + n * sizeof(T);
+}
+
+size_t fixed_payload_size(const seg::ChunkHeader& hdr) {
+    const uint32_t n = hdr.count;
+    switch (static_cast<seg::ChunkKind>(hdr.kind)) {
+        case seg::ChunkKind::Samples: {
+            const size_t values = storage::packed_size(static_cast<seg::ValueStorage>(hdr.storage), n);
+            return values == SIZE_MAX ? SIZE_MAX : n * sizeof(int64_t) + values;
+        }
+        case seg::ChunkKind::Blobs: return n * (sizeof(int64_t) + sizeof(uint32_t));
+        case seg::ChunkKind::Rollup: return n * (sizeof(int64_t) + 4 * sizeof(double) + sizeof(uint32_t));
+    }
+    return SIZE_MAX;
+}
+
+bool decode_payload(const seg::ChunkHeader& hdr, const std::string& payload, ChunkData* out) {
+    auto kind = static_cast<seg::ChunkKind>(hdr.kind);
+    if (hdr.kind > static_cast<uint8_t>(seg::ChunkKind::Rollup)) return false;
+    if (fixed_payload_size(hdr) > payload.size()) return false;
+
+    const uint32_t n = hdr.count;
+    const char* p = take(payload.data(), n, &out->t);
+    out->v.clear();
+    out->blob_len.clear();
+    out->blob_bytes.clear();
+    out->rollup.clear();
+    switch (kind) {
+        case seg::ChunkKind::Samples:
+            storage::unpack(static_cast<seg::ValueStorage>(hdr.storage), p, n, &out->v);
+            break;
+        case seg::ChunkKind::Blobs: {
+            p = take(p, n, &out->blob_len);
+            uint64_t total = 0;
+            for (uint32_t l : out->blob_len) total += l;
+            size_t used = static_cast<size_t>(p - payload.data());
+            if (used + total != payload.size()) return false;
+            out->blob_bytes.assign(p, total);
+            break;
+        }
+        case seg::ChunkKind::Rollup: {
+            std::vector<double> mn, mx, mean, last;
+            std::vector<uint32_t> cnt;
+            p = take(p, n, &mn);
+            p = take(p, n, &mx);
+            p = take(p, n, &mean);
+            p = take(p, n, &last);
+            take(p, n, &cnt);
+            out->rollup.resize(n);
+            for (uint32_t i = 0; i < n; ++i) out->rollup[i] = RollupPoint{out->t[i], mn[i], mx[i], mean[i], last[i], cnt[i]};
+            break;
+        }
+    }
+    return true;
+}
+
+void fill_stats(const ChunkData& d, seg::IndexEntry* e) {
+    if (!d.v.empty()) {
+        seg::fill_sample_stats(d.v.data(), d.v.size(), e);
+        return;
+    }
+    e->v_min = e->v_max = std::numeric_limits<double>::quiet_NaN();
+    for (const auto& r : d.rollup) {
+        if (!std::isfinite(r.min) || !std::isfinite(r.max)) continue;
+        if (std::isnan(e->v_min) || r.min < e->v_min) e->v_min = r.min;
+        if (std::isnan(e->v_max) || r.max > e->v_max) e->v_max = r.max;
+    }
+}
+
+}  // namespace
+
+SegmentReader::~SegmentReader() { close(); }
+
+void SegmentReader::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    index_.clear();
+    cipher_.reset();
+}
+
+bool SegmentReader::fail(const std::string& msg) {
+    error_ = path_ + ": " + msg;
+    return false;
+}
+
+bool SegmentReader::open(const std::string& path) {
+    close();
+    path_ = path;
+    recovered_ = false;
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return fail(std::strerror(errno));
+    struct stat st{};
+    if (fstat(fd_, &st) != 0) return fail(std::strerror(errno));
+    file_size_ = static_cast<uint64_t>(st.st_size);
+
+    if (file_size_ < sizeof(header_) || !pread_all(fd_, &header_, sizeof(header_), 0))
+        return fail("short file");
+    if (std::memcmp(header_.magic, seg::kFileMagic, sizeof(header_.magic)) != 0) return fail("bad magic");
+    if (header_.version != seg::kVersion) return fail("unsupported version");
+    if ((header_.flags & seg::kFileEncrypted) && key_) {
+        if (std::memcmp(header_.key_id, key_->id.data(), sizeof(header_.key_id)) != 0)
+            return fail("encrypted with a different key");
+        cipher_ = std::make_unique<ChunkCipher>(*key_, header_);
+    }
+
+    if (load_trailer_index()) return true;
+    recovered_ = true;
+    return scan_chunks();
+}
+
+bool SegmentReader::load_trailer_index() {
+    if (file_size_ < sizeof(header_) + sizeof(seg::Trailer)) return false;
+    seg::Trailer tr{};
+    if (!pread_all(fd_, &tr, sizeof(tr), file_size_ - sizeof(tr))) return false;
+    if (std::memcmp(tr.magic, seg::kTrailerMagic, sizeof(tr.magic)) != 0) return false;
+    uint64_t bytes = static_cast<uint64_t>(tr.index_count) * sizeof(seg::IndexEntry);
+    if (tr.index_offset + bytes + sizeof(tr) != file_size_) return false;
+    index_.resize(tr.index_count);
+    if (!pread_all(fd_, index_.data(), bytes, tr.index_offset)) return false;
+    if (crc32c(index_.data(), bytes) != tr.index_crc) {
+        index_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool SegmentReader::scan_chunks() {
+    index_.clear();
+    uint64_t off = sizeof(header_);
+    ChunkData scratch;
+    while (off + sizeof(seg::ChunkHeader) <= file_size_) {
+        seg::ChunkHeader hdr{};
+        if (!pread_all(fd_, &hdr, sizeof(hdr), off)) break;
+        if (hdr.magic != seg::kChunkMagic) break;
+        if (crc32c(&hdr, offsetof(seg::ChunkHeader, header_crc)) != hdr.header_crc) break;
+        if (off + sizeof(hdr) + hdr.stored_len > file_size_) break;
+
+        seg::IndexEntry e{};
+        e.offset = off;
+        e.length = static_cast<uint32_t>(sizeof(hdr) + hdr.stored_len);
+        e.channel = hdr.channel;
+        e.kind = hdr.kind;
+        e.count = hdr.count;
+        e.t_first = hdr.t_first;
+        e.t_last = hdr.t_last;
+        if (hdr.flags & seg::kChunkEncrypted) {
+            // Stats would leak plaintext anyway; the checksum is enough.
+            payload_.resize(hdr.stored_len);
+            if (!pread_all(fd_, &payload_[0], hdr.stored_len, off + sizeof(hdr)) ||
+                crc32c(payload_.data(), payload_.size()) != hdr.payload_crc)
+                break;
+            seg::make_opaque(&e);
+            index_.push_back(e);
+            off += e.length;
+            continue;
+        }
+        // Stats are not in the header; decode once to rebuild them.
+        if (!read_chunk(e, &scratch)) break;
+        fill_stats(scratch, &e);
+        index_.push_back(e);
+        off += e.length;
+    }
+    // A torn tail is expected after power loss; everything before it is good.
+    return true;
+}
+
+bool SegmentReader::read_chunk(const seg::IndexEntry& e, ChunkData* out) {
+    if (fd_ < 0) return fail("not open");
+    if (!pread_all(fd_, &out->hdr, sizeof(out->hdr), e.offset)) return fail("chunk header read failed");
+    const seg::ChunkHeader& hdr = out->hdr;
+    if (hdr.magic != seg::kChunkMagic || hdr.channel != e.channel || hdr.count != e.count)
+        return fail("chunk header mismatch");
+    if (!codec::available(static_cast<seg::Codec>(hdr.codec))) return fail("unsupported codec");
+
+    payload_.resize(hdr.stored_len);
+    if (!pread_all(fd_, &payload_[0], hdr.stored_len, e.offset + sizeof(hdr))) return fail("chunk read failed");
+    if (crc32c(payload_.data(), payload_.size()) != hdr.payload_crc) return fail("chunk checksum mismatch");
+    if (const char* what = unpack(hdr, &payload_, &raw_)) return fail(std::string("chunk ") + what);
+    if (!decode_payload(hdr, payload_, out)) return fail("chunk payload malformed");
+    return true;
+}
+
+const char* SegmentReader::unpack(const seg::ChunkHeader& hdr, std::string* payload, std::string* scratch) const {
+    if (hdr.flags & seg::kChunkEncrypted) {
+        if (!cipher_) return "encrypted (no key)";
+        if (!cipher_->open(hdr, payload->data(), payload->size(), scratch)) return "authentication failed";
+        payload->swap(*scratch);
+    }
+    const auto codec = static_cast<seg::Codec>(hdr.codec);
+    if (codec != seg::Codec::None) {
+        if (!codec::decompress(codec, payload->data(), payload->size(), hdr.raw_len, scratch)) return "decompression failed";
+        payload->swap(*scratch);
+    }
+    return nullptr;
+}
+
+bool SegmentReader::verify(TaskPool* pool) {
+    if (fd_ < 0) return fail("not open");
+    std::mutex mu;
+    std::string first_error;
+    auto check = [&](const seg::IndexEntry& e) {
+        // pread() on the shared fd is safe from any thread.
+        std::string chunk(e.length, '\0');
+        std::string payload, scratch;
+        const char* what = nullptr;
+        seg::ChunkHeader hdr{};
+        if (e.length < sizeof(hdr) || !pread_all(fd_, &chunk[0], e.length, e.offset)) {
+            what = "read failed";
+        } else {
+            std::memcpy(&hdr, chunk.data(), sizeof(hdr));
+            const char* stored = chunk.data() + sizeof(hdr);
+            if (hdr.magic != seg::kChunkMagic || crc32c(&hdr, offsetof(seg::ChunkHeader, header_crc)) != hdr.header_crc ||
+                sizeof(hdr) + hdr.stored_len != e.length)
+                what = "bad chunk header";
+            else if (crc32c(stored, hdr.stored_len) != hdr.payload_crc)
+                what = "checksum mismatch";
+            else if (!codec::available(static_cast<seg::Codec>(hdr.codec)))
+                what = "unsupported codec";
+            else if (!(hdr.flags & seg::kChunkEncrypted) || cipher_)  // without the key the CRC is all we can check
+                what = unpack(hdr, &payload.assign(stored, hdr.stored_len), &scratch);
+        }
+        if (what) {
+            std::lock_guard<std::mutex> lk(mu);
+            if (first_error.empty()) first_error = "chunk at " + std::to_string(e.offset) + ": " + what;
+        }
+    };
+    {
+        TaskGroup group(pool);
+        for (const auto& e : index_) group.run([&check, &e] { check(e); });
+    }
+    return first_error.empty() ? true : fail(first_error);
+}
+
+}  // namespace fr
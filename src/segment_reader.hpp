@@ -0,0 +1,80 @@
+// Random-access reader for sealed (and, via recovery scan, unsealed) segments.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "segment_crypto.hpp"
+#include "segment_format.hpp"
+#include "task_pool.hpp"
+
+namespace fr {
+
+// Decoded contents of one chunk. Only the columns for the chunk's kind are filled.
+struct ChunkData {
+    seg::ChunkHeader hdr{};
+    std::vector<int64_t> t;
+    std::vector<double> v;             // Samples, widened from their stored type
+    std::vector<uint32_t> blob_len;    // Blobs
+    std::string blob_bytes;            // Blobs, concatenated
+    std::vector<RollupPoint> rollup;   // Rollup
+};
+
+class SegmentReader {
+public:
+    SegmentReader() = default;
+    ~SegmentReader();
+
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+
+    // Opens and loads the index. A file without a valid trailer (crash before
+    // seal) is indexed by scanning chunk headers; recovered() reports that.
+    // An encrypted file opens without a key (index and verify() work), but
+    // its chunks can only be read with the key it was written with.
+    bool open(const std::string& path);
+    // Key for encrypted files; takes effect on the next open().
+    void set_key(std::shared_ptr<const MasterKey> key) { key_ = std::move(key); }
+    void close();
+
+    const std::string& error() const { return error_; }
+    const std::string& path() const { return path_; }
+    const seg::FileHeader& header() const { return header_; }
+    const std::vector<seg::IndexEntry>& index() const { return index_; }
+    seg::Tier tier() const { return static_cast<seg::Tier>(header_.tier); }
+    bool recovered() const { return recovered_; }
+    uint64_t file_size() const { return file_size_; }
+
+    // Reads, verifies and decodes one chunk.
+    bool read_chunk(const seg::IndexEntry& e, ChunkData* out);
+
+    // Checks every indexed chunk's header and payload checksums (and that
+    // compressed payloads decompress, and encrypted ones authenticate when
+    // the key is set), one task per chunk on `pool` (inline when null). False
+    // with error() naming the first bad chunk.
+    bool verify(TaskPool* pool);
+
+private:
+    bool load_trailer_index();
+    bool scan_chunks();
+    bool fail(const std::string& msg);
+    // Decrypts and decompresses a stored payload already checked against its
+    // CRC. Returns null on success, else what went wrong.
+    const char* unpack(const seg::ChunkHeader& hdr, std::string* payload, std::string* scratch) const;
+
+    int fd_ = -1;
+    std::string path_;
+    std::string error_;
+    seg::FileHeader header_{};
+    std::vector<seg::IndexEntry> index_;
+    uint64_t file_size_ = 0;
+    bool recovered_ = false;
+    std::shared_ptr<const MasterKey> key_;
+    std::unique_ptr<ChunkCipher> cipher_;  // open file's, when encrypted and keyed
+    std::string payload_;
+    std::string raw_;
+};
+
+}  // namespace fr
@@ -0,0 +1,386 @@
+#include "segment_writer.hpp"
+
+#include <fcntl.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <system_error>
+
+#include "clock.hpp"
+#include "codec.hpp"
+#include "crc32c.hpp"
+#include "fs_util.hpp"
+#include "hash_chain.hpp"
+#include "log.hpp"
+#include "storage_layout.hpp"
+#include "value_storage.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr size_t kOutFlushBytes = 1u << 20;
+
+template <typename T>
+void put(std::string& s, const std::vector<T>& v) {
+    s.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+}  // namespace
+
+SegmentWriter::SegmentWriter(SegmentWriterConfig cfg)
+    : cfg_(std::move(cfg)),
+      dir_(layout::flight_dir(cfg_.root, cfg_.flight_id)),
+      seq_(cfg_.first_seq),
+      chain_(chain_genesis(cfg_.flight_id)),
+      codec_(cfg_.codec),
+      chunk_records_(cfg_.chunk_records),
+      chunk_bytes_(cfg_.chunk_bytes),
+      out_flush_bytes_(kOutFlushBytes) {
+    make_dirs(dir_);
+    out_.reserve(kOutFlushBytes + (64u << 10));
+}
+
+void SegmentWriter::set_flush_scale(unsigned scale) {
+    if (scale == 0) scale = 1;
+    chunk_records_ = cfg_.chunk_records * scale;
+    chunk_bytes_ = cfg_.chunk_bytes * scale;
+    out_flush_bytes_ = kOutFlushBytes * scale;
+}
+
+SegmentWriter::~SegmentWriter() {
+    try {
+        close();
+    } catch (const SegmentWriteError& ex) {
+        FR_LOG_ERROR("segment writer: %s", ex.what());
+    }
+}
+
+SegmentWriter::ChannelBuf& SegmentWriter::channel_buf(uint32_t channel, seg::ChunkKind kind, int64_t t_ns) {
+    if (fd_ < 0) open_segment(t_ns);
+    if (t_ns > seg_t_last_) seg_t_last_ = t_ns;
+    ChannelBuf& buf = channels_[channel];
+    if (buf.t.empty()) buf.kind = kind;
+    return buf;
+}
+
+void SegmentWriter::append(uint32_t channel, int64_t t_ns, double value) {
+    ChannelBuf& buf = channel_buf(channel, seg::ChunkKind::Samples, t_ns);
+    buf.t.push_back(t_ns);
+    buf.v.push_back(value);
+    buf.approx_bytes += sizeof(int64_t) + sizeof(double);
+    after_append(channel, buf);
+}
+
+void SegmentWriter::append_blob(uint32_t channel, int64_t t_ns, const void* data, uint32_t len) {
+    ChannelBuf& buf = channel_buf(channel, seg::ChunkKind::Blobs, t_ns);
+    buf.t.push_back(t_ns);
+    buf.len.push_back(len);
+    buf.bytes.append(static_cast<const char*>(data), len);
+    buf.approx_bytes += sizeof(int64_t) + sizeof(uint32_t) + len;
+    after_append(channel, buf);
+}
+
+void SegmentWriter::append_rollup(uint32_t channel, const RollupPoint& p) {
+    ChannelBuf& buf = channel_buf(channel, seg::ChunkKind::Rollup, p.t);
+    buf.t.push_back(p.t);
+    buf.rollup.push_back(p);
+    buf.approx_bytes += sizeof(int64_t) + 4 * sizeof(double) + sizeof(uint32_t);
+    after_append(channel, buf);
+}
+
+void SegmentWriter::after_append(uint32_t channel, ChannelBuf& buf) {
+    if (buf.t.size() >= chunk_records_ || buf.approx_bytes >= chunk_bytes_) flush_chunk(channel, buf);
+
+    bool too_big = cfg_.max_segment_bytes && file_offset_ + pending_bytes_ >= cfg_.max_segment_bytes;
+    bool too_old = cfg_.max_segment_ns && seg_t_last_ - seg_t_first_ >= cfg_.max_segment_ns;
+    if (too_big || too_old) rotate();
+}
+
+void SegmentWriter::open_segment(int64_t t_ns) {
+    std::string path = dir_ + "/" + layout::open_segment_name(seq_, cfg_.tier);
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    seg::FileHeader hdr{};
+    std::memcpy(hdr.magic, seg::kFileMagic, sizeof(hdr.magic));
+    hdr.version = seg::kVersion;
+    hdr.tier = static_cast<uint8_t>(cfg_.tier);
+    hdr.seq = seq_;
+    hdr.created_realtime_ns = realtime_ns();
+    std::strncpy(hdr.flight_id, cfg_.flight_id.c_str(), sizeof(hdr.flight_id) - 1);
+    cipher_.reset();
+    chunks_sealed_ = 0;
+    if (cfg_.key) {
+        hdr.flags |= seg::kFileEncrypted;
+        std::memcpy(hdr.key_id, cfg_.key->id.data(), sizeof(hdr.key_id));
+        if (getrandom(&hdr.nonce_salt, sizeof(hdr.nonce_salt), 0) != sizeof(hdr.nonce_salt))
+            hdr.nonce_salt = static_cast<uint32_t>(hdr.created_realtime_ns ^ (hdr.created_realtime_ns >> 32));
+        cipher_ = std::make_shared<const ChunkCipher>(*cfg_.key, hdr);
+    }
+
+    file_offset_ = 0;
+    disk_offset_ = 0;
+    file_hash_.reset();
+    index_.clear();
+    seg_t_first_ = seg_t_last_ = t_ns;
+    write_out(&hdr, sizeof(hdr));
+
+    for (const auto& p : preamble_) {
+        ChannelBuf& buf = channels_[p.first];
+        if (buf.t.empty()) buf.kind = seg::ChunkKind::Blobs;
+        buf.t.push_back(t_ns);
+        buf.len.push_back(static_cast<uint32_t>(p.second.size()));
+        buf.bytes += p.second;
+        buf.approx_bytes += sizeof(int64_t) + sizeof(uint32_t) + p.second.size();
+    }
+}
+
+void SegmentWriter::flush_chunk(uint32_t channel, ChannelBuf& buf) {
+    if (buf.t.empty()) return;
+    auto c = std::make_shared<PendingChunk>();
+    c->channel = channel;
+    c->approx_bytes = buf.approx_bytes;
+    c->buf = std::move(buf);
+    buf = ChannelBuf();
+    if (c->buf.kind == seg::ChunkKind::Samples) {
+        auto it = storage_.find(channel);
+        if (it != storage_.end()) c->storage = it->second;
+    }
+    c->cipher = cipher_;
+    c->nonce_counter = chunks_sealed_++;
+    pending_bytes_ += c->approx_bytes;
+    pending_.push_back(c);
+
+    const seg::Codec codec = codec_;
+    if (!cfg_.pool) {
+        encode_chunk(*c, codec);
+        c->done.store(true);
+    } else {
+        cfg_.pool->submit([this, c, codec] {
+            encode_chunk(*c, codec);
+            // Set under the lock, and nothing touches `this` after it is
+            // released: seal() takes the lock once everything is done.
+            std::lock_guard<std::mutex> lk(done_mu_);
+            c->done.store(true);
+            done_cv_.notify_all();
+        });
+    }
+    // Bounded in-flight: a writer far ahead of the pool waits (and helps).
+    write_completed(cfg_.pool ? 2 * cfg_.pool->size() : 0);
+}
+
+void SegmentWriter::encode_chunk(PendingChunk& c, seg::Codec codec) {
+    const ChannelBuf& buf = c.buf;
+    const uint32_t n = static_cast<uint32_t>(buf.t.size());
+
+    double vmin = std::numeric_limits<double>::quiet_NaN();
+    double vmax = vmin;
+    auto widen = [&](double lo, double hi) {
+        if (!std::isfinite(lo) || !std::isfinite(hi)) return;
+        if (std::isnan(vmin) || lo < vmin) vmin = lo;
+        if (std::isnan(vmax) || hi > vmax) vmax = hi;
+    };
+
+    std::string raw;
+    raw.reserve(c.approx_bytes);
+    put(raw, buf.t);
+    seg::ValueStorage stored_as = seg::ValueStorage::F64;
+    std::vector<double> widened;  // what readers will see, when narrowed
+    switch (buf.kind) {
+        case seg::ChunkKind::Samples:
+            stored_as = storage::pack(c.storage.kind, c.storage.step, buf.v.data(), n, &raw);
+            if (stored_as != seg::ValueStorage::F64)
+                storage::unpack(stored_as, raw.data() + n * sizeof(int64_t), n, &widened);
+            break;
+        case seg::ChunkKind::Blobs:
+            put(raw, buf.len);
+            raw.append(buf.bytes);
+            break;
+        case seg::ChunkKind::Rollup: {
+            for (const auto& p : buf.rollup) raw.append(reinterpret_cast<const char*>(&p.min), sizeof(double));
+            for (const auto& p : buf.rollup) raw.append(reinterpret_cast<const char*>(&p.max), sizeof(double));
+            for (const auto& p : buf.rollup) raw.append(reinterpret_cast<const char*>(&p.mean), sizeof(double));
+            for (const auto& p : buf.rollup) raw.append(reinterpret_cast<const char*>(&p.last), sizeof(double));
+            for (const auto& p : buf.rollup) raw.append(reinterpret_cast<const char*>(&p.count), sizeof(uint32_t));
+            for (const auto& p : buf.rollup) widen(p.min, p.max);
+            break;
+        }
+    }
+
+    std::string packed;
+    const bool compressed = codec::compress(codec, raw.data(), raw.size(), &packed);
+    const uint32_t raw_len = static_cast<uint32_t>(raw.size());
+    std::string& stored = compressed ? packed : raw;
+
+    seg::ChunkHeader hdr{};
+    hdr.magic = seg::kChunkMagic;
+    hdr.channel = c.channel;
+    hdr.kind = static_cast<uint8_t>(buf.kind);
+    hdr.codec = static_cast<uint8_t>(compressed ? codec : seg::Codec::None);
+    if (buf.kind == seg::ChunkKind::Samples) hdr.storage = static_cast<uint8_t>(stored_as);
+    hdr.count = n;
+    hdr.t_first = buf.t.front();
+    hdr.t_last = buf.t.back();
+    if (c.cipher) {
+        hdr.flags = seg::kChunkEncrypted;
+        c.cipher->seal(hdr, c.nonce_counter, &stored);
+    }
+    hdr.stored_len = static_cast<uint32_t>(stored.size());
+    hdr.raw_len = raw_len;
+    hdr.payload_crc = crc32c(stored.data(), stored.size());
+    hdr.header_crc = crc32c(&hdr, offsetof(seg::ChunkHeader, header_crc));
+
+    seg::IndexEntry& e = c.entry;
+    e.length = static_cast<uint32_t>(sizeof(hdr) + stored.size());
+    e.channel = c.channel;
+    e.kind = hdr.kind;
+    e.count = n;
+    e.t_first = hdr.t_first;
+    e.t_last = hdr.t_last;
+    e.v_min = vmin;
+    e.v_max = vmax;
+    if (buf.kind == seg::ChunkKind::Samples)
+        seg::fill_sample_stats(widened.empty() ? buf.v.data() : widened.data(), n, &e);
+    if (c.cipher) seg::make_opaque(&e);
+
+    c.bytes.reserve(e.length);
+    c.bytes.assign(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    c.bytes += stored;
+    c.buf = ChannelBuf();  // release the columns on the worker
+}
+
+void SegmentWriter::wait_done(PendingChunk& c) {
+    while (!c.done.load(std::memory_order_acquire)) {
+        if (cfg_.pool->run_one()) continue;
+        std::unique_lock<std::mutex> lk(done_mu_);
+        done_cv_.wait_for(lk, std::chrono::milliseconds(1), [&c] { return c.done.load(); });
+    }
+}
+
+void SegmentWriter::write_completed(size_t max_pending) {
+    while (!pending_.empty()) {
+        std::shared_ptr<PendingChunk> c = pending_.front();
+        if (!c->done.load(std::memory_order_acquire)) {
+            if (pending_.size() <= max_pending) return;
+            wait_done(*c);
+        }
+        pending_bytes_ -= c->approx_bytes;
+        pending_.pop_front();
+        // Offsets are assigned here, in submission order, so the file layout
+        // does not depend on which worker finished first.
+        c->entry.offset = file_offset_;
+        index_.push_back(c->entry);
+        write_out(c->bytes.data(), c->bytes.size());
+    }
+}
+
+void SegmentWriter::write_out(const void* data, size_t len) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    out_.insert(out_.end(), p, p + len);
+    file_offset_ += len;
+    if (out_.size() >= out_flush_bytes_) drain_out();
+}
+
+void SegmentWriter::drain_out() {
+    if (out_.empty() || fd_ < 0) return;
+    if (!write_all(fd_, out_.data(), out_.size())) fail_segment(errno);
+    // Hashing here, a megabyte at a time, keeps seal() from having to
+    // re-read or hash the whole segment at once.
+    file_hash_.update(out_.data(), out_.size());
+    disk_offset_ += out_.size();
+    out_.clear();
+}
+
+void SegmentWriter::fail_segment(int err) {
+    // Pool tasks still encoding chunks for this segment touch `this`.
+    for (const auto& c : pending_) wait_done(*c);
+    { std::lock_guard<std::mutex> lk(done_mu_); }  // see flush_chunk()
+
+    // What is not wholly on disk is gone. A short write may have left part
+    // of a chunk behind; the recovery scan drops it by its CRC.
+    uint64_t lost = 0;
+    for (const auto& e : index_)
+        if (e.offset + e.length > disk_offset_) lost += e.count;
+    for (const auto& c : pending_) lost += c->entry.count;
+    for (const auto& kv : channels_) lost += kv.second.t.size();
+    index_.clear();
+    pending_.clear();
+    pending_bytes_ = 0;
+    channels_.clear();
+    out_.clear();
+
+    const std::string path = dir_ + "/" + layout::open_segment_name(seq_, cfg_.tier);
+    ::close(fd_);
+    fd_ = -1;
+    total_bytes_ += disk_offset_;
+    file_offset_ = 0;
+    seq_++;  // the next segment must not truncate this one
+    throw SegmentWriteError(err, "write " + path + " (segment abandoned)", lost);
+}
+
+void SegmentWriter::begin(int64_t t_ns) {
+    if (fd_ < 0) open_segment(t_ns);
+}
+
+void SegmentWriter::rotate() {
+    if (fd_ < 0) return;
+    seal();
+}
+
+void SegmentWriter::close() { rotate(); }
+
+void SegmentWriter::seal() {
+    // Chunk channels in id order so sealed files are deterministic.
+    std::vector<uint32_t> ids;
+    ids.reserve(channels_.size());
+    for (const auto& kv : channels_)
+        if (!kv.second.t.empty()) ids.push_back(kv.first);
+    std::sort(ids.begin(), ids.end());
+    for (uint32_t id : ids) flush_chunk(id, channels_[id]);
+    write_completed(0);
+    { std::lock_guard<std::mutex> lk(done_mu_); }  // see flush_chunk()
+
+    seg::Trailer tr{};
+    tr.index_offset = file_offset_;
+    tr.index_count = static_cast<uint32_t>(index_.size());
+    tr.index_crc = crc32c(index_.data(), index_.size() * sizeof(seg::IndexEntry));
+    std::memcpy(tr.magic, seg::kTrailerMagic, sizeof(tr.magic));
+    write_out(index_.data(), index_.size() * sizeof(seg::IndexEntry));
+    write_out(&tr, sizeof(tr));
+    drain_out();
+
+    if (fdatasync(fd_) != 0)
+        FR_LOG_ERROR("segment %s/%06u: fdatasync: %s", cfg_.flight_id.c_str(), seq_, std::strerror(errno));
+    ::close(fd_);
+    fd_ = -1;
+
+    std::string name = layout::segment_name(seq_, cfg_.tier);
+    std::string from = dir_ + "/" + layout::open_segment_name(seq_, cfg_.tier);
+    std::string to = dir_ + "/" + name;
+    if (::rename(from.c_str(), to.c_str()) != 0) {
+        FR_LOG_ERROR("segment rename %s: %s", from.c_str(), std::strerror(errno));
+    } else {
+        fsync_dir(dir_);
+    }
+
+    total_bytes_ += file_offset_;
+    SealedSegment s{cfg_.flight_id, to, name, seq_, cfg_.tier, file_offset_, seg_t_first_, seg_t_last_,
+                    file_hash_.finish(), Sha256Digest{}};
+    if (cfg_.tier == seg::Tier::Raw) {
+        chain_ = chain_link(chain_, s.hash);
+        s.link = chain_;
+    }
+    seq_++;
+    file_offset_ = 0;
+    if (on_sealed_) on_sealed_(s);
+}
+
+}  // namespace fr
@@ -0,0 +1,207 @@
+// Appends records to per-channel column buffers and writes them out as chunks
+// of the current segment. Segments rotate on size or time; sealing writes the
+// index and trailer, syncs, and atomically renames x.frs.open -> x.frs. Every
+// byte is hashed on its way to disk; raw segments are linked into the
+// flight's hash chain (see hash_chain.hpp).
+//
+// A failed write abandons the segment: it stays x.frs.open on disk for the
+// recovery scan to salvage whole chunks from, is never sealed or chained,
+// and the append (or close) that hit it throws SegmentWriteError.
+//
+// Not thread-safe: each writer belongs to exactly one thread. With a TaskPool,
+// chunk encoding (including value narrowing), index stats, compression,
+// encryption and checksums run as pool tasks; finished chunks are written in
+// submission order by the owning thread.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#include "segment_crypto.hpp"
+#include "segment_format.hpp"
+#include "sha256.hpp"
+#include "task_pool.hpp"
+
+namespace fr {
+
+struct SegmentWriterConfig {
+    std::string root;
+    std::string flight_id;
+    seg::Tier tier = seg::Tier::Raw;
+    uint32_t first_seq = 1;
+    // 0 disables the respective rotation trigger.
+    uint64_t max_segment_bytes = 64ull << 20;
+    int64_t max_segment_ns = 60LL * 1000000000;
+    // A channel's buffer becomes a chunk at this many records or bytes.
+    uint32_t chunk_records = 4096;
+    uint32_t chunk_bytes = 256u << 10;
+    seg::Codec codec = seg::Codec::Lz4;  // falls back to None per chunk when it does not help
+    TaskPool* pool = nullptr;            // null: encode inline on the writer thread
+    std::shared_ptr<const MasterKey> key;  // set: encrypt every chunk (see segment_crypto.hpp)
+};
+
+struct SealedSegment {
+    std::string flight_id;
+    std::string path;
+    std::string name;
+    uint32_t seq;
+    seg::Tier tier;
+    uint64_t bytes;
+    int64_t t_first;
+    int64_t t_last;
+    Sha256Digest hash;  // SHA-256 of the whole file
+    Sha256Digest link;  // hash chain link (raw tier only; zero otherwise)
+};
+
+// Thrown when writing a segment fails. `records_lost` counts the records the
+// writer held for it that are not wholly on disk, including the one being
+// appended.
+class SegmentWriteError : public std::system_error {
+public:
+    SegmentWriteError(int err, const std::string& what, uint64_t records_lost)
+        : std::system_error(err, std::generic_category(), what), records_lost_(records_lost) {}
+    uint64_t records_lost() const { return records_lost_; }
+
+private:
+    uint64_t records_lost_;
+};
+
+class SegmentWriter {
+public:
+    using SealCallback = std::function<void(const SealedSegment&)>;
+
+    // Creates the flight directory if needed. Throws std::system_error.
+    explicit SegmentWriter(SegmentWriterConfig cfg);
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    // Called on the writer thread after each seal; keep it cheap.
+    void set_seal_callback(SealCallback cb) { on_sealed_ = std::move(cb); }
+
+    // Blob written at the start of every segment this writer opens, so each
+    // sealed file is self-describing (e.g. the compiled config). One per channel.
+    void add_segment_preamble(uint32_t channel, std::string bytes) {
+        preamble_.emplace_back(channel, std::move(bytes));
+    }
+
+    // Narrow storage for a numeric channel's chunks (see value_storage.hpp);
+    // `step` is the fixed-point resolution. Other channels store doubles.
+    void set_storage(uint32_t channel, seg::ValueStorage s, double step) { storage_[channel] = ChannelStorage{s, step}; }
+
+    void append(uint32_t channel, int64_t t_ns, double value);
+    void append_blob(uint32_t channel, int64_t t_ns, const void* data, uint32_t len);
+    void append_rollup(uint32_t channel, const RollupPoint& p);
+
+    // Opens a segment immediately so that close() yields a sealed file even if
+    // nothing is appended (used for empty rollups that still mark completion).
+    void begin(int64_t t_ns);
+
+    // Seals the current segment (if it holds anything) and starts a new one
+    // on the next append. Appends, rotate() and close() throw
+    // SegmentWriteError when the segment cannot be written.
+    void rotate();
+    // Seals and stops; further appends reopen a new segment.
+    void close();
+
+    // Runtime overrides of the configured codec and chunk limits (thermal
+    // throttling); `scale` multiplies chunk_records, chunk_bytes and the
+    // output buffer threshold. Apply to chunks flushed from now on.
+    void set_codec(seg::Codec codec) { codec_ = codec; }
+    void set_flush_scale(unsigned scale);
+
+    const std::string& flight_id() const { return cfg_.flight_id; }
+    uint32_t next_seq() const { return seq_; }
+    uint64_t bytes_written() const { return total_bytes_; }
+
+private:
+    struct ChannelBuf {
+        seg::ChunkKind kind = seg::ChunkKind::Samples;
+        std::vector<int64_t> t;
+        std::vector<double> v;
+        std::vector<uint32_t> len;
+        std::string bytes;
+        std::vector<RollupPoint> rollup;
+        size_t approx_bytes = 0;
+    };
+
+    struct ChannelStorage {
+        seg::ValueStorage kind = seg::ValueStorage::F64;
+        double step = 0;
+    };
+
+    // A chunk handed to the pool. Only `done` is shared until it is set.
+    struct PendingChunk {
+        uint32_t channel = 0;
+        size_t approx_bytes = 0;
+        ChannelBuf buf;
+        ChannelStorage storage;
+        std::shared_ptr<const ChunkCipher> cipher;  // null: plaintext
+        uint64_t nonce_counter = 0;
+        std::string bytes;  // chunk header + stored payload
+        seg::IndexEntry entry{};  // all but offset
+        std::atomic<bool> done{false};
+    };
+
+    ChannelBuf& channel_buf(uint32_t channel, seg::ChunkKind kind, int64_t t_ns);
+    void after_append(uint32_t channel, ChannelBuf& buf);
+    void open_segment(int64_t t_ns);
+    void flush_chunk(uint32_t channel, ChannelBuf& buf);
+    static void encode_chunk(PendingChunk& c, seg::Codec codec);
+    void wait_done(PendingChunk& c);
+    // Writes finished chunks in order, blocking until at most `max_pending`
+    // remain in flight.
+    void write_completed(size_t max_pending);
+    void write_out(const void* data, size_t len);
+    void drain_out();
+    // Drops everything held for the current segment, closes it unsealed and
+    // throws SegmentWriteError.
+    [[noreturn]] void fail_segment(int err);
+    void seal();
+
+    const SegmentWriterConfig cfg_;
+    std::string dir_;
+    SealCallback on_sealed_;
+
+    int fd_ = -1;
+    uint32_t seq_;
+    uint64_t file_offset_ = 0;  // bytes handed to the kernel plus buffered
+    uint64_t disk_offset_ = 0;  // bytes handed to the kernel
+    uint64_t total_bytes_ = 0;
+    int64_t seg_t_first_ = 0;
+    int64_t seg_t_last_ = 0;
+
+    Sha256 file_hash_;  // of everything written to the current segment
+    Sha256Digest chain_;  // link of the last sealed raw segment
+
+    seg::Codec codec_;
+    uint32_t chunk_records_;
+    uint32_t chunk_bytes_;
+    size_t out_flush_bytes_;
+
+    std::shared_ptr<const ChunkCipher> cipher_;  // current segment's, when encrypting
+    uint64_t chunks_sealed_ = 0;                 // nonce counter within the segment
+
+    std::unordered_map<uint32_t, ChannelBuf> channels_;
+    std::unordered_map<uint32_t, ChannelStorage> storage_;
+    std::vector<seg::IndexEntry> index_;
+    std::vector<uint8_t> out_;
+    std::deque<std::shared_ptr<PendingChunk>> pending_;
+    uint64_t pending_bytes_ = 0;
+    std::mutex done_mu_;
+    std::condition_variable done_cv_;
+    std::vector<std::pair<uint32_t, std::string>> preamble_;
+};
+
+}  // namespace fr
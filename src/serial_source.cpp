@@ -0,0 +1,268 @@
+#include "serial_source.hpp"
+
+// termios2 and BOTHER come from the kernel headers, which clash with glibc's
+// <termios.h>; this file uses the ioctls directly instead.
+#include <asm/termbits.h>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "clock.hpp"
+#include "log.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr int kPollMs = 100;  // also bounds how long close() waits for the reader
+constexpr int64_t kCountsEveryNs = 200000000;
+constexpr uint32_t kMaxBaud = 12000000;
+constexpr size_t kMinRingBytes = 64u << 10;
+constexpr size_t kRingBytesPerMark = 128;  // about 1 ms of line time at 1 Mbaud
+
+// Standard rates keep their Bxxx code for drivers that predate BOTHER.
+speed_t baud_constant(uint32_t baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 500000: return B500000;
+        case 576000: return B576000;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        case 2500000: return B2500000;
+        case 3000000: return B3000000;
+        case 3500000: return B3500000;
+        case 4000000: return B4000000;
+        default: return 0;
+    }
+}
+
+std::string base_name(const std::string& path) {
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+}  // namespace
+
+SerialSource::SerialSource(SourceSpec spec, const SerialOptions& opts) : spec_(std::move(spec)), opts_(opts) {
+    ring_.resize(std::max(opts_.ring_bytes, kMinRingBytes));
+    marks_.resize(ring_.size() / kRingBytesPerMark);
+}
+
+bool SerialSource::open(std::string* err) {
+    // O_NONBLOCK so a port with modem-control lines never stalls the open.
+    fd_ = ::open(spec_.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        *err = spec_.path + ": " + std::strerror(errno);
+        return false;
+    }
+    if (!configure(err)) {
+        close();
+        return false;
+    }
+    if (tty_) {
+        if (opts_.low_latency) set_low_latency();
+        ioctl(fd_, TCFLSH, TCIFLUSH);
+    }
+    at_open_ = LineCounts{};
+    read_counts(&at_open_);
+    base_ = LineCounts{overruns_.load(), errors_.load(), kernel_drops_.load()};
+    head_.store(0);
+    tail_.store(0);
+    mark_head_.store(0);
+    mark_tail_.store(0);
+    received_ns_ = 0;
+    lost_.store(false);
+    stop_.store(false);
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+bool SerialSource::configure(std::string* err) {
+    tty_ = false;
+    batch_bytes_ = 0;
+    termios2 tio{};
+    if (ioctl(fd_, TCGETS2, &tio) != 0) {
+        // Not a tty (e.g. a FIFO in tests): read it as a plain byte stream.
+        return true;
+    }
+    tty_ = true;
+    if (spec_.baud == 0 || spec_.baud > kMaxBaud) {
+        *err = spec_.path + ": unsupported baud " + std::to_string(spec_.baud);
+        return false;
+    }
+    // cfmakeraw(), plus both speeds from c_ospeed.
+    tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+    const speed_t code = baud_constant(spec_.baud);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD | (code ? code : BOTHER);
+    tio.c_ispeed = tio.c_ospeed = spec_.baud;
+    // Without effect under O_NONBLOCK; batching is done by the reader.
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (ioctl(fd_, TCSETS2, &tio) != 0) {
+        *err = spec_.path + ": TCSETS2: " + std::strerror(errno);
+        return false;
+    }
+    // Drivers round to what their divisor can do, or silently keep the old rate.
+    termios2 got{};
+    if (ioctl(fd_, TCGETS2, &got) == 0 && (got.c_ospeed < spec_.baud - spec_.baud / 50 ||
+                                          got.c_ospeed > spec_.baud + spec_.baud / 50))
+        FR_LOG_WARN("source %s: driver set %u baud instead of %u", spec_.name.c_str(), got.c_ospeed, spec_.baud);
+    batch_bytes_ = std::min<uint32_t>(spec_.baud / 10000, 4096);  // ~1 ms at 8N1
+    return true;
+}
+
+void SerialSource::set_low_latency() {
+    serial_struct ss{};
+    if (ioctl(fd_, TIOCGSERIAL, &ss) == 0 && !(ss.flags & ASYNC_LOW_LATENCY)) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd_, TIOCSSERIAL, &ss);
+    }
+    // FTDI-style USB adapters otherwise hold bytes back for up to 16 ms.
+    char real[PATH_MAX];
+    if (!realpath(spec_.path.c_str(), real)) return;
+    const std::string timer = "/sys/class/tty/" + base_name(real) + "/device/latency_timer";
+    int fd = ::open(timer.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    if (::write(fd, "1", 1) != 1) FR_LOG_DEBUG("source %s: %s: %s", spec_.name.c_str(), timer.c_str(), std::strerror(errno));
+    ::close(fd);
+}
+
+bool SerialSource::read_counts(LineCounts* out) const {
+    serial_icounter_struct ic{};
+    if (!tty_ || ioctl(fd_, TIOCGICOUNT, &ic) != 0) return false;
+    out->overrun = static_cast<uint32_t>(ic.overrun);
+    out->errors = static_cast<uint64_t>(static_cast<uint32_t>(ic.frame)) + static_cast<uint32_t>(ic.parity);
+    out->buf_overrun = static_cast<uint32_t>(ic.buf_overrun);
+    return true;
+}
+
+void SerialSource::run() {
+    set_thread_name(("fr-tty-" + base_name(spec_.path)).c_str());
+    set_high_priority();
+    uint8_t discard[4096];
+    int64_t next_counts = 0;
+    while (!stop_.load(std::memory_order_relaxed)) {
+        const int ready = wait_readable(fd_, kPollMs);
+        const int64_t now = monotonic_ns();
+        if (now >= next_counts) {
+            LineCounts c;
+            if (read_counts(&c)) {
+                overruns_.store(base_.overrun + c.overrun - at_open_.overrun, std::memory_order_relaxed);
+                errors_.store(base_.errors + c.errors - at_open_.errors, std::memory_order_relaxed);
+                kernel_drops_.store(base_.buf_overrun + c.buf_overrun - at_open_.buf_overrun,
+                                    std::memory_order_relaxed);
+            }
+            next_counts = now + kCountsEveryNs;
+        }
+        if (ready == 0) continue;
+        if (ready < 0) break;
+        // Right after the first byte arrives only a few are queued; give the
+        // line up to about a millisecond to fill a worthwhile read.
+        int avail = 0;
+        if (batch_bytes_ && opts_.coalesce_us && ioctl(fd_, FIONREAD, &avail) == 0 &&
+            static_cast<uint32_t>(avail) < batch_bytes_) {
+            const uint64_t us = (batch_bytes_ - static_cast<uint32_t>(avail)) * 10000000ull / spec_.baud;
+            std::this_thread::sleep_for(std::chrono::microseconds(std::min<uint64_t>(us, opts_.coalesce_us)));
+        }
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        const size_t space = ring_.size() - static_cast<size_t>(head - tail_.load(std::memory_order_acquire));
+        ssize_t n;
+        if (space == 0) {
+            // The parser is behind by a whole ring; keep the kernel buffers
+            // moving so that at least the newest data is intact.
+            n = ::read(fd_, discard, sizeof(discard));
+            if (n > 0) {
+                ring_drops_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+                continue;
+            }
+        } else {
+            const size_t at = static_cast<size_t>(head % ring_.size());
+            n = ::read(fd_, &ring_[at], std::min(space, ring_.size() - at));
+            if (n > 0) {
+                const uint64_t mark = mark_head_.load(std::memory_order_relaxed);
+                if (mark - mark_tail_.load(std::memory_order_acquire) < marks_.size()) {
+                    marks_[mark % marks_.size()] = Mark{head, monotonic_ns()};
+                    mark_head_.store(mark + 1, std::memory_order_release);
+                }
+                head_.store(head + static_cast<uint64_t>(n), std::memory_order_release);
+                { std::lock_guard<std::mutex> lk(mu_); }
+                cv_.notify_one();
+                continue;
+            }
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        break;  // EOF: USB serial unplugged
+    }
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        lost_.store(true);
+    }
+    cv_.notify_one();
+}
+
+ssize_t SerialSource::read(uint8_t* buf, size_t cap, int timeout_ms) {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head == tail) {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait_for(lk, std::chrono::milliseconds(timeout_ms),
+                     [&] { return head_.load(std::memory_order_acquire) != tail || lost_.load(); });
+        head = head_.load(std::memory_order_acquire);
+        // The ring is drained before a lost device is reported.
+        if (head == tail) return lost_.load() ? -1 : 0;
+    }
+    // Marks are published before the bytes they cover, so there is one at
+    // or before tail; a later one ends this read.
+    uint64_t mark = mark_tail_.load(std::memory_order_relaxed);
+    const uint64_t marks = mark_head_.load(std::memory_order_acquire);
+    while (mark + 1 < marks && marks_[(mark + 1) % marks_.size()].start <= tail) ++mark;
+    mark_tail_.store(mark, std::memory_order_release);
+    uint64_t end = head;
+    if (mark + 1 < marks) end = std::min(end, marks_[(mark + 1) % marks_.size()].start);
+    if (mark < marks) received_ns_ = marks_[mark % marks_.size()].t_ns;
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(cap, end - tail));
+    const size_t at = static_cast<size_t>(tail % ring_.size());
+    const size_t first = std::min(n, ring_.size() - at);
+    std::memcpy(buf, &ring_[at], first);
+    std::memcpy(buf + first, ring_.data(), n - first);
+    tail_.store(tail + n, std::memory_order_release);
+    return static_cast<ssize_t>(n);
+}
+
+SourceCounters SerialSource::counters() const {
+    SourceCounters c;
+    c.kernel_drops = kernel_drops_.load(std::memory_order_relaxed);
+    c.overruns = overruns_.load(std::memory_order_relaxed);
+    c.framing_errors = errors_.load(std::memory_order_relaxed);
+    c.ring_drops = ring_drops_.load(std::memory_order_relaxed);
+    return c;
+}
+
+void SerialSource::close() {
+    stop_.store(true);
+    if (thread_.joinable()) thread_.join();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+}  // namespace fr
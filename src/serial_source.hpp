@@ -0,0 +1,105 @@
+// UART source (flight controller telemetry port, GNSS receiver, ...).
+//
+// At 2-3 Mbaud the kernel's tty buffers hold only a few hundred
+// milliseconds of data, so a parser that falls behind for a moment loses
+// bytes. The port is therefore drained by a dedicated high-priority reader
+// thread into a large ring; read() hands out ring contents to the source's
+// own thread, which does the framing and decoding.
+//
+// Line setup uses termios2, so any rate the driver accepts (non-standard
+// rates up to 12 Mbaud on FTDI/CP210x/CH34x) can be requested with BOTHER;
+// the rate the driver actually chose is read back and logged if it differs.
+// Low-latency mode is requested where available (ASYNC_LOW_LATENCY, the
+// USB-serial latency_timer). Reads are coalesced: when fewer bytes are
+// queued than about a millisecond of line time, the reader waits up to
+// `coalesce_us` for more before reading, which keeps syscalls per byte
+// low without the 100 ms granularity of VTIME.
+//
+// Every read from the port is stamped by the reader thread and read() never
+// returns bytes from two of them at once, so received_ns() is the time the
+// bytes came off the line even while the parser lags behind the ring.
+//
+// UART overrun, framing and parity counts come from TIOCGICOUNT where the
+// driver supports it (not on pseudo-terminals).
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "source.hpp"
+
+namespace fr {
+
+class SerialSource : public Source {
+public:
+    SerialSource(SourceSpec spec, const SerialOptions& opts);
+    ~SerialSource() override { close(); }
+
+    const SourceSpec& spec() const override { return spec_; }
+    Framing framing() const override { return Framing::Stream; }
+
+    bool open(std::string* err) override;
+    ssize_t read(uint8_t* buf, size_t cap, int timeout_ms) override;
+    void close() override;
+    int64_t received_ns() const override { return received_ns_; }
+
+    SourceCounters counters() const override;
+
+private:
+    // Kernel and UART counters as of the last TIOCGICOUNT.
+    struct LineCounts {
+        uint64_t overrun = 0;
+        uint64_t errors = 0;  // framing + parity
+        uint64_t buf_overrun = 0;
+    };
+
+    bool configure(std::string* err);
+    void set_low_latency();
+    bool read_counts(LineCounts* out) const;
+    void run();
+
+    // Ring offset of the first byte of one port read, and when it returned.
+    struct Mark {
+        uint64_t start;
+        int64_t t_ns;
+    };
+
+    SourceSpec spec_;
+    SerialOptions opts_;
+    int fd_ = -1;
+    bool tty_ = false;
+    uint32_t batch_bytes_ = 0;  // about 1 ms of line time at the configured rate
+
+    // Single producer (the reader thread), single consumer (read()).
+    std::vector<uint8_t> ring_;
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> tail_{0};
+    std::atomic<bool> lost_{false};
+    // Same arrangement for the marks; mark_tail_ is the one covering tail_.
+    // With every slot in use a read gets no mark of its own and shares the
+    // previous one's time.
+    std::vector<Mark> marks_;
+    std::atomic<uint64_t> mark_head_{0};
+    std::atomic<uint64_t> mark_tail_{0};
+    int64_t received_ns_ = 0;  // consumer side
+    std::mutex mu_;
+    std::condition_variable cv_;
+
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+
+    // Driver counts at open() and our totals before it; the atomics below
+    // are cumulative over reopens.
+    LineCounts at_open_;
+    LineCounts base_;
+    std::atomic<uint64_t> overruns_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> kernel_drops_{0};
+    std::atomic<uint64_t> ring_drops_{0};
+};
+
+}  // namespace fr
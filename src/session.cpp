@@ -0,0 +1,91 @@
+#include "session.hpp"
+
+#include "channels.hpp"
+
+namespace fr {
+
+namespace {
+
+constexpr uint8_t kMavTypeGcs = 6;
+constexpr uint8_t kMavAutopilotInvalid = 8;  // GCSs, companions, gimbals, this recorder
+constexpr uint8_t kMavModeFlagSafetyArmed = 0x80;
+constexpr uint8_t kMavLandedStateOnGround = 1;
+constexpr uint8_t kMavLandedStateInAir = 2;
+constexpr uint8_t kMavLandedStateTakeoff = 3;
+constexpr uint8_t kMavLandedStateLanding = 4;
+
+// MAVLink 2 truncates trailing zero bytes; read them back as zeros.
+uint8_t payload_byte(const MavFrame& f, size_t i) { return i < f.payload_len ? f.payload[i] : 0; }
+
+std::string time_or_dash(int64_t t) { return t ? std::to_string(t) : "-"; }
+
+}  // namespace
+
+Record session_record(SessionEvent ev, uint8_t sysid, int64_t t_ns, uint16_t source) {
+    Record r;
+    r.t_ns = t_ns;
+    r.channel = channel::make(channel::kMeta, channel::kMetaSession);
+    r.source = source;
+    r.vehicle = sysid;
+    r.blob = true;
+    r.bytes.push_back(static_cast<char>(ev));
+    r.bytes.push_back(static_cast<char>(sysid));
+    return r;
+}
+
+bool parse_session_record(const Record& r, SessionEvent* ev, uint8_t* sysid) {
+    if (!r.blob || r.channel != channel::make(channel::kMeta, channel::kMetaSession) || r.bytes.size() < 2) return false;
+    const auto code = static_cast<uint8_t>(r.bytes[0]);
+    if (code < static_cast<uint8_t>(SessionEvent::Arm) || code > static_cast<uint8_t>(SessionEvent::Landing)) return false;
+    *ev = static_cast<SessionEvent>(code);
+    *sysid = static_cast<uint8_t>(r.bytes[1]);
+    return true;
+}
+
+bool SessionDetector::observe(const MavFrame& f, SessionEvent* ev) {
+    Vehicle& v = vehicles_[f.sysid];
+    if (f.msgid == mavlink::kMsgHeartbeat) {
+        // custom_mode u32, type, autopilot, base_mode, system_status, version
+        if (payload_byte(f, 4) == kMavTypeGcs || payload_byte(f, 5) == kMavAutopilotInvalid) return false;
+        const bool armed = (payload_byte(f, 6) & kMavModeFlagSafetyArmed) != 0;
+        const bool changed = v.seen ? armed != v.armed : armed;
+        v.seen = true;
+        v.armed = armed;
+        if (!changed) return false;
+        *ev = armed ? SessionEvent::Arm : SessionEvent::Disarm;
+        return true;
+    }
+    if (f.msgid == mavlink::kMsgExtendedSysState) {
+        // vtol_state, landed_state
+        const uint8_t landed = payload_byte(f, 1);
+        const bool in_air = landed == kMavLandedStateInAir || landed == kMavLandedStateTakeoff ||
+                            landed == kMavLandedStateLanding;
+        // Undefined (0) says nothing either way.
+        if (!in_air && landed != kMavLandedStateOnGround) return false;
+        if (in_air == v.in_air) return false;
+        v.in_air = in_air;
+        *ev = in_air ? SessionEvent::Takeoff : SessionEvent::Landing;
+        return true;
+    }
+    return false;
+}
+
+std::string SessionTimes::format() const {
+    return "session " + time_or_dash(arm_ns) + " " + time_or_dash(takeoff_ns) + " " + time_or_dash(landing_ns) + " " +
+           time_or_dash(disarm_ns) + " " + std::to_string(pre_roll) + "\n";
+}
+
+size_t PreRoll::push(Record&& r) {
+    const int64_t oldest = r.t_ns - span_ns_;
+    bytes_ += cost(r);
+    q_.push_back(std::move(r));
+    size_t n = 0;
+    while (!q_.empty() && (q_.front().t_ns < oldest || bytes_ > max_bytes_)) {
+        bytes_ -= cost(q_.front());
+        q_.pop_front();
+        n++;
+    }
+    return n;
+}
+
+}  // namespace fr
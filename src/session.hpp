@@ -0,0 +1,105 @@
+// Flight sessions: one flight directory per sortie instead of one per power
+// cycle.
+//
+// A SessionDetector per source watches vehicle HEARTBEATs (the armed bit of
+// base_mode) and EXTENDED_SYS_STATE (landed state) and turns changes into
+// channel::kMetaSession records. Those travel through the merge queue like
+// any other record, so the writer sees each boundary in time order with the
+// data around it and cuts flights exactly there.
+//
+// While no vehicle is armed the writer keeps the last pre_roll of records
+// in a PreRoll buffer instead of writing them. Arming opens a new flight and
+// writes the buffer into it first, so the moments before arming (pre-flight
+// checks, the arming command itself) are part of the sortie. Disarming
+// starts a post-roll; when it runs out the flight is handed to the task pool
+// to be sealed, and the writer thread carries straight on.
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "mavlink.hpp"
+#include "record.hpp"
+
+namespace fr {
+
+struct SessionConfig {
+    bool enabled = false;  // off: one flight per power cycle
+    std::chrono::milliseconds pre_roll{30000};
+    std::chrono::milliseconds post_roll{5000};
+    size_t pre_roll_bytes = 64u << 20;  // per vehicle
+};
+
+enum class SessionEvent : uint8_t {
+    Arm = 1,
+    Disarm = 2,
+    Takeoff = 3,
+    Landing = 4,
+};
+
+// kMetaSession record payload: event, then the vehicle's system id.
+Record session_record(SessionEvent ev, uint8_t sysid, int64_t t_ns, uint16_t source);
+bool parse_session_record(const Record& r, SessionEvent* ev, uint8_t* sysid);
+
+// Touched only by its source's thread, like the framers. Every source that
+// sees a vehicle reports its transitions; the writer ignores repeats.
+class SessionDetector {
+public:
+    // True with *ev set when `f` changes its vehicle's armed or in-air state.
+    // A vehicle first seen armed (or flying) reports Arm (or Takeoff).
+    bool observe(const MavFrame& f, SessionEvent* ev);
+
+private:
+    struct Vehicle {
+        bool seen = false;
+        bool armed = false;
+        bool in_air = false;
+    };
+    Vehicle vehicles_[256];  // by system id
+};
+
+// Times of a sortie's events, CLOCK_MONOTONIC like record timestamps; 0:
+// did not happen (yet).
+struct SessionTimes {
+    int64_t arm_ns = 0;      // first arm
+    int64_t takeoff_ns = 0;  // first takeoff
+    int64_t landing_ns = 0;  // last landing
+    int64_t disarm_ns = 0;   // last disarm
+    uint64_t pre_roll = 0;   // records written from the pre-roll buffer
+
+    // Manifest line (see hash_chain.hpp):
+    //   session <arm> <takeoff|-> <landing|-> <disarm|-> <pre-roll records>
+    std::string format() const;
+};
+
+// Records from the last `span` (and at most `max_bytes` of them), oldest
+// first. Expects records in merge order; the newest sets the window.
+class PreRoll {
+public:
+    PreRoll(std::chrono::nanoseconds span, size_t max_bytes) : span_ns_(span.count()), max_bytes_(max_bytes) {}
+
+    // Returns how many old records made room for it.
+    size_t push(Record&& r);
+    // Hands every buffered record to fn(Record&&) and empties the buffer.
+    template <typename F>
+    void drain(F&& fn) {
+        for (Record& r : q_) fn(std::move(r));
+        q_.clear();
+        bytes_ = 0;
+    }
+
+    size_t size() const { return q_.size(); }
+
+private:
+    static size_t cost(const Record& r) { return sizeof(Record) + r.bytes.size(); }
+
+    const int64_t span_ns_;
+    const size_t max_bytes_;
+    std::deque<Record> q_;
+    size_t bytes_ = 0;
+};
+
+}  // namespace fr
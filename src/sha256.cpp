@@ -0,0 +1,223 @@
+#include "sha256.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define FR_SHA_X86 1
+#endif
+
+namespace fr {
+
+namespace {
+
+constexpr uint32_t kK[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline uint32_t load_be32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+           static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+}
+
+void compress_portable(uint32_t state[8], const uint8_t* blocks, size_t n) {
+    for (; n > 0; --n, blocks += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) w[i] = load_be32(blocks + 4 * i);
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kK[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef FR_SHA_X86
+
+#define FR_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+
+// SHA extensions: the state lives as ABEF/CDGH register pairs, each
+// sha256rnds2 does two rounds, and msg1/msg2 extend the schedule four words
+// at a time.
+FR_SHANI void compress_shani(uint32_t h[8], const uint8_t* blocks, size_t n) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h)), 0xb1);        // CDAB
+    __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + 4)), 0x1b);   // EFGH
+    __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+    for (; n > 0; --n, blocks += 64) {
+        const __m128i abef_in = abef;
+        const __m128i cdgh_in = cdgh;
+        __m128i w[4];
+        for (int i = 0; i < 16; ++i) {
+            __m128i& m = w[i & 3];
+            if (i < 4) {
+                m = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), bswap);
+            } else {
+                m = _mm_sha256msg1_epu32(m, w[(i - 3) & 3]);
+                m = _mm_add_epi32(m, _mm_alignr_epi8(w[(i - 1) & 3], w[(i - 2) & 3], 4));
+                m = _mm_sha256msg2_epu32(m, w[(i - 1) & 3]);
+            }
+            __m128i k = _mm_add_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i*>(kK + 4 * i)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, k);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(k, 0x0e));
+        }
+        abef = _mm_add_epi32(abef, abef_in);
+        cdgh = _mm_add_epi32(cdgh, cdgh_in);
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1b);   // FEBA
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);  // DCHG
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(h), _mm_blend_epi16(tmp, cdgh, 0xf0));     // DCBA
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(h + 4), _mm_alignr_epi8(cdgh, tmp, 8));  // HGFE
+}
+
+// GCC does not know "sha" for __builtin_cpu_supports; CPUID.(7,0):EBX[29].
+bool detect_hardware() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d) || !(b & (1u << 29))) return false;
+    return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+}
+
+#else
+
+bool detect_hardware() { return false; }
+
+#endif
+
+}  // namespace
+
+bool Sha256::hardware() {
+    static const bool hw = detect_hardware();
+    return hw;
+}
+
+void Sha256::reset() {
+    static constexpr uint32_t kInit[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                          0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::memcpy(h_, kInit, sizeof(h_));
+    buf_len_ = 0;
+    total_ = 0;
+}
+
+void Sha256::compress(const uint8_t* blocks, size_t n) {
+#ifdef FR_SHA_X86
+    if (hardware()) {
+        compress_shani(h_, blocks, n);
+        return;
+    }
+#endif
+    compress_portable(h_, blocks, n);
+}
+
+void Sha256::update(const void* data, size_t len) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    total_ += len;
+    if (buf_len_ > 0) {
+        size_t take = 64 - buf_len_ < len ? 64 - buf_len_ : len;
+        std::memcpy(buf_ + buf_len_, p, take);
+        buf_len_ += take;
+        p += take;
+        len -= take;
+        if (buf_len_ < 64) return;
+        compress(buf_, 1);
+        buf_len_ = 0;
+    }
+    if (len >= 64) {
+        compress(p, len / 64);
+        p += len & ~size_t{63};
+        len &= 63;
+    }
+    std::memcpy(buf_, p, len);
+    buf_len_ = len;
+}
+
+Sha256Digest Sha256::finish() {
+    uint64_t bits = total_ * 8;
+    uint8_t pad[72] = {0x80};
+    size_t pad_len = (buf_len_ < 56 ? 56 : 120) - buf_len_;
+    for (int i = 0; i < 8; ++i) pad[pad_len + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    update(pad, pad_len + 8);
+
+    Sha256Digest out;
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<uint8_t>(h_[i] >> 24);
+        out[4 * i + 1] = static_cast<uint8_t>(h_[i] >> 16);
+        out[4 * i + 2] = static_cast<uint8_t>(h_[i] >> 8);
+        out[4 * i + 3] = static_cast<uint8_t>(h_[i]);
+    }
+    reset();
+    return out;
+}
+
+Sha256Digest Sha256::hash(const void* data, size_t len) {
+    Sha256 s;
+    s.update(data, len);
+    return s.finish();
+}
+
+Sha256Digest hmac_sha256(const void* key, size_t key_len, const void* data, size_t len) {
+    uint8_t k[64] = {};
+    if (key_len > sizeof(k)) {
+        Sha256Digest d = Sha256::hash(key, key_len);
+        std::memcpy(k, d.data(), d.size());
+    } else {
+        std::memcpy(k, key, key_len);
+    }
+    uint8_t pad[64];
+    Sha256 inner;
+    for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = static_cast<uint8_t>(k[i] ^ 0x36);
+    inner.update(pad, sizeof(pad));
+    inner.update(data, len);
+    const Sha256Digest ih = inner.finish();
+    Sha256 outer;
+    for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = static_cast<uint8_t>(k[i] ^ 0x5c);
+    outer.update(pad, sizeof(pad));
+    outer.update(ih.data(), ih.size());
+    return outer.finish();
+}
+
+std::string to_hex(const Sha256Digest& d) {
+    static const char kHex[] = "0123456789abcdef";
+    std::string s(64, '0');
+    for (size_t i = 0; i < d.size(); ++i) {
+        s[2 * i] = kHex[d[i] >> 4];
+        s[2 * i + 1] = kHex[d[i] & 15];
+    }
+    return s;
+}
+
+}  // namespace fr
@@ -0,0 +1,42 @@
+// SHA-256, incremental. Used for content-addressed offload chunks, the
+// segment hash chain and, via HMAC, per-segment encryption keys and manifest
+// signatures. Uses the x86 SHA extensions when the CPU has them.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace fr {
+
+using Sha256Digest = std::array<uint8_t, 32>;
+
+class Sha256 {
+public:
+    Sha256() { reset(); }
+
+    void reset();
+    void update(const void* data, size_t len);
+    Sha256Digest finish();
+
+    static Sha256Digest hash(const void* data, size_t len);
+
+    // True when the SHA-NI path is in use.
+    static bool hardware();
+
+private:
+    void compress(const uint8_t* blocks, size_t n);
+
+    uint32_t h_[8];
+    uint8_t buf_[64];
+    size_t buf_len_;
+    uint64_t total_;
+};
+
+// HMAC-SHA-256 (RFC 2104).
+Sha256Digest hmac_sha256(const void* key, size_t key_len, const void* data, size_t len);
+
+std::string to_hex(const Sha256Digest& d);
+
+}  // namespace fr
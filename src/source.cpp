@@ -0,0 +1,140 @@
+#include "source.hpp"
+
+#include <poll.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+#include "can_source.hpp"
+#include "serial_source.hpp"
+#include "udp_source.hpp"
+
+namespace fr {
+
+bool parse_source_spec(const std::string& text, SourceSpec* out, std::string* err) {
+    SourceSpec s;
+    s.name = text;
+    size_t c1 = text.find(':');
+    if (c1 == std::string::npos) {
+        *err = "source '" + text + "': expected kind:args";
+        return false;
+    }
+    std::string kind = text.substr(0, c1);
+    size_t plus = kind.find('+');
+    if (plus != std::string::npos) {
+        std::string proto = kind.substr(0, plus);
+        kind = kind.substr(plus + 1);
+        if (proto == "ubx") {
+            s.protocol = LinkProtocol::Ubx;
+        } else if (proto == "rtcm3") {
+            s.protocol = LinkProtocol::Rtcm3;
+        } else if (proto == "gnss") {
+            s.protocol = LinkProtocol::Gnss;
+        } else if (proto == "dronecan") {
+            s.protocol = LinkProtocol::DroneCan;
+        } else if (proto != "mavlink") {
+            *err = "source '" + text + "': unknown protocol '" + proto + "'";
+            return false;
+        }
+    }
+    std::string rest = text.substr(c1 + 1);
+    size_t c2 = rest.rfind(':');
+    if (kind == "serial") {
+        s.kind = SourceKind::Serial;
+        s.path = c2 == std::string::npos ? rest : rest.substr(0, c2);
+        s.baud = c2 == std::string::npos ? 115200 : static_cast<uint32_t>(std::strtoul(rest.c_str() + c2 + 1, nullptr, 10));
+    } else if (kind == "udp") {
+        s.kind = SourceKind::Udp;
+        if (c2 == std::string::npos) {
+            *err = "source '" + text + "': expected udp:ADDR:PORT";
+            return false;
+        }
+        s.path = rest.substr(0, c2);
+        s.port = static_cast<uint16_t>(std::strtoul(rest.c_str() + c2 + 1, nullptr, 10));
+    } else if (kind == "can") {
+        s.kind = SourceKind::Can;
+        s.path = rest;
+        if (s.protocol != LinkProtocol::Mavlink && s.protocol != LinkProtocol::DroneCan) {
+            *err = "source '" + text + "': CAN sources carry CAN frames only";
+            return false;
+        }
+    } else {
+        *err = "source '" + text + "': unknown kind '" + kind + "'";
+        return false;
+    }
+    if (s.kind != SourceKind::Can && s.protocol == LinkProtocol::DroneCan) {
+        *err = "source '" + text + "': DroneCAN needs a CAN source";
+        return false;
+    }
+    if (s.path.empty()) {
+        *err = "source '" + text + "': missing device";
+        return false;
+    }
+    *out = s;
+    return true;
+}
+
+std::string format_source_spec(const SourceSpec& spec) {
+    std::string proto;
+    switch (spec.protocol) {
+        case LinkProtocol::Mavlink: break;
+        case LinkProtocol::Ubx: proto = "ubx+"; break;
+        case LinkProtocol::Rtcm3: proto = "rtcm3+"; break;
+        case LinkProtocol::Gnss: proto = "gnss+"; break;
+        case LinkProtocol::DroneCan: proto = "dronecan+"; break;
+    }
+    switch (spec.kind) {
+        case SourceKind::Serial: return proto + "serial:" + spec.path + ":" + std::to_string(spec.baud);
+        case SourceKind::Udp: return proto + "udp:" + spec.path + ":" + std::to_string(spec.port);
+        case SourceKind::Can: return proto + "can:" + spec.path;
+    }
+    return {};
+}
+
+std::string format_source_table(const std::vector<SourceSpec>& specs) {
+    std::string out;
+    for (const auto& s : specs) out += format_source_spec(s) + "\t" + s.name + "\n";
+    return out;
+}
+
+std::vector<SourceSpec> parse_source_table(const std::string& text) {
+    std::vector<SourceSpec> specs;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        std::string line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        size_t tab = line.find('\t');
+        SourceSpec spec;
+        std::string err;
+        // Keep indices aligned even if a line is unreadable.
+        if (parse_source_spec(line.substr(0, tab), &spec, &err) && tab != std::string::npos) spec.name = line.substr(tab + 1);
+        specs.push_back(spec);
+    }
+    return specs;
+}
+
+const std::vector<uint32_t>& Source::datagrams() const {
+    static const std::vector<uint32_t> kNone;
+    return kNone;
+}
+
+std::unique_ptr<Source> make_source(const SourceSpec& spec, const SourceOptions& opts) {
+    switch (spec.kind) {
+        case SourceKind::Serial: return std::make_unique<SerialSource>(spec, opts.serial);
+        case SourceKind::Udp: return std::make_unique<UdpSource>(spec, opts.udp);
+        case SourceKind::Can: return std::make_unique<CanSource>(spec);
+    }
+    return nullptr;
+}
+
+int wait_readable(int fd, int timeout_ms) {
+    pollfd pfd{fd, POLLIN, 0};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0) return errno == EINTR ? 0 : -1;
+    if (rc == 0) return 0;
+    return (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) && !(pfd.revents & POLLIN) ? -1 : 1;
+}
+
+}  // namespace fr
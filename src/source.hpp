@@ -0,0 +1,126 @@
+// Ingest sources. Each source is driven by its own thread (see SourceManager):
+// open() may block on device setup, read() blocks for at most `timeout_ms`.
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fr {
+
+enum class SourceKind { Serial, Udp, Can };
+
+// What a source carries beyond its raw bytes or frames.
+enum class LinkProtocol {
+    Mavlink,   // serial/UDP default; on CAN: raw frames only
+    Ubx,       // u-blox UBX only
+    Rtcm3,     // RTCM3 only
+    Gnss,      // UBX and RTCM3 interleaved (NMEA is skipped)
+    DroneCan,  // CAN only: raw frames plus reassembled transfers
+};
+
+// How bytes returned by read() are delimited.
+enum class Framing {
+    Stream,    // arbitrary byte stream; frames may straddle reads
+    Datagram,  // each read() returns whole datagrams, see Source::datagrams()
+    CanFrame,  // each read() returns whole struct can_frame records
+};
+
+struct SourceSpec {
+    std::string name;  // unique, used in logs and metadata
+    SourceKind kind = SourceKind::Serial;
+    std::string path;  // device node, interface, or bind address
+    uint32_t baud = 0;
+    uint16_t port = 0;
+    LinkProtocol protocol = LinkProtocol::Mavlink;
+};
+
+// Receive tuning for UDP sources (udp_source.hpp).
+struct UdpOptions {
+    unsigned batch = 32;          // messages per recvmmsg()
+    size_t max_datagram = 9216;   // receive slot without GRO; longer datagrams are truncated
+    int rcvbuf_bytes = 4 << 20;   // SO_RCVBUF; 0: system default
+    bool gro = true;              // UDP_GRO where the kernel supports it
+};
+
+// UART tuning (serial_source.hpp).
+struct SerialOptions {
+    size_t ring_bytes = 1u << 20;  // between the UART reader thread and the parser
+    unsigned coalesce_us = 1000;   // longest wait to let a small read grow; 0: read at once
+    bool low_latency = true;       // ASYNC_LOW_LATENCY, USB-serial latency_timer = 1 ms
+};
+
+struct SourceOptions {
+    UdpOptions udp;
+    SerialOptions serial;
+};
+
+// Link-level losses the source can see but the recorder cannot.
+struct SourceCounters {
+    uint64_t kernel_drops = 0;    // discarded by the kernel: socket or tty buffer full
+    uint64_t truncated = 0;       // datagrams longer than the receive slot
+    uint64_t overruns = 0;        // UART hardware FIFO overruns
+    uint64_t framing_errors = 0;  // UART framing and parity errors
+    uint64_t ring_drops = 0;      // bytes lost to a full ingest ring
+
+    // Everything that never reached the parser.
+    uint64_t lost() const { return kernel_drops + truncated + overruns + ring_drops; }
+    SourceCounters& operator+=(const SourceCounters& o) {
+        kernel_drops += o.kernel_drops;
+        truncated += o.truncated;
+        overruns += o.overruns;
+        framing_errors += o.framing_errors;
+        ring_drops += o.ring_drops;
+        return *this;
+    }
+};
+
+// Parses "serial:/dev/ttyACM0:921600", "udp:0.0.0.0:14550" or "can:can0",
+// optionally prefixed with a protocol other than MAVLink:
+// "ubx+serial:/dev/ttyACM1:460800", "rtcm3+udp:0.0.0.0:2101", "gnss+...",
+// "dronecan+can:can0".
+// The spec string itself becomes the default name.
+bool parse_source_spec(const std::string& text, SourceSpec* out, std::string* err);
+// Inverse of parse_source_spec (without the name).
+std::string format_source_spec(const SourceSpec& spec);
+
+// Source table stored in every segment (channel::kMetaSources) so offline
+// tools know how each source index was framed: one "spec<TAB>name" line per
+// source, in index order.
+std::string format_source_table(const std::vector<SourceSpec>& specs);
+std::vector<SourceSpec> parse_source_table(const std::string& text);
+
+class Source {
+public:
+    virtual ~Source() = default;
+
+    virtual const SourceSpec& spec() const = 0;
+    virtual Framing framing() const = 0;
+
+    // Opens and configures the device. False (with *err) if it is absent or
+    // not ready yet; the caller retries.
+    virtual bool open(std::string* err) = 0;
+    // > 0: bytes read; 0: timeout; < 0: the device went away (close and reopen).
+    virtual ssize_t read(uint8_t* buf, size_t cap, int timeout_ms) = 0;
+    virtual void close() = 0;
+
+    // Framing::Datagram only: lengths of the datagrams packed back to back by
+    // the last read(). Empty means the whole read is one datagram.
+    virtual const std::vector<uint32_t>& datagrams() const;
+    // monotonic_ns() at which the bytes of the last read() were received, for
+    // sources that buffer ahead of the caller; 0: the caller stamps them.
+    virtual int64_t received_ns() const { return 0; }
+    // Cumulative over reopens; safe to call from any thread.
+    virtual SourceCounters counters() const { return {}; }
+};
+
+std::unique_ptr<Source> make_source(const SourceSpec& spec, const SourceOptions& opts = {});
+
+// Waits up to timeout_ms for fd to become readable: 1 ready, 0 timeout, -1 error.
+int wait_readable(int fd, int timeout_ms);
+
+}  // namespace fr
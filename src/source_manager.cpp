@@ -0,0 +1,116 @@
+#include "source_manager.hpp"
+
+#include <chrono>
+
+#include "clock.hpp"
+#include "log.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+SourceManager::SourceManager(std::vector<std::unique_ptr<Source>> sources, SourceCallbacks cb,
+                             SourceRetryPolicy policy)
+    : cb_(std::move(cb)), policy_(policy) {
+    for (auto& s : sources) {
+        auto slot = std::make_unique<Slot>();
+        slot->source = std::move(s);
+        slots_.push_back(std::move(slot));
+    }
+}
+
+SourceManager::~SourceManager() { stop(); }
+
+void SourceManager::start() {
+    stop_.store(false);
+    start_ns_ = monotonic_ns();
+    for (size_t i = 0; i < slots_.size(); ++i) slots_[i]->thread = std::thread([this, i] { run(i); });
+}
+
+void SourceManager::stop() {
+    {
+        std::lock_guard<std::mutex> lk(stop_mu_);
+        stop_.store(true);
+    }
+    stop_cv_.notify_all();
+    for (auto& slot : slots_)
+        if (slot->thread.joinable()) slot->thread.join();
+}
+
+bool SourceManager::sleep_for_ms(int ms) {
+    std::unique_lock<std::mutex> lk(stop_mu_);
+    return !stop_cv_.wait_for(lk, std::chrono::milliseconds(ms), [this] { return stop_.load(); });
+}
+
+std::vector<SourceManager::Status> SourceManager::status() const {
+    std::vector<Status> out;
+    for (const auto& slot : slots_) {
+        out.push_back(Status{slot->source->spec().name, static_cast<State>(slot->state.load()), slot->opens.load(),
+                             slot->open_failures.load(), slot->bytes.load(), slot->first_data_ns.load(),
+                             slot->source->counters()});
+    }
+    return out;
+}
+
+void SourceManager::run(size_t index) {
+    Slot& slot = *slots_[index];
+    Source& src = *slot.source;
+    const std::string& name = src.spec().name;
+    set_thread_name(("fr-src-" + std::to_string(index)).c_str());
+
+    std::vector<uint8_t> buf(policy_.read_buffer_bytes);
+    int backoff = policy_.initial_backoff_ms;
+    while (!stop_.load()) {
+        slot.state.store(static_cast<int>(State::Opening));
+        std::string err;
+        if (!src.open(&err)) {
+            // Log the first failure loudly; repeats are expected while a
+            // device is absent and would only flood the log.
+            if (slot.open_failures.fetch_add(1) == 0)
+                FR_LOG_WARN("source %s not available (%s), retrying in background", name.c_str(), err.c_str());
+            else
+                FR_LOG_DEBUG("source %s: %s", name.c_str(), err.c_str());
+            slot.state.store(static_cast<int>(State::Waiting));
+            if (!sleep_for_ms(backoff)) break;
+            backoff = backoff * 2 > policy_.max_backoff_ms ? policy_.max_backoff_ms : backoff * 2;
+            continue;
+        }
+        backoff = policy_.initial_backoff_ms;
+        slot.opens++;
+        slot.state.store(static_cast<int>(State::Open));
+        FR_LOG_INFO("source %s open after %.1f ms", name.c_str(), (monotonic_ns() - start_ns_) / 1e6);
+        if (cb_.on_state) cb_.on_state(index, true);
+
+        while (!stop_.load()) {
+            ssize_t n = src.read(buf.data(), buf.size(), policy_.read_timeout_ms);
+            if (n == 0) continue;
+            if (n < 0) {
+                FR_LOG_WARN("source %s lost, reopening", name.c_str());
+                break;
+            }
+            int64_t t = src.received_ns();
+            if (t == 0) t = monotonic_ns();
+            if (slot.first_data_ns.load(std::memory_order_relaxed) == 0) {
+                slot.first_data_ns.store(t);
+                int64_t expected = 0;
+                if (first_data_ns_.compare_exchange_strong(expected, t))
+                    FR_LOG_INFO("recording started on %s, %.1f ms after startup", name.c_str(), (t - start_ns_) / 1e6);
+            }
+            slot.bytes.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+            const std::vector<uint32_t>& units = src.datagrams();
+            if (units.empty()) {
+                cb_.on_data(index, buf.data(), static_cast<size_t>(n), t);
+                continue;
+            }
+            size_t off = 0;
+            for (uint32_t len : units) {
+                cb_.on_data(index, buf.data() + off, len, t);
+                off += len;
+            }
+        }
+        src.close();
+        if (cb_.on_state) cb_.on_state(index, false);
+    }
+    slot.state.store(static_cast<int>(State::Stopped));
+}
+
+}  // namespace fr
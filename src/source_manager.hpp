@@ -0,0 +1,92 @@
+// Brings up all configured sources in parallel and keeps them alive.
+//
+// Every source gets its own thread from the moment start() is called, so a
+// slow or absent device never delays the others: the first source to deliver
+// data starts the recording, and the rest join as they appear. Sources that
+// fail to open, or disappear later, are retried in the background with capped
+// exponential backoff.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "source.hpp"
+
+namespace fr {
+
+struct SourceRetryPolicy {
+    int initial_backoff_ms = 50;
+    int max_backoff_ms = 2000;
+    int read_timeout_ms = 100;  // also bounds how long stop() waits for a reader
+    size_t read_buffer_bytes = 64u << 10;
+};
+
+struct SourceCallbacks {
+    // Runs on the source's thread; `data` is valid only for the call.
+    // Datagram sources get one call per datagram.
+    std::function<void(size_t index, const uint8_t* data, size_t len, int64_t t_ns)> on_data;
+    // Optional: source opened (true) or lost (false).
+    std::function<void(size_t index, bool open)> on_state;
+};
+
+class SourceManager {
+public:
+    enum class State { Opening, Open, Waiting, Stopped };
+
+    struct Status {
+        std::string name;
+        State state;
+        uint64_t opens;
+        uint64_t open_failures;
+        uint64_t bytes;
+        int64_t first_data_ns;  // 0 until the source has delivered anything
+        SourceCounters counters;
+    };
+
+    SourceManager(std::vector<std::unique_ptr<Source>> sources, SourceCallbacks cb, SourceRetryPolicy policy = {});
+    ~SourceManager();
+
+    SourceManager(const SourceManager&) = delete;
+    SourceManager& operator=(const SourceManager&) = delete;
+
+    void start();
+    void stop();
+
+    size_t size() const { return slots_.size(); }
+    std::vector<Status> status() const;
+    // Monotonic time of the first byte from any source; 0 if none yet.
+    int64_t first_data_ns() const { return first_data_ns_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::unique_ptr<Source> source;
+        std::thread thread;
+        std::atomic<int> state{static_cast<int>(State::Opening)};
+        std::atomic<uint64_t> opens{0};
+        std::atomic<uint64_t> open_failures{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<int64_t> first_data_ns{0};
+    };
+
+    void run(size_t index);
+    bool sleep_for_ms(int ms);
+
+    std::vector<std::unique_ptr<Slot>> slots_;
+    const SourceCallbacks cb_;
+    const SourceRetryPolicy policy_;
+
+    std::atomic<bool> stop_{false};
+    std::mutex stop_mu_;
+    std::condition_variable stop_cv_;
+    int64_t start_ns_ = 0;
+    std::atomic<int64_t> first_data_ns_{0};
+};
+
+}  // namespace fr
@@ -0,0 +1,69 @@
+// Bounded single-producer/single-consumer ring. Lock-free and wait-free:
+// push and pop each touch one shared index, and each side caches the other's
+// index so the shared cache line is only read when the ring looks full
+// (producer) or empty (consumer).
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace fr {
+
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side. False if full; `v` is left untouched then.
+    bool try_push(T&& v) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) return false;
+        }
+        slots_[tail & mask_] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. False if empty.
+    bool try_pop(T* out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return false;
+        }
+        *out = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from a third thread. Head first: a tail read
+    // later is never behind it.
+    size_t size() const {
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};  // next slot to pop; written by the consumer
+    size_t tail_cache_ = 0;                    // consumer's copy of tail_
+    alignas(64) std::atomic<size_t> tail_{0};  // next slot to push; written by the producer
+    size_t head_cache_ = 0;                    // producer's copy of head_
+};
+
+}  // namespace fr
@@ -0,0 +1,120 @@
+#include "storage_layout.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <utility>
+
+#include "fs_util.hpp"
+
+namespace fr {
+namespace layout {
+
+namespace {
+constexpr const char* kSegmentPrefix = "seg-";
+constexpr size_t kSeqDigits = 6;
+
+bool ends_with(const std::string& s, const char* suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+}  // namespace
+
+std::string flights_dir(const std::string& root) { return root + "/" + kFlightsDir; }
+
+std::string flight_dir(const std::string& root, const std::string& flight_id) {
+    return flights_dir(root) + "/" + flight_id;
+}
+
+std::string manifest_path(const std::string& root, const std::string& flight_id) {
+    return flight_dir(root, flight_id) + "/" + kManifestName;
+}
+
+std::string catalog_snapshot_path(const std::string& root, int slot) {
+    return root + "/catalog." + std::to_string(slot) + ".snap";
+}
+
+std::string catalog_journal_path(const std::string& root, int slot) {
+    return root + "/catalog." + std::to_string(slot) + ".jnl";
+}
+
+std::string segment_name(uint32_t seq, seg::Tier tier) {
+    char buf[48];
+    const char* infix = seg::tier_suffix(tier);
+    std::snprintf(buf, sizeof(buf), "%s%06u%s%s%s", kSegmentPrefix, seq, *infix ? "." : "", infix, kSegmentExt);
+    return buf;
+}
+
+std::string open_segment_name(uint32_t seq, seg::Tier tier) { return segment_name(seq, tier) + kOpenSuffix; }
+
+bool is_sealed_segment(const std::string& name) {
+    return name.compare(0, 4, kSegmentPrefix) == 0 && ends_with(name, kSegmentExt);
+}
+
+bool is_open_segment(const std::string& name) {
+    return name.compare(0, 4, kSegmentPrefix) == 0 && ends_with(name, kOpenSuffix);
+}
+
+seg::Tier segment_tier(const std::string& name) {
+    for (int t = 1; t < seg::kTierCount; ++t) {
+        auto tier = static_cast<seg::Tier>(t);
+        std::string infix = std::string(".") + seg::tier_suffix(tier) + kSegmentExt;
+        if (name.find(infix) != std::string::npos) return tier;
+    }
+    return seg::Tier::Raw;
+}
+
+bool parse_segment_seq(const std::string& name, uint32_t* seq) {
+    if (name.compare(0, 4, kSegmentPrefix) != 0 || name.size() < 4 + kSeqDigits) return false;
+    uint32_t v = 0;
+    for (size_t i = 4; i < 4 + kSeqDigits; ++i) {
+        char c = name[i];
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + static_cast<uint32_t>(c - '0');
+    }
+    *seq = v;
+    return true;
+}
+
+std::string make_flight_id(int64_t realtime_ns) {
+    time_t secs = static_cast<time_t>(realtime_ns / 1000000000);
+    tm utc{};
+    gmtime_r(&secs, &utc);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y%m%dT%H%M%SZ", &utc);
+    return buf;
+}
+
+std::string latest_flight(const std::string& root) {
+    std::vector<std::string> all = list_dir(flights_dir(root));
+    return all.empty() ? std::string() : all.back();
+}
+
+std::vector<std::string> raw_segment_paths(const std::string& root, const std::string& flight_id) {
+    std::vector<std::string> paths;
+    for (auto& f : segment_paths(root, flight_id, seg::Tier::Raw)) paths.push_back(std::move(f.second));
+    return paths;
+}
+
+std::vector<std::pair<uint32_t, std::string>> segment_paths(const std::string& root, const std::string& flight_id,
+                                                            seg::Tier tier) {
+    const std::string dir = flight_dir(root, flight_id);
+    std::vector<std::pair<uint32_t, std::string>> found;
+    for (const auto& name : list_dir(dir)) {
+        uint32_t seq = 0;
+        const bool usable = is_sealed_segment(name) || (tier == seg::Tier::Raw && is_open_segment(name));
+        if (usable && segment_tier(name) == tier && parse_segment_seq(name, &seq)) found.emplace_back(seq, dir + "/" + name);
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+std::string vehicle_flight_id(const std::string& flight_id, uint8_t sysid) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "-sys%03u", sysid);
+    return flight_id + buf;
+}
+
+}  // namespace layout
+}  // namespace fr
@@ -0,0 +1,70 @@
+// On-disk layout of a recording root. Every component that walks or writes the
+// store goes through these helpers so the naming rules live in one place.
+//
+//   <root>/flights/<flight-id>/seg-000001.frs        sealed segment
+//   <root>/flights/<flight-id>/seg-000001.r1s.frs    1 s rollup of segment 1
+//   <root>/flights/<flight-id>/seg-000002.frs.open   segment being written
+//   <root>/flights/<flight-id>/KEEP                  flagged: never reclaimed
+//   <root>/flights/<flight-id>/MANIFEST              signed hash chain of the raw segments
+//   <root>/catalog.0.snap, <root>/catalog.0.jnl      catalogue snapshot + journal
+//   <root>/catalog.1.snap, <root>/catalog.1.jnl        (two generations, alternating)
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "segment_format.hpp"
+
+namespace fr {
+namespace layout {
+
+constexpr const char* kFlightsDir = "flights";
+constexpr const char* kSegmentExt = ".frs";
+constexpr const char* kOpenSuffix = ".open";
+constexpr const char* kKeepMarker = "KEEP";
+constexpr const char* kManifestName = "MANIFEST";
+
+std::string flights_dir(const std::string& root);
+std::string flight_dir(const std::string& root, const std::string& flight_id);
+std::string manifest_path(const std::string& root, const std::string& flight_id);
+
+// Catalogue files for slot 0 or 1; see catalog.hpp.
+std::string catalog_snapshot_path(const std::string& root, int slot);
+std::string catalog_journal_path(const std::string& root, int slot);
+
+// seg-000042.frs, or seg-000042.r10s.frs for a rollup tier.
+std::string segment_name(uint32_t seq, seg::Tier tier = seg::Tier::Raw);
+// seg-000042.frs.open
+std::string open_segment_name(uint32_t seq, seg::Tier tier = seg::Tier::Raw);
+
+bool is_sealed_segment(const std::string& name);
+bool is_open_segment(const std::string& name);
+
+// Tier encoded in a segment name; Raw when there is no rollup infix.
+seg::Tier segment_tier(const std::string& name);
+
+// Parses the sequence number out of a (sealed or open) segment name.
+bool parse_segment_seq(const std::string& name, uint32_t* seq);
+
+// Sortable UTC flight id derived from a CLOCK_REALTIME timestamp:
+// 20260516T134502Z.
+std::string make_flight_id(int64_t realtime_ns);
+
+// Directory-scanning helpers for offline tools.
+// Most recent flight id under root (ids sort chronologically), or "".
+std::string latest_flight(const std::string& root);
+// Paths of a flight's raw-tier segments, sealed or still open, by sequence.
+std::vector<std::string> raw_segment_paths(const std::string& root, const std::string& flight_id);
+// (sequence, path) of one tier's segments, by sequence: sealed or open for
+// raw, sealed only for rollups (an open rollup is an interrupted compaction).
+std::vector<std::pair<uint32_t, std::string>> segment_paths(const std::string& root, const std::string& flight_id,
+                                                            seg::Tier tier);
+
+// Per-vehicle flight id used when one recorder shards a swarm by MAVLink
+// system id: 20260516T134502Z-sys007.
+std::string vehicle_flight_id(const std::string& flight_id, uint8_t sysid);
+
+}  // namespace layout
+}  // namespace fr
@@ -0,0 +1,151 @@
+#include "summary_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <map>
+
+namespace fr {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kQuantiles[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+
+// Arcsine scale function k1 and its inverse: centroid size limits shrink
+// towards q = 0 and q = 1.
+double scale_k(double q, double compression) { return compression / (2 * kPi) * std::asin(2 * q - 1); }
+double scale_q(double k, double compression) { return (std::sin(k * 2 * kPi / compression) + 1) / 2; }
+
+std::string num(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+}
+
+}  // namespace
+
+TDigest::TDigest(double compression) : compression_(compression) {
+    buffer_.reserve(static_cast<size_t>(compression_) * 5);
+}
+
+void TDigest::add(double x) {
+    if (weight_ == 0 && buffer_.empty()) min_ = max_ = x;
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+    buffer_.push_back(x);
+    if (buffer_.size() == buffer_.capacity()) compress();
+}
+
+void TDigest::compress() {
+    if (buffer_.empty()) return;
+    std::sort(buffer_.begin(), buffer_.end());
+    // Merge the sorted buffer and the centroids, then sweep left to right,
+    // folding each into the current centroid while the k1 size limit allows.
+    std::vector<Centroid> all;
+    all.reserve(centroids_.size() + buffer_.size());
+    size_t i = 0, j = 0;
+    while (i < centroids_.size() || j < buffer_.size()) {
+        if (j == buffer_.size() || (i < centroids_.size() && centroids_[i].mean <= buffer_[j]))
+            all.push_back(centroids_[i++]);
+        else
+            all.push_back(Centroid{buffer_[j++], 1});
+    }
+    const double total = weight_ + static_cast<double>(buffer_.size());
+    buffer_.clear();
+
+    std::vector<Centroid> out;
+    out.reserve(static_cast<size_t>(compression_) * 2);
+    Centroid cur = all[0];
+    double before = 0;  // weight left of `cur`
+    double limit = total * scale_q(scale_k(0, compression_) + 1, compression_);
+    for (size_t k = 1; k < all.size(); ++k) {
+        const Centroid& next = all[k];
+        if (before + cur.weight + next.weight <= limit) {
+            cur.mean += (next.mean - cur.mean) * next.weight / (cur.weight + next.weight);
+            cur.weight += next.weight;
+            continue;
+        }
+        out.push_back(cur);
+        before += cur.weight;
+        limit = total * scale_q(scale_k(before / total, compression_) + 1, compression_);
+        cur = next;
+    }
+    out.push_back(cur);
+    centroids_.swap(out);
+    weight_ = total;
+}
+
+double TDigest::quantile(double q) {
+    compress();
+    if (centroids_.empty()) return std::numeric_limits<double>::quiet_NaN();
+    if (centroids_.size() == 1) return centroids_[0].mean;
+    q = std::min(std::max(q, 0.0), 1.0);
+    const double rank = q * weight_;
+    // Each centroid's mass is taken to sit around its mean; interpolate
+    // between neighbouring centres, and towards min/max beyond the outer ones.
+    const Centroid& first = centroids_.front();
+    if (rank < first.weight / 2)
+        return min_ + (first.mean - min_) * (first.weight > 1 ? rank / (first.weight / 2) : 0.0);
+    double cum = 0;
+    for (size_t i = 0; i + 1 < centroids_.size(); ++i) {
+        const Centroid& a = centroids_[i];
+        const Centroid& b = centroids_[i + 1];
+        const double lo = cum + a.weight / 2;
+        const double hi = cum + a.weight + b.weight / 2;
+        if (rank < hi) return a.mean + (b.mean - a.mean) * (rank - lo) / (hi - lo);
+        cum += a.weight;
+    }
+    const Centroid& last = centroids_.back();
+    const double from = weight_ - last.weight / 2;
+    if (last.weight <= 1 || rank <= from) return last.mean;
+    return last.mean + (max_ - last.mean) * (rank - from) / (last.weight / 2);
+}
+
+size_t TDigest::centroid_count() {
+    compress();
+    return centroids_.size();
+}
+
+void ChannelStats::add(double v) {
+    if (!std::isfinite(v)) {
+        nulls++;
+        return;
+    }
+    if (count == 0) min = max = v;
+    min = std::min(min, v);
+    max = std::max(max, v);
+    count++;
+    const double d = v - mean;
+    mean += d / static_cast<double>(count);
+    m2 += d * (v - mean);
+    digest.add(v);
+}
+
+std::string FlightSummary::format(const std::unordered_map<uint32_t, std::string>& names) {
+    std::string out = "quantiles";
+    for (double q : kQuantiles) out += " " + num(q);
+    out += "\n";
+    std::map<uint32_t, ChannelStats*> sorted;
+    for (auto& kv : channels_) sorted[kv.first] = &kv.second;
+    for (const auto& kv : sorted) {
+        ChannelStats& s = *kv.second;
+        char id[16];
+        std::snprintf(id, sizeof(id), "0x%08x", kv.first);
+        auto name = names.find(kv.first);
+        out += std::string("stats ") + id + " " + (name != names.end() ? name->second : "-") + " " +
+               std::to_string(s.count) + " " + std::to_string(s.nulls);
+        if (s.count == 0) {
+            // Only non-finite samples: nothing to summarise.
+            for (size_t i = 0; i < 4 + sizeof(kQuantiles) / sizeof(kQuantiles[0]); ++i) out += " nan";
+        } else {
+            out += " " + num(s.min) + " " + num(s.max) + " " + num(s.mean) + " " + num(std::sqrt(s.variance()));
+            for (double q : kQuantiles) out += " " + num(s.digest.quantile(q));
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+}  // namespace fr
@@ -0,0 +1,72 @@
+// Streaming per-channel summaries, maintained by the writer threads as
+// samples go by so that a flight's statistics exist the moment it closes,
+// without reading it back.
+//
+// Per channel: count, non-finite count, min, max, mean and variance by
+// Welford's method, and quantiles from a merging t-digest (Dunning & Ertl).
+// The digest keeps O(compression) centroids, concentrated at the tails by
+// the arcsine scale function, so p1/p99 stay accurate to a fraction of a
+// percent of rank at any sample count. Not thread-safe.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fr {
+
+class TDigest {
+public:
+    explicit TDigest(double compression = 100);
+
+    void add(double x);  // finite values only
+    // q in [0, 1]; NaN when empty.
+    double quantile(double q);
+    size_t centroid_count();
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    void compress();
+
+    double compression_;
+    std::vector<Centroid> centroids_;  // sorted by mean
+    std::vector<double> buffer_;       // unmerged values
+    double weight_ = 0;                // of centroids_
+    double min_ = 0;
+    double max_ = 0;
+};
+
+struct ChannelStats {
+    uint64_t count = 0;  // finite samples
+    uint64_t nulls = 0;  // non-finite samples, excluded from everything else
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double m2 = 0;  // sum of squared deviations (Welford)
+    TDigest digest;
+
+    void add(double v);
+    double variance() const { return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0; }
+};
+
+class FlightSummary {
+public:
+    void add(uint32_t channel, double v) { channels_[channel].add(v); }
+    bool empty() const { return channels_.empty(); }
+
+    // Manifest lines (see hash_chain.hpp): one "quantiles" line listing the
+    // reported ranks, then per channel in id order
+    //   stats <channel> <name|-> <count> <nulls> <min> <max> <mean> <stddev> <q>...
+    // `names` maps channel ids to config names where known.
+    std::string format(const std::unordered_map<uint32_t, std::string>& names);
+
+private:
+    std::unordered_map<uint32_t, ChannelStats> channels_;
+};
+
+}  // namespace fr
@@ -0,0 +1,68 @@
+#include "swinging_door.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fr {
+
+SwingingDoor::Point SwingingDoor::close_door() {
+    // The held sample's own slope lies in the door unless earlier samples
+    // pushed it out; clamping keeps the stored line within bounds for all.
+    const double dt = static_cast<double>(held_.t - pivot_.t);
+    const double slope = std::min(std::max((held_.v - pivot_.v) / dt, lo_), hi_);
+    pivot_ = Point{held_.t, pivot_.v + slope * dt};
+    have_held_ = false;
+    out_++;
+    return pivot_;
+}
+
+int SwingingDoor::push(int64_t t, double v, Point out[2]) {
+    in_++;
+    int n = 0;
+    if (have_pivot_ && t > pivot_.t) {
+        const double dt = static_cast<double>(t - pivot_.t);
+        const double lo = (v - max_error_ - pivot_.v) / dt;
+        const double hi = (v + max_error_ - pivot_.v) / dt;
+        if (t - pivot_.t <= max_gap_ns_) {
+            const double new_lo = have_held_ ? std::max(lo_, lo) : lo;
+            const double new_hi = have_held_ ? std::min(hi_, hi) : hi;
+            if (new_lo <= new_hi) {
+                lo_ = new_lo;
+                hi_ = new_hi;
+                held_ = Point{t, v};
+                have_held_ = true;
+                return 0;
+            }
+        }
+        if (have_held_) {
+            out[n++] = close_door();
+            // Restart the door from the new pivot with this sample.
+            const double dt2 = static_cast<double>(t - pivot_.t);
+            if (t - pivot_.t <= max_gap_ns_) {
+                lo_ = (v - max_error_ - pivot_.v) / dt2;
+                hi_ = (v + max_error_ - pivot_.v) / dt2;
+                held_ = Point{t, v};
+                have_held_ = true;
+                return n;
+            }
+        }
+    } else if (have_pivot_ && t == pivot_.t && !have_held_ && std::abs(v - pivot_.v) <= max_error_) {
+        return 0;  // a duplicate of the stored point
+    } else if (have_held_) {
+        // Time did not advance past the pivot (clock step): start over.
+        out[n++] = close_door();
+    }
+    pivot_ = Point{t, v};
+    have_pivot_ = true;
+    out[n++] = pivot_;
+    out_++;
+    return n;
+}
+
+bool SwingingDoor::flush(Point* out) {
+    if (!have_held_) return false;
+    *out = close_door();
+    return true;
+}
+
+}  // namespace fr
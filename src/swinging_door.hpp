@@ -0,0 +1,67 @@
+// Error-bounded decimation of one numeric channel (swinging-door trending).
+//
+// Samples are held back while a single straight line from the last stored
+// point can still pass within max_error of every one of them; the "door" is
+// the range of slopes that does so, and it narrows with each sample. When a
+// new sample would close it, one point is stored on a feasible line at the
+// time of the previous sample, and that point becomes the new pivot. A flat
+// or slowly drifting signal therefore costs one sample per max_gap, while a
+// dynamic one passes through at full rate.
+//
+// Guarantee: linear interpolation between consecutive stored points is
+// within max_error of every input sample. Stored values are themselves on
+// that line, so they may differ from the raw sample by up to max_error.
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace fr {
+
+class SwingingDoor {
+public:
+    struct Point {
+        int64_t t;
+        double v;
+    };
+
+    SwingingDoor() = default;
+    // max_gap_ns <= 0: no limit on the time between stored points.
+    SwingingDoor(double max_error, int64_t max_gap_ns)
+        : max_error_(max_error), max_gap_ns_(max_gap_ns > 0 ? max_gap_ns : std::numeric_limits<int64_t>::max()) {}
+
+    // Feeds one finite sample; returns the number of points (0..2) to store,
+    // in time order, in out[].
+    int push(int64_t t, double v, Point out[2]);
+
+    // Stores the held-back sample, if any: at the end of a recording, or
+    // before a non-finite value that is stored as-is.
+    bool flush(Point* out);
+    // flush() if the held-back sample is more than max_gap older than `now`:
+    // a channel that stopped updating must not keep its last value forever.
+    bool expire(int64_t now, Point* out) {
+        if (!have_held_ || now - held_.t <= max_gap_ns_) return false;
+        return flush(out);
+    }
+    // Forgets the pivot (after flush()), so the next sample is stored as-is.
+    void reset() { have_pivot_ = have_held_ = false; }
+
+    uint64_t samples_in() const { return in_; }
+    uint64_t samples_out() const { return out_; }
+
+private:
+    Point close_door();
+
+    double max_error_ = 0;
+    int64_t max_gap_ns_ = std::numeric_limits<int64_t>::max();
+    bool have_pivot_ = false;
+    bool have_held_ = false;
+    Point pivot_{};
+    Point held_{};      // most recent sample not yet stored
+    double lo_ = 0;     // feasible slopes from pivot_ through every held-back sample
+    double hi_ = 0;
+    uint64_t in_ = 0;
+    uint64_t out_ = 0;
+};
+
+}  // namespace fr
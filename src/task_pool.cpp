@@ -0,0 +1,133 @@
+#include "task_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+// Which pool (if any) the current thread works for, and its deque.
+thread_local const TaskPool* tl_pool = nullptr;
+thread_local size_t tl_worker = 0;
+}  // namespace
+
+TaskPool::TaskPool(unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; ++i) workers_.push_back(std::make_unique<Worker>());
+    for (unsigned i = 0; i < threads; ++i) threads_.emplace_back([this, i] { worker_loop(i); });
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lk(idle_mu_);
+        stop_.store(true);
+    }
+    idle_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void TaskPool::submit(Task task) {
+    const size_t w = tl_pool == this ? tl_worker : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+        std::lock_guard<std::mutex> lk(workers_[w]->mu);
+        workers_[w]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    // Taking the lock orders this against a worker checking queued_ and
+    // going to sleep, so the wakeup cannot be lost.
+    { std::lock_guard<std::mutex> lk(idle_mu_); }
+    idle_cv_.notify_one();
+}
+
+bool TaskPool::take(size_t self, Task* out) {
+    if (queued_.load() == 0) return false;
+    {
+        Worker& own = *workers_[self];
+        std::lock_guard<std::mutex> lk(own.mu);
+        if (!own.tasks.empty()) {
+            *out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t k = 1; k < workers_.size(); ++k) {
+        Worker& victim = *workers_[(self + k) % workers_.size()];
+        std::lock_guard<std::mutex> lk(victim.mu);
+        if (!victim.tasks.empty()) {
+            *out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1);
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskPool::run_one() {
+    Task task;
+    const size_t self = tl_pool == this ? tl_worker : next_.load(std::memory_order_relaxed) % workers_.size();
+    if (!take(self, &task)) return false;
+    task();
+    executed_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void TaskPool::worker_loop(size_t index) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "fr-pool-%zu", index);
+    set_thread_name(name);
+    tl_pool = this;
+    tl_worker = index;
+
+    Task task;
+    for (;;) {
+        if (take(index, &task)) {
+            task();
+            task = nullptr;
+            executed_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(idle_mu_);
+        idle_cv_.wait(lk, [this] { return queued_.load() > 0 || stop_.load(); });
+        if (stop_.load() && queued_.load() == 0) return;
+    }
+}
+
+TaskPool::Stats TaskPool::stats() const {
+    Stats s;
+    s.executed = executed_.load();
+    s.stolen = stolen_.load();
+    return s;
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+    if (!pool_) {
+        fn();
+        return;
+    }
+    pending_.fetch_add(1);
+    pool_->submit([this, fn = std::move(fn)] {
+        fn();
+        // Decrement under the lock: once the waiter sees zero it may destroy
+        // the group, so nothing may touch it after the unlock.
+        std::lock_guard<std::mutex> lk(mu_);
+        if (pending_.fetch_sub(1) == 1) cv_.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    while (pending_.load() > 0) {
+        if (pool_->run_one()) continue;
+        std::unique_lock<std::mutex> lk(mu_);
+        // Short timeout: new stealable work may appear while we sleep.
+        cv_.wait_for(lk, std::chrono::milliseconds(1), [this] { return pending_.load() == 0; });
+    }
+    std::lock_guard<std::mutex> lk(mu_);  // last task has left its critical section
+}
+
+}  // namespace fr
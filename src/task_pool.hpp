@@ -0,0 +1,89 @@
+// Work-stealing task pool for CPU-bound pipeline stages (chunk encoding,
+// compression, index stats, checksum verification).
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// (LIFO, cache-warm) and, when empty, steals from the front of the others
+// (FIFO, oldest and largest-grained first). Tasks submitted from outside the
+// pool are spread round-robin. Whatever stage is hot at the moment simply
+// gets more workers; there are no per-stage threads to saturate.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fr {
+
+class TaskPool {
+public:
+    using Task = std::function<void()>;
+
+    struct Stats {
+        uint64_t executed = 0;
+        uint64_t stolen = 0;
+    };
+
+    // 0 threads: one per online CPU.
+    explicit TaskPool(unsigned threads = 0);
+    // Runs every queued task, then joins the workers.
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void submit(Task task);
+    // Runs one queued task on the calling thread, if there is one. Lets
+    // waiters help instead of blocking (and cannot deadlock inside a task).
+    bool run_one();
+
+    unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+    Stats stats() const;
+
+private:
+    struct Worker {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    void worker_loop(size_t index);
+    bool take(size_t self, Task* out);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> next_{0};
+    std::atomic<bool> stop_{false};
+    std::mutex idle_mu_;
+    std::condition_variable idle_cv_;
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> stolen_{0};
+};
+
+// Fork/join helper: run() tasks on a pool (or inline when the pool is null),
+// wait() until all of them have finished, helping the pool meanwhile.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPool* pool) : pool_(pool) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> fn);
+    void wait();
+
+private:
+    TaskPool* pool_;
+    std::atomic<size_t> pending_{0};
+    std::mutex mu_;
+    std::condition_variable cv_;
+};
+
+}  // namespace fr
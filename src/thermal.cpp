@@ -0,0 +1,108 @@
+#include "thermal.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "fs_util.hpp"
+#include "log.hpp"
+#include "thread_util.hpp"
+
+namespace fr {
+
+namespace {
+
+// First integer in a small sysfs attribute; false if absent or unparsable.
+bool read_long(const std::string& path, long long* out) {
+    std::string text;
+    if (!read_file(path, &text) || text.empty()) return false;
+    char* end = nullptr;
+    *out = std::strtoll(text.c_str(), &end, 10);
+    return end != text.c_str();
+}
+
+bool starts_with(const std::string& s, const char* prefix) { return s.rfind(prefix, 0) == 0; }
+
+}  // namespace
+
+ThermalReading read_thermal(const std::string& sysfs_root) {
+    ThermalReading r;
+    r.max_temp_c = std::numeric_limits<double>::quiet_NaN();
+    const std::string zones = sysfs_root + "/class/thermal";
+    for (const auto& name : list_dir(zones)) {
+        long long milli = 0;
+        if (!starts_with(name, "thermal_zone") || !read_long(zones + "/" + name + "/temp", &milli)) continue;
+        const double c = milli / 1000.0;
+        if (r.zones == 0 || c > r.max_temp_c) r.max_temp_c = c;
+        r.zones++;
+    }
+    const std::string cpus = sysfs_root + "/devices/system/cpu";
+    for (const auto& name : list_dir(cpus)) {
+        if (!starts_with(name, "cpu") || name.size() < 4 || name[3] < '0' || name[3] > '9') continue;
+        const std::string dir = cpus + "/" + name + "/cpufreq/";
+        long long cap = 0, max = 0;
+        if (!read_long(dir + "scaling_max_freq", &cap) || !read_long(dir + "cpuinfo_max_freq", &max) || max <= 0)
+            continue;
+        const double ratio = static_cast<double>(cap) / static_cast<double>(max);
+        if (ratio < r.min_freq_ratio) r.min_freq_ratio = ratio;
+        r.cpus++;
+    }
+    return r;
+}
+
+ThermalGovernor::ThermalGovernor(ThermalConfig cfg, Callback on_change)
+    : cfg_(std::move(cfg)), on_change_(std::move(on_change)) {}
+
+ThermalGovernor::~ThermalGovernor() { stop(); }
+
+void ThermalGovernor::start() {
+    if (thread_.joinable()) return;
+    stop_ = false;
+    const ThermalReading r = read_thermal(cfg_.sysfs_root);
+    if (r.zones == 0 && r.cpus == 0)
+        FR_LOG_WARN("thermal: no thermal zones or cpufreq under %s; staying in normal mode", cfg_.sysfs_root.c_str());
+    thread_ = std::thread([this] { run(); });
+}
+
+void ThermalGovernor::stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void ThermalGovernor::update(const ThermalReading& r, std::chrono::steady_clock::time_point now) {
+    const bool have_temp = r.zones > 0 && !std::isnan(r.max_temp_c);
+    const PowerMode mode = mode_.load(std::memory_order_relaxed);
+    PowerMode next = mode;
+    if (mode == PowerMode::Normal) {
+        if ((have_temp && r.max_temp_c >= cfg_.hot_c) || r.min_freq_ratio < cfg_.hot_freq_ratio) next = PowerMode::Hot;
+    } else {
+        const bool cool = (!have_temp || r.max_temp_c <= cfg_.cool_c) && r.min_freq_ratio >= cfg_.cool_freq_ratio;
+        if (cool && now - since_ >= cfg_.min_hold) next = PowerMode::Normal;
+    }
+    if (next == mode) return;
+    mode_.store(next, std::memory_order_relaxed);
+    since_ = now;
+    FR_LOG_WARN("thermal: %s mode (%.1f C, CPU frequency cap at %.0f%%)", next == PowerMode::Hot ? "hot" : "normal",
+                have_temp ? r.max_temp_c : 0.0, r.min_freq_ratio * 100);
+    if (on_change_) on_change_(next, r);
+}
+
+void ThermalGovernor::run() {
+    // Normal priority, unlike the other maintenance threads: an idle-class
+    // thread could starve under exactly the load this is meant to notice.
+    set_thread_name("fr-thermal");
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!stop_) {
+        lk.unlock();
+        update(read_thermal(cfg_.sysfs_root), std::chrono::steady_clock::now());
+        lk.lock();
+        cv_.wait_for(lk, cfg_.poll_interval, [this] { return stop_; });
+    }
+}
+
+}  // namespace fr
@@ -0,0 +1,86 @@
+// Thermal and power-aware operating mode.
+//
+// A background thread polls sysfs once a second:
+//
+//   <sysfs>/class/thermal/thermal_zone*/temp                 millidegrees C
+//   <sysfs>/devices/system/cpu/cpu*/cpufreq/scaling_max_freq  current cap, kHz
+//   <sysfs>/devices/system/cpu/cpu*/cpufreq/cpuinfo_max_freq  hardware max, kHz
+//
+// and switches the recorder to Hot when the hottest zone reaches `hot_c` or
+// any CPU's frequency cap falls below `hot_freq_ratio` of its maximum
+// (thermal or power capping; the *current* frequency is ignored because it
+// also drops when the CPU is merely idle). It returns to Normal only once
+// every zone is at or below `cool_c`, every cap is back above
+// `cool_freq_ratio`, and the mode has been held for `min_hold`.
+//
+// The sysfs root is configurable so the governor can be pointed at a mock
+// tree. Missing files are ignored: a board without thermal zones is governed
+// by frequency alone, one without cpufreq by temperature alone.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fr {
+
+enum class PowerMode : uint8_t { Normal, Hot };
+
+struct ThermalConfig {
+    std::string sysfs_root = "/sys";
+    double hot_c = 80.0;
+    double cool_c = 70.0;
+    double hot_freq_ratio = 0.75;
+    double cool_freq_ratio = 0.9;
+    std::chrono::milliseconds poll_interval{1000};
+    std::chrono::milliseconds min_hold{10000};
+};
+
+struct ThermalReading {
+    double max_temp_c = 0;       // NaN without thermal zones
+    double min_freq_ratio = 1;   // lowest scaling_max/cpuinfo_max over CPUs; 1 without cpufreq
+    unsigned zones = 0;
+    unsigned cpus = 0;
+};
+
+// Reads one sample from a sysfs tree. Never throws.
+ThermalReading read_thermal(const std::string& sysfs_root);
+
+class ThermalGovernor {
+public:
+    using Callback = std::function<void(PowerMode, const ThermalReading&)>;
+
+    // `on_change` runs on the governor thread at every mode switch.
+    ThermalGovernor(ThermalConfig cfg, Callback on_change);
+    ~ThermalGovernor();
+
+    ThermalGovernor(const ThermalGovernor&) = delete;
+    ThermalGovernor& operator=(const ThermalGovernor&) = delete;
+
+    void start();
+    void stop();
+
+    // Evaluates one reading; exposed so the policy can be driven directly.
+    void update(const ThermalReading& r, std::chrono::steady_clock::time_point now);
+    PowerMode mode() const { return mode_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    const ThermalConfig cfg_;
+    Callback on_change_;
+    std::atomic<PowerMode> mode_{PowerMode::Normal};
+    std::chrono::steady_clock::time_point since_{};
+
+    std::thread thread_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+}  // namespace fr
@@ -0,0 +1,53 @@
+#include "thread_util.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace fr {
+
+namespace {
+// From linux/ioprio.h, which is not exported by every libc.
+constexpr int kIoprioClassShift = 13;
+constexpr int kIoprioClassBestEffort = 2;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioBestEffortLowest = 7;
+constexpr int kIoprioWhoProcess = 1;
+}  // namespace
+
+void set_thread_name(const char* name) {
+    char buf[16];
+    std::strncpy(buf, name, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    pthread_setname_np(pthread_self(), buf);
+}
+
+void set_background_priority() {
+    sched_param sp{};
+    sp.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+#ifdef SYS_ioprio_set
+    // who == 0 with IOPRIO_WHO_PROCESS targets the calling thread.
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+#endif
+}
+
+void set_maintenance_priority() {
+#ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, (kIoprioClassBestEffort << kIoprioClassShift) | kIoprioBestEffortLowest);
+#endif
+}
+
+void set_high_priority() {
+    sched_param sp{};
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0) return;
+    // PRIO_PROCESS with a thread id adjusts just that thread on Linux.
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), -10);
+}
+
+}  // namespace fr
@@ -0,0 +1,26 @@
+// Helpers for tagging threads by role. Background maintenance threads drop to
+// idle CPU and I/O priority so they can never compete with ingest or the writer
+// (or, when they must keep up regardless, to the lowest best-effort I/O level);
+// the health reporter and UART readers go the other way so bulk work cannot
+// delay them.
+#pragma once
+
+namespace fr {
+
+// Sets the calling thread's name (truncated to 15 chars as the kernel requires).
+void set_thread_name(const char* name);
+
+// Moves the calling thread to SCHED_IDLE and the idle I/O class. Best effort:
+// failures are ignored because the work is still correct at normal priority.
+void set_background_priority();
+
+// Keeps the calling thread's normal CPU scheduling but moves it to the lowest
+// best-effort I/O priority: for maintenance that must not starve, only yield.
+void set_maintenance_priority();
+
+// Moves the calling thread to SCHED_FIFO at the lowest real-time priority,
+// falling back to nice -10 without CAP_SYS_NICE. Best effort, like the above.
+// Only for threads that sleep almost all the time.
+void set_high_priority();
+
+}  // namespace fr
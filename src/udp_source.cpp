@@ -0,0 +1,173 @@
+#include "udp_source.hpp"
+
+#include <arpa/inet.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "log.hpp"
+
+namespace fr {
+
+namespace {
+
+// Largest UDP payload; a GRO message never exceeds it either.
+constexpr size_t kMaxUdpPayload = 65535;
+
+}  // namespace
+
+UdpSource::UdpSource(SourceSpec spec, const UdpOptions& opts) : spec_(std::move(spec)), opts_(opts) {
+    if (opts_.batch == 0) opts_.batch = 1;
+    slot_ = opts_.gro ? kMaxUdpPayload : std::min(std::max<size_t>(opts_.max_datagram, 512), kMaxUdpPayload);
+    arena_.resize(opts_.batch * slot_);
+    control_.resize(opts_.batch * kControlBytes);
+    msgs_.resize(opts_.batch);
+    iov_.resize(opts_.batch);
+    seg_size_.resize(opts_.batch);
+    lengths_.reserve(opts_.batch);
+}
+
+bool UdpSource::open(std::string* err) {
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        *err = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (opts_.rcvbuf_bytes > 0) {
+        // SO_RCVBUFFORCE ignores net.core.rmem_max but needs CAP_NET_ADMIN.
+        const int want = opts_.rcvbuf_bytes;
+        if (setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &want, sizeof(want)) != 0)
+            setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &want, sizeof(want));
+        int got = 0;
+        socklen_t len = sizeof(got);
+        // The kernel reports twice the usable size.
+        if (getsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &got, &len) == 0 && got / 2 < want && !rcvbuf_warned_) {
+            FR_LOG_WARN("source %s: receive buffer %d KiB of %d KiB requested (raise net.core.rmem_max)",
+                        spec_.name.c_str(), got / 2048, want / 1024);
+            rcvbuf_warned_ = true;
+        }
+    }
+    setsockopt(fd_, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+    // Pre-4.18 kernels lack UDP_GRO; datagrams then simply arrive one by one.
+    gro_ = opts_.gro && setsockopt(fd_, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) == 0;
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(spec_.port);
+    if (inet_pton(AF_INET, spec_.path.c_str(), &sa.sin_addr) != 1) {
+        *err = "bad address " + spec_.path;
+        close();
+        return false;
+    }
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0) {
+        // Typically EADDRNOTAVAIL until the radio's interface comes up.
+        *err = spec_.path + ":" + std::to_string(spec_.port) + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UdpSource::prepare(size_t i) {
+    iov_[i] = iovec{arena_.data() + i * slot_, slot_};
+    msgs_[i] = mmsghdr{};
+    msgs_[i].msg_hdr.msg_iov = &iov_[i];
+    msgs_[i].msg_hdr.msg_iovlen = 1;
+    msgs_[i].msg_hdr.msg_control = control_.data() + i * kControlBytes;
+    msgs_[i].msg_hdr.msg_controllen = kControlBytes;
+}
+
+void UdpSource::parse_control(size_t i) {
+    msghdr& h = msgs_[i].msg_hdr;
+    seg_size_[i] = 0;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+            // Only attached once the socket has dropped something.
+            std::memcpy(&ovfl_, CMSG_DATA(c), sizeof(ovfl_));
+            drops_.store(drops_base_ + ovfl_, std::memory_order_relaxed);
+        } else if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO) {
+            int gso = 0;
+            std::memcpy(&gso, CMSG_DATA(c), sizeof(gso));
+            seg_size_[i] = static_cast<uint16_t>(gso);
+        }
+    }
+}
+
+void UdpSource::poll_drops() {
+    uint32_t mem[SK_MEMINFO_VARS] = {};
+    socklen_t len = sizeof(mem);
+    if (getsockopt(fd_, SOL_SOCKET, SO_MEMINFO, mem, &len) != 0 || len <= SK_MEMINFO_DROPS * sizeof(uint32_t)) return;
+    ovfl_ = mem[SK_MEMINFO_DROPS];
+    drops_.store(drops_base_ + ovfl_, std::memory_order_relaxed);
+}
+
+ssize_t UdpSource::read(uint8_t* buf, size_t cap, int timeout_ms) {
+    lengths_.clear();
+    if (msg_ == got_) {
+        int ready = wait_readable(fd_, timeout_ms);
+        if (ready == 0) poll_drops();
+        if (ready <= 0) return ready;
+        for (size_t i = 0; i < msgs_.size(); ++i) prepare(i);
+        // Only what is already queued: waiting for a full batch would delay
+        // the receive timestamp of the first datagram.
+        int n = recvmmsg(fd_, msgs_.data(), static_cast<unsigned>(msgs_.size()), MSG_DONTWAIT, nullptr);
+        if (n < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        for (int i = 0; i < n; ++i) parse_control(static_cast<size_t>(i));
+        msg_ = 0;
+        got_ = static_cast<size_t>(n);
+        off_ = 0;
+    }
+    // Whatever does not fit stays in the arena for the next call.
+    size_t out = 0;
+    for (; msg_ < got_; ++msg_, off_ = 0) {
+        const mmsghdr& m = msgs_[msg_];
+        if (m.msg_hdr.msg_flags & MSG_TRUNC) {
+            truncated_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        const uint8_t* data = arena_.data() + msg_ * slot_;
+        const size_t len = m.msg_len;
+        const size_t seg = seg_size_[msg_] ? seg_size_[msg_] : len;
+        while (off_ < len) {
+            size_t n = std::min(seg, len - off_);
+            if (n > cap - out) {
+                if (out) return static_cast<ssize_t>(out);
+                // A caller buffer smaller than one datagram.
+                truncated_.fetch_add(1, std::memory_order_relaxed);
+                n = cap;
+            }
+            std::memcpy(buf + out, data + off_, n);
+            lengths_.push_back(static_cast<uint32_t>(n));
+            out += n;
+            off_ += std::min(seg, len - off_);
+        }
+    }
+    return static_cast<ssize_t>(out);
+}
+
+SourceCounters UdpSource::counters() const {
+    SourceCounters c;
+    c.kernel_drops = drops_.load(std::memory_order_relaxed);
+    c.truncated = truncated_.load(std::memory_order_relaxed);
+    return c;
+}
+
+void UdpSource::close() {
+    if (fd_ >= 0) {
+        poll_drops();
+        ::close(fd_);
+    }
+    fd_ = -1;
+    drops_base_ += ovfl_;
+    ovfl_ = 0;
+    msg_ = got_ = off_ = 0;
+}
+
+}  // namespace fr
@@ -0,0 +1,77 @@
+// UDP telemetry source (IP radios, SITL, companion computers).
+//
+// IP radios deliver floods of small datagrams, so one recv() per datagram
+// caps ingest well below link rate. Instead each read() drains up to
+// `batch` queued messages with one recvmmsg() into a preallocated arena and
+// packs the datagrams back to back into the caller's buffer (datagrams()
+// gives the boundaries). With UDP_GRO the kernel may coalesce a burst of
+// equal-sized datagrams from one sender into a single message, which is
+// split again here using the reported segment size.
+//
+// SO_RXQ_OVFL makes the kernel report how many datagrams it dropped because
+// the receive buffer was full; those losses happen before the recorder sees
+// anything and are exported through counters(). The count rides on the next
+// datagram queued after a drop, so while the link is idle it is also polled
+// with SO_MEMINFO to catch drops at the end of a burst.
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <vector>
+
+#include "source.hpp"
+
+namespace fr {
+
+class UdpSource : public Source {
+public:
+    UdpSource(SourceSpec spec, const UdpOptions& opts);
+    ~UdpSource() override { close(); }
+
+    const SourceSpec& spec() const override { return spec_; }
+    Framing framing() const override { return Framing::Datagram; }
+
+    bool open(std::string* err) override;
+    ssize_t read(uint8_t* buf, size_t cap, int timeout_ms) override;
+    void close() override;
+
+    const std::vector<uint32_t>& datagrams() const override { return lengths_; }
+    SourceCounters counters() const override;
+
+private:
+    // One message's control buffer: SO_RXQ_OVFL (uint32) and UDP_GRO (int).
+    static constexpr size_t kControlBytes = 64;
+
+    void prepare(size_t i);
+    void parse_control(size_t i);
+    void poll_drops();
+
+    SourceSpec spec_;
+    UdpOptions opts_;
+    int fd_ = -1;
+    bool gro_ = false;
+    size_t slot_ = 0;  // arena bytes per message
+
+    std::vector<uint8_t> arena_;
+    std::vector<uint8_t> control_;
+    std::vector<mmsghdr> msgs_;
+    std::vector<iovec> iov_;
+    std::vector<uint16_t> seg_size_;  // GRO segment size per message; 0: one datagram
+
+    // Messages received but not yet handed out: [msg_, got_), the current
+    // one from byte off_.
+    size_t msg_ = 0;
+    size_t got_ = 0;
+    size_t off_ = 0;
+    std::vector<uint32_t> lengths_;
+
+    uint32_t ovfl_ = 0;        // SO_RXQ_OVFL count of the current socket
+    uint64_t drops_base_ = 0;  // ... and of the sockets before it
+    bool rcvbuf_warned_ = false;
+    std::atomic<uint64_t> drops_{0};
+    std::atomic<uint64_t> truncated_{0};
+};
+
+}  // namespace fr
@@ -0,0 +1,344 @@
+#include "value_storage.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define FR_HALF_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FR_HALF_NEON 1
+#endif
+
+namespace fr {
+namespace storage {
+
+namespace {
+
+using seg::ValueStorage;
+
+uint32_t bits_of(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+float float_of(uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// Round-to-nearest-even float -> binary16, bit-exact with the hardware
+// conversions for everything but NaN payloads (after F. Giesen).
+uint16_t half_from_float(float f) {
+    constexpr uint32_t kInf = 255u << 23;
+    constexpr uint32_t kHalfLimit = (127u + 16) << 23;  // 2^16: rounds to inf from here
+    constexpr uint32_t kDenormMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+    uint32_t u = bits_of(f);
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+    uint16_t h;
+    if (u >= kHalfLimit) {
+        h = u > kInf ? 0x7e00 : 0x7c00;
+    } else if (u < (113u << 23)) {
+        // Below the smallest normal half: let the FPU round the mantissa.
+        h = static_cast<uint16_t>(bits_of(float_of(u) + float_of(kDenormMagic)) - kDenormMagic);
+    } else {
+        const uint32_t odd = (u >> 13) & 1;
+        u += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + odd;
+        h = static_cast<uint16_t>(u >> 13);
+    }
+    return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+float float_from_half(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+    if (exp == 0x1f) return float_of(sign | 0x7f800000u | (mant << 13));
+    if (exp == 0) {
+        const float m = std::ldexp(static_cast<float>(mant), -24);
+        return sign ? -m : m;
+    }
+    return float_of(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+uint16_t bf16_from_float(float f) {
+    const uint32_t u = bits_of(f);
+    if ((u & 0x7fffffffu) > 0x7f800000u) return static_cast<uint16_t>((u >> 16) | 0x40);  // keep NaN quiet
+    return static_cast<uint16_t>((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+}
+
+float float_from_bf16(uint16_t h) { return float_of(static_cast<uint32_t>(h) << 16); }
+
+// Vector kernels return how many leading values they converted; the scalar
+// loops finish the rest.
+
+#ifdef FR_HALF_X86
+
+#define FR_F16C __attribute__((target("avx,f16c")))
+
+FR_F16C size_t to_half_f16c(const double* v, size_t n, uint16_t* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(v + i));
+        const __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(v + i + 4));
+        const __m256 f = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+
+FR_F16C size_t from_half_f16c(const uint16_t* h, size_t n, double* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 f = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i)));
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+    }
+    return i;
+}
+
+// CPUID.1:ECX[29]; "avx" also checks that the OS saves the YMM state.
+bool detect_hardware() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_F16C)) return false;
+    return __builtin_cpu_supports("avx");
+}
+
+#elif defined(FR_HALF_NEON)
+
+// Half-precision conversions are part of base AArch64.
+size_t to_half_neon(const double* v, size_t n, uint16_t* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t f = vcombine_f32(vcvt_f32_f64(vld1q_f64(v + i)), vcvt_f32_f64(vld1q_f64(v + i + 2)));
+        vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(f)));
+    }
+    return i;
+}
+
+size_t from_half_neon(const uint16_t* h, size_t n, double* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t f = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(h + i)));
+        vst1q_f64(out + i, vcvt_f64_f32(vget_low_f32(f)));
+        vst1q_f64(out + i + 2, vcvt_high_f64_f32(f));
+    }
+    return i;
+}
+
+bool detect_hardware() { return true; }
+
+#else
+
+bool detect_hardware() { return false; }
+
+#endif
+
+void to_half(const double* v, size_t n, uint16_t* out) {
+    size_t i = 0;
+#if defined(FR_HALF_X86)
+    if (hardware()) i = to_half_f16c(v, n, out);
+#elif defined(FR_HALF_NEON)
+    if (hardware()) i = to_half_neon(v, n, out);
+#endif
+    for (; i < n; ++i) out[i] = half_from_float(static_cast<float>(v[i]));
+}
+
+void from_half(const uint16_t* h, size_t n, double* out) {
+    size_t i = 0;
+#if defined(FR_HALF_X86)
+    if (hardware()) i = from_half_f16c(h, n, out);
+#elif defined(FR_HALF_NEON)
+    if (hardware()) i = from_half_neon(h, n, out);
+#endif
+    for (; i < n; ++i) out[i] = float_from_half(h[i]);
+}
+
+template <typename T>
+void append(std::string* out, const std::vector<T>& v) {
+    out->append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+// True if some finite input came out as inf: the exponent field of the
+// narrow value is all ones.
+bool overflowed(const double* v, const std::vector<uint16_t>& narrow, uint16_t exp_mask) {
+    for (size_t i = 0; i < narrow.size(); ++i)
+        if ((narrow[i] & exp_mask) == exp_mask && std::isfinite(v[i])) return true;
+    return false;
+}
+
+template <typename Q>
+bool pack_fixed(double step, const double* v, size_t n, std::string* out) {
+    constexpr Q kNull = std::numeric_limits<Q>::min();
+    constexpr double kMax = std::numeric_limits<Q>::max();
+    if (!(step > 0) || !std::isfinite(step)) return false;
+    double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+    for (size_t i = 0; i < n; ++i)
+        if (std::isfinite(v[i])) {
+            lo = std::min(lo, v[i]);
+            hi = std::max(hi, v[i]);
+        }
+    double base = 0;
+    if (lo <= hi) {
+        // Centred, so |q| <= range / 2 / step, which must stay clear of kNull.
+        if (!((hi - lo) / step <= 2 * (kMax - 1))) return false;
+        base = lo + (hi - lo) / 2;
+    }
+    std::vector<Q> q(n);
+    for (size_t i = 0; i < n; ++i)
+        q[i] = std::isfinite(v[i]) ? static_cast<Q>(std::nearbyint((v[i] - base) / step)) : kNull;
+    out->append(reinterpret_cast<const char*>(&step), sizeof(step));
+    out->append(reinterpret_cast<const char*>(&base), sizeof(base));
+    append(out, q);
+    return true;
+}
+
+template <typename Q>
+void unpack_fixed(const char* p, size_t n, double* out) {
+    constexpr Q kNull = std::numeric_limits<Q>::min();
+    double step, base;
+    std::memcpy(&step, p, sizeof(step));
+    std::memcpy(&base, p + sizeof(step), sizeof(base));
+    std::vector<Q> q(n);
+    std::memcpy(q.data(), p + 2 * sizeof(double), n * sizeof(Q));
+    for (size_t i = 0; i < n; ++i)
+        out[i] = q[i] == kNull ? std::numeric_limits<double>::quiet_NaN() : base + q[i] * step;
+}
+
+bool try_pack(ValueStorage s, double step, const double* v, size_t n, std::string* out) {
+    switch (s) {
+        case ValueStorage::F64:
+            out->append(reinterpret_cast<const char*>(v), n * sizeof(double));
+            return true;
+        case ValueStorage::F32: {
+            std::vector<float> f(n);
+            for (size_t i = 0; i < n; ++i) f[i] = static_cast<float>(v[i]);
+            for (size_t i = 0; i < n; ++i)
+                if (std::isinf(f[i]) && std::isfinite(v[i])) return false;
+            append(out, f);
+            return true;
+        }
+        case ValueStorage::F16: {
+            std::vector<uint16_t> h(n);
+            to_half(v, n, h.data());
+            if (overflowed(v, h, 0x7c00)) return false;
+            append(out, h);
+            return true;
+        }
+        case ValueStorage::BF16: {
+            std::vector<uint16_t> h(n);
+            for (size_t i = 0; i < n; ++i) h[i] = bf16_from_float(static_cast<float>(v[i]));
+            if (overflowed(v, h, 0x7f80)) return false;
+            append(out, h);
+            return true;
+        }
+        case ValueStorage::Fixed16: return pack_fixed<int16_t>(step, v, n, out);
+        case ValueStorage::Fixed32: return pack_fixed<int32_t>(step, v, n, out);
+    }
+    return false;
+}
+
+std::atomic<bool> scalar_only{false};
+
+ValueStorage wider(ValueStorage s) {
+    switch (s) {
+        case ValueStorage::F16:
+        case ValueStorage::BF16: return ValueStorage::F32;
+        case ValueStorage::Fixed16: return ValueStorage::Fixed32;
+        default: return ValueStorage::F64;
+    }
+}
+
+}  // namespace
+
+bool parse(const std::string& name, seg::ValueStorage* out) {
+    static const std::pair<const char*, ValueStorage> kNames[] = {
+        {"f64", ValueStorage::F64},  {"f32", ValueStorage::F32},     {"f16", ValueStorage::F16},
+        {"bf16", ValueStorage::BF16}, {"i16", ValueStorage::Fixed16}, {"i32", ValueStorage::Fixed32},
+    };
+    for (const auto& n : kNames)
+        if (name == n.first) {
+            *out = n.second;
+            return true;
+        }
+    return false;
+}
+
+const char* name(seg::ValueStorage s) {
+    switch (s) {
+        case ValueStorage::F64: return "f64";
+        case ValueStorage::F32: return "f32";
+        case ValueStorage::F16: return "f16";
+        case ValueStorage::BF16: return "bf16";
+        case ValueStorage::Fixed16: return "i16";
+        case ValueStorage::Fixed32: return "i32";
+    }
+    return "?";
+}
+
+bool fixed_point(seg::ValueStorage s) { return s == ValueStorage::Fixed16 || s == ValueStorage::Fixed32; }
+
+size_t packed_size(seg::ValueStorage s, size_t n) {
+    switch (s) {
+        case ValueStorage::F64: return n * sizeof(double);
+        case ValueStorage::F32: return n * sizeof(float);
+        case ValueStorage::F16:
+        case ValueStorage::BF16: return n * sizeof(uint16_t);
+        case ValueStorage::Fixed16: return 2 * sizeof(double) + n * sizeof(int16_t);
+        case ValueStorage::Fixed32: return 2 * sizeof(double) + n * sizeof(int32_t);
+    }
+    return SIZE_MAX;
+}
+
+seg::ValueStorage pack(seg::ValueStorage want, double step, const double* v, size_t n, std::string* out) {
+    const size_t at = out->size();
+    for (ValueStorage s = want;; s = wider(s)) {
+        if (try_pack(s, step, v, n, out)) return s;
+        out->resize(at);
+    }
+}
+
+void unpack(seg::ValueStorage s, const char* p, size_t n, std::vector<double>* out) {
+    out->resize(n);
+    double* v = out->data();
+    switch (s) {
+        case ValueStorage::F64: std::memcpy(v, p, n * sizeof(double)); break;
+        case ValueStorage::F32: {
+            std::vector<float> f(n);
+            std::memcpy(f.data(), p, n * sizeof(float));
+            for (size_t i = 0; i < n; ++i) v[i] = f[i];
+            break;
+        }
+        case ValueStorage::F16:
+        case ValueStorage::BF16: {
+            std::vector<uint16_t> h(n);
+            std::memcpy(h.data(), p, n * sizeof(uint16_t));
+            if (s == ValueStorage::F16)
+                from_half(h.data(), n, v);
+            else
+                for (size_t i = 0; i < n; ++i) v[i] = float_from_bf16(h[i]);
+            break;
+        }
+        case ValueStorage::Fixed16: unpack_fixed<int16_t>(p, n, v); break;
+        case ValueStorage::Fixed32: unpack_fixed<int32_t>(p, n, v); break;
+    }
+}
+
+bool hardware() {
+    static const bool hw = detect_hardware();
+    return hw && !scalar_only.load(std::memory_order_relaxed);
+}
+
+void force_scalar(bool on) { scalar_only.store(on, std::memory_order_relaxed); }
+
+}  // namespace storage
+}  // namespace fr
@@ -0,0 +1,48 @@
+// Narrow storage for numeric samples. Most sensors deliver 12-16 bits of
+// real resolution, yet every sample travels as a double; a channel can
+// declare a narrower seg::ValueStorage and its Samples chunks are packed into
+// it before compression, and widened back to double on read.
+//
+// Packing never loses a value outright: if a chunk holds a finite value the
+// requested storage cannot represent (beyond half-float range, or a range
+// too wide for the fixed-point step), the chunk falls back to the next wider
+// storage, ending at F64. Fixed point rounds to the nearest step, so the
+// reconstruction error is at most step / 2; non-finite samples read back as
+// NaN.
+//
+// Half-float conversion uses F16C (x86, detected at runtime) or the AArch64
+// fp16 conversions, eight or four values per instruction; elsewhere, and for
+// loop tails, an exact round-to-nearest-even scalar version.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "segment_format.hpp"
+
+namespace fr {
+namespace storage {
+
+// "f64", "f32", "f16", "bf16", "i16", "i32".
+bool parse(const std::string& name, seg::ValueStorage* out);
+const char* name(seg::ValueStorage s);
+bool fixed_point(seg::ValueStorage s);
+
+// Payload bytes for n values; SIZE_MAX for an unknown storage.
+size_t packed_size(seg::ValueStorage s, size_t n);
+
+// Appends v[0..n) to *out as `want` (or a wider fallback, see above) and
+// returns the storage used. `step` is the fixed-point resolution, > 0.
+seg::ValueStorage pack(seg::ValueStorage want, double step, const double* v, size_t n, std::string* out);
+// Widens packed_size(s, n) bytes at p into *out.
+void unpack(seg::ValueStorage s, const char* p, size_t n, std::vector<double>* out);
+
+// Vector half-float kernels in use.
+bool hardware();
+// Tests: use the scalar conversions even where vector ones exist.
+void force_scalar(bool on);
+
+}  // namespace storage
+}  // namespace fr
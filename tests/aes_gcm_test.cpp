@@ -0,0 +1,136 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/aes_gcm.hpp"
+#include "../src/sha256.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+// AES-256 test cases 13-16 from the GCM specification (McGrew & Viega),
+// which NIST's GCMVS vectors include.
+struct Vector {
+    const char* key;
+    const char* iv;
+    const char* plain;
+    const char* aad;
+    const char* cipher;
+    const char* tag;
+};
+
+const char* kKey15 = "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308";
+const char* kPlain15 =
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+    "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255";
+const char* kCipher15 =
+    "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+    "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad";
+
+const Vector kVectors[] = {
+    {"0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000", "", "", "",
+     "530f8afbc74536b9a963b4f1c4cb738b"},
+    {"0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+     "00000000000000000000000000000000", "", "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919"},
+    {kKey15, "cafebabefacedbaddecaf888", kPlain15, "", kCipher15, "b094dac5d93471bdec1a502270e3cc6c"},
+};
+
+void check_vector(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv, const std::vector<uint8_t>& plain,
+                  const std::vector<uint8_t>& aad, const std::string& cipher_hex, const std::string& tag_hex) {
+    AesGcm gcm(key.data());
+    std::vector<uint8_t> out(plain.size());
+    uint8_t tag[AesGcm::kTagBytes];
+    gcm.encrypt(iv.data(), aad.data(), aad.size(), plain.data(), plain.size(), out.data(), tag);
+    CHECK_EQ(test::to_hex(out.data(), out.size()), cipher_hex);
+    CHECK_EQ(test::to_hex(tag, sizeof tag), tag_hex);
+
+    std::vector<uint8_t> back(out.size());
+    CHECK(gcm.decrypt(iv.data(), aad.data(), aad.size(), out.data(), out.size(), tag, back.data()));
+    CHECK(back == plain);
+}
+
+void check_spec_vectors() {
+    for (const Vector& v : kVectors)
+        check_vector(test::from_hex(v.key), test::from_hex(v.iv), test::from_hex(v.plain), test::from_hex(v.aad),
+                     v.cipher, v.tag);
+    // Test case 16: 60 bytes of plaintext with AAD, so both the data and the
+    // AAD end on a partial block.
+    std::vector<uint8_t> plain = test::from_hex(kPlain15);
+    plain.resize(60);
+    check_vector(test::from_hex(kKey15), test::from_hex("cafebabefacedbaddecaf888"), plain,
+                 test::from_hex("feedfacedeadbeeffeedfacedeadbeefabaddad2"), std::string(kCipher15, 120),
+                 "76fc6ece0f4e1768cddf8853bb2d551b");
+}
+
+}  // namespace
+
+TEST(aes_gcm_spec_vectors) {
+    check_spec_vectors();
+    AesGcm::force_portable(true);
+    CHECK(!AesGcm::hardware());
+    check_spec_vectors();
+    AesGcm::force_portable(false);
+}
+
+TEST(aes_gcm_paths_agree) {
+    // Lengths around the four-block stride of the hardware path, with and
+    // without AAD. Nothing to compare on CPUs without AES-NI.
+    if (!AesGcm::hardware()) return;
+    std::mt19937 rng(41);
+    uint8_t key[AesGcm::kKeyBytes], nonce[AesGcm::kNonceBytes];
+    for (uint8_t& b : key) b = static_cast<uint8_t>(rng());
+    AesGcm gcm(key);
+    for (size_t len = 0; len < 200; ++len) {
+        for (uint8_t& b : nonce) b = static_cast<uint8_t>(rng());
+        std::vector<uint8_t> in(len), aad(len % 37);
+        for (uint8_t& b : in) b = static_cast<uint8_t>(rng());
+        for (uint8_t& b : aad) b = static_cast<uint8_t>(rng());
+        std::vector<uint8_t> hw(len), sw(len);
+        uint8_t hw_tag[AesGcm::kTagBytes], sw_tag[AesGcm::kTagBytes];
+        gcm.encrypt(nonce, aad.data(), aad.size(), in.data(), len, hw.data(), hw_tag);
+        AesGcm::force_portable(true);
+        gcm.encrypt(nonce, aad.data(), aad.size(), in.data(), len, sw.data(), sw_tag);
+        AesGcm::force_portable(false);
+        CHECK(hw == sw);
+        CHECK_EQ(test::to_hex(hw_tag, sizeof hw_tag), test::to_hex(sw_tag, sizeof sw_tag));
+    }
+}
+
+TEST(aes_gcm_rejects_tampering) {
+    uint8_t key[AesGcm::kKeyBytes] = {1};
+    uint8_t nonce[AesGcm::kNonceBytes] = {2};
+    const std::string aad = "segment header";
+    std::vector<uint8_t> plain(100, 0x5a), sealed(plain.size()), out(plain.size());
+    uint8_t tag[AesGcm::kTagBytes];
+    AesGcm gcm(key);
+    gcm.encrypt(nonce, aad.data(), aad.size(), plain.data(), plain.size(), sealed.data(), tag);
+    CHECK(gcm.decrypt(nonce, aad.data(), aad.size(), sealed.data(), sealed.size(), tag, out.data()));
+
+    sealed[50] ^= 1;
+    CHECK(!gcm.decrypt(nonce, aad.data(), aad.size(), sealed.data(), sealed.size(), tag, out.data()));
+    sealed[50] ^= 1;
+    tag[0] ^= 0x80;
+    CHECK(!gcm.decrypt(nonce, aad.data(), aad.size(), sealed.data(), sealed.size(), tag, out.data()));
+    tag[0] ^= 0x80;
+    const std::string other = "segment headeR";
+    CHECK(!gcm.decrypt(nonce, other.data(), other.size(), sealed.data(), sealed.size(), tag, out.data()));
+    nonce[11] ^= 1;
+    CHECK(!gcm.decrypt(nonce, aad.data(), aad.size(), sealed.data(), sealed.size(), tag, out.data()));
+}
+
+TEST(sha256_known_answers) {
+    const Sha256Digest abc = Sha256::hash("abc", 3);
+    CHECK_EQ(test::to_hex(abc.data(), abc.size()),
+             std::string("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    // Two-block message from FIPS 180-2, fed in pieces.
+    const std::string msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    Sha256 h;
+    h.update(msg.data(), 5);
+    h.update(msg.data() + 5, msg.size() - 5);
+    const Sha256Digest d = h.finish();
+    CHECK_EQ(test::to_hex(d.data(), d.size()),
+             std::string("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+}
+
+}  // namespace fr
@@ -0,0 +1,117 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/codec.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+std::string bytes(const std::vector<uint8_t>& v) { return std::string(v.begin(), v.end()); }
+
+// Walks an LZ4 block and checks the end-of-block rules other decoders rely
+// on: no match starts in the last 12 bytes of output, and the block ends in
+// at least 5 literals. False if the block does not parse.
+bool follows_end_rules(const std::string& block, size_t raw_len) {
+    const auto* ip = reinterpret_cast<const uint8_t*>(block.data());
+    const auto* const iend = ip + block.size();
+    size_t pos = 0;
+    auto length = [&](size_t n) {
+        for (uint8_t b = 255; b == 255 && ip < iend; n += b) b = *ip++;
+        return n;
+    };
+    while (ip < iend) {
+        const uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) lit = length(lit);
+        ip += lit;
+        pos += lit;
+        if (ip == iend) return raw_len < 13 || lit >= 5;
+        if (ip > iend || iend - ip < 2) return false;
+        ip += 2;
+        size_t ml = token & 15;
+        if (ml == 15) ml = length(ml);
+        if (pos + 12 > raw_len) return false;
+        pos += ml + 4;
+        if (pos + 5 > raw_len) return false;
+    }
+    return false;
+}
+
+void check_round_trip(const std::string& raw) {
+    std::string packed, back;
+    if (!codec::compress(seg::Codec::Lz4, raw.data(), raw.size(), &packed)) return;  // stored raw
+    CHECK(packed.size() < raw.size());
+    CHECK(follows_end_rules(packed, raw.size()));
+    CHECK(codec::decompress(seg::Codec::Lz4, packed.data(), packed.size(), raw.size(), &back));
+    CHECK(back == raw);
+}
+
+}  // namespace
+
+TEST(lz4_decodes_reference_block) {
+    // Literals "abc", a 20-byte overlapping match at offset 3 (length
+    // extension byte), then 5 final literals.
+    const std::string block = bytes(test::from_hex("3f 616263 0300 01 50 78797a7a79"));
+    std::string out;
+    CHECK(codec::decompress(seg::Codec::Lz4, block.data(), block.size(), 28, &out));
+    CHECK_EQ(out, std::string("abcabcabcabcabcabcabcabxyzzy"));
+    // The decoder must produce exactly the declared size.
+    CHECK(!codec::decompress(seg::Codec::Lz4, block.data(), block.size(), 27, &out));
+    CHECK(!codec::decompress(seg::Codec::Lz4, block.data(), block.size(), 29, &out));
+}
+
+TEST(lz4_rejects_malformed_blocks) {
+    std::string out;
+    const char* bad[] = {
+        "3f 616263 0000 01 50 78797a7a79",  // offset 0
+        "3f 616263 0400 01 50 78797a7a79",  // offset before the start of output
+        "3f 616263 03",                     // truncated offset
+        "f0 ff",                            // literal length runs off the end
+        "50 78797a",                        // fewer literals than the token says
+    };
+    for (const char* hex : bad) {
+        const std::string block = bytes(test::from_hex(hex));
+        CHECK(!codec::decompress(seg::Codec::Lz4, block.data(), block.size(), 28, &out));
+    }
+}
+
+TEST(lz4_round_trips) {
+    std::mt19937 rng(32);
+    check_round_trip(std::string(100000, 'z'));
+    check_round_trip(std::string(13, 'z'));
+    check_round_trip("abcabcabcabcabcabcabcabxyzzy");
+
+    // Sample-like data: slowly varying doubles, compressible but not
+    // trivially.
+    std::string samples;
+    double v = 0;
+    for (int i = 0; i < 8192; ++i) {
+        v += static_cast<int>(rng() % 5) - 2;
+        samples.append(reinterpret_cast<const char*>(&v), sizeof v);
+    }
+    check_round_trip(samples);
+
+    // Long literal runs (length extensions) between matches, and matches
+    // near the 64 KiB offset limit.
+    std::string mixed;
+    std::string noise(70000, 0);
+    for (char& c : noise) c = static_cast<char>(rng());
+    mixed = noise.substr(0, 600) + std::string(300, 'q') + noise + noise.substr(0, 5000) + noise.substr(0, 17);
+    check_round_trip(mixed);
+
+    // Incompressible input is left to be stored raw.
+    std::string packed;
+    CHECK(!codec::compress(seg::Codec::Lz4, noise.data(), noise.size(), &packed));
+}
+
+TEST(codec_none_passes_through) {
+    std::string out;
+    CHECK(codec::decompress(seg::Codec::None, "abc", 3, 3, &out));
+    CHECK_EQ(out, std::string("abc"));
+    CHECK(!codec::decompress(seg::Codec::None, "abc", 3, 4, &out));
+    CHECK(!codec::compress(seg::Codec::None, "abc", 3, &out));
+}
+
+}  // namespace fr
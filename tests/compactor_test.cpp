@@ -0,0 +1,143 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "../src/channels.hpp"
+#include "../src/compactor.hpp"
+#include "../src/query.hpp"
+#include "../src/segment_reader.hpp"
+#include "../src/segment_writer.hpp"
+#include "../src/storage_layout.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const uint32_t kChannel = channel::make(channel::kDecoded, 5);
+const int64_t kBase = 1700000000LL * 1000000000;  // a whole minute
+const int64_t kSecond = 1000000000;
+
+// 180 s at 4 Hz of value == second, with every 10th sample NaN.
+SealedSegment write_raw(const std::string& root, const std::string& flight, size_t* nans) {
+    SegmentWriterConfig cfg;
+    cfg.root = root;
+    cfg.flight_id = flight;
+    cfg.max_segment_ns = 0;
+    cfg.chunk_records = 256;
+    SealedSegment sealed{};
+    SegmentWriter w(cfg);
+    w.set_seal_callback([&](const SealedSegment& s) { sealed = s; });
+    *nans = 0;
+    for (int i = 0; i < 720; ++i) {
+        const bool nan = i % 10 == 3;
+        *nans += nan;
+        w.append(kChannel, kBase + i * kSecond / 4, nan ? std::numeric_limits<double>::quiet_NaN() : i / 4);
+    }
+    w.close();
+    return sealed;
+}
+
+CompactorConfig compactor_config(const std::string& root) {
+    CompactorConfig cfg;
+    cfg.root = root;
+    cfg.backfill = false;
+    return cfg;
+}
+
+bool run_query(const std::string& root, const std::string& flight, bool rollups, QueryResult* out) {
+    QueryEngine q(root, nullptr);
+    QuerySpec spec;
+    spec.channels = {kChannel};
+    spec.use_rollups = rollups;
+    spec.max_points = 10;
+    return q.run(spec, {flight}, out);
+}
+
+}  // namespace
+
+// Rollups hold finite samples only; the NaNs are counted on the side.
+TEST(compactor_skips_non_finite_samples) {
+    const std::string root = test::temp_dir("compactor");
+    const std::string flight = layout::make_flight_id(kBase);
+    size_t nans = 0;
+    const SealedSegment raw = write_raw(root, flight, &nans);
+
+    Compactor c(compactor_config(root));
+    CHECK(c.compact(flight, raw.path, raw.seq));
+    CHECK_EQ(c.stats().null_samples, nans);
+    CHECK(Compactor::has_rollups(layout::flight_dir(root, flight), raw.seq));
+
+    SegmentReader r;
+    CHECK(r.open(layout::flight_dir(root, flight) + "/" + layout::segment_name(raw.seq, seg::Tier::Rollup1s)));
+    uint64_t count = 0;
+    for (const auto& e : r.index()) {
+        ChunkData d;
+        CHECK(r.read_chunk(e, &d));
+        for (const RollupPoint& p : d.rollup) {
+            count += p.count;
+            CHECK(p.count > 0);
+            CHECK(std::isfinite(p.min) && std::isfinite(p.max) && std::isfinite(p.mean));
+        }
+    }
+    CHECK_EQ(count, 720 - nans);
+}
+
+// Wide spans read rollups and agree with the raw samples.
+TEST(query_rollups_match_raw) {
+    const std::string root = test::temp_dir("compactor");
+    const std::string flight = layout::make_flight_id(kBase);
+    size_t nans = 0;
+    const SealedSegment raw = write_raw(root, flight, &nans);
+    Compactor c(compactor_config(root));
+    CHECK(c.compact(flight, raw.path, raw.seq));
+
+    QueryResult from_raw, from_rollups;
+    CHECK(run_query(root, flight, false, &from_raw));
+    CHECK(run_query(root, flight, true, &from_rollups));
+    CHECK_EQ(from_raw.stats.segments_rollup, 0u);
+    CHECK_EQ(from_rollups.stats.segments_rollup, 1u);
+    CHECK(from_rollups.resolution_ns > 0);
+    CHECK_EQ(from_raw.channels.at(0).count, 720 - nans);
+    CHECK_EQ(from_rollups.channels.at(0).count, from_raw.channels.at(0).count);
+    CHECK_EQ(from_rollups.channels.at(0).min, from_raw.channels.at(0).min);
+    CHECK_EQ(from_rollups.channels.at(0).max, from_raw.channels.at(0).max);
+    CHECK(std::abs(from_rollups.channels.at(0).avg() - from_raw.channels.at(0).avg()) < 1e-9);
+
+    // With the raw segment reclaimed, aggregates still come from the
+    // rollups; a query that insists on raw samples reports it unavailable.
+    CHECK(unlink(raw.path.c_str()) == 0);
+    QueryResult reclaimed, raw_only;
+    CHECK(run_query(root, flight, true, &reclaimed));
+    CHECK_EQ(reclaimed.channels.at(0).count, from_raw.channels.at(0).count);
+    run_query(root, flight, false, &raw_only);
+    CHECK_EQ(raw_only.stats.segments_unavailable, 1u);
+}
+
+// A chunk that cannot be read leaves the coarsest tier, the completion
+// marker, unwritten so that backfill retries the segment.
+TEST(compactor_withholds_marker_on_read_error) {
+    const std::string root = test::temp_dir("compactor");
+    const std::string flight = layout::make_flight_id(kBase);
+    size_t nans = 0;
+    const SealedSegment raw = write_raw(root, flight, &nans);
+    {
+        SegmentReader r;
+        CHECK(r.open(raw.path));
+        const uint64_t at = r.index().at(0).offset + sizeof(seg::ChunkHeader) + 1;
+        const int fd = ::open(raw.path.c_str(), O_WRONLY);
+        CHECK(fd >= 0);
+        const char junk = 0x5a;
+        CHECK(pwrite(fd, &junk, 1, static_cast<off_t>(at)) == 1);
+        ::close(fd);
+    }
+    Compactor c(compactor_config(root));
+    CHECK(!c.compact(flight, raw.path, raw.seq));
+    const std::string dir = layout::flight_dir(root, flight);
+    CHECK(!Compactor::has_rollups(dir, raw.seq));
+    CHECK(access((dir + "/" + layout::segment_name(raw.seq, seg::Tier::Rollup1s)).c_str(), F_OK) == 0);
+}
+
+}  // namespace fr
@@ -0,0 +1,253 @@
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "../src/config.hpp"
+#include "../src/crc32c.hpp"
+#include "../src/fs_util.hpp"
+#include "../src/value_storage.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const char kConfig[] =
+    "# telemetry\n"
+    "source fc udp:127.0.0.1:14550 priority=1\n"
+    "message 33 priority=1 max_rate_hz=10\n"
+    "message 0 store=0   # heartbeats: fields only\n"
+    "channel 3 gpos.alt msg=33 offset=16 type=i32 scale=0.001 storage=i32 precision=0.001\n"
+    "channel 1 gpos.lat msg=33 offset=4 type=i32 scale=1e-7\n"
+    "channel 2 hb.custom_mode msg=0 offset=0 type=u32 priority=3 max_error=0.5\n"
+    "channel 4 vfr.airspeed msg=74 offset=0 type=f32 storage=f16\n";
+
+std::string compiled() {
+    std::string blob, errors;
+    CHECK(compile_config(kConfig, &blob, &errors));
+    CHECK_EQ(errors, std::string());
+    return blob;
+}
+
+cfg::ConfigHeader header_of(const std::string& blob) {
+    cfg::ConfigHeader h;
+    std::memcpy(&h, blob.data(), sizeof(h));
+    return h;
+}
+
+void set_header(std::string* blob, const cfg::ConfigHeader& h) { std::memcpy(&(*blob)[0], &h, sizeof(h)); }
+
+// Recomputes the CRC after a body edit, so only the structural checks can object.
+void reseal(std::string* blob) {
+    cfg::ConfigHeader h = header_of(*blob);
+    h.crc = crc32c(blob->data() + sizeof(h), blob->size() - sizeof(h));
+    set_header(blob, h);
+}
+
+std::string rejection(const std::string& blob) {
+    std::string err;
+    CHECK(CompiledConfig::from_bytes(blob, &err) == nullptr);
+    return err;
+}
+
+}  // namespace
+
+TEST(config_compiles_and_round_trips) {
+    std::string err;
+    auto c = CompiledConfig::from_bytes(compiled(), &err);
+    CHECK(c != nullptr);
+    if (!c) return;
+    CHECK_EQ(c->header().version, cfg::kVersion);
+
+    CHECK_EQ(c->source_count(), 1u);
+    CHECK_EQ(std::string(c->str(c->source(0).name_off)), std::string("fc"));
+    CHECK_EQ(std::string(c->str(c->source(0).spec_off)), std::string("udp:127.0.0.1:14550"));
+    CHECK_EQ(c->source(0).priority, uint8_t{1});
+
+    // Rules sorted by msgid, 74 added for its channel; each owns a
+    // contiguous run of channels in file order.
+    CHECK_EQ(c->message_count(), 3u);
+    CHECK_EQ(c->find_message(0), 0);
+    CHECK_EQ(c->find_message(33), 1);
+    CHECK_EQ(c->find_message(74), 2);
+    CHECK_EQ(c->find_message(5), -1);
+    CHECK_EQ(c->find_message(1000), -1);
+    const cfg::MessageRec& hb = c->message(0);
+    CHECK_EQ(hb.flags & cfg::kStoreFrame, 0);
+    CHECK_EQ(hb.n_channels, 1u);
+    const cfg::MessageRec& gpos = c->message(1);
+    CHECK_EQ(gpos.priority, uint8_t{1});
+    CHECK_EQ(gpos.min_interval_us, 100000u);
+    CHECK(gpos.flags & cfg::kStoreFrame);
+    CHECK_EQ(gpos.n_channels, 2u);
+    CHECK_EQ(c->channel(gpos.first_channel).id, 3u);
+    CHECK_EQ(c->channel(gpos.first_channel + 1).id, 1u);
+    CHECK(c->message(2).flags & cfg::kStoreFrame);
+
+    const cfg::ChannelRec* alt = c->find_channel(3);
+    CHECK(alt != nullptr);
+    if (alt) {
+        CHECK_EQ(std::string(c->str(alt->name_off)), std::string("gpos.alt"));
+        CHECK_EQ(alt->offset, uint16_t{16});
+        CHECK(alt->type == static_cast<uint8_t>(cfg::FieldType::I32));
+        CHECK_EQ(alt->scale, 0.001f);
+        CHECK(alt->storage == static_cast<uint8_t>(seg::ValueStorage::Fixed32));
+        CHECK_EQ(alt->precision, 0.001f);
+        CHECK_EQ(alt->max_gap_s, 10.0f);  // the default
+    }
+    const cfg::ChannelRec* mode = c->find_channel(2);
+    CHECK(mode != nullptr && mode->priority == 3 && mode->max_error == 0.5f);
+    const cfg::ChannelRec* speed = c->find_channel(4);
+    CHECK(speed != nullptr && speed->storage == static_cast<uint8_t>(seg::ValueStorage::F16));
+    CHECK(c->find_channel(9) == nullptr);
+
+    // Compiling is deterministic.
+    CHECK(compiled() == std::string(reinterpret_cast<const char*>(c->data()), c->size()));
+}
+
+TEST(config_compile_reports_every_error) {
+    const std::string text =
+        "source fc udp:127.0.0.1:14550\n"
+        "source fc udp:127.0.0.1:14551\n"                        // 2: duplicate source
+        "source gps bogus:/dev/null\n"                           // 3: bad spec
+        "message 0 priority=7\n"                                 // 4: priority
+        "message 0\n"                                            // 5: duplicate message
+        "message 1 max_rate_hz=0\n"                              // 6: rate
+        "channel 1 a msg=0 offset=0\n"                           // 7: no type
+        "channel 2 b msg=0 offset=0 type=u128\n"                 // 8: type
+        "channel 3 c msg=0 offset=252 type=u32\n"                // 9: past the payload
+        "channel 4 d msg=0 offset=0 type=u8 storage=i16\n"       // 10: needs precision
+        "channel 5 e msg=0 offset=0 type=u8 precision=0.1\n"     // 11: precision without fixed point
+        "channel 6 f msg=0 offset=0 type=u8 max_error=-1\n"      // 12: max_error
+        "channel 7 a msg=0 offset=0 type=u8\n"                   // 13: fine
+        "channel 7 g msg=0 offset=0 type=u8\n"                   // 14: duplicate id
+        "channel 8 a msg=0 offset=0 type=u8\n"                   // 15: duplicate name
+        "widget 1\n";                                            // 16: unknown
+    std::string blob = "untouched", errors;
+    CHECK(!compile_config(text, &blob, &errors));
+    CHECK_EQ(blob, std::string("untouched"));
+    const char* expected[] = {
+        "line 2: duplicate source fc",
+        "line 3: ",
+        "line 4: priority must be 0..3",
+        "line 5: duplicate message 0",
+        "line 6: max_rate_hz must be > 0",
+        "line 7: expected: channel",
+        "line 8: unknown type u128",
+        "line 9: field does not fit in a MAVLink payload",
+        "line 10: storage=i16 needs precision=",
+        "line 11: precision applies to i16/i32 storage only",
+        "line 12: max_error must be >= 0",
+        "line 14: duplicate channel id",
+        "line 15: duplicate channel a",
+        "line 16: unknown directive 'widget'",
+    };
+    for (const char* e : expected) {
+        if (errors.find(e) == std::string::npos) test::fail(__FILE__, __LINE__, std::string("missing: ") + e);
+    }
+    CHECK(errors.find("line 1:") == std::string::npos);
+    CHECK(errors.find("line 13:") == std::string::npos);
+}
+
+TEST(config_rejects_damaged_blobs) {
+    const std::string good = compiled();
+
+    CHECK_EQ(rejection(""), std::string("truncated header"));
+    CHECK_EQ(rejection(good.substr(0, sizeof(cfg::ConfigHeader) - 1)), std::string("truncated header"));
+    CHECK_EQ(rejection(good.substr(0, good.size() - 1)), std::string("checksum mismatch"));
+    CHECK_EQ(rejection(good + '\0'), std::string("checksum mismatch"));
+
+    std::string bad = good;
+    bad[sizeof(cfg::ConfigHeader) + 5] ^= 1;
+    CHECK_EQ(rejection(bad), std::string("checksum mismatch"));
+
+    bad = good;
+    bad[0] = 'X';
+    CHECK_EQ(rejection(bad), std::string("not a compiled config"));
+
+    // One format version; older and newer ones alike are refused.
+    for (uint16_t v : {uint16_t{0}, uint16_t{cfg::kVersion + 1}}) {
+        bad = good;
+        cfg::ConfigHeader h = header_of(bad);
+        h.version = v;
+        set_header(&bad, h);
+        CHECK_EQ(rejection(bad), "config version " + std::to_string(v) + " not supported");
+    }
+
+    // Checksummed but inconsistent.
+    bad = good;
+    cfg::ConfigHeader h = header_of(bad);
+    h.n_channels += 1000;
+    set_header(&bad, h);
+    CHECK_EQ(rejection(bad), std::string("table out of bounds"));
+
+    bad = good;
+    h = header_of(bad);
+    bad[h.strings_off + h.strings_size - 1] = 'x';  // unterminated string table
+    reseal(&bad);
+    CHECK_EQ(rejection(bad), std::string("table out of bounds"));
+
+    bad = good;
+    h = header_of(bad);
+    cfg::MessageRec m;
+    std::memcpy(&m, bad.data() + h.messages_off + sizeof(m), sizeof(m));
+    m.msgid = 0;  // same as the rule before it
+    std::memcpy(&bad[h.messages_off + sizeof(m)], &m, sizeof(m));
+    reseal(&bad);
+    CHECK_EQ(rejection(bad), std::string("message table corrupt"));
+
+    bad = good;
+    h = header_of(bad);
+    cfg::ChannelRec c;
+    std::memcpy(&c, bad.data() + h.channels_off, sizeof(c));
+    c.type = 99;
+    std::memcpy(&bad[h.channels_off], &c, sizeof(c));
+    reseal(&bad);
+    CHECK_EQ(rejection(bad), std::string("channel table corrupt"));
+
+    bad = good;
+    h = header_of(bad);
+    cfg::SourceRec s;
+    std::memcpy(&s, bad.data() + h.sources_off, sizeof(s));
+    s.spec_off = h.strings_size;
+    std::memcpy(&bad[h.sources_off], &s, sizeof(s));
+    reseal(&bad);
+    CHECK_EQ(rejection(bad), std::string("source table corrupt"));
+}
+
+TEST(config_load_maps_file_and_rejects_damage) {
+    const std::string dir = test::temp_dir("config");
+    const std::string good = compiled();
+    std::string err;
+
+    const std::string path = dir + "/fr.cfg";
+    CHECK(write_file_atomic(path, good.data(), good.size()));
+    auto c = CompiledConfig::load(path, &err);
+    CHECK(c != nullptr);
+    if (c) {
+        CHECK(std::string(reinterpret_cast<const char*>(c->data()), c->size()) == good);
+        CHECK_EQ(c->find_message(33), 1);
+    }
+
+    CHECK(CompiledConfig::load(dir + "/missing.cfg", &err) == nullptr);
+    CHECK(err.find(dir + "/missing.cfg: ") == 0);
+
+    const std::string tiny = dir + "/tiny.cfg";
+    CHECK(write_file_atomic(tiny, good.data(), 10));
+    CHECK(CompiledConfig::load(tiny, &err) == nullptr);
+    CHECK_EQ(err, tiny + ": too small to be a compiled config");
+
+    const std::string cut = dir + "/cut.cfg";
+    CHECK(write_file_atomic(cut, good.data(), good.size() - 3));
+    CHECK(CompiledConfig::load(cut, &err) == nullptr);
+    CHECK_EQ(err, cut + ": checksum mismatch");
+
+    std::string flipped = good;
+    flipped.back() ^= 0x40;
+    const std::string bad = dir + "/bad.cfg";
+    CHECK(write_file_atomic(bad, flipped.data(), flipped.size()));
+    CHECK(CompiledConfig::load(bad, &err) == nullptr);
+    CHECK_EQ(err, bad + ": checksum mismatch");
+}
+
+}  // namespace fr
@@ -0,0 +1,229 @@
+#include <linux/can.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/dronecan.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const int64_t kMs = 1000000;
+
+// Message frame id: priority, data type id, source node.
+uint32_t message_id(uint16_t type, uint8_t node, uint8_t priority = 16) {
+    return uint32_t{priority} << 24 | uint32_t{type} << 8 | node;
+}
+
+// Service frame id: priority, service type id, request flag, destination and source node.
+uint32_t service_id(uint8_t type, bool request, uint8_t dest, uint8_t node) {
+    return uint32_t{4} << 24 | uint32_t{type} << 16 | uint32_t{request} << 15 | uint32_t{dest} << 8 | 0x80 | node;
+}
+
+can_frame frame(uint32_t id, const std::vector<uint8_t>& data, uint8_t tail) {
+    can_frame f{};
+    f.can_id = id | CAN_EFF_FLAG;
+    std::memcpy(f.data, data.data(), data.size());
+    f.data[data.size()] = tail;
+    f.can_dlc = static_cast<uint8_t>(data.size() + 1);
+    return f;
+}
+
+uint8_t tail(bool start, bool end, bool toggle, uint8_t tid) {
+    return static_cast<uint8_t>((start ? 0x80 : 0) | (end ? 0x40 : 0) | (toggle ? 0x20 : 0) | (tid & 0x1f));
+}
+
+// CRC-16-CCITT as the transfer CRC uses it: seeded with the data type
+// signature, then the payload.
+uint16_t transfer_crc(uint64_t signature, const std::vector<uint8_t>& payload) {
+    uint16_t crc = 0xffff;
+    auto add = [&crc](uint8_t b) {
+        crc ^= static_cast<uint16_t>(b << 8);
+        for (int i = 0; i < 8; ++i) crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+    };
+    for (int i = 0; i < 8; ++i) add(static_cast<uint8_t>(signature >> (8 * i)));
+    for (uint8_t b : payload) add(b);
+    return crc;
+}
+
+// Splits `payload` into the frames of one multi-frame transfer, CRC first.
+std::vector<can_frame> split(uint32_t id, uint8_t tid, uint16_t crc, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> bytes = {static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8)};
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+    std::vector<can_frame> out;
+    for (size_t off = 0; off < bytes.size(); off += 7) {
+        const size_t n = std::min<size_t>(7, bytes.size() - off);
+        const std::vector<uint8_t> chunk(bytes.begin() + off, bytes.begin() + off + n);
+        out.push_back(frame(id, chunk, tail(off == 0, off + n == bytes.size(), out.size() % 2, tid)));
+    }
+    return out;
+}
+
+std::vector<uint8_t> counting(size_t n) {
+    std::vector<uint8_t> v(n);
+    for (size_t i = 0; i < n; ++i) v[i] = static_cast<uint8_t>(i * 7 + 1);
+    return v;
+}
+
+}  // namespace
+
+TEST(dronecan_single_frame_transfers) {
+    DroneCanReassembler r;
+    const DroneCanTransfer* t = r.push(frame(message_id(1030, 42), {1, 2, 3}, tail(true, true, false, 5)), 0);
+    CHECK(t != nullptr);
+    if (t) {
+        CHECK_EQ(t->local, 1030u);
+        CHECK(!t->multi_frame);
+        CHECK_EQ(t->transfer_crc, uint16_t{0});
+        CHECK_EQ(std::string(reinterpret_cast<const char*>(t->payload), t->len), std::string("\x01\x02\x03"));
+    }
+
+    // Anonymous messages keep only the 2-bit discriminator.
+    t = r.push(frame(message_id(0x1234, 0), {9}, tail(true, true, false, 0)), 0);
+    CHECK(t != nullptr && t->local == (0x1234u & 0x3));
+    // Services: kService | service type id.
+    t = r.push(frame(service_id(11, true, 10, 42), {}, tail(true, true, false, 0)), 0);
+    CHECK(t != nullptr && t->local == (dronecan::kService | 11));
+
+    // Standard-id, RTR, error and empty frames are not DroneCAN.
+    can_frame f = frame(0x123, {1}, tail(true, true, false, 0));
+    f.can_id = 0x123;
+    CHECK(r.push(f, 0) == nullptr);
+    f = frame(message_id(1030, 42), {1}, tail(true, true, false, 0));
+    f.can_id |= CAN_RTR_FLAG;
+    CHECK(r.push(f, 0) == nullptr);
+    f.can_id = message_id(1030, 42) | CAN_EFF_FLAG | CAN_ERR_FLAG;
+    CHECK(r.push(f, 0) == nullptr);
+    f.can_id = message_id(1030, 42) | CAN_EFF_FLAG;
+    f.can_dlc = 0;
+    CHECK(r.push(f, 0) == nullptr);
+    CHECK_EQ(r.stats().frames, uint64_t{3});
+    CHECK_EQ(r.stats().transfers, uint64_t{3});
+}
+
+TEST(dronecan_multi_frame_keeps_transfer_crc) {
+    const uint64_t signature = 0x8280632c40e574b5ull;  // any data type signature will do
+    const std::vector<uint8_t> payload = counting(40);
+    const uint16_t crc = transfer_crc(signature, payload);
+    const uint32_t id = message_id(1063, 7, 20);
+
+    DroneCanReassembler r;
+    const std::vector<can_frame> frames = split(id, 3, crc, payload);
+    CHECK_EQ(frames.size(), size_t{6});
+    const DroneCanTransfer* t = nullptr;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        t = r.push(frames[i], static_cast<int64_t>(i) * kMs);
+        CHECK((t != nullptr) == (i + 1 == frames.size()));
+    }
+    CHECK(t != nullptr);
+    if (!t) return;
+    CHECK(t->multi_frame);
+    CHECK_EQ(t->can_id, id);
+    CHECK_EQ(t->local, 1063u);
+    CHECK_EQ(t->transfer_crc, crc);
+    CHECK(std::vector<uint8_t>(t->payload, t->payload + t->len) == payload);
+    // What offline tools do with it once they know the signature.
+    CHECK_EQ(transfer_crc(signature, std::vector<uint8_t>(t->payload, t->payload + t->len)), t->transfer_crc);
+    CHECK_EQ(r.stats().multi_frame, uint64_t{1});
+    CHECK_EQ(r.stats().errors, uint64_t{0});
+}
+
+TEST(dronecan_rejects_broken_sequences) {
+    const std::vector<uint8_t> payload = counting(20);
+    const uint32_t id = message_id(1034, 9);
+    const std::vector<can_frame> good = split(id, 4, 0xbeef, payload);  // 4 frames
+
+    DroneCanReassembler r;
+    // A repeated frame breaks the toggle.
+    CHECK(r.push(good[0], 0) == nullptr);
+    CHECK(r.push(good[1], 1) == nullptr);
+    CHECK(r.push(good[1], 2) == nullptr);
+    CHECK_EQ(r.stats().errors, uint64_t{1});
+    // The session is gone: the rest are orphans.
+    CHECK(r.push(good[2], 3) == nullptr);
+    CHECK_EQ(r.stats().orphans, uint64_t{1});
+
+    // A continuation from another transfer id.
+    const std::vector<can_frame> other = split(id, 5, 0xbeef, payload);
+    CHECK(r.push(good[0], 10) == nullptr);
+    CHECK(r.push(other[1], 11) == nullptr);
+    CHECK_EQ(r.stats().errors, uint64_t{2});
+
+    // A start with the toggle set, or too short to hold the CRC.
+    can_frame bad = good[0];
+    bad.data[bad.can_dlc - 1] |= 0x20;
+    CHECK(r.push(bad, 20) == nullptr);
+    CHECK(r.push(frame(id, {1}, tail(true, false, false, 6)), 21) == nullptr);
+    CHECK_EQ(r.stats().errors, uint64_t{4});
+
+    // A new start while a transfer is open: counted, and the new one wins.
+    CHECK(r.push(good[0], 30) == nullptr);
+    CHECK(r.push(other[0], 31) == nullptr);
+    CHECK_EQ(r.stats().errors, uint64_t{5});
+    const DroneCanTransfer* t = nullptr;
+    for (size_t i = 1; i < other.size(); ++i) t = r.push(other[i], 32 + static_cast<int64_t>(i));
+    CHECK(t != nullptr && std::vector<uint8_t>(t->payload, t->payload + t->len) == payload);
+
+    // Oversized transfers are dropped.
+    const std::vector<can_frame> huge = split(id, 7, 0, counting(dronecan::kMaxPayload + 10));
+    t = nullptr;
+    for (const can_frame& f : huge) t = r.push(f, 40);
+    CHECK(t == nullptr);
+    CHECK_EQ(r.stats().errors, uint64_t{6});
+}
+
+TEST(dronecan_times_out_stale_sessions) {
+    const std::vector<can_frame> frames = split(message_id(1034, 9), 1, 0, counting(20));
+    DroneCanReassembler r;
+    CHECK(r.push(frames[0], 0) == nullptr);
+    CHECK(r.push(frames[1], dronecan::kTimeoutNs + 1) == nullptr);
+    CHECK_EQ(r.stats().timeouts, uint64_t{1});
+    CHECK(r.push(frames[2], dronecan::kTimeoutNs + 2) == nullptr);
+    CHECK_EQ(r.stats().orphans, uint64_t{1});
+
+    // Spread over just under the timeout, it completes.
+    const int64_t t0 = 10 * dronecan::kTimeoutNs;
+    const DroneCanTransfer* t = nullptr;
+    for (size_t i = 0; i < frames.size(); ++i)
+        t = r.push(frames[i], t0 + static_cast<int64_t>(i) * (dronecan::kTimeoutNs / 4));
+    CHECK(t != nullptr);
+}
+
+TEST(dronecan_full_slot_table_evicts_oldest) {
+    DroneCanReassembler r;
+    // One open session per source node, one more than there are slots.
+    std::vector<std::vector<can_frame>> sessions;
+    for (uint8_t node = 1; node <= dronecan::kSlots + 1; ++node) {
+        sessions.push_back(split(message_id(1034, node), 0, node, counting(20)));
+        CHECK(r.push(sessions.back()[0], node * kMs) == nullptr);
+    }
+    CHECK_EQ(r.stats().evictions, uint64_t{1});
+    // Node 1 started first and lost its slot; the newest still completes.
+    CHECK(r.push(sessions[0][1], 100 * kMs) == nullptr);
+    CHECK_EQ(r.stats().orphans, uint64_t{1});
+    const DroneCanTransfer* t = nullptr;
+    for (size_t i = 1; i < sessions.back().size(); ++i) t = r.push(sessions.back()[i], 100 * kMs);
+    CHECK(t != nullptr && t->transfer_crc == dronecan::kSlots + 1);
+
+    // Full again; a slot reclaimed from a session past the timeout counts
+    // as a timeout.
+    CHECK(r.push(split(message_id(1034, 100), 0, 0, counting(20))[0], 100 * kMs) == nullptr);
+    CHECK(r.push(split(message_id(1034, 101), 0, 0, counting(20))[0], 3 * dronecan::kTimeoutNs) == nullptr);
+    CHECK_EQ(r.stats().timeouts, uint64_t{1});
+    CHECK_EQ(r.stats().evictions, uint64_t{1});
+}
+
+TEST(dronecan_encode_layout) {
+    const uint8_t payload[] = {0xaa, 0xbb, 0xcc};
+    const DroneCanTransfer t{0x10abcd42, 0xabcd, 0x1234, true, payload, sizeof(payload)};
+    std::string out = "stale";
+    DroneCanReassembler::encode(t, &out);
+    CHECK_EQ(out.size(), dronecan::kRecordHeader + sizeof(payload));
+    CHECK_EQ(test::to_hex(reinterpret_cast<const uint8_t*>(out.data()), out.size()),
+             std::string("42cdab10" "3412" "aabbcc"));
+}
+
+}  // namespace fr
@@ -0,0 +1,108 @@
+// Hand-built flights for the decode and replay tests: records are written
+// exactly as given, so a test controls which frames have raw bytes behind
+// them. Recorder tests feed a live UDP source through UdpSender instead.
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../src/channels.hpp"
+#include "../src/mavlink.hpp"
+#include "../src/record.hpp"
+#include "../src/segment_writer.hpp"
+#include "../src/source.hpp"
+
+namespace fr {
+namespace test {
+
+// A MAVLink v2 HEARTBEAT; `seq` tells frames apart. Type 2 is a quadrotor,
+// 6 a GCS; base_mode 0x80 is armed.
+inline std::string heartbeat(uint8_t sysid, uint8_t seq, uint8_t base_mode = 0, uint8_t type = 2) {
+    const uint8_t payload[9] = {0, 0, 0, 0, type, 3, base_mode, 0, 3};
+    uint8_t buf[mavlink::kMaxFrameV2];
+    const size_t n = mavlink::encode_v2(buf, seq, sysid, 1, mavlink::kMsgHeartbeat, payload, sizeof(payload));
+    return std::string(reinterpret_cast<const char*>(buf), n);
+}
+
+inline Record blob(uint32_t channel, int64_t t_ns, const std::string& bytes) {
+    Record r;
+    r.t_ns = t_ns;
+    r.channel = channel;
+    r.blob = true;
+    r.bytes = bytes;
+    return r;
+}
+
+inline SourceSpec udp_source(const std::string& name, uint16_t port) {
+    SourceSpec s;
+    s.name = name;
+    s.kind = SourceKind::Udp;
+    s.path = "127.0.0.1";
+    s.port = port;
+    return s;
+}
+
+// A loopback port that was free a moment ago, for a recorder's UDP source.
+inline uint16_t free_udp_port() {
+    const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(a);
+    uint16_t port = 0;
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) == 0 &&
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&a), &len) == 0)
+        port = ntohs(a.sin_port);
+    ::close(fd);
+    return port;
+}
+
+// Sends datagrams to 127.0.0.1:<port>.
+struct UdpSender {
+    int fd = -1;
+    sockaddr_in to{};
+
+    explicit UdpSender(uint16_t port) {
+        fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        to.sin_port = htons(port);
+    }
+    ~UdpSender() { ::close(fd); }
+    UdpSender(const UdpSender&) = delete;
+    UdpSender& operator=(const UdpSender&) = delete;
+
+    bool send(const std::string& bytes) const {
+        return ::sendto(fd, bytes.data(), bytes.size(), 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to)) ==
+               static_cast<ssize_t>(bytes.size());
+    }
+};
+
+// One flight, one segment, with the source table every recorder segment has.
+inline void write_flight(const std::string& root, const std::string& flight, const std::vector<SourceSpec>& sources,
+                         std::vector<Record> records) {
+    SegmentWriterConfig cfg;
+    cfg.root = root;
+    cfg.flight_id = flight;
+    cfg.max_segment_ns = 0;
+    SegmentWriter w(cfg);
+    w.add_segment_preamble(channel::make(channel::kMeta, channel::kMetaSources), format_source_table(sources));
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& a, const Record& b) { return a.t_ns < b.t_ns; });
+    for (const Record& r : records) {
+        if (r.blob)
+            w.append_blob(r.channel, r.t_ns, r.bytes.data(), static_cast<uint32_t>(r.bytes.size()));
+        else
+            w.append(r.channel, r.t_ns, r.value);
+    }
+    w.close();
+}
+
+}  // namespace test
+}  // namespace fr
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../src/gnss.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+// UBX-ACK-ACK for UBX-CFG-PRT, as sent by every u-blox receiver.
+const char* kUbxAck = "b5 62 05 01 02 00 06 00 0e 37";
+
+std::vector<uint8_t> rtcm_frame(const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> f = {gnss::kRtcmPreamble, static_cast<uint8_t>(payload.size() >> 8),
+                              static_cast<uint8_t>(payload.size())};
+    f.insert(f.end(), payload.begin(), payload.end());
+    const uint32_t crc = gnss::crc24q(f.data(), f.size());
+    f.push_back(static_cast<uint8_t>(crc >> 16));
+    f.push_back(static_cast<uint8_t>(crc >> 8));
+    f.push_back(static_cast<uint8_t>(crc));
+    return f;
+}
+
+struct Seen {
+    std::vector<std::pair<bool, uint16_t>> frames;  // (rtcm, msg_id)
+    void operator()(const GnssFrame& f) { frames.emplace_back(f.rtcm, f.msg_id); }
+};
+
+}  // namespace
+
+TEST(crc24q_known_answer) {
+    const char* check = "123456789";
+    CHECK_EQ(gnss::crc24q(reinterpret_cast<const uint8_t*>(check), 9), 0xcde703u);
+    // Incremental over a split input.
+    const uint32_t part = gnss::crc24q(reinterpret_cast<const uint8_t*>(check), 4);
+    CHECK_EQ(gnss::crc24q(reinterpret_cast<const uint8_t*>(check) + 4, 5, part), 0xcde703u);
+    // A frame's CRC over everything including its own CRC is zero.
+    const std::vector<uint8_t> f = rtcm_frame({0x3e, 0xd0, 0x00, 0x01});
+    CHECK_EQ(gnss::crc24q(f.data(), f.size()), 0u);
+}
+
+// UBX and RTCM3 interleaved with NMEA, fed whole and then one byte at a time.
+TEST(gnss_framer_interleaved) {
+    std::vector<uint8_t> stream;
+    const std::string nmea = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+    const std::vector<uint8_t> ubx = test::from_hex(kUbxAck);
+    const std::vector<uint8_t> rtcm = rtcm_frame({0x3e, 0xd0, 0x00, 0x03, 0x8a, 0x0e});  // message 1005
+    std::vector<uint8_t> bad = rtcm_frame({0x43, 0x50, 0x11});                         // 1077, CRC broken
+    bad.back() ^= 1;
+    stream.insert(stream.end(), nmea.begin(), nmea.end());
+    stream.insert(stream.end(), ubx.begin(), ubx.end());
+    stream.insert(stream.end(), bad.begin(), bad.end());
+    stream.insert(stream.end(), rtcm.begin(), rtcm.end());
+    stream.insert(stream.end(), nmea.begin(), nmea.end());
+    stream.insert(stream.end(), ubx.begin(), ubx.end());
+
+    for (size_t step : {stream.size(), size_t{1}, size_t{7}}) {
+        GnssFramer framer;
+        Seen seen;
+        for (size_t off = 0; off < stream.size(); off += step)
+            framer.feed(stream.data() + off, std::min(step, stream.size() - off), seen);
+        CHECK_EQ(seen.frames.size(), 3u);
+        if (seen.frames.size() != 3) continue;
+        CHECK(!seen.frames[0].first);
+        CHECK_EQ(seen.frames[0].second, 0x0501);
+        CHECK(seen.frames[1].first);
+        CHECK_EQ(seen.frames[1].second, 1005);
+        CHECK(!seen.frames[2].first);
+        CHECK_EQ(framer.stats().crc_errors, 1u);
+        CHECK_EQ(framer.stats().ubx_frames, 2u);
+        CHECK_EQ(framer.stats().rtcm_frames, 1u);
+    }
+}
+
+// A UBX-only source ignores RTCM3 frames.
+TEST(gnss_framer_accept_mask) {
+    const std::vector<uint8_t> ubx = test::from_hex(kUbxAck);
+    std::vector<uint8_t> stream = rtcm_frame({0x3e, 0xd0, 0x00});
+    stream.insert(stream.end(), ubx.begin(), ubx.end());
+    GnssFramer framer(gnss::kUbx);
+    Seen seen;
+    framer.feed(stream.data(), stream.size(), seen);
+    CHECK_EQ(seen.frames.size(), 1u);
+    CHECK_EQ(framer.stats().rtcm_frames, 0u);
+}
+
+}  // namespace fr
@@ -0,0 +1,129 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../src/fs_util.hpp"
+#include "../src/hash_chain.hpp"
+#include "../src/storage_layout.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const char* kFlight = "20260101T000000Z";
+
+std::shared_ptr<const MasterKey> key_file(const std::string& root, const std::string& name, char digit) {
+    const std::string path = root + "/" + name;
+    const std::string hex(64, digit);
+    CHECK(write_file_atomic(path, hex.data(), hex.size()));
+    return load_master_key(path);
+}
+
+// Three raw segments of different sizes and the manifest entries for them.
+std::vector<ManifestSegment> write_segments(const std::string& root) {
+    const std::string dir = layout::flight_dir(root, kFlight);
+    make_dirs(dir);
+    std::vector<ManifestSegment> segs;
+    Sha256Digest prev = chain_genesis(kFlight);
+    for (uint32_t seq = 0; seq < 3; ++seq) {
+        ManifestSegment s;
+        s.name = layout::segment_name(seq);
+        const std::string data(1000 + 4096 * seq, static_cast<char>('a' + seq));
+        CHECK(write_file_atomic(dir + "/" + s.name, data.data(), data.size()));
+        CHECK(hash_file(dir + "/" + s.name, &s.hash));
+        s.bytes = data.size();
+        s.t_first = seq * 1000;
+        s.t_last = s.t_first + 999;
+        s.link = chain_link(prev, s.hash);
+        prev = s.link;
+        segs.push_back(s);
+    }
+    return segs;
+}
+
+}  // namespace
+
+TEST(hash_chain_signed_manifest_verifies) {
+    const std::string root = test::temp_dir("chain");
+    const auto key = key_file(root, "key", '7');
+    const auto other = key_file(root, "other", '8');
+    TaskPool pool(2);
+    CHECK(write_manifest(root, kFlight, write_segments(root), key.get()));
+
+    ChainReport r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(r.manifest);
+    CHECK(r.ok());
+    CHECK(r.signature == ChainReport::Signature::Valid);
+    CHECK_EQ(r.listed, size_t{3});
+    CHECK_EQ(r.verified, size_t{3});
+
+    r = verify_chain(root, kFlight, nullptr, &pool);
+    CHECK(r.ok());
+    CHECK(r.signature == ChainReport::Signature::Unchecked);
+
+    r = verify_chain(root, kFlight, other.get(), &pool);
+    CHECK(!r.ok());
+    CHECK(r.signature == ChainReport::Signature::Invalid);
+
+    // Editing the manifest body, e.g. to hide a segment's size, voids the
+    // signature.
+    std::string text;
+    CHECK(read_file(layout::manifest_path(root, kFlight), &text));
+    const size_t at = text.find(" 1000 ");
+    CHECK(at != std::string::npos);
+    text.replace(at, 6, " 1001 ");
+    CHECK(write_file_atomic(layout::manifest_path(root, kFlight), text.data(), text.size()));
+    r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(r.signature == ChainReport::Signature::Invalid);
+}
+
+TEST(hash_chain_detects_tampering) {
+    const std::string root = test::temp_dir("chain");
+    const auto key = key_file(root, "key", '7');
+    TaskPool pool(2);
+    std::vector<ManifestSegment> segs = write_segments(root);
+    CHECK(write_manifest(root, kFlight, segs, key.get()));
+    const std::string dir = layout::flight_dir(root, kFlight);
+
+    // A reclaimed segment is missing, not an error.
+    CHECK(::unlink((dir + "/" + segs[0].name).c_str()) == 0);
+    ChainReport r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(r.ok());
+    CHECK_EQ(r.missing, size_t{1});
+    CHECK_EQ(r.verified, size_t{2});
+
+    // Changed contents are.
+    const std::string forged(segs[1].bytes, 'z');
+    CHECK(write_file_atomic(dir + "/" + segs[1].name, forged.data(), forged.size()));
+    r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(!r.ok());
+    CHECK_EQ(r.verified, size_t{1});
+
+    // So is a manifest, even a validly signed one, that drops a segment from
+    // the middle of the chain.
+    const std::vector<ManifestSegment> gapped = {segs[0], segs[2]};
+    CHECK(write_manifest(root, kFlight, gapped, key.get()));
+    r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(r.signature == ChainReport::Signature::Valid);
+    CHECK(!r.ok());
+
+    // Sealed after the last manifest write: reported, not an error.
+    CHECK(write_manifest(root, kFlight, {segs[0]}, key.get()));
+    r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(r.ok());
+    CHECK_EQ(r.unlisted, size_t{2});
+}
+
+TEST(hash_chain_unsigned_manifest_rejected_with_key) {
+    const std::string root = test::temp_dir("chain");
+    const auto key = key_file(root, "key", '7');
+    TaskPool pool(2);
+    CHECK(write_manifest(root, kFlight, write_segments(root), nullptr));
+    CHECK(verify_chain(root, kFlight, nullptr, &pool).ok());
+    const ChainReport r = verify_chain(root, kFlight, key.get(), &pool);
+    CHECK(!r.ok());
+    CHECK(r.signature == ChainReport::Signature::Invalid);
+}
+
+}  // namespace fr
@@ -0,0 +1,267 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/health.hpp"
+#include "../src/mavlink.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const int64_t kMs = 1000000;
+const int64_t kNow = 100000 * kMs;
+
+// Datagram socket bound where a test points the monitor; local sends are
+// queued by the time send() returns, so draining needs no wait.
+struct Receiver {
+    int fd = -1;
+    ~Receiver() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    std::vector<std::string> drain() const {
+        std::vector<std::string> out;
+        char buf[1024];
+        ssize_t n;
+        while ((n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) >= 0) out.emplace_back(buf, static_cast<size_t>(n));
+        return out;
+    }
+};
+
+// Stands in for systemd's $NOTIFY_SOCKET.
+void bind_unix(Receiver* r, const std::string& path) {
+    r->fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_un a{};
+    a.sun_family = AF_UNIX;
+    std::strncpy(a.sun_path, path.c_str(), sizeof(a.sun_path) - 1);
+    CHECK_EQ(::bind(r->fd, reinterpret_cast<const sockaddr*>(&a), sizeof(a)), 0);
+}
+
+// Stands in for the GCS; returns the port.
+uint16_t bind_udp(Receiver* r) {
+    r->fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(a);
+    CHECK_EQ(::bind(r->fd, reinterpret_cast<const sockaddr*>(&a), sizeof(a)), 0);
+    CHECK_EQ(::getsockname(r->fd, reinterpret_cast<sockaddr*>(&a), &len), 0);
+    return ntohs(a.sin_port);
+}
+
+struct Msg {
+    uint32_t msgid;
+    uint8_t sysid;
+    uint8_t compid;
+    std::vector<uint8_t> payload;  // zero-extended past v2 truncation
+};
+
+std::vector<Msg> parse(const std::vector<std::string>& datagrams) {
+    std::vector<Msg> out;
+    MavlinkFramer framer;
+    for (const std::string& d : datagrams) {
+        framer.feed(reinterpret_cast<const uint8_t*>(d.data()), d.size(), [&](const MavFrame& f) {
+            Msg m{f.msgid, f.sysid, f.compid, std::vector<uint8_t>(f.payload, f.payload + f.payload_len)};
+            m.payload.resize(64);
+            out.push_back(std::move(m));
+        });
+    }
+    return out;
+}
+
+uint32_t u32(const Msg& m, size_t off) {
+    uint32_t v;
+    std::memcpy(&v, m.payload.data() + off, sizeof(v));
+    return v;
+}
+
+float named_value(const std::vector<Msg>& msgs, const std::string& name) {
+    for (const Msg& m : msgs) {
+        if (m.msgid != mavlink::kMsgNamedValueFloat) continue;
+        if (std::string(reinterpret_cast<const char*>(m.payload.data() + 8), 10).c_str() != name) continue;
+        float v;
+        std::memcpy(&v, m.payload.data() + 4, sizeof(v));
+        return v;
+    }
+    test::fail(__FILE__, __LINE__, "no NAMED_VALUE_FLOAT " + name);
+    return 0;
+}
+
+const Msg* find(const std::vector<Msg>& msgs, uint32_t msgid) {
+    for (const Msg& m : msgs)
+        if (m.msgid == msgid) return &m;
+    return nullptr;
+}
+
+std::string statustext(const Msg& m) {
+    return std::string(reinterpret_cast<const char*>(m.payload.data() + 1), 50).c_str();
+}
+
+HealthSample healthy() {
+    HealthSample s;
+    s.queue_depth = 3;
+    s.queue_capacity = 100;
+    s.last_write_ns = kNow - 500 * kMs;
+    s.oldest_tick_ns = kNow - 100 * kMs;
+    s.free_bytes = 2u << 20;
+    s.sources = 1;
+    s.sources_open = 1;
+    return s;
+}
+
+}  // namespace
+
+TEST(health_tick_tracks_state) {
+    HealthSample s = healthy();
+    HealthConfig cfg;
+    cfg.systemd = false;
+    HealthMonitor m(cfg, [&] { return s; });
+
+    m.tick(kNow);
+    CHECK(m.state() == HealthState::Ok);
+
+    // Stalled once the least recent writer loop is older than stall_after.
+    s.oldest_tick_ns = kNow - 800 * kMs;
+    m.tick(kNow);
+    CHECK(m.state() == HealthState::Ok);
+    s.oldest_tick_ns = kNow - 801 * kMs;
+    m.tick(kNow);
+    CHECK(m.state() == HealthState::Stalled);
+    s.oldest_tick_ns = 0;  // no writer loop yet
+    m.tick(kNow);
+    CHECK(m.state() == HealthState::Ok);
+
+    // A drop holds Degraded for two seconds after the count last grew.
+    const auto live_tick = [&](int64_t t) {
+        s.oldest_tick_ns = t - 100 * kMs;
+        m.tick(t);
+    };
+    s.dropped = 5;
+    live_tick(kNow);
+    CHECK(m.state() == HealthState::Degraded);
+    live_tick(kNow + 1999 * kMs);
+    CHECK(m.state() == HealthState::Degraded);
+    live_tick(kNow + 2000 * kMs);
+    CHECK(m.state() == HealthState::Ok);
+    s.link_lost = 1;  // losses before ingest count too
+    live_tick(kNow + 3000 * kMs);
+    CHECK(m.state() == HealthState::Degraded);
+    s.oldest_tick_ns = kNow;  // a stall outranks the drops
+    m.tick(kNow + 3900 * kMs);
+    CHECK(m.state() == HealthState::Stalled);
+    live_tick(kNow + 5000 * kMs);
+    CHECK(m.state() == HealthState::Ok);
+
+    const int64_t t = kNow + 5000 * kMs;
+    s.headroom_ok = false;
+    m.tick(t);
+    CHECK(m.state() == HealthState::Degraded);
+    s.headroom_ok = true;
+    s.sources_open = 0;
+    m.tick(t);
+    CHECK(m.state() == HealthState::Degraded);
+    s.sources = 0;  // none configured is not a fault
+    m.tick(t);
+    CHECK(m.state() == HealthState::Ok);
+    s.hot = true;  // informational only
+    m.tick(t);
+    CHECK(m.state() == HealthState::Ok);
+}
+
+TEST(health_reports_to_systemd_and_mavlink) {
+    Receiver notify, gcs;
+    const std::string path = test::temp_dir("health") + "/notify";
+    bind_unix(&notify, path);
+    setenv("NOTIFY_SOCKET", path.c_str(), 1);
+    setenv("WATCHDOG_USEC", "1000000", 1);
+    unsetenv("WATCHDOG_PID");
+
+    HealthSample s = healthy();
+    HealthConfig cfg;
+    cfg.udp_host = "127.0.0.1";
+    cfg.udp_port = bind_udp(&gcs);
+    cfg.sysid = 7;
+    HealthMonitor m(cfg, [&] { return s; });
+    unsetenv("NOTIFY_SOCKET");
+    unsetenv("WATCHDOG_USEC");
+
+    // Healthy: the watchdog is fed; heartbeat and counters, no STATUSTEXT.
+    m.tick(kNow);
+    CHECK(notify.drain() == std::vector<std::string>({"WATCHDOG=1\nSTATUS=ok: queue 3/100, 0+0 dropped, last write "
+                                                      "0.5 s ago, 2 MB free, 1/1 sources open"}));
+    std::vector<Msg> msgs = parse(gcs.drain());
+    CHECK_EQ(msgs.size(), size_t{7});
+    const Msg* hb = find(msgs, mavlink::kMsgHeartbeat);
+    CHECK(hb != nullptr);
+    if (!hb) return;
+    CHECK_EQ(hb->sysid, uint8_t{7});
+    CHECK_EQ(hb->compid, uint8_t{191});
+    CHECK_EQ(u32(*hb, 0), 0u);
+    CHECK_EQ(hb->payload[4], uint8_t{18});  // onboard controller
+    CHECK_EQ(hb->payload[7], uint8_t{4});   // active
+    CHECK_EQ(named_value(msgs, "fr_queue"), 3.0f);
+    CHECK_EQ(named_value(msgs, "fr_wr_age"), 0.5f);
+    CHECK_EQ(named_value(msgs, "fr_free_mb"), 2.0f);
+    CHECK(find(msgs, mavlink::kMsgStatustext) == nullptr);
+
+    // Stalled: the watchdog starves, the heartbeat turns critical.
+    s.oldest_tick_ns = kNow - 1500 * kMs;
+    m.tick(kNow);
+    std::vector<std::string> notes = notify.drain();
+    CHECK_EQ(notes.size(), size_t{1});
+    CHECK(notes.size() == 1 && notes[0].rfind("STATUS=STALLED: queue 3/100", 0) == 0);
+    msgs = parse(gcs.drain());
+    hb = find(msgs, mavlink::kMsgHeartbeat);
+    CHECK(hb != nullptr && u32(*hb, 0) == kHealthStalled && hb->payload[7] == 5);
+    const Msg* text = find(msgs, mavlink::kMsgStatustext);
+    CHECK(text != nullptr && text->payload[0] == 2);
+    CHECK(text != nullptr && statustext(*text) == "fr: writer stalled 1.5 s");
+    // Unchanged problems: no second STATUSTEXT.
+    m.tick(kNow);
+    notify.drain();
+    CHECK(find(parse(gcs.drain()), mavlink::kMsgStatustext) == nullptr);
+
+    // Degraded: fed again; the hot flag rides along without being a problem.
+    s.oldest_tick_ns = kNow;
+    s.dropped = 4;
+    s.link_lost = 2;
+    s.hot = true;
+    m.tick(kNow);
+    notes = notify.drain();
+    CHECK(notes.size() == 1 && notes[0].rfind("WATCHDOG=1\nSTATUS=degraded: queue 3/100, 4+2 dropped", 0) == 0);
+    CHECK(notes.size() == 1 && notes[0].find(", thermal hot mode") != std::string::npos);
+    msgs = parse(gcs.drain());
+    hb = find(msgs, mavlink::kMsgHeartbeat);
+    CHECK(hb != nullptr && u32(*hb, 0) == (kHealthDropping | kHealthHotMode) && hb->payload[7] == 4);
+    text = find(msgs, mavlink::kMsgStatustext);
+    CHECK(text != nullptr && text->payload[0] == 4 && statustext(*text) == "fr: degraded: dropping");
+    CHECK_EQ(named_value(msgs, "fr_drops"), 4.0f);
+    CHECK_EQ(named_value(msgs, "fr_lnklost"), 2.0f);
+
+    // Recovered once the drop flag's hold runs out.
+    s.oldest_tick_ns = kNow + 2000 * kMs;
+    m.tick(kNow + 2000 * kMs);
+    notes = notify.drain();
+    CHECK(notes.size() == 1 && notes[0].rfind("WATCHDOG=1\nSTATUS=ok: ", 0) == 0);
+    msgs = parse(gcs.drain());
+    text = find(msgs, mavlink::kMsgStatustext);
+    CHECK(text != nullptr && text->payload[0] == 6 && statustext(*text) == "fr: recording ok");
+
+    // The thread brackets its ticks with READY and STOPPING.
+    m.start();
+    m.stop();
+    notes = notify.drain();
+    CHECK(std::find(notes.begin(), notes.end(), "READY=1") != notes.end());
+    CHECK(!notes.empty() && notes.back() == "STOPPING=1\nSTATUS=stopping: closing segments");
+}
+
+}  // namespace fr
@@ -0,0 +1,102 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/lazy_decode.hpp"
+#include "../src/segment_reader.hpp"
+#include "../src/storage_layout.hpp"
+#include "flight_fixture.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const int64_t kBase = 1700000000LL * 1000000000;
+const int64_t kMs = 1000000;
+const uint32_t kHeartbeat = channel::make(channel::kMavlink, mavlink::kMsgHeartbeat);
+const uint32_t kValue = channel::make(channel::kDecoded, 7);
+
+// Records per channel in a flight, blobs keyed by content.
+struct Contents {
+    std::map<uint32_t, size_t> count;
+    std::map<std::string, size_t> frames;
+};
+
+Contents read_flight(const std::string& root, const std::string& flight) {
+    Contents out;
+    for (const std::string& path : layout::raw_segment_paths(root, flight)) {
+        SegmentReader r;
+        CHECK(r.open(path));
+        for (const seg::IndexEntry& e : r.index()) {
+            ChunkData d;
+            CHECK(r.read_chunk(e, &d));
+            out.count[e.channel] += d.t.size();
+            size_t off = 0;
+            for (uint32_t len : d.blob_len) {
+                if (e.channel == kHeartbeat) out.frames[d.blob_bytes.substr(off, len)]++;
+                off += len;
+            }
+        }
+    }
+    return out;
+}
+
+bool decode(const std::string& root, const std::string& flight, std::string* err) {
+    TaskPool pool(2);
+    LazyDecodeConfig cfg;
+    cfg.root = root;
+    cfg.flight_id = flight;
+    cfg.pool = &pool;
+    LazyDecoder d(cfg);
+    const bool ok = d.run();
+    *err = d.error();
+    return ok;
+}
+
+}  // namespace
+
+TEST(lazy_decode_refuses_flight_without_raw_stream) {
+    const std::string root = test::temp_dir("decode");
+    const std::string flight = layout::make_flight_id(kBase);
+    std::vector<Record> records;
+    for (uint8_t i = 0; i < 20; ++i) records.push_back(test::blob(kHeartbeat, kBase + i * kMs, test::heartbeat(1, i)));
+    test::write_flight(root, flight, {test::udp_source("fc", 14550)}, records);
+
+    std::string err;
+    CHECK(!decode(root, flight, &err));
+    CHECK(err.find("no raw stream") != std::string::npos);
+    CHECK(layout::raw_segment_paths(root, flight + "-decoded").empty());
+}
+
+// Source 0 was captured raw and framed; source 1 only framed, and source 0's
+// raw capture has a gap (as while disk headroom was low before raw was
+// kept there). Nothing may be lost and nothing doubled.
+TEST(lazy_decode_keeps_frames_without_raw_bytes) {
+    const std::string root = test::temp_dir("decode");
+    const std::string flight = layout::make_flight_id(kBase);
+    const uint32_t raw0 = channel::make(channel::kRawStream, 0);
+    std::vector<Record> records;
+    for (uint8_t i = 0; i < 30; ++i) {
+        const int64_t t = kBase + i * 10 * kMs;
+        const std::string f = test::heartbeat(1, i);
+        if (i < 10 || i >= 20) records.push_back(test::blob(raw0, t, f));  // gap in raw capture
+        records.push_back(test::blob(kHeartbeat, t, f));
+        records.push_back(test::blob(kHeartbeat, t + 3 * kMs, test::heartbeat(2, i)));  // source 1
+        Record v;
+        v.t_ns = t + 5 * kMs;
+        v.channel = kValue;
+        v.value = i;
+        records.push_back(v);
+    }
+    test::write_flight(root, flight, {test::udp_source("fc", 14550), test::udp_source("radio", 14551)}, records);
+
+    std::string err;
+    CHECK(decode(root, flight, &err));
+    const Contents out = read_flight(root, flight + "-decoded");
+    CHECK_EQ(out.count.count(raw0), size_t{0});
+    CHECK_EQ(out.count.at(kHeartbeat), size_t{60});
+    CHECK_EQ(out.frames.size(), size_t{60});
+    CHECK_EQ(out.count.at(kValue), size_t{30});
+}
+
+}  // namespace fr
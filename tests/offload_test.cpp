@@ -0,0 +1,122 @@
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+
+#include "../src/fs_util.hpp"
+#include "../src/offload.hpp"
+#include "../src/storage_layout.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+std::string random_bytes(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string s(n, '\0');
+    for (char& c : s) c = static_cast<char>(rng());
+    return s;
+}
+
+void put_segment(const std::string& root, const std::string& flight, const std::string& data) {
+    const std::string dir = layout::flight_dir(root, flight);
+    make_dirs(dir);
+    CHECK(write_file_atomic(dir + "/" + layout::segment_name(1), data.data(), data.size()));
+}
+
+OffloadServerConfig server_config(const std::string& root) {
+    OffloadServerConfig cfg;
+    cfg.root = root;
+    cfg.bind_addr = "127.0.0.1";
+    cfg.port = 0;
+    cfg.chunk_bytes = 64u << 10;
+    cfg.io_timeout_ms = 2000;
+    return cfg;
+}
+
+OffloadClientConfig client_config(uint16_t port, const std::string& dest) {
+    OffloadClientConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = port;
+    cfg.dest = dest;
+    cfg.io_timeout_ms = 2000;
+    return cfg;
+}
+
+size_t thread_count() {
+    size_t n = 0;
+    DIR* d = opendir("/proc/self/task");
+    if (!d) return 0;
+    while (dirent* e = readdir(d))
+        if (e->d_name[0] != '.') n++;
+    closedir(d);
+    return n;
+}
+
+}  // namespace
+
+// A later run, with a fresh client, still finds chunks of files completed by
+// an earlier one and does not fetch them again.
+TEST(offload_reuses_chunks_across_runs) {
+    const std::string root = test::temp_dir("offload-src");
+    const std::string dest = test::temp_dir("offload-dst");
+    const std::string data = random_bytes(300 << 10, 1);
+    put_segment(root, "20240101T000000Z", data);
+    OffloadServer server(server_config(root));
+    server.start();
+    {
+        OffloadClient first(client_config(server.port(), dest));
+        CHECK(first.sync());
+        CHECK_EQ(first.stats().files_completed, 1u);
+        CHECK_EQ(first.stats().bytes_received, data.size());
+    }
+    put_segment(root, "20240101T010000Z", data);
+    OffloadClient second(client_config(server.port(), dest));
+    CHECK(second.sync());
+    CHECK_EQ(second.stats().files_completed, 1u);
+    CHECK_EQ(second.stats().files_present, 1u);
+    CHECK_EQ(second.stats().bytes_reused, data.size());
+    CHECK_EQ(second.stats().bytes_received, 0u);
+    server.stop();
+}
+
+// A file that cannot be written locally fails that file, not the whole pass.
+TEST(offload_continues_past_local_errors) {
+    const std::string root = test::temp_dir("offload-src");
+    const std::string dest = test::temp_dir("offload-dst");
+    put_segment(root, "20240101T000000Z", random_bytes(100 << 10, 2));
+    put_segment(root, "20240101T010000Z", random_bytes(100 << 10, 3));
+    // A plain file where the first flight's directory has to go.
+    make_dirs(layout::flights_dir(dest));
+    CHECK(write_file_atomic(layout::flight_dir(dest, "20240101T000000Z"), "x", 1));
+
+    OffloadServer server(server_config(root));
+    server.start();
+    OffloadClient client(client_config(server.port(), dest));
+    CHECK(!client.sync_with_retry(2, 1));
+    CHECK_EQ(client.stats().files_completed, 1u);
+    struct stat st{};
+    CHECK(stat((layout::flight_dir(dest, "20240101T010000Z") + "/" + layout::segment_name(1)).c_str(), &st) == 0);
+    server.stop();
+}
+
+// Finished connections do not leave a thread behind each.
+TEST(offload_reaps_client_threads) {
+    const std::string root = test::temp_dir("offload-src");
+    const std::string dest = test::temp_dir("offload-dst");
+    put_segment(root, "20240101T000000Z", random_bytes(10 << 10, 4));
+    OffloadServer server(server_config(root));
+    server.start();
+    const size_t before = thread_count();
+    for (int i = 0; i < 20; ++i) {
+        OffloadClient client(client_config(server.port(), dest));
+        CHECK(client.sync());
+    }
+    usleep(50000);
+    CHECK(thread_count() <= before + 2);
+    server.stop();
+}
+
+}  // namespace fr
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "../src/channels.hpp"
+#include "../src/query.hpp"
+#include "../src/segment_writer.hpp"
+#include "../src/storage_layout.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const uint32_t kChannel = channel::make(channel::kDecoded, 7);
+const int64_t kBase = 1700000000LL * 1000000000;
+
+// 4096 samples, 1 ms apart, value i % 100 - 50, every 7th NaN.
+std::string write_flight(const std::string& root) {
+    const std::string flight = layout::make_flight_id(kBase);
+    SegmentWriterConfig cfg;
+    cfg.root = root;
+    cfg.flight_id = flight;
+    cfg.chunk_records = 512;
+    SegmentWriter w(cfg);
+    for (int i = 0; i < 4096; ++i)
+        w.append(kChannel, kBase + i * 1000000LL,
+                 i % 7 == 0 ? std::numeric_limits<double>::quiet_NaN() : i % 100 - 50);
+    w.close();
+    return flight;
+}
+
+}  // namespace
+
+TEST(query_counts_finite_samples) {
+    const std::string root = test::temp_dir("query");
+    const std::string flight = write_flight(root);
+    QueryEngine q(root, nullptr);
+    QuerySpec spec;
+    spec.channels = {kChannel};
+    QueryResult r;
+    CHECK(q.run(spec, {flight}, &r));
+    CHECK_EQ(r.channels.at(0).count, 4096u - 586u);
+    CHECK_EQ(r.channels.at(0).min, -50.0);
+    CHECK_EQ(r.channels.at(0).max, 49.0);
+}
+
+// min/max without count are still answered from the index, and the channel
+// is reported as having samples.
+TEST(query_min_max_without_count) {
+    const std::string root = test::temp_dir("query");
+    const std::string flight = write_flight(root);
+    QueryEngine q(root, nullptr);
+    QuerySpec spec;
+    spec.channels = {kChannel};
+    spec.aggregates = kAggMin | kAggMax;
+    QueryResult r;
+    CHECK(q.run(spec, {flight}, &r));
+    const ChannelSummary& c = r.channels.at(0);
+    CHECK(c.matched);
+    CHECK_EQ(c.min, -50.0);
+    CHECK_EQ(c.max, 49.0);
+    CHECK_EQ(r.stats.chunks_decoded, 0u);
+}
+
+// A value predicate prunes chunks by their statistics and still counts
+// exactly what matches.
+TEST(query_value_predicate) {
+    const std::string root = test::temp_dir("query");
+    const std::string flight = write_flight(root);
+    QueryEngine q(root, nullptr);
+    QuerySpec spec;
+    spec.channels = {kChannel};
+    spec.v_lo = 40;
+    spec.v_hi = 1000;
+    QueryResult r;
+    CHECK(q.run(spec, {flight}, &r));
+    uint64_t want = 0;
+    for (int i = 0; i < 4096; ++i)
+        if (i % 7 != 0 && i % 100 - 50 >= 40) want++;
+    CHECK_EQ(r.channels.at(0).count, want);
+    CHECK_EQ(r.channels.at(0).min, 40.0);
+}
+
+}  // namespace fr
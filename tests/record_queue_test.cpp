@@ -0,0 +1,121 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/clock.hpp"
+#include "../src/record_queue.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+Record at(int64_t t_ns, uint16_t source) {
+    Record r;
+    r.t_ns = t_ns;
+    r.source = source;
+    return r;
+}
+
+}  // namespace
+
+TEST(record_queue_merges_producers_in_order) {
+    constexpr size_t kProducers = 3;
+    constexpr int kPerProducer = 3000;
+    RecordQueue q(kProducers, kProducers * 4096, std::chrono::seconds(1));
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p)
+        producers.emplace_back([&q, p] {
+            for (int i = 0; i < kPerProducer; ++i) {
+                q.push(p, at(monotonic_ns(), static_cast<uint16_t>(p)));
+                if (i % 64 == 0) std::this_thread::yield();
+            }
+        });
+
+    std::atomic<bool> closed{false};
+    std::thread closer([&] {
+        for (auto& t : producers) t.join();
+        q.close();
+        closed = true;
+    });
+    std::vector<Record> out, batch;
+    for (;;) {
+        const bool last = closed.load();
+        batch.clear();
+        q.pop_batch(&batch, 256, std::chrono::milliseconds(50));
+        if (last && batch.empty()) break;
+        for (auto& r : batch) out.push_back(std::move(r));
+    }
+    closer.join();
+
+    CHECK_EQ(q.dropped(), uint64_t{0});
+    CHECK_EQ(q.late(), uint64_t{0});
+    CHECK_EQ(out.size(), kProducers * kPerProducer);
+    size_t per[kProducers] = {};
+    for (size_t i = 0; i < out.size(); ++i) {
+        per[out[i].source]++;
+        if (i) CHECK(out[i - 1].t_ns <= out[i].t_ns);
+    }
+    for (size_t p = 0; p < kProducers; ++p) CHECK_EQ(per[p], size_t{kPerProducer});
+}
+
+TEST(record_queue_holds_for_quiet_producers) {
+    const auto window = std::chrono::milliseconds(100);
+    RecordQueue q(2, 4096, window);
+    const int64_t t0 = monotonic_ns();
+    q.push(0, at(t0, 0));
+
+    // Producer 1 has said nothing yet, so it might still deliver something
+    // older than t0 until the window has passed.
+    std::vector<Record> out;
+    CHECK_EQ(q.pop_batch(&out, 16, std::chrono::milliseconds(10)), size_t{0});
+
+    // Once it has delivered a later record, both can go.
+    q.push(1, at(t0 + 1000, 1));
+    CHECK_EQ(q.pop_batch(&out, 16, std::chrono::milliseconds(0)), size_t{2});
+    CHECK_EQ(out[0].source, uint16_t{0});
+    CHECK_EQ(out[1].source, uint16_t{1});
+
+    // A lone record waits out the window, then goes.
+    out.clear();
+    const int64_t t1 = monotonic_ns();
+    q.push(0, at(t1, 0));
+    CHECK_EQ(q.pop_batch(&out, 16, std::chrono::seconds(5)), size_t{1});
+    CHECK(monotonic_ns() - t1 >= std::chrono::nanoseconds(window).count());
+
+    // Anything older than what has been released goes at once, as late.
+    out.clear();
+    q.push(1, at(t1 - 1000, 1));
+    CHECK_EQ(q.pop_batch(&out, 16, std::chrono::milliseconds(0)), size_t{1});
+    CHECK_EQ(q.late(), uint64_t{1});
+}
+
+TEST(record_queue_close_releases_in_order_with_ties_to_lower_producer) {
+    RecordQueue q(3, 4096, std::chrono::seconds(10));
+    const int64_t t = monotonic_ns();
+    q.push(2, at(t, 2));
+    q.push(1, at(t, 1));
+    q.push(0, at(t + 5, 0));
+    q.push(1, at(t + 7, 1));
+    q.push(2, at(t + 6, 2));
+    q.close();
+    std::vector<Record> out;
+    while (q.pop_batch(&out, 2, std::chrono::milliseconds(0))) {
+    }
+    CHECK_EQ(out.size(), size_t{5});
+    const uint16_t want[] = {1, 2, 0, 2, 1};
+    for (size_t i = 0; i < out.size() && i < 5; ++i) CHECK_EQ(out[i].source, want[i]);
+    CHECK_EQ(q.late(), uint64_t{0});
+}
+
+TEST(record_queue_full_ring_drops_without_blocking) {
+    RecordQueue q(1, 1, std::chrono::milliseconds(10));
+    size_t accepted = 0;
+    const int64_t t = monotonic_ns();
+    for (int i = 0; i < 5000; ++i) accepted += q.push(0, at(t + i, 0));
+    CHECK(accepted < 5000);
+    CHECK_EQ(q.dropped(), uint64_t{5000 - accepted});
+    CHECK_EQ(q.size(), accepted);
+}
+
+}  // namespace fr
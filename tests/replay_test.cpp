@@ -0,0 +1,165 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/clock.hpp"
+#include "../src/replay.hpp"
+#include "../src/storage_layout.hpp"
+#include "flight_fixture.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const int64_t kBase = 1700000000LL * 1000000000;
+const int64_t kMs = 1000000;
+const uint32_t kHeartbeat = channel::make(channel::kMavlink, mavlink::kMsgHeartbeat);
+
+// A bound loopback UDP socket standing in for the consumer.
+struct Listener {
+    int fd = -1;
+    uint16_t port = 0;
+
+    Listener() {
+        fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(a);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) == 0 &&
+            ::getsockname(fd, reinterpret_cast<sockaddr*>(&a), &len) == 0)
+            port = ntohs(a.sin_port);
+    }
+    ~Listener() { ::close(fd); }
+
+    std::vector<std::string> drain() const {
+        std::vector<std::string> out;
+        char buf[2048];
+        for (ssize_t n; (n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) >= 0;) out.emplace_back(buf, n);
+        return out;
+    }
+};
+
+// fc: raw capture with a gap, plus the frames recorded alongside; radio:
+// frames only; gps: raw UBX bytes only.
+std::vector<std::string> write_mixed_flight(const std::string& root, const std::string& flight) {
+    std::vector<Record> records;
+    std::vector<std::string> expected;  // everything, in time order
+    for (uint8_t i = 0; i < 30; ++i) {
+        const int64_t t = kBase + i * 10 * kMs;
+        const std::string fc = test::heartbeat(1, i), radio = test::heartbeat(2, i);
+        if (i < 10 || i >= 20) records.push_back(test::blob(channel::make(channel::kRawStream, 0), t, fc));
+        records.push_back(test::blob(kHeartbeat, t, fc));
+        records.push_back(test::blob(kHeartbeat, t + 2 * kMs, radio));
+        expected.push_back(fc);
+        expected.push_back(radio);
+        if (i % 6 == 0) {
+            const std::string gps = "ubx-" + std::to_string(i);
+            records.push_back(test::blob(channel::make(channel::kRawStream, 2), t + 4 * kMs, gps));
+            expected.push_back(gps);
+        }
+    }
+    SourceSpec gps = test::udp_source("gps", 14552);
+    gps.protocol = LinkProtocol::Ubx;
+    test::write_flight(root, flight, {test::udp_source("fc", 14550), test::udp_source("radio", 14551), gps}, records);
+    return expected;
+}
+
+bool replay(const std::string& root, const std::string& flight, const std::string& source, const Listener& l,
+            Replayer::Stats* stats, std::string* err = nullptr) {
+    ReplayConfig cfg;
+    cfg.root = root;
+    cfg.flight_id = flight;
+    cfg.speed = 0;
+    cfg.source = source;
+    Replayer r(cfg, make_replay_sink("udp:127.0.0.1:" + std::to_string(l.port)));
+    std::atomic<bool> stop{false};
+    const bool ok = r.run(stop);
+    *stats = r.stats();
+    if (err) *err = r.error();
+    return ok;
+}
+
+}  // namespace
+
+TEST(replay_prefers_raw_and_falls_back_to_frames) {
+    const std::string root = test::temp_dir("replay");
+    const std::string flight = layout::make_flight_id(kBase);
+    const std::vector<std::string> expected = write_mixed_flight(root, flight);
+    Listener l;
+    CHECK(l.port != 0);
+
+    Replayer::Stats st;
+    CHECK(replay(root, flight, "", l, &st));
+    const std::vector<std::string> got = l.drain();
+    CHECK_EQ(got.size(), expected.size());
+    CHECK(got == expected);
+    CHECK_EQ(st.records, uint64_t{expected.size()});
+    CHECK_EQ(st.unattributed, uint64_t{0});
+}
+
+TEST(replay_selects_one_source) {
+    const std::string root = test::temp_dir("replay");
+    const std::string flight = layout::make_flight_id(kBase);
+    write_mixed_flight(root, flight);
+    Listener l;
+    Replayer::Stats st;
+
+    // Two MAVLink sources: fc's raw bytes only. The frames fc lacks raw bytes
+    // for cannot be told from radio's.
+    CHECK(replay(root, flight, "fc", l, &st));
+    std::vector<std::string> got = l.drain();
+    CHECK_EQ(got.size(), size_t{20});
+    for (const std::string& f : got) CHECK_EQ(static_cast<int>(static_cast<uint8_t>(f[5])), 1);  // sysid
+    CHECK_EQ(st.unattributed, uint64_t{40});
+
+    CHECK(replay(root, flight, "2", l, &st));
+    got = l.drain();
+    CHECK_EQ(got.size(), size_t{5});
+    for (const std::string& f : got) CHECK(f.rfind("ubx-", 0) == 0);
+
+    std::string err;
+    CHECK(!replay(root, flight, "nope", l, &st, &err));
+    CHECK(err.find("fc") != std::string::npos);
+}
+
+TEST(replay_single_source_frames_without_raw) {
+    const std::string root = test::temp_dir("replay");
+    const std::string flight = layout::make_flight_id(kBase);
+    std::vector<Record> records;
+    for (uint8_t i = 0; i < 25; ++i) records.push_back(test::blob(kHeartbeat, kBase + i * kMs, test::heartbeat(1, i)));
+    test::write_flight(root, flight, {test::udp_source("fc", 14550)}, records);
+    Listener l;
+    Replayer::Stats st;
+    CHECK(replay(root, flight, "fc", l, &st));
+    CHECK_EQ(l.drain().size(), size_t{25});
+    CHECK_EQ(st.unattributed, uint64_t{0});
+}
+
+TEST(replay_pty_write_honours_stop) {
+    // Nobody opens the slave: the pty buffer fills and the write must wait
+    // without blocking past a stop request.
+    std::unique_ptr<ReplaySink> sink = make_replay_sink("pty");
+    std::atomic<bool> stop{false};
+    std::thread stopper([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        stop = true;
+    });
+    const std::string chunk(4096, 'x');
+    const int64_t t0 = monotonic_ns();
+    bool ok = true;
+    for (int i = 0; i < 1024 && ok && !stop.load(); ++i)
+        ok = sink->write(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size(), stop);
+    stopper.join();
+    CHECK(ok);
+    CHECK(monotonic_ns() - t0 < 2000 * kMs);
+}
+
+}  // namespace fr
@@ -0,0 +1,88 @@
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../src/fs_util.hpp"
+#include "../src/retention.hpp"
+#include "../src/storage_layout.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+void touch(const std::string& path, size_t bytes) {
+    const std::string data(bytes, 'x');
+    CHECK(write_file_atomic(path, data.data(), data.size()));
+}
+
+bool exists(const std::string& path) { return access(path.c_str(), F_OK) == 0; }
+
+// Runs passes until at least one has finished.
+void run_pass(RetentionManager& rm) {
+    rm.start();
+    for (int i = 0; i < 500 && rm.stats().passes == 0; ++i) {
+        rm.kick();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    rm.stop();
+}
+
+RetentionConfig unreachable_headroom(const std::string& root) {
+    RetentionConfig cfg;
+    cfg.root = root;
+    cfg.headroom_bytes = UINT64_MAX / 4;  // always short: reclaim everything allowed
+    cfg.poll_interval = std::chrono::milliseconds(10);
+    return cfg;
+}
+
+}  // namespace
+
+// Segments still being written (or left open by a crash) are never reclaimed,
+// even when nothing else is left.
+TEST(retention_keeps_open_segments) {
+    const std::string root = test::temp_dir("retention");
+    const std::string dir = layout::flight_dir(root, "F1");
+    make_dirs(dir);
+    touch(dir + "/" + layout::segment_name(1), 4096);
+    touch(dir + "/" + layout::segment_name(1, seg::Tier::Rollup1m), 512);
+    touch(dir + "/" + layout::open_segment_name(2), 4096);
+
+    RetentionManager rm(unreachable_headroom(root));
+    run_pass(rm);
+    CHECK(!exists(dir + "/" + layout::segment_name(1)));
+    CHECK(!exists(dir + "/" + layout::segment_name(1, seg::Tier::Rollup1m)));
+    CHECK(exists(dir + "/" + layout::open_segment_name(2)));
+    CHECK(!rm.headroom_ok());
+}
+
+// Raw data goes before rollups, across flights: the oldest flight's rollups
+// outlive a newer flight's raw segments.
+TEST(retention_drops_rollups_after_raw) {
+    const std::string root = test::temp_dir("retention");
+    const std::string old_dir = layout::flight_dir(root, "F1");
+    const std::string new_dir = layout::flight_dir(root, "F2");
+    make_dirs(old_dir);
+    make_dirs(new_dir);
+    touch(old_dir + "/" + layout::segment_name(1), 64 << 10);
+    touch(old_dir + "/" + layout::segment_name(2, seg::Tier::Rollup10s), 4096);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    touch(new_dir + "/" + layout::segment_name(1), 64 << 10);
+
+    // Short by a little more than both raw segments: the rollup survives.
+    struct statvfs vfs{};
+    CHECK(statvfs(root.c_str(), &vfs) == 0);
+    const uint64_t free = static_cast<uint64_t>(vfs.f_bavail) * vfs.f_frsize;
+    RetentionConfig cfg = unreachable_headroom(root);
+    cfg.headroom_bytes = free + (96 << 10);
+    cfg.hysteresis_bytes = 0;
+    RetentionManager rm(cfg);
+    run_pass(rm);
+    CHECK(!exists(old_dir + "/" + layout::segment_name(1)));
+    CHECK(!exists(new_dir + "/" + layout::segment_name(1)));
+    CHECK(exists(old_dir + "/" + layout::segment_name(2, seg::Tier::Rollup10s)));
+}
+
+}  // namespace fr
@@ -0,0 +1,67 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "../src/segment_format.hpp"
+#include "test.hpp"
+
+namespace fr {
+
+TEST(chunk_stats_skip_nulls) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const std::vector<double> v = {3, nan, -2, 7, std::numeric_limits<double>::infinity(), 3};
+    seg::IndexEntry e{};
+    e.count = static_cast<uint32_t>(v.size());
+    seg::fill_sample_stats(v.data(), v.size(), &e);
+    CHECK(e.flags & seg::kIndexNullCount);
+    CHECK_EQ(e.null_count, 2u);
+    CHECK_EQ(e.v_min, -2.0);
+    CHECK_EQ(e.v_max, 7.0);
+    uint64_t finite = 0;
+    CHECK(seg::finite_count(e, &finite));
+    CHECK_EQ(finite, 4u);
+}
+
+// Integer-valued chunks get a bloom filter: no false negatives, and values
+// inside [v_min, v_max] that never occurred are mostly ruled out.
+TEST(chunk_bloom_filter) {
+    std::vector<double> v;
+    for (int i = 0; i < 1000; ++i) v.push_back((i % 8) * 10);  // 0, 10, ... 70
+    seg::IndexEntry e{};
+    e.count = static_cast<uint32_t>(v.size());
+    seg::fill_sample_stats(v.data(), v.size(), &e);
+    CHECK(e.flags & seg::kIndexBloom);
+    for (int k = 0; k < 8; ++k) CHECK(seg::may_contain(e, k * 10));
+    int false_positives = 0;
+    for (int k = 0; k <= 70; ++k)
+        if (k % 10 && seg::may_contain(e, k)) false_positives++;
+    CHECK(false_positives < 10);
+    CHECK(!seg::may_contain(e, 71));  // outside the bounds
+    CHECK(!seg::may_contain(e, -1));
+    // The filter is only kept when every value is an integer.
+    CHECK(!seg::may_contain(e, 12.5));
+}
+
+TEST(chunk_bloom_needs_integers) {
+    std::vector<double> v;
+    for (int i = 0; i < 100; ++i) v.push_back(i * 0.25);
+    seg::IndexEntry e{};
+    e.count = static_cast<uint32_t>(v.size());
+    seg::fill_sample_stats(v.data(), v.size(), &e);
+    CHECK(!(e.flags & seg::kIndexBloom));
+    CHECK(seg::may_contain(e, 3.0));
+}
+
+TEST(opaque_entries_never_prune_by_value) {
+    const std::vector<double> v = {1, 2, 3};
+    seg::IndexEntry e{};
+    e.count = 3;
+    seg::fill_sample_stats(v.data(), v.size(), &e);
+    seg::make_opaque(&e);
+    CHECK(e.flags & seg::kIndexOpaque);
+    CHECK(!(e.flags & seg::kIndexBloom));
+    CHECK(seg::may_contain(e, 1000));
+    CHECK(std::isinf(e.v_min) && e.v_min < 0);
+}
+
+}  // namespace fr
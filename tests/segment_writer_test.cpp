@@ -0,0 +1,67 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "../src/segment_reader.hpp"
+#include "../src/segment_writer.hpp"
+#include "../src/storage_layout.hpp"
+#include "test.hpp"
+
+namespace fr {
+
+TEST(segment_writer_abandons_a_segment_it_cannot_write) {
+    SegmentWriterConfig wc;
+    wc.root = test::temp_dir("segwrite");
+    wc.flight_id = "f1";
+    wc.max_segment_ns = 0;
+    wc.chunk_records = 10;
+    const std::string dir = layout::flight_dir(wc.root, wc.flight_id);
+    SegmentWriter w(wc);
+    std::vector<SealedSegment> sealed;
+    w.set_seal_callback([&](const SealedSegment& s) { sealed.push_back(s); });
+
+    // Segment 1 lands on a full disk.
+    const std::string first = dir + "/" + layout::open_segment_name(1);
+    CHECK_EQ(::symlink("/dev/full", first.c_str()), 0);
+    for (int i = 0; i < 25; ++i) w.append(1, 1000 + i, i);
+    bool threw = false;
+    try {
+        w.close();
+    } catch (const SegmentWriteError& ex) {
+        threw = true;
+        CHECK_EQ(ex.records_lost(), uint64_t{25});
+        CHECK(ex.code().value() == ENOSPC);
+    }
+    CHECK(threw);
+    CHECK(sealed.empty());  // never sealed, never chained
+    CHECK_EQ(w.next_seq(), 2u);
+
+    // The next segment starts fresh and seals normally.
+    for (int i = 0; i < 5; ++i) w.append(1, 2000 + i, i);
+    w.close();
+    CHECK_EQ(sealed.size(), size_t{1});
+    if (sealed.size() != 1) return;
+    CHECK_EQ(sealed[0].seq, 2u);
+    SegmentReader r;
+    CHECK(r.open(sealed[0].path));
+    CHECK(!r.recovered());
+    uint64_t records = 0;
+    for (const auto& e : r.index()) records += e.count;
+    CHECK_EQ(records, uint64_t{5});
+    CHECK_EQ(sealed[0].bytes, r.file_size());
+
+    // There is one format version; a file claiming any other is refused.
+    const uint16_t other = seg::kVersion + 1;
+    const int fd = ::open(sealed[0].path.c_str(), O_WRONLY | O_CLOEXEC);
+    CHECK(fd >= 0);
+    CHECK_EQ(::pwrite(fd, &other, sizeof(other), offsetof(seg::FileHeader, version)), ssize_t{sizeof(other)});
+    ::close(fd);
+    CHECK(!r.open(sealed[0].path));
+    CHECK_EQ(r.error(), sealed[0].path + ": unsupported version");
+}
+
+}  // namespace fr
@@ -0,0 +1,72 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../src/clock.hpp"
+#include "../src/serial_source.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+// Master side of a pseudo-terminal; the slave stands in for the UART.
+struct Pty {
+    int master = -1;
+    std::string slave;
+
+    Pty() {
+        master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return;
+        slave = ptsname(master);
+    }
+    ~Pty() {
+        if (master >= 0) ::close(master);
+    }
+};
+
+}  // namespace
+
+TEST(serial_source_stamps_reads_when_received) {
+    Pty pty;
+    CHECK(!pty.slave.empty());
+    if (pty.slave.empty()) return;
+    SourceSpec spec;
+    spec.name = "pty";
+    spec.path = pty.slave;
+    spec.baud = 115200;
+    SerialOptions opts;
+    opts.low_latency = false;
+    SerialSource src(spec, opts);
+    std::string err;
+    const bool opened = src.open(&err);
+    CHECK(opened);
+    if (!opened) return;
+
+    // Two bursts far enough apart for the reader thread to take them in two
+    // port reads, both queued before the parser looks at the ring.
+    const std::string a(40, 'a'), b(60, 'b');
+    CHECK_EQ(::write(pty.master, a.data(), a.size()), static_cast<ssize_t>(a.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const int64_t second_sent = monotonic_ns();
+    CHECK_EQ(::write(pty.master, b.data(), b.size()), static_cast<ssize_t>(b.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const int64_t parsed = monotonic_ns();
+
+    uint8_t buf[4096];
+    const ssize_t n1 = src.read(buf, sizeof buf, 100);
+    const int64_t t1 = src.received_ns();
+    CHECK_EQ(std::string(reinterpret_cast<char*>(buf), n1 > 0 ? n1 : 0), a);
+    CHECK(t1 > 0 && t1 < second_sent);
+
+    const ssize_t n2 = src.read(buf, sizeof buf, 100);
+    const int64_t t2 = src.received_ns();
+    CHECK_EQ(std::string(reinterpret_cast<char*>(buf), n2 > 0 ? n2 : 0), b);
+    CHECK(t2 >= second_sent && t2 < parsed);
+    src.close();
+}
+
+}  // namespace fr
@@ -0,0 +1,268 @@
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/channels.hpp"
+#include "../src/clock.hpp"
+#include "../src/fs_util.hpp"
+#include "../src/recorder.hpp"
+#include "../src/segment_reader.hpp"
+#include "../src/session.hpp"
+#include "../src/storage_layout.hpp"
+#include "flight_fixture.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const int64_t kMs = 1000000;
+const uint8_t kArmed = 0x80;
+
+// A frame with the given payload; the detector only reads the header fields
+// and the payload.
+MavFrame frame(uint8_t sysid, uint32_t msgid, const std::vector<uint8_t>& payload) {
+    MavFrame f{};
+    f.payload = payload.data();
+    f.payload_len = static_cast<uint8_t>(payload.size());
+    f.version = 2;
+    f.sysid = sysid;
+    f.msgid = msgid;
+    return f;
+}
+
+// custom_mode, type, autopilot, base_mode, system_status, mavlink_version
+std::vector<uint8_t> heartbeat(uint8_t base_mode, uint8_t type = 2, uint8_t autopilot = 3) {
+    return {0, 0, 0, 0, type, autopilot, base_mode, 4, 3};
+}
+
+// vtol_state, landed_state
+std::vector<uint8_t> sys_state(uint8_t landed) { return {0, landed}; }
+
+Record sized(int64_t t_ns, size_t bytes) {
+    Record r;
+    r.t_ns = t_ns;
+    r.blob = true;
+    r.bytes.assign(bytes, 'x');
+    return r;
+}
+
+struct Observed {
+    bool changed;
+    SessionEvent ev;
+};
+
+Observed observe(SessionDetector& d, const MavFrame& f) {
+    Observed o{false, SessionEvent::Arm};
+    o.changed = d.observe(f, &o.ev);
+    return o;
+}
+
+bool wait_for(const std::function<bool()>& done) {
+    for (int i = 0; i < 300 && !done(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return done();
+}
+
+}  // namespace
+
+TEST(session_detector_reports_arm_and_disarm) {
+    SessionDetector d;
+    const std::vector<uint8_t> disarmed = heartbeat(0), armed = heartbeat(kArmed | 0x01);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, disarmed)).changed);  // first seen on the ground
+    Observed o = observe(d, frame(1, mavlink::kMsgHeartbeat, armed));
+    CHECK(o.changed && o.ev == SessionEvent::Arm);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, armed)).changed);
+    o = observe(d, frame(1, mavlink::kMsgHeartbeat, disarmed));
+    CHECK(o.changed && o.ev == SessionEvent::Disarm);
+
+    // A vehicle first seen armed arms at once; vehicles are independent.
+    o = observe(d, frame(2, mavlink::kMsgHeartbeat, armed));
+    CHECK(o.changed && o.ev == SessionEvent::Arm);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, disarmed)).changed);
+
+    // MAVLink 2 drops trailing zeros: a payload cut before base_mode is disarmed.
+    const std::vector<uint8_t> truncated(armed.begin(), armed.begin() + 6);
+    o = observe(d, frame(2, mavlink::kMsgHeartbeat, truncated));
+    CHECK(o.changed && o.ev == SessionEvent::Disarm);
+}
+
+TEST(session_detector_ignores_gcs_and_companions) {
+    SessionDetector d;
+    // A GCS, and a companion computer (autopilot "invalid"), both claiming
+    // to be armed, under the same system id as the vehicle.
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, heartbeat(kArmed, 6))).changed);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, heartbeat(kArmed, 18, 8))).changed);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, heartbeat(0))).changed);
+    // Nor do they disarm it.
+    CHECK(observe(d, frame(1, mavlink::kMsgHeartbeat, heartbeat(kArmed))).changed);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, heartbeat(0, 6))).changed);
+    CHECK(!observe(d, frame(1, mavlink::kMsgHeartbeat, heartbeat(0, 18, 8))).changed);
+    // Other messages say nothing.
+    CHECK(!observe(d, frame(1, mavlink::kMsgStatustext, heartbeat(0))).changed);
+}
+
+TEST(session_detector_reports_takeoff_and_landing) {
+    SessionDetector d;
+    CHECK(!observe(d, frame(1, mavlink::kMsgExtendedSysState, sys_state(1))).changed);  // on ground
+    Observed o = observe(d, frame(1, mavlink::kMsgExtendedSysState, sys_state(3)));      // taking off
+    CHECK(o.changed && o.ev == SessionEvent::Takeoff);
+    CHECK(!observe(d, frame(1, mavlink::kMsgExtendedSysState, sys_state(2))).changed);  // in air
+    CHECK(!observe(d, frame(1, mavlink::kMsgExtendedSysState, sys_state(0))).changed);  // undefined
+    CHECK(!observe(d, frame(1, mavlink::kMsgExtendedSysState, sys_state(4))).changed);  // landing
+    o = observe(d, frame(1, mavlink::kMsgExtendedSysState, sys_state(1)));
+    CHECK(o.changed && o.ev == SessionEvent::Landing);
+}
+
+TEST(session_record_round_trips) {
+    const Record r = session_record(SessionEvent::Landing, 42, 123, 3);
+    SessionEvent ev;
+    uint8_t sysid = 0;
+    CHECK(parse_session_record(r, &ev, &sysid));
+    CHECK(ev == SessionEvent::Landing);
+    CHECK_EQ(sysid, uint8_t{42});
+    CHECK_EQ(r.t_ns, int64_t{123});
+
+    Record bad = r;
+    bad.bytes[0] = 9;
+    CHECK(!parse_session_record(bad, &ev, &sysid));
+    bad = r;
+    bad.channel = channel::make(channel::kMavlink, 0);
+    CHECK(!parse_session_record(bad, &ev, &sysid));
+}
+
+TEST(pre_roll_keeps_span_and_bytes) {
+    PreRoll p(std::chrono::milliseconds(100), 1u << 20);
+    for (int i = 0; i < 10; ++i) CHECK_EQ(p.push(sized(i * 10 * kMs, 10)), size_t{0});
+    CHECK_EQ(p.size(), size_t{10});
+    // More than 100 ms behind the newest falls out; exactly 100 ms stays.
+    CHECK_EQ(p.push(sized(110 * kMs, 10)), size_t{1});
+    CHECK_EQ(p.push(sized(125 * kMs, 10)), size_t{2});
+    std::vector<int64_t> kept;
+    p.drain([&](Record&& r) { kept.push_back(r.t_ns); });
+    CHECK_EQ(kept.size(), size_t{9});
+    CHECK(!kept.empty() && kept.front() == 30 * kMs && kept.back() == 125 * kMs);
+    CHECK_EQ(p.size(), size_t{0});
+
+    // Each record costs sizeof(Record) plus its bytes; room for three.
+    const size_t cost = sizeof(Record) + 1000;
+    PreRoll small(std::chrono::seconds(60), 3 * cost);
+    for (int i = 0; i < 3; ++i) CHECK_EQ(small.push(sized(i, 1000)), size_t{0});
+    CHECK_EQ(small.push(sized(3, 1000)), size_t{1});
+    CHECK_EQ(small.push(sized(4, 3000)), size_t{3});  // the big one needs three of the others' room
+    CHECK_EQ(small.size(), size_t{1});
+    // A record bigger than the whole buffer does not stay either.
+    CHECK_EQ(small.push(sized(5, 4 * cost)), size_t{2});
+    CHECK_EQ(small.size(), size_t{0});
+}
+
+// Two sorties through a live recorder: the first closes on the post-roll
+// timer while data keeps coming, the second when the link goes quiet. Each
+// becomes its own sealed flight, with its pre-roll and nothing of the other.
+TEST(recorder_seals_one_flight_per_sortie) {
+    const uint16_t port = test::free_udp_port();
+    RecorderConfig rc;
+    rc.root = test::temp_dir("sorties");
+    rc.sources.push_back(test::udp_source("fc", port));
+    rc.writer.max_segment_ns = 0;
+    rc.retention.headroom_bytes = 0;
+    rc.health.systemd = false;
+    rc.thermal_governor = false;
+    rc.compact = false;
+    rc.reorder_window = std::chrono::milliseconds(10);
+    rc.sessions.enabled = true;
+    rc.sessions.pre_roll = std::chrono::milliseconds(150);
+    rc.sessions.post_roll = std::chrono::milliseconds(300);
+
+    Recorder rec(rc);
+    rec.start();
+    test::UdpSender fc(port);
+    uint8_t seq = 0;
+    std::map<uint8_t, int64_t> sent;  // seq -> time sent
+    const auto send = [&](int n, uint8_t base_mode, uint8_t type = 2) {
+        for (int i = 0; i < n; ++i) {
+            sent[seq] = monotonic_ns();
+            fc.send(test::heartbeat(1, seq++, base_mode, type));
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    };
+    const std::string flights = layout::flights_dir(rc.root);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));  // the source is bound
+    send(5, kArmed, 6);  // a GCS says armed: no sortie
+    send(15, 0);
+    CHECK(list_dir(flights).empty());
+    const uint8_t arm1 = seq;
+    send(10, kArmed);
+    const uint8_t disarm1 = seq;
+    send(30, 0);  // 600 ms: the post-roll ends half way through
+    const uint8_t arm2 = seq;
+    send(10, kArmed);
+    const uint8_t disarm2 = seq;
+    send(1, 0);
+    const uint8_t quiet = seq;
+
+    // The second sortie is sealed once its post-roll is over, with no more data.
+    const auto sealed = [&] {
+        const std::vector<std::string> ids = list_dir(flights);
+        if (ids.size() != 2) return false;
+        for (const auto& id : ids)
+            for (const auto& name : list_dir(flights + "/" + id))
+                if (layout::is_open_segment(name)) return false;
+        return true;
+    };
+    CHECK(wait_for(sealed));
+    CHECK_EQ(rec.stats().sessions, uint64_t{2});
+    rec.stop();
+    CHECK(rec.stats().pre_roll_discarded > 0);
+
+    // Which heartbeats each flight holds, by sequence number.
+    const std::vector<std::string> ids = list_dir(flights);
+    CHECK_EQ(ids.size(), size_t{2});
+    if (ids.size() != 2) return;
+    std::vector<std::vector<uint8_t>> held(2);
+    for (size_t i = 0; i < 2; ++i)
+        for (const std::string& path : layout::raw_segment_paths(rc.root, ids[i])) {
+            SegmentReader r;
+            CHECK(r.open(path));
+            CHECK(!r.recovered());
+            for (const seg::IndexEntry& e : r.index()) {
+                if (e.channel != channel::make(channel::kMavlink, mavlink::kMsgHeartbeat)) continue;
+                ChunkData d;
+                CHECK(r.read_chunk(e, &d));
+                size_t off = 0;
+                for (uint32_t len : d.blob_len) {
+                    held[i].push_back(static_cast<uint8_t>(d.blob_bytes[off + 4]));  // v2 seq
+                    off += len;
+                }
+            }
+        }
+    const auto count = [](const std::vector<uint8_t>& v, uint8_t from, uint8_t to) {
+        size_t n = 0;
+        for (uint8_t s : v) n += s >= from && s < to;
+        return n;
+    };
+    // Every armed heartbeat, in its own sortie only.
+    CHECK_EQ(count(held[0], arm1, disarm1), size_t{10});
+    CHECK_EQ(count(held[1], arm2, disarm2), size_t{10});
+    CHECK_EQ(count(held[1], arm1, disarm1), size_t{0});
+    CHECK_EQ(count(held[0], arm2, quiet), size_t{0});
+    // Pre-roll: the last 150 ms before arming, not the GCS heartbeats before.
+    const size_t pre1 = count(held[0], 0, arm1);
+    CHECK(pre1 >= 3 && pre1 <= 9);
+    CHECK_EQ(count(held[0], 0, 5), size_t{0});
+    // Post-roll: what came within 300 ms of disarming, and nothing after.
+    const int64_t close1 = sent[disarm1] + 300 * kMs;
+    size_t post1 = 0;
+    for (uint8_t s : held[0])
+        if (s >= disarm1 && s < arm2) {
+            post1++;
+            CHECK(sent[s] < close1 + 20 * kMs);
+        }
+    CHECK(post1 >= 10);
+    CHECK(count(held[1], disarm1, arm2) >= 3);  // the next sortie's pre-roll
+    CHECK_EQ(count(held[1], disarm2, quiet), size_t{1});
+}
+
+}  // namespace fr
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../src/summary_stats.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const double kRanks[] = {0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 0.999};
+
+// Largest distance, as a fraction of the sample count, between the rank
+// each estimate asks for and the rank it actually has in the data.
+double worst_rank_error(std::vector<double> data, TDigest& digest) {
+    std::sort(data.begin(), data.end());
+    const double n = static_cast<double>(data.size());
+    double worst = 0;
+    for (double q : kRanks) {
+        const double est = digest.quantile(q);
+        const double lo = std::lower_bound(data.begin(), data.end(), est) - data.begin();
+        const double hi = std::upper_bound(data.begin(), data.end(), est) - data.begin();
+        const double want = q * n;
+        const double err = want < lo ? lo - want : want > hi ? want - hi : 0;
+        worst = std::max(worst, err / n);
+    }
+    return worst;
+}
+
+template <class Dist>
+double digest_error(Dist dist, size_t n) {
+    std::mt19937_64 rng(48);
+    std::vector<double> data(n);
+    TDigest digest;
+    for (double& x : data) {
+        x = dist(rng);
+        digest.add(x);
+    }
+    CHECK(digest.centroid_count() <= 200);
+    return worst_rank_error(data, digest);
+}
+
+}  // namespace
+
+TEST(tdigest_quantiles_within_rank_tolerance) {
+    CHECK(digest_error(std::uniform_real_distribution<double>(-5, 5), 200000) < 0.002);
+    CHECK(digest_error(std::normal_distribution<double>(20, 3), 200000) < 0.002);
+    CHECK(digest_error(std::exponential_distribution<double>(0.5), 50000) < 0.002);
+}
+
+TEST(tdigest_tails_are_tight) {
+    // Sorted input is the worst case for a merging digest's buffer.
+    TDigest digest;
+    for (int i = 0; i < 100000; ++i) digest.add(i);
+    CHECK(std::fabs(digest.quantile(0.001) - 100) < 5);
+    CHECK(std::fabs(digest.quantile(0.999) - 99900) < 5);
+    CHECK_EQ(digest.quantile(0), 0.0);
+    CHECK_EQ(digest.quantile(1), 99999.0);
+}
+
+TEST(tdigest_small_and_empty) {
+    TDigest empty;
+    CHECK(std::isnan(empty.quantile(0.5)));
+    TDigest one;
+    one.add(3.5);
+    CHECK_EQ(one.quantile(0.01), 3.5);
+    CHECK_EQ(one.quantile(0.99), 3.5);
+    TDigest same;
+    for (int i = 0; i < 1000; ++i) same.add(-2);
+    CHECK_EQ(same.quantile(0.5), -2.0);
+}
+
+TEST(channel_stats_moments_and_nulls) {
+    ChannelStats s;
+    const double values[] = {2, 4, 4, 4, 5, 5, 7, 9};
+    for (double v : values) s.add(v);
+    s.add(std::numeric_limits<double>::quiet_NaN());
+    s.add(std::numeric_limits<double>::infinity());
+    CHECK_EQ(s.count, uint64_t{8});
+    CHECK_EQ(s.nulls, uint64_t{2});
+    CHECK_EQ(s.min, 2.0);
+    CHECK_EQ(s.max, 9.0);
+    CHECK_EQ(s.mean, 5.0);
+    CHECK(std::fabs(s.variance() - 32.0 / 7) < 1e-12);
+}
+
+}  // namespace fr
@@ -0,0 +1,157 @@
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/channels.hpp"
+#include "../src/config.hpp"
+#include "../src/decoder.hpp"
+#include "../src/swinging_door.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+const int64_t kMs = 1000000;
+
+// Linear interpolation between stored points at time t.
+double interpolate(const std::vector<SwingingDoor::Point>& pts, int64_t t) {
+    size_t i = 1;
+    while (i < pts.size() && pts[i].t < t) ++i;
+    if (i == pts.size()) return pts.back().v;
+    const SwingingDoor::Point& a = pts[i - 1];
+    const SwingingDoor::Point& b = pts[i];
+    if (b.t == a.t) return b.v;
+    return a.v + (b.v - a.v) * static_cast<double>(t - a.t) / static_cast<double>(b.t - a.t);
+}
+
+struct Sample {
+    int64_t t;
+    double v;
+};
+
+std::shared_ptr<const CompiledConfig> decimating_config() {
+    const std::string text =
+        "message 0\n"
+        "channel 10 hb.custom_mode msg=0 offset=0 type=u32 max_error=0.5 max_gap_s=1\n";
+    std::string blob, errors;
+    CHECK(compile_config(text, &blob, &errors));
+    std::string err;
+    auto cfg = CompiledConfig::from_bytes(std::move(blob), &err);
+    CHECK(cfg != nullptr);
+    return cfg;
+}
+
+// Samples of decoded channel 10 that a Decoder emits.
+struct Collector {
+    std::vector<Sample> samples;
+    void operator()(Record&& r) {
+        if (!r.blob && r.channel == channel::make(channel::kDecoded, 10)) samples.push_back(Sample{r.t_ns, r.value});
+    }
+};
+
+void feed(Decoder& d, uint32_t msgid, uint8_t sysid, uint32_t value, int64_t t, Collector& out) {
+    uint8_t payload[9] = {};
+    std::memcpy(payload, &value, sizeof(value));
+    MavFrame f{};
+    f.data = payload;
+    f.len = sizeof(payload);
+    f.payload = payload;
+    f.payload_len = sizeof(payload);
+    f.version = 2;
+    f.sysid = sysid;
+    f.msgid = msgid;
+    d.decode(f, t, 0, [&](Record&& r) { out(std::move(r)); });
+}
+
+}  // namespace
+
+// Interpolating the stored points reproduces every input within max_error.
+TEST(swinging_door_error_bound) {
+    const double max_error = 0.25;
+    SwingingDoor door(max_error, 0);
+    std::mt19937 rng(7);
+    std::normal_distribution<double> step(0, 0.1);
+    std::vector<Sample> in;
+    std::vector<SwingingDoor::Point> out;
+    double v = 0;
+    for (int i = 0; i < 20000; ++i) {
+        v += step(rng);
+        in.push_back(Sample{i * 10 * kMs, v});
+        SwingingDoor::Point p[2];
+        const int n = door.push(in.back().t, v, p);
+        for (int k = 0; k < n; ++k) out.push_back(p[k]);
+    }
+    SwingingDoor::Point last;
+    if (door.flush(&last)) out.push_back(last);
+    CHECK(out.size() < in.size() / 2);
+    CHECK_EQ(out.back().t, in.back().t);
+    double worst = 0;
+    for (const Sample& s : in) worst = std::max(worst, std::abs(interpolate(out, s.t) - s.v));
+    CHECK(worst <= max_error + 1e-9);
+    CHECK_EQ(door.samples_in(), in.size());
+    CHECK_EQ(door.samples_out(), out.size());
+}
+
+// A flat signal still stores a point at least every max_gap.
+TEST(swinging_door_max_gap) {
+    const int64_t gap = 1000 * kMs;
+    SwingingDoor door(0.5, gap);
+    std::vector<SwingingDoor::Point> out;
+    for (int i = 0; i < 1000; ++i) {
+        SwingingDoor::Point p[2];
+        const int n = door.push(i * 10 * kMs, 3.0, p);
+        for (int k = 0; k < n; ++k) out.push_back(p[k]);
+    }
+    CHECK(out.size() >= 9);
+    for (size_t i = 1; i < out.size(); ++i) CHECK(out[i].t - out[i - 1].t <= gap);
+}
+
+// A held sample older than max_gap is released without a newer sample.
+TEST(swinging_door_expire) {
+    SwingingDoor door(0.5, 1000 * kMs);
+    SwingingDoor::Point p[2];
+    CHECK_EQ(door.push(0, 1.0, p), 1);
+    CHECK_EQ(door.push(100 * kMs, 1.0, p), 0);
+    SwingingDoor::Point held;
+    CHECK(!door.expire(600 * kMs, &held));
+    CHECK(door.expire(1200 * kMs, &held));
+    CHECK_EQ(held.t, 100 * kMs);
+    CHECK(!door.expire(5000 * kMs, &held));
+}
+
+// Disarm flushes one vehicle's held samples and leaves the others alone.
+TEST(decoder_flush_vehicle) {
+    Decoder d(decimating_config());
+    Collector out;
+    for (int i = 0; i < 5; ++i) {
+        feed(d, 0, 1, 5, i * 100 * kMs, out);
+        feed(d, 0, 2, 7, i * 100 * kMs, out);
+    }
+    CHECK_EQ(out.samples.size(), 2u);  // each vehicle's first sample
+    d.flush_vehicle(1, 0, [&](Record&& r) { out(std::move(r)); });
+    CHECK_EQ(out.samples.size(), 3u);
+    CHECK_EQ(out.samples.back().t, 400 * kMs);
+    CHECK_EQ(out.samples.back().v, 5.0);
+    d.flush(0, [&](Record&& r) { out(std::move(r)); });
+    CHECK_EQ(out.samples.size(), 4u);
+    CHECK_EQ(out.samples.back().v, 7.0);
+}
+
+// Frames of other messages release samples held longer than max_gap.
+TEST(decoder_expires_held_samples) {
+    Decoder d(decimating_config());
+    Collector out;
+    feed(d, 0, 1, 5, 0, out);
+    feed(d, 0, 1, 5, 200 * kMs, out);
+    CHECK_EQ(out.samples.size(), 1u);
+    feed(d, 1, 1, 0, 800 * kMs, out);  // no rule: stored as a frame
+    CHECK_EQ(out.samples.size(), 1u);
+    feed(d, 1, 1, 0, 1300 * kMs, out);
+    CHECK_EQ(out.samples.size(), 2u);
+    CHECK_EQ(out.samples.back().t, 200 * kMs);
+}
+
+}  // namespace fr
@@ -0,0 +1,56 @@
+// Minimal test harness for fr-tests: TEST(name) registers a case, CHECK and
+// CHECK_EQ record a failure and carry on, so one run reports every broken
+// expectation. Cases run one after another on the main thread.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fr {
+namespace test {
+
+struct Case {
+    const char* name;
+    void (*fn)();
+};
+
+std::vector<Case>& registry();
+
+struct Register {
+    Register(const char* name, void (*fn)()) { registry().push_back(Case{name, fn}); }
+};
+
+void fail(const char* file, int line, const std::string& what);
+
+// Fresh empty directory under $TMPDIR (or /tmp), removed at exit.
+std::string temp_dir(const std::string& tag);
+
+// Bytes from a hex string; spaces are ignored.
+std::vector<uint8_t> from_hex(const std::string& hex);
+std::string to_hex(const uint8_t* data, size_t len);
+
+template <typename A, typename B>
+void check_eq(const A& a, const B& b, const char* as, const char* bs, const char* file, int line) {
+    if (a == b) return;
+    std::ostringstream os;
+    os << as << " == " << bs << " (" << a << " vs " << b << ")";
+    fail(file, line, os.str());
+}
+
+}  // namespace test
+}  // namespace fr
+
+#define TEST(name)                                                          \
+    static void test_##name();                                              \
+    static const ::fr::test::Register register_##name(#name, test_##name); \
+    static void test_##name()
+
+#define CHECK(cond)                                                \
+    do {                                                           \
+        if (!(cond)) ::fr::test::fail(__FILE__, __LINE__, #cond);  \
+    } while (0)
+
+#define CHECK_EQ(a, b) ::fr::test::check_eq((a), (b), #a, #b, __FILE__, __LINE__)
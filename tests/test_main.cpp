@@ -0,0 +1,105 @@
+// fr-tests: known-answer and regression tests.
+//
+//   fr-tests [NAME-SUBSTRING]
+//
+// Build: g++ -std=c++17 -O2 -pthread tests/*.cpp src/*.cpp -o fr-tests
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/log.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace test {
+namespace {
+
+int failures = 0;
+std::vector<std::string> temp_dirs;
+
+void remove_temp_dirs() {
+    for (const auto& d : temp_dirs) {
+        const std::string cmd = "rm -rf '" + d + "'";
+        if (std::system(cmd.c_str()) != 0) std::fprintf(stderr, "cannot remove %s\n", d.c_str());
+    }
+}
+
+}  // namespace
+
+std::vector<Case>& registry() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void fail(const char* file, int line, const std::string& what) {
+    std::fprintf(stderr, "  %s:%d: CHECK failed: %s\n", file, line, what.c_str());
+    failures++;
+}
+
+std::string temp_dir(const std::string& tag) {
+    const char* base = std::getenv("TMPDIR");
+    std::string templ = std::string(base && *base ? base : "/tmp") + "/fr-test-" + tag + "-XXXXXX";
+    std::vector<char> buf(templ.begin(), templ.end());
+    buf.push_back('\0');
+    if (!mkdtemp(buf.data())) {
+        std::perror("mkdtemp");
+        std::exit(2);
+    }
+    if (temp_dirs.empty()) std::atexit(remove_temp_dirs);
+    temp_dirs.emplace_back(buf.data());
+    return temp_dirs.back();
+}
+
+std::vector<uint8_t> from_hex(const std::string& hex) {
+    std::vector<uint8_t> out;
+    int hi = -1;
+    for (char c : hex) {
+        int v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else continue;
+        if (hi < 0) {
+            hi = v;
+        } else {
+            out.push_back(static_cast<uint8_t>(hi << 4 | v));
+            hi = -1;
+        }
+    }
+    return out;
+}
+
+std::string to_hex(const uint8_t* data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+    for (size_t i = 0; i < len; ++i) {
+        s += digits[data[i] >> 4];
+        s += digits[data[i] & 15];
+    }
+    return s;
+}
+
+}  // namespace test
+}  // namespace fr
+
+int main(int argc, char** argv) {
+    using namespace fr::test;
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    fr::set_log_level(fr::LogLevel::Error);
+    size_t ran = 0, failed = 0;
+    for (const Case& c : registry()) {
+        if (filter && !std::strstr(c.name, filter)) continue;
+        const int before = failures;
+        c.fn();
+        ran++;
+        if (failures != before) {
+            failed++;
+            std::fprintf(stderr, "FAIL %s\n", c.name);
+        }
+    }
+    std::printf("%zu tests, %zu failed\n", ran, failed);
+    return failed ? 1 : 0;
+}
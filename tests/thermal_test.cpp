@@ -0,0 +1,233 @@
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/clock.hpp"
+#include "../src/codec.hpp"
+#include "../src/fs_util.hpp"
+#include "../src/recorder.hpp"
+#include "../src/segment_reader.hpp"
+#include "../src/storage_layout.hpp"
+#include "../src/thermal.hpp"
+#include "flight_fixture.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void put(const std::string& path, const std::string& text) {
+    make_dirs(path.substr(0, path.rfind('/')));
+    CHECK(write_file_atomic(path, text.data(), text.size()));
+}
+
+void set_temp(const std::string& sysfs, double c) {
+    put(sysfs + "/class/thermal/thermal_zone0/temp", std::to_string(static_cast<long long>(c * 1000)) + "\n");
+}
+
+void set_freq(const std::string& sysfs, unsigned cpu, long long cap_khz, long long max_khz) {
+    const std::string dir = sysfs + "/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/";
+    put(dir + "scaling_max_freq", std::to_string(cap_khz) + "\n");
+    put(dir + "cpuinfo_max_freq", std::to_string(max_khz) + "\n");
+}
+
+ThermalReading temp(double c) {
+    ThermalReading r;
+    r.max_temp_c = c;
+    r.zones = 1;
+    return r;
+}
+
+ThermalReading freq(double ratio) {
+    ThermalReading r;
+    r.max_temp_c = std::nan("");
+    r.min_freq_ratio = ratio;
+    r.cpus = 1;
+    return r;
+}
+
+bool wait_for(const std::function<bool()>& done) {
+    for (int i = 0; i < 200 && !done(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return done();
+}
+
+}  // namespace
+
+TEST(read_thermal_takes_hottest_zone_and_lowest_cap) {
+    const std::string sysfs = test::temp_dir("sysfs");
+    set_temp(sysfs, 45);
+    put(sysfs + "/class/thermal/thermal_zone1/temp", "61500\n");
+    make_dirs(sysfs + "/class/thermal/thermal_zone2");                    // no temp file
+    put(sysfs + "/class/thermal/cooling_device0/temp", "99000\n");        // not a zone
+    put(sysfs + "/class/thermal/thermal_zone3/temp", "unavailable\n");   // unreadable
+    set_freq(sysfs, 0, 1200000, 1500000);
+    set_freq(sysfs, 1, 1500000, 1500000);
+    make_dirs(sysfs + "/devices/system/cpu/cpu2");                        // no cpufreq
+    set_freq(sysfs, 3, 900000, 0);                                        // no maximum
+    put(sysfs + "/devices/system/cpu/cpufreq/scaling_max_freq", "1\n");  // policy dir, not a CPU
+
+    const ThermalReading r = read_thermal(sysfs);
+    CHECK_EQ(r.zones, 2u);
+    CHECK_EQ(r.max_temp_c, 61.5);
+    CHECK_EQ(r.cpus, 2u);
+    CHECK(std::fabs(r.min_freq_ratio - 0.8) < 1e-12);
+
+    const ThermalReading none = read_thermal(sysfs + "/missing");
+    CHECK_EQ(none.zones, 0u);
+    CHECK_EQ(none.cpus, 0u);
+    CHECK(std::isnan(none.max_temp_c));
+    CHECK_EQ(none.min_freq_ratio, 1.0);
+}
+
+TEST(thermal_governor_holds_and_applies_hysteresis) {
+    ThermalConfig cfg;  // hot at 80 C, cool at 70 C, hold 10 s
+    std::vector<PowerMode> changes;
+    ThermalGovernor g(cfg, [&](PowerMode m, const ThermalReading&) { changes.push_back(m); });
+    const Clock::time_point t0 = Clock::now();
+    const auto at = [&](int s) { return t0 + std::chrono::seconds(s); };
+
+    g.update(temp(79.9), at(0));
+    CHECK(g.mode() == PowerMode::Normal);
+    g.update(temp(80), at(1));
+    CHECK(g.mode() == PowerMode::Hot);
+    g.update(temp(50), at(5));  // cool, but not held long enough
+    CHECK(g.mode() == PowerMode::Hot);
+    g.update(temp(75), at(20));  // held, but above cool_c
+    CHECK(g.mode() == PowerMode::Hot);
+    g.update(temp(70), at(20));
+    CHECK(g.mode() == PowerMode::Normal);
+    g.update(temp(75), at(21));  // below hot_c: stays normal
+    CHECK(g.mode() == PowerMode::Normal);
+    CHECK_EQ(changes.size(), size_t{2});
+    CHECK(changes.size() == 2 && changes[0] == PowerMode::Hot && changes[1] == PowerMode::Normal);
+}
+
+TEST(thermal_governor_follows_frequency_cap) {
+    ThermalConfig cfg;
+    cfg.min_hold = std::chrono::milliseconds(0);
+    ThermalGovernor g(cfg, nullptr);
+    const Clock::time_point t0 = Clock::now();
+
+    g.update(freq(0.8), t0);  // between the ratios: no change
+    CHECK(g.mode() == PowerMode::Normal);
+    g.update(freq(0.7), t0);
+    CHECK(g.mode() == PowerMode::Hot);
+    g.update(freq(0.85), t0);  // not yet back above cool_freq_ratio
+    CHECK(g.mode() == PowerMode::Hot);
+    ThermalReading both = freq(0.95);
+    both.zones = 1;
+    both.max_temp_c = 72;  // the cap recovered, the zone has not
+    g.update(both, t0);
+    CHECK(g.mode() == PowerMode::Hot);
+    both.max_temp_c = 65;
+    g.update(both, t0);
+    CHECK(g.mode() == PowerMode::Normal);
+}
+
+// The governor thread reads the mock tree, and the recorder switches the
+// codec, the flush scale and the thinning with it.
+TEST(recorder_follows_thermal_mode) {
+    const std::string sysfs = test::temp_dir("sysfs");
+    set_temp(sysfs, 45);
+    set_freq(sysfs, 0, 1000000, 1000000);
+
+    std::string blob, errors;
+    CHECK(compile_config("message 0 priority=0\n"
+                         "channel 10 hb.custom_mode msg=0 offset=0 type=u32 priority=2\n",
+                         &blob, &errors));
+    std::string err;
+    std::shared_ptr<const CompiledConfig> config = CompiledConfig::from_bytes(std::move(blob), &err);
+    CHECK(config != nullptr);
+    if (!config) return;
+
+    const uint16_t port = test::free_udp_port();
+    RecorderConfig rc;
+    rc.root = test::temp_dir("thermal-rec");
+    rc.config = config;
+    rc.sources.push_back(test::udp_source("fc", port));
+    rc.writer.codec = seg::Codec::Zstd;
+    rc.writer.chunk_records = 16;
+    rc.writer.max_segment_ns = 0;
+    rc.retention.headroom_bytes = 0;
+    rc.health.systemd = false;
+    rc.compact = false;
+    rc.reorder_window = std::chrono::milliseconds(10);
+    rc.thermal.sysfs_root = sysfs;
+    rc.thermal.poll_interval = std::chrono::milliseconds(10);
+    rc.thermal.min_hold = std::chrono::milliseconds(0);
+    rc.hot_flush_scale = 4;
+    rc.hot_thin_interval = std::chrono::milliseconds(200);
+    rc.hot_thin_priority = 2;
+
+    Recorder rec(rc);
+    rec.start();
+    test::UdpSender fc(port);
+    uint8_t seq = 0;
+    const auto send = [&](int n) {
+        for (int i = 0; i < n; ++i) {
+            fc.send(test::heartbeat(1, seq++));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    };
+    // Writers pick up a new mode on their next loop, at most 100 ms later.
+    const auto settle = [] { std::this_thread::sleep_for(std::chrono::milliseconds(200)); };
+
+    settle();  // the source is bound
+    send(40);
+    const int64_t hot_from = monotonic_ns();
+    set_temp(sysfs, 90);
+    CHECK(wait_for([&] { return rec.power_mode() == PowerMode::Hot; }));
+    settle();
+    const int64_t hot_sent = monotonic_ns();
+    send(100);
+    const int64_t hot_done = monotonic_ns();
+    set_temp(sysfs, 60);
+    CHECK(wait_for([&] { return rec.power_mode() == PowerMode::Normal; }));
+    settle();
+    const int64_t cool_sent = monotonic_ns();
+    send(40);
+    settle();
+    const std::string flight = rec.flight_id();
+    rec.stop();
+
+    const uint32_t frames = channel::make(channel::kMavlink, mavlink::kMsgHeartbeat);
+    const uint32_t values = channel::make(channel::kDecoded, 10);
+    // Without zstd support, zstd chunks are stored uncompressed.
+    const seg::Codec normal_codec = codec::available(seg::Codec::Zstd) ? seg::Codec::Zstd : seg::Codec::None;
+    size_t hot_frames = 0, hot_values = 0, big_chunks = 0;
+    for (const std::string& path : layout::raw_segment_paths(rc.root, flight)) {
+        SegmentReader r;
+        CHECK(r.open(path));
+        for (const seg::IndexEntry& e : r.index()) {
+            ChunkData d;
+            CHECK(r.read_chunk(e, &d));
+            for (int64_t t : d.t) {
+                if (t < hot_sent || t > hot_done) continue;
+                hot_frames += e.channel == frames;
+                hot_values += e.channel == values;
+            }
+            if (e.channel != frames) continue;
+            const auto codec = static_cast<seg::Codec>(d.hdr.codec);
+            if (e.count > 16 && e.t_last <= hot_done) {
+                // Flushed by its last record, while hot: only the hot flush
+                // scale lets a chunk grow past 16 records.
+                big_chunks++;
+                CHECK(codec == seg::Codec::Lz4);
+            } else if (e.t_last < hot_from || e.t_first >= cool_sent) {
+                CHECK(codec == normal_codec);
+            }
+        }
+    }
+    CHECK(big_chunks >= 1);
+    // The priority-2 channel is thinned to one sample per 200 ms; the
+    // priority-0 message's frames are not.
+    CHECK_EQ(hot_frames, size_t{100});
+    CHECK(hot_values >= 1 && hot_values <= 4);
+}
+
+}  // namespace fr
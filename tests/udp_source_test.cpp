@@ -0,0 +1,191 @@
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/udp_source.hpp"
+#include "flight_fixture.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+std::unique_ptr<UdpSource> open_source(const UdpOptions& opts, uint16_t port) {
+    auto src = std::make_unique<UdpSource>(test::udp_source("udp", port), opts);
+    std::string err;
+    if (!src->open(&err)) {
+        test::fail(__FILE__, __LINE__, "open: " + err);
+        return nullptr;
+    }
+    return src;
+}
+
+UdpOptions options(unsigned batch, bool gro) {
+    UdpOptions o;
+    o.batch = batch;
+    o.gro = gro;
+    o.rcvbuf_bytes = 0;
+    return o;
+}
+
+std::string counting(size_t n) {
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; ++i) s[i] = static_cast<char>(i * 7 + 1);
+    return s;
+}
+
+std::string got(const uint8_t* buf, ssize_t n) {
+    return std::string(reinterpret_cast<const char*>(buf), n > 0 ? static_cast<size_t>(n) : 0);
+}
+
+}  // namespace
+
+TEST(udp_source_batches_queued_datagrams) {
+    const uint16_t port = test::free_udp_port();
+    auto src = open_source(options(4, false), port);
+    if (!src) return;
+    test::UdpSender tx(port);
+
+    // Loopback sends are queued by the time sendto() returns.
+    std::string all;
+    for (int i = 0; i < 10; ++i) {
+        const std::string d(static_cast<size_t>(20 + i), static_cast<char>('a' + i));
+        CHECK(tx.send(d));
+        all += d;
+    }
+    static uint8_t buf[1 << 16];
+    std::string out;
+    ssize_t n = src->read(buf, sizeof buf, 100);
+    CHECK(src->datagrams() == std::vector<uint32_t>({20, 21, 22, 23}));
+    out += got(buf, n);
+    n = src->read(buf, sizeof buf, 100);
+    CHECK(src->datagrams() == std::vector<uint32_t>({24, 25, 26, 27}));
+    out += got(buf, n);
+    n = src->read(buf, sizeof buf, 100);
+    CHECK(src->datagrams() == std::vector<uint32_t>({28, 29}));
+    out += got(buf, n);
+    CHECK(out == all);
+    CHECK_EQ(src->read(buf, sizeof buf, 0), ssize_t{0});
+    CHECK(src->datagrams().empty());
+
+    // What does not fit the caller's buffer waits for the next call.
+    for (char c : {'x', 'y', 'z'}) CHECK(tx.send(std::string(30, c)));
+    n = src->read(buf, 70, 100);
+    CHECK_EQ(got(buf, n), std::string(30, 'x') + std::string(30, 'y'));
+    CHECK(src->datagrams() == std::vector<uint32_t>({30, 30}));
+    n = src->read(buf, 70, 0);
+    CHECK_EQ(got(buf, n), std::string(30, 'z'));
+    CHECK_EQ(src->counters().truncated, uint64_t{0});
+}
+
+TEST(udp_source_splits_gro_messages) {
+    const uint16_t port = test::free_udp_port();
+    test::UdpSender tx(port);
+    // Sent as one GSO buffer of 100-byte segments; loopback hands it to a
+    // UDP_GRO socket unsplit.
+    const int seg = 100;
+    CHECK_EQ(setsockopt(tx.fd, IPPROTO_UDP, UDP_SEGMENT, &seg, sizeof(seg)), 0);
+    const std::string burst = counting(350);
+    static uint8_t buf[1 << 16];
+
+    {
+        // One message per recvmmsg() slot, yet all four datagrams come out.
+        auto src = open_source(options(1, true), port);
+        if (!src) return;
+        CHECK(tx.send(burst));
+        ssize_t n = src->read(buf, sizeof buf, 100);
+        CHECK(got(buf, n) == burst);
+        CHECK(src->datagrams() == std::vector<uint32_t>({100, 100, 100, 50}));
+
+        // Split across calls at a segment boundary.
+        CHECK(tx.send(burst));
+        n = src->read(buf, 250, 100);
+        CHECK(got(buf, n) == burst.substr(0, 200));
+        CHECK(src->datagrams() == std::vector<uint32_t>({100, 100}));
+        n = src->read(buf, 250, 100);
+        CHECK(got(buf, n) == burst.substr(200));
+        CHECK(src->datagrams() == std::vector<uint32_t>({100, 50}));
+        CHECK_EQ(src->counters().truncated, uint64_t{0});
+    }
+
+    // Without UDP_GRO the kernel segments it: one datagram per slot.
+    auto src = open_source(options(1, false), port);
+    if (!src) return;
+    CHECK(tx.send(burst));
+    const ssize_t n = src->read(buf, sizeof buf, 100);
+    CHECK(got(buf, n) == burst.substr(0, 100));
+    CHECK(src->datagrams() == std::vector<uint32_t>({100}));
+}
+
+TEST(udp_source_counts_truncated_datagrams) {
+    const uint16_t port = test::free_udp_port();
+    UdpOptions opts = options(8, false);
+    opts.max_datagram = 512;
+    auto src = open_source(opts, port);
+    if (!src) return;
+    test::UdpSender tx(port);
+    static uint8_t buf[1 << 16];
+
+    // Longer than the receive slot: dropped whole, not passed on cut short.
+    CHECK(tx.send(counting(600)));
+    CHECK(tx.send(counting(100)));
+    ssize_t n = src->read(buf, sizeof buf, 100);
+    CHECK(got(buf, n) == counting(100));
+    CHECK(src->datagrams() == std::vector<uint32_t>({100}));
+    CHECK_EQ(src->counters().truncated, uint64_t{1});
+
+    // Longer than the caller's buffer: cut to fit, and counted.
+    CHECK(tx.send(counting(80)));
+    CHECK(tx.send(counting(10)));
+    n = src->read(buf, 50, 100);
+    CHECK(got(buf, n) == counting(50));
+    CHECK(src->datagrams() == std::vector<uint32_t>({50}));
+    CHECK_EQ(src->counters().truncated, uint64_t{2});
+    n = src->read(buf, 50, 0);
+    CHECK(got(buf, n) == counting(10));
+}
+
+TEST(udp_source_reports_kernel_drops) {
+    const uint16_t port = test::free_udp_port();
+    UdpOptions opts = options(256, false);
+    opts.rcvbuf_bytes = 1;  // the kernel's minimum: a few datagrams
+    auto src = open_source(opts, port);
+    if (!src) return;
+    test::UdpSender tx(port);
+    static uint8_t buf[1 << 16];
+    const std::string d = counting(200);
+
+    // One read takes everything that was queued; the datagrams that were
+    // not leave no trace yet.
+    for (int i = 0; i < 100; ++i) tx.send(d);
+    CHECK(src->read(buf, sizeof buf, 100) > 0);
+    const uint64_t kept = src->datagrams().size();
+    CHECK(kept >= 1 && kept < 100);
+    CHECK_EQ(src->counters().kernel_drops, uint64_t{0});
+
+    // The next datagram carries the SO_RXQ_OVFL count.
+    CHECK(tx.send(d));
+    CHECK(src->read(buf, sizeof buf, 100) > 0);
+    CHECK_EQ(src->datagrams().size(), size_t{1});
+    uint64_t drops = 100 - kept;
+    CHECK_EQ(src->counters().kernel_drops, drops);
+
+    // Drops at the end of a burst are found by polling once the link idles.
+    for (int i = 0; i < 100; ++i) tx.send(d);
+    CHECK(src->read(buf, sizeof buf, 100) > 0);
+    drops += 100 - src->datagrams().size();
+    CHECK_EQ(src->read(buf, sizeof buf, 0), ssize_t{0});
+    CHECK_EQ(src->counters().kernel_drops, drops);
+
+    // Reopening starts a new socket without losing the count.
+    src->close();
+    std::string err;
+    CHECK(src->open(&err));
+    CHECK_EQ(src->read(buf, sizeof buf, 0), ssize_t{0});
+    CHECK_EQ(src->counters().kernel_drops, drops);
+}
+
+}  // namespace fr
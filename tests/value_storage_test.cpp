@@ -0,0 +1,157 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/value_storage.hpp"
+#include "test.hpp"
+
+namespace fr {
+namespace {
+
+using seg::ValueStorage;
+
+uint16_t half_at(const std::string& packed, size_t i) {
+    uint16_t h;
+    std::memcpy(&h, packed.data() + 2 * i, sizeof(h));
+    return h;
+}
+
+// Every binary16 bit pattern, in order.
+std::string all_halves() {
+    std::string all;
+    for (uint32_t h = 0; h <= 0xffff; ++h) {
+        const uint16_t bits = static_cast<uint16_t>(h);
+        all.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+    }
+    return all;
+}
+
+bool half_nan(uint16_t h) { return (h & 0x7c00) == 0x7c00 && (h & 0x3ff); }
+
+// The same bits, or NaN on both sides (payloads may differ).
+bool same_double(double a, double b) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Packs `v` as F16 with the vector kernels and with the scalar code, and
+// checks the two agree bit for bit.
+void check_pack_paths(const std::vector<double>& v) {
+    std::string hw, sw;
+    const ValueStorage hw_used = storage::pack(ValueStorage::F16, 1, v.data(), v.size(), &hw);
+    storage::force_scalar(true);
+    const ValueStorage sw_used = storage::pack(ValueStorage::F16, 1, v.data(), v.size(), &sw);
+    storage::force_scalar(false);
+    CHECK(hw_used == ValueStorage::F16);
+    CHECK(sw_used == ValueStorage::F16);
+    CHECK_EQ(hw.size(), sw.size());
+    if (hw.size() != sw.size()) return;
+    size_t mismatched = 0;
+    for (size_t i = 0; i < v.size(); ++i) {
+        const uint16_t a = half_at(hw, i), b = half_at(sw, i);
+        if (a != b && !(half_nan(a) && half_nan(b))) mismatched++;
+    }
+    CHECK_EQ(mismatched, size_t{0});
+}
+
+}  // namespace
+
+TEST(storage_f16_scalar_matches_vector_pack) {
+    if (!storage::hardware()) return;  // nothing to compare against
+    std::mt19937_64 rng(49);
+
+    // Every finite half and NaN, and the points halfway between neighbours,
+    // where round-to-nearest-even decides. The odd count leaves a tail for
+    // the scalar loop on the vector path too.
+    std::vector<double> halves;
+    storage::unpack(ValueStorage::F16, all_halves().data(), 0x10000, &halves);
+    std::vector<double> v;
+    for (uint32_t h = 0; h <= 0xffff; ++h) {
+        if (std::isinf(halves[h])) continue;  // a finite neighbour would overflow the chunk
+        v.push_back(halves[h]);
+        if ((h & 0x7fff) < 0x7bff) v.push_back((halves[h] + halves[h + 1]) / 2);
+    }
+    v.push_back(0.1);
+    check_pack_paths(v);
+
+    // Random values over the normal half range, the subnormal range and
+    // below it.
+    std::vector<double> r(100003);
+    for (size_t i = 0; i < r.size(); ++i) {
+        const double mag = std::ldexp(std::uniform_real_distribution<double>(1, 2)(rng),
+                                      std::uniform_int_distribution<int>(-30, 14)(rng));
+        r[i] = rng() & 1 ? mag : -mag;
+    }
+    r[7] = std::numeric_limits<double>::quiet_NaN();
+    r[8] = -0.0;
+    r[9] = 65504;
+    r[10] = 65519.99;  // largest value that still rounds down to 65504
+    check_pack_paths(r);
+}
+
+TEST(storage_f16_scalar_matches_vector_unpack) {
+    if (!storage::hardware()) return;
+    const std::string all = all_halves();
+    std::vector<double> hw, sw;
+    storage::unpack(ValueStorage::F16, all.data(), 0x10000, &hw);
+    storage::force_scalar(true);
+    storage::unpack(ValueStorage::F16, all.data(), 0x10000, &sw);
+    storage::force_scalar(false);
+    CHECK_EQ(hw.size(), sw.size());
+    size_t mismatched = 0;
+    for (size_t i = 0; i < hw.size() && i < sw.size(); ++i) mismatched += !same_double(hw[i], sw[i]);
+    CHECK_EQ(mismatched, size_t{0});
+}
+
+TEST(storage_f16_overflow_falls_back) {
+    for (bool scalar : {false, true}) {
+        storage::force_scalar(scalar);
+        std::vector<double> v(20, 1.5);
+        v[13] = 65520;  // rounds to inf as a half
+        v[14] = std::numeric_limits<double>::infinity();
+        std::string packed;
+        CHECK(storage::pack(ValueStorage::F16, 1, v.data(), v.size(), &packed) == ValueStorage::F32);
+        std::vector<double> back;
+        storage::unpack(ValueStorage::F32, packed.data(), v.size(), &back);
+        CHECK_EQ(back[13], 65520.0);
+        CHECK_EQ(back[0], 1.5);
+
+        // Infinity alone is not a reason to widen.
+        v[13] = 1.5;
+        packed.clear();
+        CHECK(storage::pack(ValueStorage::F16, 1, v.data(), v.size(), &packed) == ValueStorage::F16);
+    }
+    storage::force_scalar(false);
+}
+
+TEST(storage_fixed_point_error_within_half_step) {
+    std::mt19937_64 rng(490);
+    const double step = 0.01;
+    std::vector<double> v(4099);
+    for (double& x : v) x = std::uniform_real_distribution<double>(1000, 1300)(rng);
+    v[100] = std::numeric_limits<double>::quiet_NaN();
+
+    std::string packed;
+    CHECK(storage::pack(ValueStorage::Fixed16, step, v.data(), v.size(), &packed) == ValueStorage::Fixed16);
+    CHECK_EQ(packed.size(), storage::packed_size(ValueStorage::Fixed16, v.size()));
+    std::vector<double> back;
+    storage::unpack(ValueStorage::Fixed16, packed.data(), v.size(), &back);
+    double worst = 0;
+    for (size_t i = 0; i < v.size(); ++i)
+        if (i != 100) worst = std::max(worst, std::fabs(back[i] - v[i]));
+    CHECK(worst <= step / 2 * (1 + 1e-9));
+    CHECK(std::isnan(back[100]));
+
+    // 65536 steps do not fit in 16 bits; 32 do.
+    v[0] = v[1] + 70000 * step;
+    packed.clear();
+    CHECK(storage::pack(ValueStorage::Fixed16, step, v.data(), v.size(), &packed) == ValueStorage::Fixed32);
+    v[0] = 1e300;
+    packed.clear();
+    CHECK(storage::pack(ValueStorage::Fixed16, step, v.data(), v.size(), &packed) == ValueStorage::F64);
+}
+
+}  // namespace fr